@@ -0,0 +1,141 @@
+#include "AtlasPacker.h"
+
+#include <algorithm>
+
+namespace
+{
+	struct Shelf
+	{
+		int Y = 0;
+		int Height = 0;
+		int NextX = 0;
+	};
+
+	struct OpenPage
+	{
+		std::vector<Shelf> Shelves;
+		std::vector<int> Members;
+		int Width = 0;
+		int Height = 0;
+	};
+}
+
+AtlasLayout AtlasPacker::Pack(const std::vector<AtlasEntry>& entries, const AtlasSettings& settings)
+{
+	AtlasLayout layout;
+	layout.Placements.resize(entries.size());
+
+	//tallest first keeps the shelves tight, ties keep their order so the same input packs the same way
+	std::vector<int> order;
+	for (int i = 0; i < static_cast<int>(entries.size()); i++)
+	{
+		if (CanPack(entries[i], settings))
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&entries](const int a, const int b)
+		{
+			if (entries[a].Group != entries[b].Group)
+				return entries[a].Group < entries[b].Group;
+			if (entries[a].Height != entries[b].Height)
+				return entries[a].Height > entries[b].Height;
+			return entries[a].Width > entries[b].Width;
+		});
+
+	size_t begin = 0;
+	while (begin < order.size())
+	{
+		const std::uint32_t group = entries[order[begin]].Group;
+		size_t end = begin;
+		while (end < order.size() && entries[order[end]].Group == group)
+			end++;
+
+		std::vector<OpenPage> pages;
+		for (size_t k = begin; k < end; k++)
+		{
+			const int index = order[k];
+			const AtlasEntry& entry = entries[index];
+			const int alignment = Alignment(entry, settings);
+			const int cellWidth = entry.Width + alignment;
+			const int cellHeight = entry.Height + alignment;
+
+			//first shelf with room on any page, then a new shelf, then a new page
+			int pageIndex = -1;
+			int x = 0;
+			int y = 0;
+			for (size_t p = 0; p < pages.size() && pageIndex < 0; p++)
+			{
+				for (Shelf& shelf : pages[p].Shelves)
+				{
+					if (cellHeight <= shelf.Height && shelf.NextX + cellWidth <= settings.PageSize)
+					{
+						pageIndex = static_cast<int>(p);
+						x = shelf.NextX;
+						y = shelf.Y;
+						shelf.NextX += cellWidth;
+						break;
+					}
+				}
+				if (pageIndex < 0 && pages[p].Height + cellHeight <= settings.PageSize)
+				{
+					pageIndex = static_cast<int>(p);
+					y = pages[p].Height;
+					pages[p].Shelves.push_back({ y, cellHeight, cellWidth });
+					pages[p].Height += cellHeight;
+				}
+			}
+			if (pageIndex < 0)
+			{
+				pageIndex = static_cast<int>(pages.size());
+				pages.emplace_back();
+				pages.back().Shelves.push_back({ 0, cellHeight, cellWidth });
+				pages.back().Height = cellHeight;
+			}
+
+			OpenPage& page = pages[pageIndex];
+			page.Members.push_back(index);
+			page.Width = (std::max)(page.Width, x + cellWidth);
+			layout.Placements[index] = { pageIndex, x, y };
+		}
+
+		//a page holding a single texture saves no view
+		for (const OpenPage& page : pages)
+		{
+			const int pageIndex = page.Members.size() < 2 ? -1 : static_cast<int>(layout.Pages.size());
+			if (pageIndex >= 0)
+				layout.Pages.push_back({ group, page.Width, page.Height, static_cast<int>(page.Members.size()) });
+			for (const int member : page.Members)
+				layout.Placements[member].Page = pageIndex;
+		}
+
+		begin = end;
+	}
+	return layout;
+}
+
+AtlasUvRect AtlasPacker::UvRect(const AtlasEntry& entry, const AtlasPlacement& placement, const AtlasPage& page)
+{
+	if (placement.Page < 0 || page.Width <= 0 || page.Height <= 0)
+		return {};
+
+	const float width = static_cast<float>(page.Width);
+	const float height = static_cast<float>(page.Height);
+	return { entry.Width / width, entry.Height / height, placement.X / width, placement.Y / height };
+}
+
+int AtlasPacker::Alignment(const AtlasEntry& entry, const AtlasSettings& settings)
+{
+	return (std::max)(entry.BlockSize, 1) << ((std::max)(settings.MipCount, 1) - 1);
+}
+
+bool AtlasPacker::CanPack(const AtlasEntry& entry, const AtlasSettings& settings)
+{
+	if (entry.Width <= 0 || entry.Height <= 0 || entry.BlockSize <= 0 || settings.MipCount <= 0)
+		return false;
+	if (entry.Width > settings.MaxEntrySize || entry.Height > settings.MaxEntrySize || entry.MipCount < settings.MipCount)
+		return false;
+
+	//every kept mip has to be made of whole blocks and the entry has to fit a page with its gutter
+	const int alignment = Alignment(entry, settings);
+	return entry.Width % alignment == 0 && entry.Height % alignment == 0 &&
+		entry.Width + alignment <= settings.PageSize && entry.Height + alignment <= settings.PageSize;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct AtlasEntry
+{
+	int Width = 0;
+	int Height = 0;
+	int MipCount = 1;
+	//entries only share a page with their own group, the texture format
+	std::uint32_t Group = 0;
+	//texels per side of a compression block, 1 for uncompressed formats
+	int BlockSize = 1;
+};
+
+struct AtlasSettings
+{
+	int PageSize = 2048;
+	//bigger textures gain little from sharing a page and keep their own views
+	int MaxEntrySize = 256;
+	//mips every page keeps, entries need at least as many
+	int MipCount = 4;
+};
+
+struct AtlasPlacement
+{
+	//-1 when the entry stays on its own
+	int Page = -1;
+	int X = 0;
+	int Y = 0;
+};
+
+struct AtlasPage
+{
+	std::uint32_t Group = 0;
+	int Width = 0;
+	int Height = 0;
+	int Entries = 0;
+};
+
+struct AtlasLayout
+{
+	std::vector<AtlasPlacement> Placements;
+	std::vector<AtlasPage> Pages;
+};
+
+//where an entry lands inside its page, in uvs: scale first, then offset
+struct AtlasUvRect
+{
+	float ScaleU = 1.0f;
+	float ScaleV = 1.0f;
+	float OffsetU = 0.0f;
+	float OffsetV = 0.0f;
+};
+
+//packs small textures of the same format into shared pages so draws stop switching views.
+//shelf packing, tallest first. every entry starts on a grid coarse enough that each of the
+//page's mips is made of whole blocks, and keeps one grid cell free to its right and below
+//for the gutter that stops filtering from reaching a neighbour. has no device dependency
+class AtlasPacker
+{
+public:
+	//entries that do not fit the rules or would end up alone on a page keep Page -1
+	static AtlasLayout Pack(const std::vector<AtlasEntry>& entries, const AtlasSettings& settings);
+	static AtlasUvRect UvRect(const AtlasEntry& entry, const AtlasPlacement& placement, const AtlasPage& page);
+	//grid entries start on, also the free space kept after each of them
+	static int Alignment(const AtlasEntry& entry, const AtlasSettings& settings);
+	static bool CanPack(const AtlasEntry& entry, const AtlasSettings& settings);
+};
@@ -18,6 +18,31 @@ std::wstring BasicUtil::GetCroppedName(const WCHAR* filename)
 	return name.substr(0, name.size() - 4);
 }
 
+std::wstring BasicUtil::CanonicalPath(const WCHAR* filename)
+{
+	std::wstring path(MAX_PATH, L'\0');
+	DWORD length = GetFullPathNameW(filename, static_cast<DWORD>(path.size()), &path[0], nullptr);
+	if (length > path.size())
+	{
+		path.resize(length);
+		length = GetFullPathNameW(filename, static_cast<DWORD>(path.size()), &path[0], nullptr);
+	}
+	if (length == 0)
+	{
+		path = filename;
+	}
+	else
+	{
+		path.resize(length);
+	}
+
+	for (auto& c : path)
+	{
+		c = c == L'/' ? L'\\' : towlower(c);
+	}
+	return path;
+}
+
 std::string BasicUtil::TrimName(const std::string& name, int border)
 {
 	return name.size() > border ? name.substr(0, 12) + "..." : name;
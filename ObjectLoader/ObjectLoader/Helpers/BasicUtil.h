@@ -14,6 +14,8 @@ public:
 	static bool TryToOpenFile(const WCHAR* extension1, const WCHAR* extension2, PWSTR& filePath);
 	static void ChangeTextureState(ID3D12GraphicsCommandList4* cmdList, RtvSrvTexture& texture, D3D12_RESOURCE_STATES newState);
 	static std::string WStringToUtf8(const std::wstring& wstr);
+	//absolute, lowercase, backslash separated, so one file always maps to one key
+	static std::wstring CanonicalPath(const WCHAR* filename);
 
 	//helper with enums
 	template<typename E>
@@ -0,0 +1,130 @@
+#include "CasterVolume.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	//corner indices of every face of a hexahedron in BoundingFrustum::GetCorners order
+	constexpr int Faces[6][4] =
+	{
+		{ 0, 1, 2, 3 }, //near
+		{ 4, 5, 6, 7 }, //far
+		{ 0, 1, 5, 4 }, //top
+		{ 1, 2, 6, 5 }, //right
+		{ 2, 3, 7, 6 }, //bottom
+		{ 3, 0, 4, 7 }  //left
+	};
+
+	//both corners of every edge and the two faces meeting there
+	constexpr int Edges[12][4] =
+	{
+		{ 0, 1, 0, 2 }, { 1, 2, 0, 3 }, { 2, 3, 0, 4 }, { 3, 0, 0, 5 },
+		{ 4, 5, 1, 2 }, { 5, 6, 1, 3 }, { 6, 7, 1, 4 }, { 7, 4, 1, 5 },
+		{ 0, 4, 2, 5 }, { 1, 5, 2, 3 }, { 2, 6, 3, 4 }, { 3, 7, 4, 5 }
+	};
+
+	//plane through point with the given normal, flipped so that inside ends up behind it
+	XMFLOAT4 OrientedPlane(FXMVECTOR normal, FXMVECTOR point, FXMVECTOR inside)
+	{
+		XMVECTOR n = XMVector3Normalize(normal);
+		if (XMVectorGetX(XMVector3Dot(n, inside - point)) > 0.0f)
+			n = XMVectorNegate(n);
+
+		XMFLOAT4 plane;
+		XMStoreFloat4(&plane, n);
+		plane.w = -XMVectorGetX(XMVector3Dot(n, point));
+		return plane;
+	}
+}
+
+CasterVolume CasterVolume::FromReceivers(const XMFLOAT3 (&corners)[8], FXMVECTOR lightDirection)
+{
+	XMVECTOR points[8];
+	XMVECTOR center = XMVectorZero();
+	for (int i = 0; i < 8; i++)
+	{
+		points[i] = XMLoadFloat3(&corners[i]);
+		center += points[i];
+	}
+	center /= 8.0f;
+	const XMVECTOR light = XMVector3Normalize(lightDirection);
+
+	CasterVolume volume;
+	XMFLOAT4 facePlanes[6];
+	bool facesLight[6];
+	for (int face = 0; face < 6; face++)
+	{
+		//newell's normal, stays sane for the tiny near face
+		XMVECTOR normal = XMVectorZero();
+		XMVECTOR faceCenter = XMVectorZero();
+		for (int i = 0; i < 4; i++)
+		{
+			const XMVECTOR current = points[Faces[face][i]];
+			const XMVECTOR next = points[Faces[face][(i + 1) % 4]];
+			normal += XMVector3Cross(current, next);
+			faceCenter += current;
+		}
+		facePlanes[face] = OrientedPlane(normal, faceCenter / 4.0f, center);
+		//a face the light enters through stops nothing, casters sit anywhere in front of it
+		facesLight[face] = facePlanes[face].x * XMVectorGetX(light) + facePlanes[face].y * XMVectorGetY(light) +
+			facePlanes[face].z * XMVectorGetZ(light) < 0.0f;
+		if (!facesLight[face])
+			volume.Add(facePlanes[face]);
+	}
+
+	//the sides of the sweep run along the light through the edges between lit and unlit faces
+	for (const auto& edge : Edges)
+	{
+		if (facesLight[edge[2]] == facesLight[edge[3]])
+			continue;
+		const XMVECTOR normal = XMVector3Cross(points[edge[1]] - points[edge[0]], light);
+		//an edge along the light adds nothing, leaving it out only makes the volume larger
+		if (XMVectorGetX(XMVector3LengthSq(normal)) < 1e-12f)
+			continue;
+		volume.Add(OrientedPlane(normal, points[edge[0]], center));
+	}
+	return volume;
+}
+
+void CasterVolume::FrustumSlice(const BoundingFrustum& viewFrustum, FXMMATRIX invView, const float nearDepth, const float farDepth,
+                                XMFLOAT3 (&corners)[8])
+{
+	//a view space frustum from a projection, every corner ray starts at the eye
+	XMFLOAT3 frustumCorners[BoundingFrustum::CORNER_COUNT];
+	viewFrustum.GetCorners(frustumCorners);
+	for (int i = 0; i < 4; i++)
+	{
+		const XMVECTOR ray = XMLoadFloat3(&frustumCorners[i]) / frustumCorners[i].z;
+		XMStoreFloat3(&corners[i], XMVector3TransformCoord(ray * nearDepth, invView));
+		XMStoreFloat3(&corners[i + 4], XMVector3TransformCoord(ray * farDepth, invView));
+	}
+}
+
+void CasterVolume::Clip(const CullingPlanes& planes)
+{
+	for (const auto& plane : planes.Planes)
+		Add(plane);
+}
+
+ContainmentType CasterVolume::Contains(const BoundingBox& box) const
+{
+	bool inside = true;
+	for (int i = 0; i < _count; i++)
+	{
+		const XMFLOAT4& plane = _planes[i];
+		const float distance = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+		const float radius = std::abs(plane.x) * box.Extents.x + std::abs(plane.y) * box.Extents.y + std::abs(plane.z) * box.Extents.z;
+		if (distance > radius)
+			return DISJOINT;
+		inside = inside && distance <= -radius;
+	}
+	return inside ? CONTAINS : INTERSECTS;
+}
+
+void CasterVolume::Add(const XMFLOAT4& plane)
+{
+	if (_count < MaxPlanes)
+		_planes[_count++] = plane;
+}
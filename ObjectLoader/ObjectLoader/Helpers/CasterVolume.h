@@ -0,0 +1,34 @@
+#pragma once
+#include <DirectXCollision.h>
+#include "CullingKernel.h"
+
+//convex volume holding every point that can throw a directional light's shadow onto a set of receivers:
+//the receivers swept back toward the light. anything outside it has nothing to shade
+class CasterVolume
+{
+public:
+	//corners of a convex hexahedron in BoundingFrustum::GetCorners order, near face then far face.
+	//lightDirection is the way the light travels
+	static CasterVolume FromReceivers(const DirectX::XMFLOAT3 (&corners)[8], DirectX::FXMVECTOR lightDirection);
+	//world space corners of the camera frustum between two view depths
+	static void FrustumSlice(const DirectX::BoundingFrustum& viewFrustum, DirectX::FXMMATRIX invView, float nearDepth, float farDepth,
+	                         DirectX::XMFLOAT3 (&corners)[8]);
+
+	//keeps only the part inside planes as well
+	void Clip(const CullingPlanes& planes);
+	//plane tests only, boxes outside near a corner of the volume count as intersecting
+	DirectX::ContainmentType Contains(const DirectX::BoundingBox& box) const;
+
+	int PlaneCount() const { return _count; }
+	const DirectX::XMFLOAT4& Plane(const int i) const { return _planes[i]; }
+
+	//six faces, a silhouette plane per edge and a clipping box
+	static constexpr int MaxPlanes = 24;
+
+private:
+	void Add(const DirectX::XMFLOAT4& plane);
+
+	//outward facing, a point is inside when dot(n, p) + d <= 0 for all of them
+	DirectX::XMFLOAT4 _planes[MaxPlanes] = {};
+	int _count = 0;
+};
@@ -0,0 +1,99 @@
+#include "CullCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	CullingPlanes OffsetPlanes(const CullingPlanes& planes, const float offset)
+	{
+		CullingPlanes result = planes;
+		for (auto& plane : result.Planes)
+			plane.w += offset;
+		return result;
+	}
+}
+
+CullCache::Reuse CullCache::Cull(const SceneBvh& bvh, const std::vector<BoundingBox>& bounds, const CullingPlanes& planes,
+                                 const uint32_t sceneVersion, std::vector<int>& visible)
+{
+	const bool sameScene = _valid && _sceneVersion == sceneVersion;
+	if (sameScene && Drift(_planes, planes) == 0.0f)
+	{
+		_lastReuse = Reuse::Exact;
+		visible = _result;
+		return _lastReuse;
+	}
+
+	if (sameScene && Drift(_buildPlanes, planes) < Margin)
+	{
+		_lastReuse = Reuse::Band;
+	}
+	else
+	{
+		Build(bvh, bounds, planes);
+		_sceneVersion = sceneVersion;
+		_valid = true;
+		_lastReuse = Reuse::None;
+	}
+
+	_planes = planes;
+	_visible = _inside;
+	for (const int i : _band)
+	{
+		if (planes.Contains(bounds[i]) != DISJOINT)
+			_visible.Set(i);
+	}
+
+	//the mask keeps the result ascending without sorting it
+	_result.clear();
+	_visible.ForEach([this](const size_t i) { _result.push_back(static_cast<int>(i)); });
+	visible = _result;
+	return _lastReuse;
+}
+
+float CullCache::Drift(const CullingPlanes& from, const CullingPlanes& to) const
+{
+	//a box is in front of or behind a plane by where its corners are, and a corner p moves against it by
+	//dn . (p - origin) + dw, where dw is the change of the plane's distance to the scene origin.
+	//every corner is within the scene box, so no more than |dn| * reach + |dw|
+	float drift = 0.0f;
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& a = from.Planes[i];
+		const XMFLOAT4& b = to.Planes[i];
+		const float dx = b.x - a.x;
+		const float dy = b.y - a.y;
+		const float dz = b.z - a.z;
+		const float dw = dx * _origin.x + dy * _origin.y + dz * _origin.z + b.w - a.w;
+		drift = (std::max)(drift, std::sqrt(dx * dx + dy * dy + dz * dz) * _reach + std::abs(dw));
+	}
+	return drift;
+}
+
+void CullCache::Build(const SceneBvh& bvh, const std::vector<BoundingBox>& bounds, const CullingPlanes& planes)
+{
+	_buildPlanes = planes;
+
+	const BoundingBox scene = bvh.RootBox();
+	_origin = scene.Center;
+	_reach = std::sqrt(scene.Extents.x * scene.Extents.x + scene.Extents.y * scene.Extents.y + scene.Extents.z * scene.Extents.z);
+
+	//anything outside the pushed out planes stays outside, anything inside the pulled in ones stays in
+	_band.clear();
+	bvh.Query(OffsetPlanes(planes, -Margin), _band);
+
+	const CullingPlanes inner = OffsetPlanes(planes, Margin);
+	_inside.Reset(bounds.size());
+	size_t bandCount = 0;
+	for (const int i : _band)
+	{
+		if (inner.Contains(bounds[i]) != DISJOINT)
+			_inside.Set(i);
+		else
+			_band[bandCount++] = i;
+	}
+	_band.resize(bandCount);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+#include "SceneBvh.h"
+
+//last cull of one view, reused while the scene is still and no box can have moved
+//by Margin against any plane since the last full cull. turning the view counts too,
+//a plane turned by a small angle moves the boxes far from the scene center the most
+class CullCache
+{
+public:
+	enum class Reuse
+	{
+		//culled from scratch against the bvh
+		None,
+		//same planes and scene, the last result as is
+		Exact,
+		//only the boxes near the planes were tested again
+		Band
+	};
+
+	//fills visible with ascending indices of the boxes the planes do not reject,
+	//sceneVersion has to change whenever any of the boxes did
+	Reuse Cull(const SceneBvh& bvh, const std::vector<DirectX::BoundingBox>& bounds, const CullingPlanes& planes,
+	           uint32_t sceneVersion, std::vector<int>& visible);
+	//forces the next cull to start from scratch
+	void Invalidate() { _valid = false; }
+
+	Reuse LastReuse() const { return _lastReuse; }
+
+	//world units the planes are pushed out and pulled in by on a full cull
+	static constexpr float Margin = 0.5f;
+
+private:
+	//most any box moved against one of the planes since the last full cull
+	float Drift(const CullingPlanes& from, const CullingPlanes& to) const;
+	void Build(const SceneBvh& bvh, const std::vector<DirectX::BoundingBox>& bounds, const CullingPlanes& planes);
+
+	//planes of the last full cull, and of the last cull of any kind
+	CullingPlanes _buildPlanes = {};
+	CullingPlanes _planes = {};
+	//middle of the scene box and its half diagonal, at the last full cull
+	DirectX::XMFLOAT3 _origin = {};
+	float _reach = 0.0f;
+	uint32_t _sceneVersion = 0;
+	bool _valid = false;
+	Reuse _lastReuse = Reuse::None;
+
+	//stay visible while the planes move less than Margin
+	VisibilityMask _inside;
+	//within Margin of a plane, tested every frame
+	std::vector<int> _band;
+	VisibilityMask _visible;
+	std::vector<int> _result;
+};
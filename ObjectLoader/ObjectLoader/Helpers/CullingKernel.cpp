@@ -0,0 +1,198 @@
+#include "CullingKernel.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	XMFLOAT4 StorePlane(const FXMVECTOR plane)
+	{
+		XMFLOAT4 result;
+		XMStoreFloat4(&result, plane);
+		return result;
+	}
+
+	//outward plane through center + normal * extent
+	XMFLOAT4 FacePlane(const FXMVECTOR normal, const FXMVECTOR center, const float extent)
+	{
+		XMFLOAT4 plane;
+		XMStoreFloat4(&plane, normal);
+		plane.w = -XMVectorGetX(XMVector3Dot(normal, center)) - extent;
+		return plane;
+	}
+}
+
+void AabbSoa::Resize(const size_t count)
+{
+	_count = count;
+	//a group may start at the last box, and avx reads whole groups of eight
+	const size_t padded = (count + CullingKernel::GroupSize - 1 + 7) & ~static_cast<size_t>(7);
+	for (auto array : { &CenterX, &CenterY, &CenterZ, &ExtentX, &ExtentY, &ExtentZ })
+		array->assign(padded, 0.0f);
+}
+
+void AabbSoa::Set(const size_t index, const BoundingBox& box)
+{
+	CenterX[index] = box.Center.x;
+	CenterY[index] = box.Center.y;
+	CenterZ[index] = box.Center.z;
+	ExtentX[index] = box.Extents.x;
+	ExtentY[index] = box.Extents.y;
+	ExtentZ[index] = box.Extents.z;
+}
+
+void VisibilityMask::Reset(const size_t count)
+{
+	_count = count;
+	_words.assign((count + 31) / 32, 0u);
+}
+
+size_t VisibilityMask::Count() const
+{
+	size_t count = 0;
+	ForEach([&count](size_t) { count++; });
+	return count;
+}
+
+CullingPlanes CullingPlanes::FromFrustum(const BoundingFrustum& frustum)
+{
+	XMVECTOR planes[6];
+	frustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+	CullingPlanes result;
+	for (int i = 0; i < 6; i++)
+		result.Planes[i] = StorePlane(planes[i]);
+	return result;
+}
+
+CullingPlanes CullingPlanes::FromOrientedBox(const BoundingOrientedBox& box)
+{
+	const XMVECTOR orientation = XMLoadFloat4(&box.Orientation);
+	const XMVECTOR center = XMLoadFloat3(&box.Center);
+	const float extents[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+	const XMVECTOR axes[3] =
+	{
+		XMVector3Rotate(g_XMIdentityR0, orientation),
+		XMVector3Rotate(g_XMIdentityR1, orientation),
+		XMVector3Rotate(g_XMIdentityR2, orientation)
+	};
+
+	CullingPlanes result;
+	for (int i = 0; i < 3; i++)
+	{
+		result.Planes[i * 2] = FacePlane(axes[i], center, extents[i]);
+		result.Planes[i * 2 + 1] = FacePlane(XMVectorNegate(axes[i]), center, extents[i]);
+	}
+	return result;
+}
+
+ContainmentType CullingPlanes::Contains(const BoundingBox& box) const
+{
+	bool inside = true;
+	for (const auto& plane : Planes)
+	{
+		//summed in the order the simd paths use, so all of them agree on boxes touching a plane
+		const float distance = plane.x * box.Center.x + plane.w + plane.y * box.Center.y + plane.z * box.Center.z;
+		const float radius = std::abs(plane.x) * box.Extents.x + std::abs(plane.y) * box.Extents.y + std::abs(plane.z) * box.Extents.z;
+		if (distance > radius)
+			return DISJOINT;
+		inside = inside && distance <= -radius;
+	}
+	return inside ? CONTAINS : INTERSECTS;
+}
+
+uint32_t CullingKernel::TestGroup(const CullingPlanes& planes, const AabbSoa& boxes, const size_t first)
+{
+#if defined(_XM_SSE_INTRINSICS_)
+	const __m128 centerX = _mm_loadu_ps(&boxes.CenterX[first]);
+	const __m128 centerY = _mm_loadu_ps(&boxes.CenterY[first]);
+	const __m128 centerZ = _mm_loadu_ps(&boxes.CenterZ[first]);
+	const __m128 extentX = _mm_loadu_ps(&boxes.ExtentX[first]);
+	const __m128 extentY = _mm_loadu_ps(&boxes.ExtentY[first]);
+	const __m128 extentZ = _mm_loadu_ps(&boxes.ExtentZ[first]);
+
+	__m128 outside = _mm_setzero_ps();
+	for (const auto& plane : planes.Planes)
+	{
+		//signed distance of the centers against the projected half size of the boxes
+		__m128 distance = _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+		distance = _mm_add_ps(distance, _mm_mul_ps(centerY, _mm_set1_ps(plane.y)));
+		distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, _mm_set1_ps(plane.z)));
+		__m128 radius = _mm_mul_ps(extentX, _mm_set1_ps(std::abs(plane.x)));
+		radius = _mm_add_ps(radius, _mm_mul_ps(extentY, _mm_set1_ps(std::abs(plane.y))));
+		radius = _mm_add_ps(radius, _mm_mul_ps(extentZ, _mm_set1_ps(std::abs(plane.z))));
+		outside = _mm_or_ps(outside, _mm_cmpgt_ps(distance, radius));
+	}
+	return ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu;
+#else
+	uint32_t visible = 0;
+	for (size_t i = 0; i < GroupSize; i++)
+	{
+		bool outside = false;
+		for (const auto& plane : planes.Planes)
+		{
+			const size_t box = first + i;
+			const float distance = plane.x * boxes.CenterX[box] + plane.w + plane.y * boxes.CenterY[box] + plane.z * boxes.CenterZ[box];
+			const float radius = std::abs(plane.x) * boxes.ExtentX[box] + std::abs(plane.y) * boxes.ExtentY[box] + std::abs(plane.z) * boxes.ExtentZ[box];
+			outside = outside || distance > radius;
+		}
+		visible |= outside ? 0u : 1u << i;
+	}
+	return visible;
+#endif
+}
+
+void CullingKernel::Cull(const CullingPlanes& planes, const AabbSoa& boxes, VisibilityMask& visible)
+{
+	const size_t count = boxes.Size();
+	visible.Reset(count);
+	auto& words = visible.Words();
+
+#if defined(_XM_AVX_INTRINSICS_)
+	//eight boxes per step, four steps fill one mask word
+	__m256 normalX[6], normalY[6], normalZ[6], absX[6], absY[6], absZ[6], offset[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = planes.Planes[p];
+		normalX[p] = _mm256_set1_ps(plane.x);
+		normalY[p] = _mm256_set1_ps(plane.y);
+		normalZ[p] = _mm256_set1_ps(plane.z);
+		absX[p] = _mm256_set1_ps(std::abs(plane.x));
+		absY[p] = _mm256_set1_ps(std::abs(plane.y));
+		absZ[p] = _mm256_set1_ps(std::abs(plane.z));
+		offset[p] = _mm256_set1_ps(plane.w);
+	}
+
+	for (size_t first = 0; first < count; first += 8)
+	{
+		const __m256 centerX = _mm256_loadu_ps(&boxes.CenterX[first]);
+		const __m256 centerY = _mm256_loadu_ps(&boxes.CenterY[first]);
+		const __m256 centerZ = _mm256_loadu_ps(&boxes.CenterZ[first]);
+		const __m256 extentX = _mm256_loadu_ps(&boxes.ExtentX[first]);
+		const __m256 extentY = _mm256_loadu_ps(&boxes.ExtentY[first]);
+		const __m256 extentZ = _mm256_loadu_ps(&boxes.ExtentZ[first]);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(centerX, normalX[p]), offset[p]);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(centerY, normalY[p]));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(centerZ, normalZ[p]));
+			__m256 radius = _mm256_mul_ps(extentX, absX[p]);
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(extentY, absY[p]));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(extentZ, absZ[p]));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, radius, _CMP_GT_OQ));
+		}
+		const uint32_t bits = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu;
+		words[first >> 5] |= bits << (first & 31);
+	}
+#else
+	for (size_t first = 0; first < count; first += GroupSize)
+		words[first >> 5] |= TestGroup(planes, boxes, first) << (first & 31);
+#endif
+
+	//padding boxes past the end are zero sized at the origin and may have passed
+	if (count % 32 != 0)
+		words.back() &= (1u << (count % 32)) - 1u;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//world space boxes with one array per component so the kernel loads several boxes at once
+class AabbSoa
+{
+public:
+	//arrays are padded past count so groups starting at any index can be loaded
+	void Resize(size_t count);
+	void Set(size_t index, const DirectX::BoundingBox& box);
+	size_t Size() const { return _count; }
+
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> ExtentX;
+	std::vector<float> ExtentY;
+	std::vector<float> ExtentZ;
+
+private:
+	size_t _count = 0;
+};
+
+//one bit per object, set when the object survived culling
+class VisibilityMask
+{
+public:
+	//clears every bit
+	void Reset(size_t count);
+	void Set(size_t index) { _words[index >> 5] |= 1u << (index & 31); }
+	void Clear(size_t index) { _words[index >> 5] &= ~(1u << (index & 31)); }
+	bool Test(size_t index) const { return (_words[index >> 5] >> (index & 31) & 1u) != 0; }
+	size_t Size() const { return _count; }
+	size_t Count() const;
+
+	//calls fn(index) for every set bit in ascending order
+	template<typename Fn>
+	void ForEach(const Fn& fn) const;
+
+	std::vector<uint32_t>& Words() { return _words; }
+	const std::vector<uint32_t>& Words() const { return _words; }
+
+private:
+	std::vector<uint32_t> _words;
+	size_t _count = 0;
+};
+
+//convex volume as outward facing planes, a point is inside when dot(n, p) + d <= 0 for all of them
+struct CullingPlanes
+{
+	DirectX::XMFLOAT4 Planes[6];
+
+	static CullingPlanes FromFrustum(const DirectX::BoundingFrustum& frustum);
+	static CullingPlanes FromOrientedBox(const DirectX::BoundingOrientedBox& box);
+
+	//plane tests only, boxes outside near a corner of the volume count as intersecting
+	DirectX::ContainmentType Contains(const DirectX::BoundingBox& box) const;
+};
+
+//box against plane tests, four boxes per instruction with sse and eight with avx
+class CullingKernel
+{
+public:
+	//bit i of the result is set when box first + i is not outside any plane
+	static uint32_t TestGroup(const CullingPlanes& planes, const AabbSoa& boxes, size_t first);
+	//tests every box and writes the result into visible
+	static void Cull(const CullingPlanes& planes, const AabbSoa& boxes, VisibilityMask& visible);
+
+	static constexpr size_t GroupSize = 4;
+};
+
+template<typename Fn>
+void VisibilityMask::ForEach(const Fn& fn) const
+{
+	for (size_t word = 0; word < _words.size(); word++)
+	{
+		uint32_t bits = _words[word];
+		while (bits != 0)
+		{
+			//lowest set bit first
+#ifdef _MSC_VER
+			unsigned long bit;
+			_BitScanForward(&bit, bits);
+#else
+			const unsigned bit = static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+			fn(word * 32 + bit);
+			bits &= bits - 1;
+		}
+	}
+}
@@ -0,0 +1,291 @@
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr std::uint32_t gDdsMagic = 0x20534444; //"DDS "
+	constexpr size_t gHeaderSize = 124;
+	constexpr size_t gDx10HeaderSize = 20;
+
+	//byte offsets inside DDS_HEADER, which starts right after the magic
+	constexpr size_t gHeightOffset = 8;
+	constexpr size_t gWidthOffset = 12;
+	constexpr size_t gDepthOffset = 20;
+	constexpr size_t gMipCountOffset = 24;
+	constexpr size_t gPixelFormatOffset = 72;
+	constexpr size_t gCaps2Offset = 108;
+
+	//byte offsets inside DDS_PIXELFORMAT
+	constexpr size_t gPfFlagsOffset = 4;
+	constexpr size_t gPfFourCcOffset = 8;
+	constexpr size_t gPfBitCountOffset = 12;
+	constexpr size_t gPfMasksOffset = 16;
+
+	constexpr std::uint32_t gPfAlphaPixels = 0x1;
+	constexpr std::uint32_t gPfFourCc = 0x4;
+	constexpr std::uint32_t gPfRgb = 0x40;
+	constexpr std::uint32_t gPfLuminance = 0x20000;
+
+	constexpr std::uint32_t gCaps2Cubemap = 0x200;
+	constexpr std::uint32_t gCaps2AllFaces = 0xFC00;
+	constexpr std::uint32_t gCaps2Volume = 0x200000;
+
+	constexpr std::uint32_t gDx10Texture2D = 3;
+	constexpr std::uint32_t gDx10MiscTextureCube = 0x4;
+
+	std::uint32_t ReadU32(const std::uint8_t* data)
+	{
+		std::uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	constexpr std::uint32_t FourCc(const char a, const char b, const char c, const char d)
+	{
+		return static_cast<std::uint32_t>(a) | static_cast<std::uint32_t>(b) << 8 |
+			static_cast<std::uint32_t>(c) << 16 | static_cast<std::uint32_t>(d) << 24;
+	}
+
+	//bytes per 4x4 block, 0 if not block compressed
+	size_t BlockBytes(const DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			return 8;
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	size_t BitsPerPixel(const DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return 128;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R32G32_FLOAT:
+			return 64;
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+		case DXGI_FORMAT_R11G11B10_FLOAT:
+		case DXGI_FORMAT_R16G16_FLOAT:
+		case DXGI_FORMAT_R16G16_UNORM:
+		case DXGI_FORMAT_R32_FLOAT:
+			return 32;
+		case DXGI_FORMAT_R8G8_UNORM:
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_R16_UNORM:
+			return 16;
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_A8_UNORM:
+			return 8;
+		default:
+			return 0;
+		}
+	}
+}
+
+bool DdsFile::ComputePitch(const DXGI_FORMAT format, const std::uint32_t width, const std::uint32_t height, size_t& rowPitch, size_t& rowCount)
+{
+	const size_t blockBytes = BlockBytes(format);
+	if (blockBytes > 0)
+	{
+		rowPitch = (std::max)(size_t(1), (static_cast<size_t>(width) + 3) / 4) * blockBytes;
+		rowCount = (std::max)(size_t(1), (static_cast<size_t>(height) + 3) / 4);
+		return true;
+	}
+
+	const size_t bits = BitsPerPixel(format);
+	if (bits == 0)
+	{
+		return false;
+	}
+	rowPitch = (static_cast<size_t>(width) * bits + 7) / 8;
+	rowCount = height;
+	return true;
+}
+
+bool DdsFile::Parse(const std::uint8_t* data, const size_t size, DdsLayout& layout)
+{
+	if (size < sizeof(std::uint32_t) + gHeaderSize || ReadU32(data) != gDdsMagic || ReadU32(data + 4) != gHeaderSize)
+	{
+		return false;
+	}
+
+	const std::uint8_t* header = data + sizeof(std::uint32_t);
+	const std::uint8_t* pixelFormat = header + gPixelFormatOffset;
+	const std::uint32_t caps2 = ReadU32(header + gCaps2Offset);
+	size_t offset = sizeof(std::uint32_t) + gHeaderSize;
+
+	layout = {};
+	layout.Width = ReadU32(header + gWidthOffset);
+	layout.Height = ReadU32(header + gHeightOffset);
+	layout.MipCount = (std::max)(1u, ReadU32(header + gMipCountOffset));
+
+	const bool hasDx10 = (ReadU32(pixelFormat + gPfFlagsOffset) & gPfFourCc) &&
+		ReadU32(pixelFormat + gPfFourCcOffset) == FourCc('D', 'X', '1', '0');
+	if (hasDx10)
+	{
+		if (size < offset + gDx10HeaderSize)
+		{
+			return false;
+		}
+		const std::uint8_t* dx10 = data + offset;
+		offset += gDx10HeaderSize;
+
+		layout.Format = static_cast<DXGI_FORMAT>(ReadU32(dx10));
+		if (ReadU32(dx10 + 4) != gDx10Texture2D)
+		{
+			return false;
+		}
+		layout.ArraySize = (std::max)(1u, ReadU32(dx10 + 12));
+		layout.IsCubemap = (ReadU32(dx10 + 8) & gDx10MiscTextureCube) != 0;
+	}
+	else
+	{
+		if ((caps2 & gCaps2Volume) || ReadU32(header + gDepthOffset) > 1)
+		{
+			return false;
+		}
+		layout.Format = LegacyFormat(pixelFormat);
+		if (caps2 & gCaps2Cubemap)
+		{
+			//partial cube maps can not be described by a d3d12 cube srv
+			if ((caps2 & gCaps2AllFaces) != gCaps2AllFaces)
+			{
+				return false;
+			}
+			layout.IsCubemap = true;
+		}
+	}
+
+	if (layout.IsCubemap)
+	{
+		layout.ArraySize *= 6;
+	}
+
+	if (layout.Format == DXGI_FORMAT_UNKNOWN || layout.Width == 0 || layout.Height == 0)
+	{
+		return false;
+	}
+
+	//a longer chain than the size allows would be rejected by resource creation
+	std::uint32_t maxMips = 1;
+	for (std::uint32_t extent = (std::max)(layout.Width, layout.Height); extent > 1; extent /= 2)
+	{
+		maxMips++;
+	}
+	if (layout.MipCount > maxMips)
+	{
+		return false;
+	}
+
+	layout.Subresources.reserve(static_cast<size_t>(layout.ArraySize) * layout.MipCount);
+	for (std::uint32_t item = 0; item < layout.ArraySize; item++)
+	{
+		std::uint32_t width = layout.Width;
+		std::uint32_t height = layout.Height;
+		for (std::uint32_t mip = 0; mip < layout.MipCount; mip++)
+		{
+			DdsSubresource subresource;
+			if (!ComputePitch(layout.Format, width, height, subresource.RowPitch, subresource.RowCount))
+			{
+				return false;
+			}
+			subresource.Offset = offset;
+			subresource.Width = width;
+			subresource.Height = height;
+			subresource.SlicePitch = subresource.RowPitch * subresource.RowCount;
+			offset += subresource.SlicePitch;
+			if (offset > size)
+			{
+				return false;
+			}
+			layout.Subresources.push_back(subresource);
+
+			width = (std::max)(1u, width / 2);
+			height = (std::max)(1u, height / 2);
+		}
+	}
+	return true;
+}
+
+DXGI_FORMAT DdsFile::LegacyFormat(const std::uint8_t* pixelFormat)
+{
+	const std::uint32_t flags = ReadU32(pixelFormat + gPfFlagsOffset);
+	const std::uint32_t bitCount = ReadU32(pixelFormat + gPfBitCountOffset);
+	const std::uint32_t r = ReadU32(pixelFormat + gPfMasksOffset);
+	const std::uint32_t g = ReadU32(pixelFormat + gPfMasksOffset + 4);
+	const std::uint32_t b = ReadU32(pixelFormat + gPfMasksOffset + 8);
+	const std::uint32_t a = ReadU32(pixelFormat + gPfMasksOffset + 12);
+
+	if (flags & gPfFourCc)
+	{
+		switch (ReadU32(pixelFormat + gPfFourCcOffset))
+		{
+		case FourCc('D', 'X', 'T', '1'): return DXGI_FORMAT_BC1_UNORM;
+		case FourCc('D', 'X', 'T', '2'):
+		case FourCc('D', 'X', 'T', '3'): return DXGI_FORMAT_BC2_UNORM;
+		case FourCc('D', 'X', 'T', '4'):
+		case FourCc('D', 'X', 'T', '5'): return DXGI_FORMAT_BC3_UNORM;
+		case FourCc('A', 'T', 'I', '1'):
+		case FourCc('B', 'C', '4', 'U'): return DXGI_FORMAT_BC4_UNORM;
+		case FourCc('B', 'C', '4', 'S'): return DXGI_FORMAT_BC4_SNORM;
+		case FourCc('A', 'T', 'I', '2'):
+		case FourCc('B', 'C', '5', 'U'): return DXGI_FORMAT_BC5_UNORM;
+		case FourCc('B', 'C', '5', 'S'): return DXGI_FORMAT_BC5_SNORM;
+		//d3dfmt values stored as fourcc
+		case 36: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case 111: return DXGI_FORMAT_R16_FLOAT;
+		case 112: return DXGI_FORMAT_R16G16_FLOAT;
+		case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case 114: return DXGI_FORMAT_R32_FLOAT;
+		case 115: return DXGI_FORMAT_R32G32_FLOAT;
+		case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	if ((flags & gPfRgb) && bitCount == 32)
+	{
+		if (r == 0x000000ff && g == 0x0000ff00 && b == 0x00ff0000 && a == 0xff000000) return DXGI_FORMAT_R8G8B8A8_UNORM;
+		if (r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff && a == 0xff000000) return DXGI_FORMAT_B8G8R8A8_UNORM;
+		if (r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff && !(flags & gPfAlphaPixels)) return DXGI_FORMAT_B8G8R8X8_UNORM;
+		if (r == 0x0000ffff && g == 0xffff0000) return DXGI_FORMAT_R16G16_UNORM;
+		if (r == 0xffffffff) return DXGI_FORMAT_R32_FLOAT;
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	if (flags & gPfLuminance)
+	{
+		if (bitCount == 8 && r == 0xff) return DXGI_FORMAT_R8_UNORM;
+		if (bitCount == 16 && r == 0xffff) return DXGI_FORMAT_R16_UNORM;
+		if (bitCount == 16 && r == 0x00ff && a == 0xff00) return DXGI_FORMAT_R8G8_UNORM;
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+//where one subresource lives inside a dds file and how its rows are laid out
+struct DdsSubresource
+{
+	size_t Offset = 0;
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	size_t RowPitch = 0;
+	//rows of blocks for compressed formats
+	size_t RowCount = 0;
+	size_t SlicePitch = 0;
+};
+
+struct DdsLayout
+{
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint32_t MipCount = 1;
+	//faces included for cube maps
+	std::uint32_t ArraySize = 1;
+	bool IsCubemap = false;
+	//array item major, mip minor, same order as d3d12 subresource indices
+	std::vector<DdsSubresource> Subresources;
+};
+
+//reads dds headers straight from memory, e.g. a mapped file. only 2d textures,
+//arrays and cube maps in formats the renderer actually samples are accepted
+class DdsFile
+{
+public:
+	static bool Parse(const std::uint8_t* data, size_t size, DdsLayout& layout);
+	//tightly packed pitches as stored in dds files, false for unsupported formats
+	static bool ComputePitch(DXGI_FORMAT format, std::uint32_t width, std::uint32_t height, size_t& rowPitch, size_t& rowCount);
+
+private:
+	static DXGI_FORMAT LegacyFormat(const std::uint8_t* pixelFormat);
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cmath>
+
+//how far displacement mapping can move a surface, so culling sees tessellated objects where they are drawn.
+//the domain shader adds normal * height * scale with a unit world space normal, so the reach is in world units
+
+//values the red channel of a displacement map takes, measured when it loads.
+//the default covers any unorm map that was not measured
+struct HeightRange
+{
+	float Min = 0.0f;
+	float Max = 1.0f;
+};
+
+//furthest a surface point can move, the normal points anywhere so every axis can take all of it
+inline float DisplacementReach(const HeightRange& heights, const float scale)
+{
+	return (std::max)(std::abs(heights.Min * scale), std::abs(heights.Max * scale));
+}
+
+//world space box grown by reach on every side
+inline DirectX::BoundingBox InflateBounds(const DirectX::BoundingBox& bounds, const float reach)
+{
+	DirectX::BoundingBox inflated = bounds;
+	inflated.Extents.x += reach;
+	inflated.Extents.y += reach;
+	inflated.Extents.z += reach;
+	return inflated;
+}
@@ -26,6 +26,8 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount)
 
     LightsContainingFrustum = std::make_unique<UploadBuffer<LightIndex>>(device, 512, false);
     LightsInsideFrustum = std::make_unique<UploadBuffer<LightIndex>>(device, 512, false);
+    LightClusterRanges = std::make_unique<UploadBuffer<ClusterRange>>(device, gLightClustersCount, false);
+    LightClusterIndices = std::make_unique<UploadBuffer<uint32_t>>(device, gMaxClusterLightIndices, false);
 
     GodRaysCb = std::make_unique<UploadBuffer<GodRaysConstants>>(device, passCount, true);
     StaticObjCb = std::make_unique < UploadBuffer<StaticObjectConstants>>(device, 512, true);
@@ -4,6 +4,7 @@
 #include "../../../Common/MathHelper.h"
 #include "../../../Common/UploadBuffer.h"
 #include "VertexData.h"
+#include "LightClusters.h"
 
 struct StaticObjectConstants
 {
@@ -41,6 +42,11 @@ struct MaterialConstants
 
     int ArmLayout = 0;
     float Pad[3] = {};
+
+    //TextureHandle::UvRect of what each texture register is bound to
+    DirectX::XMFLOAT4 UvRects[8] = {
+        { 1.0f, 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f },
+        { 1.0f, 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f } };
 };
 
 struct GBufferPassConstants
@@ -81,6 +87,9 @@ struct Light
 };
 
 static constexpr int gCascadesCount = 3;
+//froxel grid the local lights are sorted into, see LightClusters
+static constexpr int gLightClustersCount = 16 * 9 * 24;
+static constexpr int gMaxClusterLightIndices = 1 << 16;
 
 struct Cascade
 {
@@ -105,6 +114,13 @@ struct DirectionalLightConstants
     int LightsContainingFrustum = 0;
     Light MainSpotlight = Light();
     Cascade Cascades[gCascadesCount];
+    //clustered local lights, the view depth of a pixel is its distance along CameraLook
+    DirectX::XMFLOAT3 CameraLook = { 0.0f, 0.0f, 1.0f };
+    int Clustered = 0;
+    int ClusterCounts[3] = { 1, 1, 1 };
+    float SliceScale = 0.0f;
+    float SliceBias = 0.0f;
+    float ClusterPadding[3]{ 0.f, 0.f, 0.f };
 };
 
 struct ShadowLightConstants
@@ -220,6 +236,8 @@ public:
     std::unique_ptr<UploadBuffer<Light>> LocalLightCb = nullptr;
     std::unique_ptr<UploadBuffer<LightIndex>> LightsInsideFrustum = nullptr;
     std::unique_ptr<UploadBuffer<LightIndex>> LightsContainingFrustum = nullptr;
+    std::unique_ptr<UploadBuffer<ClusterRange>> LightClusterRanges = nullptr;
+    std::unique_ptr<UploadBuffer<uint32_t>> LightClusterIndices = nullptr;
     
     std::unique_ptr<UploadBuffer<StaticObjectConstants>> StaticObjCb = nullptr;
     
@@ -0,0 +1,354 @@
+#include "IblBaker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+	constexpr float gPi = 3.14159265358979f;
+
+	void Normalize(float& x, float& y, float& z)
+	{
+		const float length = std::sqrt(x * x + y * y + z * z);
+		x /= length;
+		y /= length;
+		z /= length;
+	}
+
+	void Accumulate(IblColor& sum, const IblColor& color, const float weight)
+	{
+		sum.R += color.R * weight;
+		sum.G += color.G * weight;
+		sum.B += color.B * weight;
+	}
+
+	IblColor Lerp(const IblColor& a, const IblColor& b, const float t)
+	{
+		return { a.R + (b.R - a.R) * t, a.G + (b.G - a.G) * t, a.B + (b.B - a.B) * t };
+	}
+
+	void ShBasis(const float x, const float y, const float z, float basis[9])
+	{
+		basis[0] = 0.282095f;
+		basis[1] = 0.488603f * y;
+		basis[2] = 0.488603f * z;
+		basis[3] = 0.488603f * x;
+		basis[4] = 1.092548f * x * y;
+		basis[5] = 1.092548f * y * z;
+		basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+		basis[7] = 1.092548f * x * z;
+		basis[8] = 0.546274f * (x * x - y * y);
+	}
+
+	float RadicalInverse(std::uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return static_cast<float>(bits) * 2.3283064365386963e-10f;
+	}
+}
+
+template<typename Body>
+void IblBaker::ForEachRow(const int size, WorkerPool& pool, const Body& body)
+{
+	for (int face = 0; face < 6; face++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			pool.Submit([face, y, &body]() { body(face, y); });
+		}
+	}
+	pool.WaitIdle();
+}
+
+void IblBaker::FaceDirection(const int face, const float u, const float v, float& x, float& y, float& z)
+{
+	switch (face)
+	{
+	case 0: x = 1.0f; y = -v; z = -u; break;
+	case 1: x = -1.0f; y = -v; z = u; break;
+	case 2: x = u; y = 1.0f; z = v; break;
+	case 3: x = u; y = -1.0f; z = -v; break;
+	case 4: x = u; y = -v; z = 1.0f; break;
+	default: x = -u; y = -v; z = -1.0f; break;
+	}
+}
+
+IblColor IblBaker::Sample(const IblCube& cube, const float x, const float y, const float z)
+{
+	const float ax = std::fabs(x);
+	const float ay = std::fabs(y);
+	const float az = std::fabs(z);
+
+	int face;
+	float u;
+	float v;
+	if (ax >= ay && ax >= az)
+	{
+		face = x > 0.0f ? 0 : 1;
+		u = (x > 0.0f ? -z : z) / ax;
+		v = -y / ax;
+	}
+	else if (ay >= az)
+	{
+		face = y > 0.0f ? 2 : 3;
+		u = x / ay;
+		v = (y > 0.0f ? z : -z) / ay;
+	}
+	else
+	{
+		face = z > 0.0f ? 4 : 5;
+		u = (z > 0.0f ? x : -x) / az;
+		v = -y / az;
+	}
+
+	//bilinear inside the face, edges clamp instead of crossing the seam
+	const float fx = (u * 0.5f + 0.5f) * cube.Size - 0.5f;
+	const float fy = (v * 0.5f + 0.5f) * cube.Size - 0.5f;
+	const int x0 = (std::min)((std::max)(static_cast<int>(std::floor(fx)), 0), cube.Size - 1);
+	const int y0 = (std::min)((std::max)(static_cast<int>(std::floor(fy)), 0), cube.Size - 1);
+	const int x1 = (std::min)(x0 + 1, cube.Size - 1);
+	const int y1 = (std::min)(y0 + 1, cube.Size - 1);
+	const float tx = (std::min)((std::max)(fx - x0, 0.0f), 1.0f);
+	const float ty = (std::min)((std::max)(fy - y0, 0.0f), 1.0f);
+
+	const IblColor top = Lerp(cube.At(face, x0, y0), cube.At(face, x1, y0), tx);
+	const IblColor bottom = Lerp(cube.At(face, x0, y1), cube.At(face, x1, y1), tx);
+	return Lerp(top, bottom, ty);
+}
+
+IblColor IblBaker::SampleLod(const std::vector<IblCube>& chain, const float x, const float y, const float z, float lod)
+{
+	lod = (std::min)((std::max)(lod, 0.0f), static_cast<float>(chain.size() - 1));
+	const int lower = static_cast<int>(lod);
+	const int upper = (std::min)(lower + 1, static_cast<int>(chain.size()) - 1);
+	return Lerp(Sample(chain[lower], x, y, z), Sample(chain[upper], x, y, z), lod - lower);
+}
+
+IblCube IblBaker::CubeFromEquirect(const float* rgba, const int width, const int height, const int faceSize, WorkerPool& pool)
+{
+	IblCube cube(faceSize);
+	const auto texel = [&](int x, const int y) -> IblColor
+	{
+		x = (x % width + width) % width;
+		const float* p = rgba + (static_cast<size_t>((std::min)((std::max)(y, 0), height - 1)) * width + x) * 4;
+		return { p[0], p[1], p[2] };
+	};
+
+	ForEachRow(faceSize, pool, [&](const int face, const int y)
+		{
+			for (int x = 0; x < faceSize; x++)
+			{
+				float dx, dy, dz;
+				FaceDirection(face, 2.0f * (x + 0.5f) / faceSize - 1.0f, 2.0f * (y + 0.5f) / faceSize - 1.0f, dx, dy, dz);
+				Normalize(dx, dy, dz);
+
+				const float fu = (0.5f + std::atan2(dz, dx) / (2.0f * gPi)) * width - 0.5f;
+				const float fv = std::acos((std::min)((std::max)(dy, -1.0f), 1.0f)) / gPi * height - 0.5f;
+				const int u0 = static_cast<int>(std::floor(fu));
+				const int v0 = static_cast<int>(std::floor(fv));
+				const float tu = fu - u0;
+				const float tv = fv - v0;
+
+				const IblColor top = Lerp(texel(u0, v0), texel(u0 + 1, v0), tu);
+				const IblColor bottom = Lerp(texel(u0, v0 + 1), texel(u0 + 1, v0 + 1), tu);
+				cube.At(face, x, y) = Lerp(top, bottom, tv);
+			}
+		});
+	return cube;
+}
+
+IblCube IblBaker::Downsample(const IblCube& cube)
+{
+	IblCube result((std::max)(cube.Size / 2, 1));
+	for (int face = 0; face < 6; face++)
+	{
+		for (int y = 0; y < result.Size; y++)
+		{
+			for (int x = 0; x < result.Size; x++)
+			{
+				IblColor sum;
+				for (int i = 0; i < 4; i++)
+				{
+					const int sx = (std::min)(x * 2 + (i & 1), cube.Size - 1);
+					const int sy = (std::min)(y * 2 + (i >> 1), cube.Size - 1);
+					Accumulate(sum, cube.At(face, sx, sy), 0.25f);
+				}
+				result.At(face, x, y) = sum;
+			}
+		}
+	}
+	return result;
+}
+
+float IblBaker::TexelSolidAngle(const int x, const int y, const int size)
+{
+	//integral of the projected area over the texel corners
+	const auto area = [](const float u, const float v) { return std::atan2(u * v, std::sqrt(u * u + v * v + 1.0f)); };
+	const float invSize = 1.0f / size;
+	const float u0 = 2.0f * x * invSize - 1.0f;
+	const float v0 = 2.0f * y * invSize - 1.0f;
+	const float u1 = u0 + 2.0f * invSize;
+	const float v1 = v0 + 2.0f * invSize;
+	return area(u0, v0) - area(u0, v1) - area(u1, v0) + area(u1, v1);
+}
+
+IblSh IblBaker::ProjectIrradiance(const IblCube& radiance)
+{
+	IblSh sh;
+	for (int face = 0; face < 6; face++)
+	{
+		for (int y = 0; y < radiance.Size; y++)
+		{
+			for (int x = 0; x < radiance.Size; x++)
+			{
+				float dx, dy, dz;
+				FaceDirection(face, 2.0f * (x + 0.5f) / radiance.Size - 1.0f, 2.0f * (y + 0.5f) / radiance.Size - 1.0f, dx, dy, dz);
+				Normalize(dx, dy, dz);
+
+				float basis[9];
+				ShBasis(dx, dy, dz, basis);
+				const float solidAngle = TexelSolidAngle(x, y, radiance.Size);
+				for (int i = 0; i < 9; i++)
+				{
+					Accumulate(sh.Coefficients[i], radiance.At(face, x, y), basis[i] * solidAngle);
+				}
+			}
+		}
+	}
+
+	//clamped cosine band factors pi, 2pi/3, pi/4, already divided by pi
+	const float bands[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (int i = 0; i < 9; i++)
+	{
+		sh.Coefficients[i].R *= bands[i];
+		sh.Coefficients[i].G *= bands[i];
+		sh.Coefficients[i].B *= bands[i];
+	}
+	return sh;
+}
+
+IblColor IblBaker::EvaluateSh(const IblSh& sh, const float x, const float y, const float z)
+{
+	float basis[9];
+	ShBasis(x, y, z, basis);
+	IblColor result;
+	for (int i = 0; i < 9; i++)
+	{
+		Accumulate(result, sh.Coefficients[i], basis[i]);
+	}
+	//ringing can push dark directions below zero
+	result.R = (std::max)(result.R, 0.0f);
+	result.G = (std::max)(result.G, 0.0f);
+	result.B = (std::max)(result.B, 0.0f);
+	return result;
+}
+
+IblCube IblBaker::IrradianceCube(const IblSh& sh, const int faceSize)
+{
+	IblCube cube(faceSize);
+	for (int face = 0; face < 6; face++)
+	{
+		for (int y = 0; y < faceSize; y++)
+		{
+			for (int x = 0; x < faceSize; x++)
+			{
+				float dx, dy, dz;
+				FaceDirection(face, 2.0f * (x + 0.5f) / faceSize - 1.0f, 2.0f * (y + 0.5f) / faceSize - 1.0f, dx, dy, dz);
+				Normalize(dx, dy, dz);
+				cube.At(face, x, y) = EvaluateSh(sh, dx, dy, dz);
+			}
+		}
+	}
+	return cube;
+}
+
+std::vector<IblCube> IblBaker::PrefilterGgx(const IblCube& source, const int faceSize, const int mipCount, const int sampleCount, WorkerPool& pool)
+{
+	std::vector<IblCube> chain = { source };
+	while (chain.back().Size > 1)
+	{
+		chain.push_back(Downsample(chain.back()));
+	}
+	const float texelSolidAngle = 4.0f * gPi / (6.0f * source.Size * source.Size);
+
+	std::vector<IblCube> mips;
+	for (int mip = 0; mip < mipCount; mip++)
+	{
+		const int size = (std::max)(faceSize >> mip, 1);
+		const float roughness = mipCount > 1 ? static_cast<float>(mip) / (mipCount - 1) : 0.0f;
+		const float alpha = roughness * roughness;
+		const float alpha2 = alpha * alpha;
+		IblCube target(size);
+
+		ForEachRow(size, pool, [&](const int face, const int y)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					float nx, ny, nz;
+					FaceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, nx, ny, nz);
+					Normalize(nx, ny, nz);
+
+					if (mip == 0)
+					{
+						target.At(face, x, y) = SampleLod(chain, nx, ny, nz, std::log2(static_cast<float>(source.Size) / size));
+						continue;
+					}
+
+					//tangent frame around the normal, n = v = r as in the split sum approximation
+					float upX = std::fabs(nz) < 0.999f ? 0.0f : 1.0f;
+					float upY = 0.0f;
+					float upZ = std::fabs(nz) < 0.999f ? 1.0f : 0.0f;
+					float tx = upY * nz - upZ * ny;
+					float ty = upZ * nx - upX * nz;
+					float tz = upX * ny - upY * nx;
+					Normalize(tx, ty, tz);
+					const float bx = ny * tz - nz * ty;
+					const float by = nz * tx - nx * tz;
+					const float bz = nx * ty - ny * tx;
+
+					IblColor sum;
+					float weight = 0.0f;
+					for (int i = 0; i < sampleCount; i++)
+					{
+						const float xi1 = static_cast<float>(i) / sampleCount;
+						const float xi2 = RadicalInverse(static_cast<std::uint32_t>(i));
+						const float phi = 2.0f * gPi * xi1;
+						const float cosTheta = std::sqrt((1.0f - xi2) / (1.0f + (alpha2 - 1.0f) * xi2));
+						const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+						const float hx = tx * std::cos(phi) * sinTheta + bx * std::sin(phi) * sinTheta + nx * cosTheta;
+						const float hy = ty * std::cos(phi) * sinTheta + by * std::sin(phi) * sinTheta + ny * cosTheta;
+						const float hz = tz * std::cos(phi) * sinTheta + bz * std::sin(phi) * sinTheta + nz * cosTheta;
+
+						const float nDotH = cosTheta;
+						const float lx = 2.0f * nDotH * hx - nx;
+						const float ly = 2.0f * nDotH * hy - ny;
+						const float lz = 2.0f * nDotH * hz - nz;
+						const float nDotL = nx * lx + ny * ly + nz * lz;
+						if (nDotL <= 0.0f)
+						{
+							continue;
+						}
+
+						//pdf of the reflected direction is d * nDotH / (4 * vDotH) and v = n here
+						const float denom = nDotH * nDotH * (alpha2 - 1.0f) + 1.0f;
+						const float d = alpha2 / (gPi * denom * denom);
+						const float pdf = d * 0.25f;
+						const float sampleSolidAngle = 1.0f / (sampleCount * pdf + 0.0001f);
+						const float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+						Accumulate(sum, SampleLod(chain, lx, ly, lz, lod), nDotL);
+						weight += nDotL;
+					}
+					target.At(face, x, y) = { sum.R / weight, sum.G / weight, sum.B / weight };
+				}
+			});
+		mips.push_back(std::move(target));
+	}
+	return mips;
+}
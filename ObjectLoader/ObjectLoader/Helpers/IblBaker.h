@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <vector>
+#include "WorkerPool.h"
+
+struct IblColor
+{
+	float R = 0.0f;
+	float G = 0.0f;
+	float B = 0.0f;
+};
+
+//six square faces in d3d order +x -x +y -y +z -z, rows top to bottom
+struct IblCube
+{
+	int Size = 0;
+	std::vector<IblColor> Texels;
+
+	explicit IblCube(int size = 0) : Size(size), Texels(static_cast<size_t>(6) * size * size) {}
+	IblColor& At(int face, int x, int y) { return Texels[(static_cast<size_t>(face) * Size + y) * Size + x]; }
+	const IblColor& At(int face, int x, int y) const { return Texels[(static_cast<size_t>(face) * Size + y) * Size + x]; }
+};
+
+//order 2 spherical harmonics, 9 coefficients per channel
+struct IblSh
+{
+	std::array<IblColor, 9> Coefficients;
+};
+
+//bakes image based lighting on the cpu: sh irradiance and a ggx prefiltered mip chain
+//matching the split sum lookup in Lighting.hlsl
+class IblBaker
+{
+public:
+	//rgba float texels, longitude along x
+	static IblCube CubeFromEquirect(const float* rgba, int width, int height, int faceSize, WorkerPool& pool);
+	//2x2 box filter down to the next mip
+	static IblCube Downsample(const IblCube& cube);
+
+	//projects radiance and convolves it with the clamped cosine, divided by pi
+	//so the result is the lambert radiance for a white albedo like the shader expects
+	static IblSh ProjectIrradiance(const IblCube& radiance);
+	static IblColor EvaluateSh(const IblSh& sh, float x, float y, float z);
+	static IblCube IrradianceCube(const IblSh& sh, int faceSize);
+
+	//mip m is filtered for roughness m / (mipCount - 1), importance sampled
+	//with source lods picked from the sample pdf to keep the noise down
+	static std::vector<IblCube> PrefilterGgx(const IblCube& source, int faceSize, int mipCount, int sampleCount, WorkerPool& pool);
+
+	//u and v in [-1, 1], direction is not normalized
+	static void FaceDirection(int face, float u, float v, float& x, float& y, float& z);
+	static IblColor Sample(const IblCube& cube, float x, float y, float z);
+	//trilinear over a mip chain, lod 0 is chain[0]
+	static IblColor SampleLod(const std::vector<IblCube>& chain, float x, float y, float z, float lod);
+
+private:
+	static float TexelSolidAngle(int x, int y, int size);
+	//runs body(face, row) for every row of every face of a cube of the given size
+	template<typename Body>
+	static void ForEachRow(int size, WorkerPool& pool, const Body& body);
+};
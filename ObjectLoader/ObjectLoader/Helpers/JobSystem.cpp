@@ -0,0 +1,247 @@
+#include "JobSystem.h"
+
+namespace
+{
+	struct OwnedDeque
+	{
+		uint64_t System;
+		size_t Deque;
+	};
+
+	//the deques the current thread owns, one per system it worked with
+	thread_local std::vector<OwnedDeque> ownedDeques;
+	std::atomic<uint64_t> nextSystemId{ 1 };
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+	: _id(nextSystemId.fetch_add(1, std::memory_order_relaxed))
+{
+	if (workerCount == 0)
+	{
+		const unsigned hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	_deques.reserve(workerCount + MaxOutsideThreads);
+	for (size_t i = 0; i < workerCount + MaxOutsideThreads; i++)
+	{
+		_deques.push_back(std::make_unique<WorkDeque>());
+	}
+	_claimed.store(workerCount, std::memory_order_relaxed);
+
+	_workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+
+	for (auto& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	Push({ std::move(work), counter });
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter, JobCounter& after)
+{
+	if (counter)
+	{
+		counter->_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	{
+		//the last job of after drops it to zero under this lock, so it either sees the job or the job sees zero
+		std::lock_guard<std::mutex> lock(after._mutex);
+		if (!after.Done())
+		{
+			after._held.push_back({ std::move(work), counter });
+			return;
+		}
+	}
+	Push({ std::move(work), counter });
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.Done())
+	{
+		Held job;
+		if (TryTake(job))
+		{
+			Execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	//the job that finished the counter may still hold its lock, the caller is free to destroy it after this
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter._mutex);
+		error.swap(counter._error);
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+JobSystem& JobSystem::Shared()
+{
+	static JobSystem system;
+	return system;
+}
+
+void JobSystem::Push(Held job)
+{
+	WorkDeque& deque = *_deques[OwnDeque(true)];
+	//counted first so a thief taking it right away never sees the count below zero
+	_queued.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(deque.Mutex);
+		deque.Jobs.push_back(std::move(job));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+	}
+	_wake.notify_one();
+}
+
+bool JobSystem::TryTake(Held& job)
+{
+	const size_t own = OwnDeque(false);
+	const size_t count = _claimed.load(std::memory_order_acquire);
+	//a thread without a deque only steals
+	const size_t first = own == NoDeque ? 0 : own;
+	for (size_t i = 0; i < count; i++)
+	{
+		WorkDeque& deque = *_deques[(first + i) % count];
+		std::lock_guard<std::mutex> lock(deque.Mutex);
+		if (deque.Jobs.empty())
+		{
+			continue;
+		}
+
+		//newest of its own is still warm in cache, oldest of someone else's tends to be the biggest piece left
+		if (i == 0 && own != NoDeque)
+		{
+			job = std::move(deque.Jobs.back());
+			deque.Jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(deque.Jobs.front());
+			deque.Jobs.pop_front();
+		}
+		_queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::Execute(Held& job)
+{
+	//a job that throws still finishes, or whoever waits for its counter waits forever
+	try
+	{
+		job.Work();
+	}
+	catch (...)
+	{
+		if (job.Counter)
+		{
+			std::lock_guard<std::mutex> lock(job.Counter->_mutex);
+			if (!job.Counter->_error)
+			{
+				job.Counter->_error = std::current_exception();
+			}
+		}
+	}
+	if (job.Counter)
+	{
+		Finish(job.Counter);
+	}
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	std::vector<Held> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->_mutex);
+		if (counter->_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			released.swap(counter->_held);
+		}
+	}
+
+	for (auto& job : released)
+	{
+		Push(std::move(job));
+	}
+}
+
+void JobSystem::WorkerLoop(const size_t index)
+{
+	ownedDeques.push_back({ _id, index });
+
+	for (;;)
+	{
+		Held job;
+		if (TryTake(job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_wake.wait(lock, [this]() { return _stopping || _queued.load(std::memory_order_acquire) > 0; });
+		//queued jobs are still finished when stopping
+		if (_stopping && _queued.load(std::memory_order_acquire) == 0)
+		{
+			return;
+		}
+	}
+}
+
+size_t JobSystem::OwnDeque(const bool claim)
+{
+	for (const OwnedDeque& owned : ownedDeques)
+	{
+		if (owned.System == _id)
+		{
+			return owned.Deque;
+		}
+	}
+	if (!claim)
+	{
+		return NoDeque;
+	}
+
+	//past the last one the outside threads share it, still correct, only contended
+	size_t index = _claimed.load(std::memory_order_relaxed);
+	while (index < _deques.size() && !_claimed.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel))
+	{
+	}
+	index = (std::min)(index, _deques.size() - 1);
+	ownedDeques.push_back({ _id, index });
+	return index;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+//counts unfinished jobs started with it, jobs can also be held back until one reaches zero
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool Done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Held
+	{
+		std::function<void()> Work;
+		JobCounter* Counter;
+	};
+
+	std::atomic<int> _pending{ 0 };
+	mutable std::mutex _mutex;
+	//first exception one of its jobs threw, Wait rethrows it
+	std::exception_ptr _error;
+	//jobs waiting for this counter, released by whoever finishes its last job
+	std::vector<Held> _held;
+};
+
+//threads with a deque each: a thread takes its newest job first and steals the oldest from the others when it runs dry.
+//threads that are not workers get a deque of their own the first time they queue a job, and help while they wait instead of sleeping
+class JobSystem
+{
+public:
+	//0 means one worker less than the hardware has threads, the caller is the one missing
+	explicit JobSystem(unsigned workerCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//queued on the calling thread's deque, counter is incremented now and decremented once the job ran
+	void Run(std::function<void()> work, JobCounter* counter = nullptr);
+	//same, but the job is only queued once after has reached zero
+	void Run(std::function<void()> work, JobCounter* counter, JobCounter& after);
+	//runs queued jobs on the calling thread until the counter reaches zero, then rethrows the first exception its jobs threw.
+	//a job without a counter has nobody to report to, what it throws is dropped
+	void Wait(JobCounter& counter);
+
+	//body(first, last) for chunks of at most grain indices, 0 picks a grain that gives every thread a few chunks.
+	//returns once all of them ran, the caller works on them too, and rethrows what a chunk threw
+	template <typename Body>
+	void ParallelFor(size_t begin, size_t end, size_t grain, const Body& body);
+
+	//workers plus the thread that waits
+	size_t ThreadCount() const { return _workers.size() + 1; }
+	//threads other than the workers that can have a deque, later ones share the last
+	static const size_t MaxOutsideThreads = 8;
+
+	//system the engine shares, made on first use from the main thread
+	static JobSystem& Shared();
+
+private:
+	using Held = JobCounter::Held;
+
+	struct WorkDeque
+	{
+		std::mutex Mutex;
+		std::deque<Held> Jobs;
+	};
+
+	void Push(Held job);
+	//own deque from the back, then the others from the front
+	bool TryTake(Held& job);
+	void Execute(Held& job);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(size_t index);
+	//the calling thread's deque, claims one for a thread that is not a worker when asked to, NoDeque when it has none
+	size_t OwnDeque(bool claim);
+	static const size_t NoDeque = static_cast<size_t>(-1);
+
+	//the workers' first, then the ones outside threads claim, all made up front so thieves never see the vector move
+	std::vector<std::unique_ptr<WorkDeque>> _deques;
+	//deques in use, thieves only look at these
+	std::atomic<size_t> _claimed{ 0 };
+	//tells systems apart on a thread, an address can be reused by the next one
+	const uint64_t _id;
+	std::vector<std::thread> _workers;
+	//jobs sitting in any deque, sleeping workers wait for it to rise
+	std::atomic<size_t> _queued{ 0 };
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	bool _stopping = false;
+};
+
+template <typename Body>
+void JobSystem::ParallelFor(const size_t begin, const size_t end, size_t grain, const Body& body)
+{
+	if (end <= begin)
+		return;
+
+	const size_t count = end - begin;
+	if (grain == 0)
+		grain = (std::max)(count / (ThreadCount() * 4), static_cast<size_t>(1));
+	if (count <= grain)
+	{
+		body(begin, end);
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t first = begin; first < end; first += grain)
+	{
+		const size_t last = (std::min)(first + grain, end);
+		Run([&body, first, last]() { body(first, last); }, &counter);
+	}
+	Wait(counter);
+}
@@ -0,0 +1,250 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr int GroupSize = 4;
+	constexpr float RightAngle = 1.57079632679f;
+
+	//the spot cone against the sphere around a cluster, see "cull that cone" by bart wronski.
+	//false only when the sphere lies past the side of the cone, past its range or behind it
+	bool ConeTouches(const float vX, const float vY, const float vZ, const float clusterRadius, const ClusterLight& light,
+	                 const float cosAngle, const float sinAngle)
+	{
+		const float lengthSq = vX * vX + vY * vY + vZ * vZ;
+		const float alongAxis = vX * light.Direction.x + vY * light.Direction.y + vZ * light.Direction.z;
+		const float fromAxis = std::sqrt((std::max)(lengthSq - alongAxis * alongAxis, 0.0f));
+		const float sideDistance = cosAngle * fromAxis - alongAxis * sinAngle;
+		return !(sideDistance > clusterRadius || alongAxis > clusterRadius + light.Radius || alongAxis < -clusterRadius);
+	}
+
+	float SpanMin(const std::vector<float>& center, const std::vector<float>& extent, const int cluster)
+	{
+		return center[cluster] - extent[cluster];
+	}
+
+	float SpanMax(const std::vector<float>& center, const std::vector<float>& extent, const int cluster)
+	{
+		return center[cluster] + extent[cluster];
+	}
+}
+
+void LightClusters::SetLens(const float fovY, const float aspect, const float nearZ, const float farZ, const ClusterGridSettings& settings)
+{
+	if (fovY == _fovY && aspect == _aspect && nearZ == _nearZ && farZ == _farZ && settings.TilesX == _settings.TilesX &&
+		settings.TilesY == _settings.TilesY && settings.Slices == _settings.Slices)
+		return;
+
+	_fovY = fovY;
+	_aspect = aspect;
+	_nearZ = nearZ;
+	_farZ = farZ;
+	_settings = settings;
+
+	const float depthRatio = std::log(farZ / nearZ);
+	_sliceScale = static_cast<float>(settings.Slices) / depthRatio;
+	_sliceBias = -static_cast<float>(settings.Slices) * std::log(nearZ) / depthRatio;
+
+	const int count = ClusterCount();
+	for (auto array : { &_centerX, &_centerY, &_centerZ, &_extentX, &_extentY, &_extentZ, &_radius })
+		array->assign(count + GroupSize, 0.0f);
+
+	const float tanHalfY = std::tan(fovY * 0.5f);
+	const float tanHalfX = tanHalfY * aspect;
+	for (int slice = 0; slice < settings.Slices; slice++)
+	{
+		const float sliceNear = nearZ * std::pow(farZ / nearZ, static_cast<float>(slice) / settings.Slices);
+		const float sliceFar = nearZ * std::pow(farZ / nearZ, static_cast<float>(slice + 1) / settings.Slices);
+		for (int tileY = 0; tileY < settings.TilesY; tileY++)
+		{
+			//screen rows go down, view space goes up
+			const float top = (1.0f - 2.0f * tileY / settings.TilesY) * tanHalfY;
+			const float bottom = (1.0f - 2.0f * (tileY + 1) / settings.TilesY) * tanHalfY;
+			for (int tileX = 0; tileX < settings.TilesX; tileX++)
+			{
+				const float left = (-1.0f + 2.0f * tileX / settings.TilesX) * tanHalfX;
+				const float right = (-1.0f + 2.0f * (tileX + 1) / settings.TilesX) * tanHalfX;
+
+				//the tile's corners at both ends of the slice
+				const float minX = (std::min)(left * sliceNear, left * sliceFar);
+				const float maxX = (std::max)(right * sliceNear, right * sliceFar);
+				const float minY = (std::min)(bottom * sliceNear, bottom * sliceFar);
+				const float maxY = (std::max)(top * sliceNear, top * sliceFar);
+
+				const int cluster = ClusterIndex(tileX, tileY, slice);
+				_centerX[cluster] = (minX + maxX) * 0.5f;
+				_centerY[cluster] = (minY + maxY) * 0.5f;
+				_centerZ[cluster] = (sliceNear + sliceFar) * 0.5f;
+				_extentX[cluster] = (maxX - minX) * 0.5f;
+				_extentY[cluster] = (maxY - minY) * 0.5f;
+				_extentZ[cluster] = (sliceFar - sliceNear) * 0.5f;
+				_radius[cluster] = std::sqrt(_extentX[cluster] * _extentX[cluster] + _extentY[cluster] * _extentY[cluster] +
+					_extentZ[cluster] * _extentZ[cluster]);
+			}
+		}
+	}
+}
+
+int LightClusters::SliceAt(const float viewZ) const
+{
+	if (viewZ <= _nearZ)
+		return 0;
+	const int slice = static_cast<int>(std::floor(std::log(viewZ) * _sliceScale + _sliceBias));
+	return (std::min)((std::max)(slice, 0), _settings.Slices - 1);
+}
+
+BoundingBox LightClusters::Bounds(const int cluster) const
+{
+	return BoundingBox(XMFLOAT3(_centerX[cluster], _centerY[cluster], _centerZ[cluster]),
+	                   XMFLOAT3(_extentX[cluster], _extentY[cluster], _extentZ[cluster]));
+}
+
+bool LightClusters::Touches(const ClusterLight& light, const BoundingBox& bounds)
+{
+	//distance from the sphere center to the box
+	const float dX = (std::max)(std::abs(bounds.Center.x - light.Position.x) - bounds.Extents.x, 0.0f);
+	const float dY = (std::max)(std::abs(bounds.Center.y - light.Position.y) - bounds.Extents.y, 0.0f);
+	const float dZ = (std::max)(std::abs(bounds.Center.z - light.Position.z) - bounds.Extents.z, 0.0f);
+	if (dX * dX + dY * dY + dZ * dZ > light.Radius * light.Radius)
+		return false;
+	if (!light.Spot || light.Angle >= RightAngle)
+		return true;
+
+	const float clusterRadius = std::sqrt(bounds.Extents.x * bounds.Extents.x + bounds.Extents.y * bounds.Extents.y +
+		bounds.Extents.z * bounds.Extents.z);
+	return ConeTouches(bounds.Center.x - light.Position.x, bounds.Center.y - light.Position.y, bounds.Center.z - light.Position.z,
+	                   clusterRadius, light, std::cos(light.Angle), std::sin(light.Angle));
+}
+
+bool LightClusters::Assign(const std::vector<ClusterLight>& lights, const size_t maxIndices)
+{
+	_hits.clear();
+	for (const auto& light : lights)
+	{
+		if (light.Radius <= 0.0f || light.Position.z + light.Radius < _nearZ || light.Position.z - light.Radius > _farZ)
+			continue;
+
+		//one slice of slack on both sides, the boxes decide anyway
+		const int firstSlice = (std::max)(SliceAt(light.Position.z - light.Radius) - 1, 0);
+		const int lastSlice = (std::min)(SliceAt(light.Position.z + light.Radius) + 1, _settings.Slices - 1);
+		for (int slice = firstSlice; slice <= lastSlice; slice++)
+		{
+			//boxes of a column share their x range and boxes of a row their y range,
+			//so whole columns and rows the sphere misses on one axis are skipped without changing the result
+			int firstX = 0;
+			int lastX = _settings.TilesX - 1;
+			while (firstX <= lastX && SpanMax(_centerX, _extentX, ClusterIndex(firstX, 0, slice)) < light.Position.x - light.Radius)
+				firstX++;
+			while (lastX >= firstX && SpanMin(_centerX, _extentX, ClusterIndex(lastX, 0, slice)) > light.Position.x + light.Radius)
+				lastX--;
+			int firstY = 0;
+			int lastY = _settings.TilesY - 1;
+			//rows go down the screen
+			while (firstY <= lastY && SpanMin(_centerY, _extentY, ClusterIndex(0, firstY, slice)) > light.Position.y + light.Radius)
+				firstY++;
+			while (lastY >= firstY && SpanMax(_centerY, _extentY, ClusterIndex(0, lastY, slice)) < light.Position.y - light.Radius)
+				lastY--;
+
+			for (int tileY = firstY; firstX <= lastX && tileY <= lastY; tileY++)
+				TestClusters(light, ClusterIndex(firstX, tileY, slice), ClusterIndex(lastX, tileY, slice) + 1);
+		}
+	}
+
+	const int count = ClusterCount();
+	_ranges.assign(count, ClusterRange());
+	if (_hits.size() > maxIndices)
+	{
+		_indices.clear();
+		return false;
+	}
+
+	//counting sort by cluster, lights keep their order within a cluster
+	for (const auto& hit : _hits)
+		_ranges[hit.first].Count++;
+	uint32_t offset = 0;
+	for (auto& range : _ranges)
+	{
+		range.Offset = offset;
+		offset += range.Count;
+		range.Count = 0;
+	}
+	_indices.resize(_hits.size());
+	for (const auto& hit : _hits)
+	{
+		auto& range = _ranges[hit.first];
+		_indices[range.Offset + range.Count++] = hit.second;
+	}
+	return true;
+}
+
+void LightClusters::TestClusters(const ClusterLight& light, const int first, const int last)
+{
+	const bool cone = light.Spot && light.Angle < RightAngle;
+	const float cosAngle = std::cos(light.Angle);
+	const float sinAngle = std::sin(light.Angle);
+
+	for (int group = first; group < last; group += GroupSize)
+	{
+		uint32_t touched;
+#if defined(_XM_SSE_INTRINSICS_)
+		const __m128 zero = _mm_setzero_ps();
+		//abs by clearing the sign bit
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 toCenterX = _mm_sub_ps(_mm_loadu_ps(&_centerX[group]), _mm_set1_ps(light.Position.x));
+		const __m128 toCenterY = _mm_sub_ps(_mm_loadu_ps(&_centerY[group]), _mm_set1_ps(light.Position.y));
+		const __m128 toCenterZ = _mm_sub_ps(_mm_loadu_ps(&_centerZ[group]), _mm_set1_ps(light.Position.z));
+
+		const __m128 dX = _mm_max_ps(_mm_sub_ps(_mm_and_ps(toCenterX, absMask), _mm_loadu_ps(&_extentX[group])), zero);
+		const __m128 dY = _mm_max_ps(_mm_sub_ps(_mm_and_ps(toCenterY, absMask), _mm_loadu_ps(&_extentY[group])), zero);
+		const __m128 dZ = _mm_max_ps(_mm_sub_ps(_mm_and_ps(toCenterZ, absMask), _mm_loadu_ps(&_extentZ[group])), zero);
+		const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX, dX), _mm_mul_ps(dY, dY)), _mm_mul_ps(dZ, dZ));
+		__m128 hit = _mm_cmple_ps(distanceSq, _mm_set1_ps(light.Radius * light.Radius));
+
+		if (cone && _mm_movemask_ps(hit) != 0)
+		{
+			const __m128 clusterRadius = _mm_loadu_ps(&_radius[group]);
+			const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, toCenterX), _mm_mul_ps(toCenterY, toCenterY)),
+			                                   _mm_mul_ps(toCenterZ, toCenterZ));
+			const __m128 alongAxis = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, _mm_set1_ps(light.Direction.x)),
+			                                               _mm_mul_ps(toCenterY, _mm_set1_ps(light.Direction.y))),
+			                                    _mm_mul_ps(toCenterZ, _mm_set1_ps(light.Direction.z)));
+			const __m128 fromAxis = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(alongAxis, alongAxis)), zero));
+			const __m128 sideDistance = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(cosAngle), fromAxis), _mm_mul_ps(alongAxis, _mm_set1_ps(sinAngle)));
+			__m128 culled = _mm_cmpgt_ps(sideDistance, clusterRadius);
+			culled = _mm_or_ps(culled, _mm_cmpgt_ps(alongAxis, _mm_add_ps(clusterRadius, _mm_set1_ps(light.Radius))));
+			culled = _mm_or_ps(culled, _mm_cmplt_ps(alongAxis, _mm_sub_ps(zero, clusterRadius)));
+			hit = _mm_andnot_ps(culled, hit);
+		}
+		touched = static_cast<uint32_t>(_mm_movemask_ps(hit));
+#else
+		touched = 0;
+		for (int i = 0; i < GroupSize; i++)
+		{
+			const int cluster = group + i;
+			const float toCenterX = _centerX[cluster] - light.Position.x;
+			const float toCenterY = _centerY[cluster] - light.Position.y;
+			const float toCenterZ = _centerZ[cluster] - light.Position.z;
+			const float dX = (std::max)(std::abs(toCenterX) - _extentX[cluster], 0.0f);
+			const float dY = (std::max)(std::abs(toCenterY) - _extentY[cluster], 0.0f);
+			const float dZ = (std::max)(std::abs(toCenterZ) - _extentZ[cluster], 0.0f);
+			bool hit = dX * dX + dY * dY + dZ * dZ <= light.Radius * light.Radius;
+			if (hit && cone)
+				hit = ConeTouches(toCenterX, toCenterY, toCenterZ, _radius[cluster], light, cosAngle, sinAngle);
+			touched |= hit ? 1u << i : 0u;
+		}
+#endif
+		//the last group may run into the next row
+		if (last - group < GroupSize)
+			touched &= (1u << (last - group)) - 1;
+
+		for (int i = 0; touched != 0; i++, touched >>= 1)
+		{
+			if (touched & 1u)
+				_hits.emplace_back(static_cast<uint32_t>(group + i), light.Index);
+		}
+	}
+}
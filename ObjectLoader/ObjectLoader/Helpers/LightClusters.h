@@ -0,0 +1,95 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//where the lights of a cluster start in the index list and how many there are, uint2 on the gpu
+struct ClusterRange
+{
+	uint32_t Offset = 0;
+	uint32_t Count = 0;
+};
+
+//local light as the clusters see it, in view space
+struct ClusterLight
+{
+	DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+	float Radius = 0.0f;
+	//normalized, only read for spots
+	DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f };
+	//half angle of the cone, spots this wide or wider are tested as point lights
+	float Angle = 0.0f;
+	bool Spot = false;
+	//what ends up in the index list
+	uint32_t Index = 0;
+};
+
+struct ClusterGridSettings
+{
+	int TilesX = 16;
+	int TilesY = 9;
+	int Slices = 24;
+};
+
+//froxel grid over the camera frustum, screen tiles by slices exponential in view depth.
+//lights are assigned on the cpu and handed to the gpu as a range per cluster plus one compact index list,
+//has no device dependency
+class LightClusters
+{
+public:
+	//rebuilds the cluster boxes, nothing happens while the lens and the grid stay the same
+	void SetLens(float fovY, float aspect, float nearZ, float farZ, const ClusterGridSettings& settings = ClusterGridSettings());
+	//fills Ranges and Indices, false when the lists need more than maxIndices entries and were left empty
+	bool Assign(const std::vector<ClusterLight>& lights, size_t maxIndices);
+
+	int TilesX() const { return _settings.TilesX; }
+	int TilesY() const { return _settings.TilesY; }
+	int Slices() const { return _settings.Slices; }
+	int ClusterCount() const { return _settings.TilesX * _settings.TilesY * _settings.Slices; }
+	//tile 0, 0 is the top left corner of the screen
+	int ClusterIndex(const int tileX, const int tileY, const int slice) const
+	{
+		return (slice * _settings.TilesY + tileY) * _settings.TilesX + tileX;
+	}
+
+	//slice = floor(log(viewZ) * SliceScale + SliceBias), the shader does the same
+	float SliceScale() const { return _sliceScale; }
+	float SliceBias() const { return _sliceBias; }
+	int SliceAt(float viewZ) const;
+
+	//view space box around a cluster
+	DirectX::BoundingBox Bounds(int cluster) const;
+	//the test Assign runs, one light against one cluster box
+	static bool Touches(const ClusterLight& light, const DirectX::BoundingBox& bounds);
+
+	const std::vector<ClusterRange>& Ranges() const { return _ranges; }
+	const std::vector<uint32_t>& Indices() const { return _indices; }
+
+private:
+	//marks the clusters of [first, last) the light touches, four at a time
+	void TestClusters(const ClusterLight& light, int first, int last);
+
+	ClusterGridSettings _settings = { 0, 0, 0 };
+	float _fovY = 0.0f;
+	float _aspect = 0.0f;
+	float _nearZ = 0.0f;
+	float _farZ = 0.0f;
+	float _sliceScale = 0.0f;
+	float _sliceBias = 0.0f;
+
+	//cluster boxes with one array per component, padded by a group so any index can start one
+	std::vector<float> _centerX;
+	std::vector<float> _centerY;
+	std::vector<float> _centerZ;
+	std::vector<float> _extentX;
+	std::vector<float> _extentY;
+	std::vector<float> _extentZ;
+	//radius of the sphere around each box, for the cone test
+	std::vector<float> _radius;
+
+	//cluster and light of every hit, counting sorted into the lists afterwards
+	std::vector<std::pair<uint32_t, uint32_t>> _hits;
+	std::vector<ClusterRange> _ranges;
+	std::vector<uint32_t> _indices;
+};
@@ -0,0 +1,214 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	//closest point on triangle abc to p, real time collision detection 5.1.5
+	XMVECTOR ClosestPointOnTriangle(const FXMVECTOR p, const FXMVECTOR a, const FXMVECTOR b, const GXMVECTOR c)
+	{
+		const XMVECTOR ab = b - a;
+		const XMVECTOR ac = c - a;
+		const XMVECTOR ap = p - a;
+		const float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+		const float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		const XMVECTOR bp = p - b;
+		const float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+		const float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+
+		const XMVECTOR cp = p - c;
+		const float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+		const float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		const float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	//uniform grid of triangle indices, each triangle listed in every cell its box touches
+	class TriangleGrid
+	{
+	public:
+		explicit TriangleGrid(const std::vector<XMFLOAT3>& triangles) : _triangles(triangles)
+		{
+			const int count = static_cast<int>(triangles.size() / 3);
+			float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (const auto& v : triangles)
+			{
+				const float p[3] = { v.x, v.y, v.z };
+				for (int axis = 0; axis < 3; axis++)
+				{
+					min[axis] = (std::min)(min[axis], p[axis]);
+					max[axis] = (std::max)(max[axis], p[axis]);
+				}
+			}
+
+			//a couple of triangles per cell along the longest side
+			const float longest = (std::max)((std::max)(max[0] - min[0], max[1] - min[1]), max[2] - min[2]);
+			const int cells = (std::min)((std::max)(static_cast<int>(std::cbrt(static_cast<float>(count))) * 2, 1), 64);
+			_cellSize = longest > 0.0f ? longest / cells : 1.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_min[axis] = min[axis];
+				_res[axis] = (std::min)((std::max)(static_cast<int>(std::ceil((max[axis] - min[axis]) / _cellSize)), 1), 64);
+			}
+
+			//two passes, count then fill
+			_cellStart.assign(static_cast<size_t>(_res[0]) * _res[1] * _res[2] + 1, 0);
+			for (int pass = 0; pass < 2; pass++)
+			{
+				std::vector<int> cursor;
+				if (pass == 1)
+				{
+					for (size_t i = 1; i < _cellStart.size(); i++)
+						_cellStart[i] += _cellStart[i - 1];
+					_items.resize(_cellStart.back());
+					cursor.assign(_cellStart.begin(), _cellStart.end() - 1);
+				}
+
+				for (int t = 0; t < count; t++)
+				{
+					int lo[3];
+					int hi[3];
+					for (int axis = 0; axis < 3; axis++)
+					{
+						const float a = (&triangles[t * 3].x)[axis];
+						const float b = (&triangles[t * 3 + 1].x)[axis];
+						const float c = (&triangles[t * 3 + 2].x)[axis];
+						lo[axis] = Cell((std::min)((std::min)(a, b), c), axis);
+						hi[axis] = Cell((std::max)((std::max)(a, b), c), axis);
+					}
+					for (int z = lo[2]; z <= hi[2]; z++)
+						for (int y = lo[1]; y <= hi[1]; y++)
+							for (int x = lo[0]; x <= hi[0]; x++)
+							{
+								const size_t cell = Index(x, y, z);
+								if (pass == 0)
+									_cellStart[cell + 1]++;
+								else
+									_items[cursor[cell]++] = t;
+							}
+				}
+			}
+		}
+
+		//distance from p to the nearest triangle, cells are visited in growing shells
+		float Distance(const XMFLOAT3& point) const
+		{
+			const XMVECTOR p = XMLoadFloat3(&point);
+			const int center[3] = { Cell(point.x, 0), Cell(point.y, 1), Cell(point.z, 2) };
+			const int maxShell = (std::max)((std::max)(_res[0], _res[1]), _res[2]);
+
+			float best = FLT_MAX;
+			for (int shell = 0; shell <= maxShell; shell++)
+			{
+				for (int z = (std::max)(center[2] - shell, 0); z <= (std::min)(center[2] + shell, _res[2] - 1); z++)
+					for (int y = (std::max)(center[1] - shell, 0); y <= (std::min)(center[1] + shell, _res[1] - 1); y++)
+						for (int x = (std::max)(center[0] - shell, 0); x <= (std::min)(center[0] + shell, _res[0] - 1); x++)
+						{
+							//inner cells were done by earlier shells
+							if ((std::max)((std::max)(std::abs(x - center[0]), std::abs(y - center[1])), std::abs(z - center[2])) != shell)
+								continue;
+
+							const size_t cell = Index(x, y, z);
+							for (int i = _cellStart[cell]; i < _cellStart[cell + 1]; i++)
+							{
+								const int t = _items[i];
+								const XMVECTOR closest = ClosestPointOnTriangle(p, XMLoadFloat3(&_triangles[t * 3]),
+									XMLoadFloat3(&_triangles[t * 3 + 1]), XMLoadFloat3(&_triangles[t * 3 + 2]));
+								best = (std::min)(best, XMVectorGetX(XMVector3LengthSq(closest - p)));
+							}
+						}
+
+				//cells of the next shell are at least this far away
+				const float reach = shell * _cellSize;
+				if (best <= reach * reach)
+					break;
+			}
+			return std::sqrt(best);
+		}
+
+	private:
+		int Cell(const float value, const int axis) const
+		{
+			return (std::min)((std::max)(static_cast<int>((value - _min[axis]) / _cellSize), 0), _res[axis] - 1);
+		}
+
+		size_t Index(const int x, const int y, const int z) const
+		{
+			return (static_cast<size_t>(z) * _res[1] + y) * _res[0] + x;
+		}
+
+		const std::vector<XMFLOAT3>& _triangles;
+		float _min[3] = {};
+		float _cellSize = 1.0f;
+		int _res[3] = { 1, 1, 1 };
+		std::vector<int> _cellStart;
+		std::vector<int> _items;
+	};
+}
+
+std::vector<XMFLOAT3> LodSelector::ReferencePoints(const std::vector<XMFLOAT3>& triangles)
+{
+	const size_t step = (triangles.size() + MaxReferencePoints - 1) / MaxReferencePoints;
+	std::vector<XMFLOAT3> points;
+	points.reserve((std::min)(triangles.size(), MaxReferencePoints));
+	for (size_t i = 0; i < triangles.size(); i += step)
+		points.push_back(triangles[i]);
+	return points;
+}
+
+float LodSelector::GeometricError(const std::vector<XMFLOAT3>& reference, const std::vector<XMFLOAT3>& triangles)
+{
+	if (reference.empty() || triangles.size() < 3)
+		return 0.0f;
+
+	const TriangleGrid grid(triangles);
+	float error = 0.0f;
+	for (const auto& point : reference)
+		error = (std::max)(error, grid.Distance(point));
+	return error;
+}
+
+float LodSelector::FitBudget(const float tolerance, const int budget, const std::function<int(float)>& triangles)
+{
+	if (budget <= 0 || triangles(tolerance) <= budget)
+		return tolerance;
+
+	float low = tolerance;
+	float high = (std::max)(tolerance, 0.5f) * 2.0f;
+	for (int i = 0; i < 16 && triangles(high) > budget; i++)
+	{
+		low = high;
+		high *= 2.0f;
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		const float middle = (low + high) * 0.5f;
+		(triangles(middle) > budget ? low : high) = middle;
+	}
+	return high;
+}
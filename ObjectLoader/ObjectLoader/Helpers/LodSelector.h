@@ -0,0 +1,42 @@
+#pragma once
+#include <DirectXMath.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+//picks lods by how large their geometric error looks on screen, has no device dependency
+class LodSelector
+{
+public:
+	//at most MaxReferencePoints corners of the reference triangles, spread evenly over them
+	static std::vector<DirectX::XMFLOAT3> ReferencePoints(const std::vector<DirectX::XMFLOAT3>& triangles);
+	//largest distance from the reference points to the simplified triangles, three points per triangle
+	static float GeometricError(const std::vector<DirectX::XMFLOAT3>& reference, const std::vector<DirectX::XMFLOAT3>& triangles);
+
+	//lod whose error, scaled by pixelsPerUnit, stays within tolerance pixels, starting from currentLod.
+	//a finer lod is taken once the current error is hysteresis above tolerance
+	//and a coarser one once its error is hysteresis below it. lods go finest first, each with an Error
+	template<typename Lods>
+	static int Select(const Lods& lods, float pixelsPerUnit, float tolerance, float hysteresis, int currentLod);
+
+	//smallest tolerance from the given one up that keeps triangles(tolerance) within budget,
+	//doubled until it fits and then bisected. triangles has to fall as the tolerance grows
+	static float FitBudget(float tolerance, int budget, const std::function<int(float)>& triangles);
+
+	//the error is a sampled one, more points mostly cost time
+	static constexpr size_t MaxReferencePoints = 8192;
+};
+
+template<typename Lods>
+int LodSelector::Select(const Lods& lods, const float pixelsPerUnit, const float tolerance, const float hysteresis, const int currentLod)
+{
+	const int last = static_cast<int>(lods.size()) - 1;
+	int lod = (std::min)((std::max)(currentLod, 0), (std::max)(last, 0));
+	const auto pixels = [&](const int index) { return lods[index].Error * pixelsPerUnit; };
+
+	while (lod > 0 && pixels(lod) > tolerance * (1.0f + hysteresis))
+		lod--;
+	while (lod < last && pixels(lod + 1) <= tolerance * (1.0f - hysteresis))
+		lod++;
+	return lod;
+}
@@ -3,14 +3,26 @@
 #include <string>
 #include <wrl.h>
 #include "BasicUtil.h"
+#include "NameTable.h"
+#include "TextureRole.h"
 
 using namespace DirectX;
 
 struct TextureHandle
 {
-	std::string Name = "load";
+	//interned pretty name, only the ui turns it back into a string
+	NameId Label = gInvalidNameId;
 	UINT Index = 0;
 	bool UseTexture = false;
+	NameId Id = gInvalidNameId;
+	//part of the view the texture covers, xy scale and zw offset. only textures packed into an atlas page have less than all of it
+	XMFLOAT4 UvRect = { 1.0f, 1.0f, 0.0f, 0.0f };
+
+	const std::string& Name() const
+	{
+		static const std::string unset = "load";
+		return Label == gInvalidNameId ? unset : NameTable::Name(Label);
+	}
 };
 
 enum class MatProp : int8_t
@@ -45,6 +57,51 @@ enum class ARMLayout : int8_t
 	Rough_Metal_AO,   // R=Rough, G=Metal, B=AO
 };
 
+inline TextureRole TextureRoleOf(const MatProp prop)
+{
+	return prop == MatProp::BaseColor || prop == MatProp::Emissive ? TextureRole::Color : TextureRole::Data;
+}
+
+inline TextureRole TextureRoleOf(const MatTex tex)
+{
+	//ao stays multi-channel, it is often the same file as the packed arm map
+	if (tex == MatTex::Normal) return TextureRole::Normal;
+	if (tex == MatTex::Displacement) return TextureRole::Mask;
+	return TextureRole::Data;
+}
+
+//neutral texture bound while the real one is still decoding
+enum class TexturePlaceholder : int8_t
+{
+	Grey = 0,
+	White,
+	Black,
+	FlatNormal,
+	DefaultOrm,	//ao 1, roughness 0.5, metallic 0
+	Count
+};
+
+inline TexturePlaceholder PlaceholderOf(const MatProp prop)
+{
+	switch (prop)
+	{
+	case MatProp::BaseColor: return TexturePlaceholder::Grey;
+	case MatProp::Emissive: return TexturePlaceholder::Black;
+	case MatProp::Opacity: return TexturePlaceholder::White;
+	default: return TexturePlaceholder::DefaultOrm;
+	}
+}
+
+inline TexturePlaceholder PlaceholderOf(const MatTex tex)
+{
+	switch (tex)
+	{
+	case MatTex::Normal: return TexturePlaceholder::FlatNormal;
+	case MatTex::Displacement: return TexturePlaceholder::Black;
+	default: return TexturePlaceholder::DefaultOrm;
+	}
+}
+
 struct MaterialProperty
 {
 	TextureHandle texture;
@@ -53,7 +110,8 @@ struct MaterialProperty
 
 struct Material
 {
-	std::string name;
+	//interned at import, the string is only looked up for the ui
+	NameId name = gInvalidNameId;
 	std::array<MaterialProperty, BasicUtil::EnumIndex(MatProp::Count)> properties;
 	std::array<TextureHandle, BasicUtil::EnumIndex(MatTex::Count)> textures;
 	std::array<float, BasicUtil::EnumIndex(MatAddInfo::Count)> additionalInfo{};
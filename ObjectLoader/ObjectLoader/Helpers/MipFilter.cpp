@@ -0,0 +1,183 @@
+#include "MipFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//source texels [first, first + count) and how much of each one a destination texel covers
+	struct Footprint
+	{
+		std::uint32_t First = 0;
+		std::uint32_t Count = 0;
+		float Weights[3] = {};
+	};
+
+	//a destination texel spans sourceSize / destSize source texels, which is at most three when halving
+	std::vector<Footprint> Footprints(const std::uint32_t sourceSize, const std::uint32_t destSize)
+	{
+		std::vector<Footprint> footprints(destSize);
+		const double scale = static_cast<double>(sourceSize) / destSize;
+		for (std::uint32_t i = 0; i < destSize; i++)
+		{
+			const double start = i * scale;
+			const double end = (i + 1) * scale;
+			Footprint& footprint = footprints[i];
+			footprint.First = static_cast<std::uint32_t>(start);
+			const std::uint32_t last = (std::min)(static_cast<std::uint32_t>(std::ceil(end)), sourceSize);
+			footprint.Count = last - footprint.First;
+			for (std::uint32_t t = 0; t < footprint.Count; t++)
+			{
+				const double texelStart = (std::max)(start, static_cast<double>(footprint.First + t));
+				const double texelEnd = (std::min)(end, static_cast<double>(footprint.First + t + 1));
+				footprint.Weights[t] = static_cast<float>((texelEnd - texelStart) / scale);
+			}
+		}
+		return footprints;
+	}
+
+	//what gets averaged, undone by Encode
+	void Decode(const float* texel, const MipContent content, float* out)
+	{
+		switch (content)
+		{
+		case MipContent::Srgb:
+			for (int c = 0; c < 3; c++)
+				out[c] = MipFilter::SrgbToLinear(texel[c]);
+			out[3] = texel[3];
+			return;
+		case MipContent::Normal:
+			for (int c = 0; c < 3; c++)
+				out[c] = texel[c] * 2.0f - 1.0f;
+			out[3] = texel[3];
+			return;
+		case MipContent::Linear:
+		default:
+			std::copy(texel, texel + 4, out);
+			return;
+		}
+	}
+
+	void Encode(const float* value, const MipContent content, float* texel)
+	{
+		switch (content)
+		{
+		case MipContent::Srgb:
+			for (int c = 0; c < 3; c++)
+				texel[c] = MipFilter::LinearToSrgb(value[c]);
+			texel[3] = value[3];
+			return;
+		case MipContent::Normal:
+		{
+			//averaged normals get shorter, a fully cancelled one points straight out of the surface
+			const float length = std::sqrt(value[0] * value[0] + value[1] * value[1] + value[2] * value[2]);
+			const float n[3] = {
+				length > 1e-6f ? value[0] / length : 0.0f,
+				length > 1e-6f ? value[1] / length : 0.0f,
+				length > 1e-6f ? value[2] / length : 1.0f };
+			for (int c = 0; c < 3; c++)
+				texel[c] = n[c] * 0.5f + 0.5f;
+			texel[3] = value[3];
+			return;
+		}
+		case MipContent::Linear:
+		default:
+			std::copy(value, value + 4, texel);
+			return;
+		}
+	}
+}
+
+std::uint32_t MipFilter::LevelCount(std::uint32_t width, std::uint32_t height)
+{
+	std::uint32_t count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = (std::max)(width / 2, 1u);
+		height = (std::max)(height / 2, 1u);
+		count++;
+	}
+	return count;
+}
+
+MipLevel MipFilter::Downsample(const MipLevel& source, const MipContent content)
+{
+	MipLevel dest((std::max)(source.Width / 2, 1u), (std::max)(source.Height / 2, 1u));
+	const std::vector<Footprint> columns = Footprints(source.Width, dest.Width);
+	const std::vector<Footprint> rows = Footprints(source.Height, dest.Height);
+
+	for (std::uint32_t y = 0; y < dest.Height; y++)
+	{
+		const Footprint& row = rows[y];
+		for (std::uint32_t x = 0; x < dest.Width; x++)
+		{
+			const Footprint& column = columns[x];
+			float sum[4] = {};
+			for (std::uint32_t sy = 0; sy < row.Count; sy++)
+			{
+				for (std::uint32_t sx = 0; sx < column.Count; sx++)
+				{
+					const float weight = row.Weights[sy] * column.Weights[sx];
+					float value[4];
+					Decode(source.At(column.First + sx, row.First + sy), content, value);
+					for (int c = 0; c < 4; c++)
+						sum[c] += value[c] * weight;
+				}
+			}
+			Encode(sum, content, dest.At(x, y));
+		}
+	}
+	return dest;
+}
+
+std::vector<MipLevel> MipFilter::BuildChain(MipLevel top, const MipContent content)
+{
+	std::vector<MipLevel> chain;
+	chain.reserve(LevelCount(top.Width, top.Height));
+	chain.push_back(std::move(top));
+	while (chain.back().Width > 1 || chain.back().Height > 1)
+	{
+		//every level is filtered from the previous one, exact box averages of the top for power of two sizes
+		chain.push_back(Downsample(chain.back(), content));
+	}
+	return chain;
+}
+
+MipLevel MipFilter::FromRgba8(const std::uint8_t* pixels, const std::uint32_t width, const std::uint32_t height, const size_t rowPitch)
+{
+	MipLevel level(width, height);
+	for (std::uint32_t y = 0; y < height; y++)
+	{
+		const std::uint8_t* row = pixels + y * rowPitch;
+		float* texels = level.At(0, y);
+		for (size_t i = 0; i < static_cast<size_t>(width) * 4; i++)
+			texels[i] = row[i] / 255.0f;
+	}
+	return level;
+}
+
+void MipFilter::ToRgba8(const MipLevel& level, std::uint8_t* pixels, const size_t rowPitch)
+{
+	for (std::uint32_t y = 0; y < level.Height; y++)
+	{
+		std::uint8_t* row = pixels + y * rowPitch;
+		const float* texels = level.At(0, y);
+		for (size_t i = 0; i < static_cast<size_t>(level.Width) * 4; i++)
+		{
+			const float value = (std::min)((std::max)(texels[i], 0.0f), 1.0f);
+			row[i] = static_cast<std::uint8_t>(value * 255.0f + 0.5f);
+		}
+	}
+}
+
+float MipFilter::SrgbToLinear(const float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float MipFilter::LinearToSrgb(const float value)
+{
+	if (value <= 0.0f)
+		return 0.0f;
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//how the channels of a texture have to be averaged
+enum class MipContent : std::int8_t
+{
+	Linear = 0,	//plain data, averaged as stored
+	Srgb,		//gamma-encoded rgb, averaged in linear space, alpha stays linear
+	Normal		//xyz packed into [0,1], averaged as vectors and brought back to unit length
+};
+
+//one level as rgba floats, rows top to bottom without padding
+struct MipLevel
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::vector<float> Texels;
+
+	MipLevel() = default;
+	MipLevel(std::uint32_t width, std::uint32_t height) : Width(width), Height(height), Texels(static_cast<size_t>(width) * height * 4) {}
+	float* At(std::uint32_t x, std::uint32_t y) { return &Texels[(static_cast<size_t>(y) * Width + x) * 4]; }
+	const float* At(std::uint32_t x, std::uint32_t y) const { return &Texels[(static_cast<size_t>(y) * Width + x) * 4]; }
+};
+
+//builds mip chains on the cpu. every texel of a level is the area-weighted average of the texels it covers
+//in the level above, which is a 2x2 box for even sizes and stays exact for odd ones.
+//has no device dependency, the upload code converts to and from its own image types
+class MipFilter
+{
+public:
+	//levels down to 1x1, the top one included
+	static std::uint32_t LevelCount(std::uint32_t width, std::uint32_t height);
+	static MipLevel Downsample(const MipLevel& source, MipContent content);
+	//the top level first, then every level down to 1x1
+	static std::vector<MipLevel> BuildChain(MipLevel top, MipContent content);
+
+	static MipLevel FromRgba8(const std::uint8_t* pixels, std::uint32_t width, std::uint32_t height, size_t rowPitch);
+	static void ToRgba8(const MipLevel& level, std::uint8_t* pixels, size_t rowPitch);
+
+	static float SrgbToLinear(float value);
+	static float LinearToSrgb(float value);
+};
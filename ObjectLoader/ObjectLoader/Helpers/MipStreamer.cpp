@@ -0,0 +1,233 @@
+#include "MipStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+int MipStreamer::MipForFootprint(const float uvPerPixel, const size_t textureSize, const int mipCount)
+{
+	const float texelsPerPixel = uvPerPixel * static_cast<float>(textureSize);
+	if (!(texelsPerPixel > 1.0f))
+	{
+		return 0;
+	}
+	const int mip = static_cast<int>(std::floor(std::log2(texelsPerPixel)));
+	return std::min(mip, mipCount - 1);
+}
+
+int MipStreamer::TailMip(size_t width, size_t height, const int mipCount, const size_t tailSize)
+{
+	int mip = 0;
+	while (mip < mipCount - 1 && std::max(width, height) > tailSize)
+	{
+		width = std::max<size_t>(width / 2, 1);
+		height = std::max<size_t>(height / 2, 1);
+		mip++;
+	}
+	return mip;
+}
+
+void MipStreamer::Track(const NameId id, const std::vector<std::uint64_t>& mipBytes, const int tailMip, const int residentMip)
+{
+	if (id == gInvalidNameId || mipBytes.empty())
+	{
+		return;
+	}
+	Untrack(id);
+	if (id >= _states.size())
+	{
+		_states.resize(static_cast<size_t>(id) + 1);
+	}
+
+	State& state = _states[id];
+	state.Tracked = true;
+	state.MipCount = static_cast<int>(mipBytes.size());
+	state.TailMip = tailMip;
+	state.Resident = residentMip;
+	state.Desired = INT32_MAX;
+	state.LastNeeded = _frame;
+	state.LastUsed = _frame;
+
+	state.BytesFrom.assign(mipBytes.size() + 1, 0);
+	for (int mip = state.MipCount - 1; mip >= 0; mip--)
+	{
+		state.BytesFrom[mip] = state.BytesFrom[mip + 1] + mipBytes[mip];
+	}
+	_residentBytes += BytesAt(state, residentMip);
+}
+
+void MipStreamer::Untrack(const NameId id)
+{
+	if (IsTracked(id))
+	{
+		_residentBytes -= BytesAt(_states[id], _states[id].Resident);
+		_states[id] = {};
+	}
+}
+
+bool MipStreamer::IsTracked(const NameId id) const
+{
+	return id < _states.size() && _states[id].Tracked;
+}
+
+void MipStreamer::Request(const NameId id, const int mip)
+{
+	if (!IsTracked(id))
+	{
+		return;
+	}
+	State& state = _states[id];
+	state.Desired = std::min(state.Desired, std::max(mip, 0));
+}
+
+std::vector<MipStreamer::Change> MipStreamer::Schedule(const int maxChanges)
+{
+	struct Candidate
+	{
+		Change Value;
+		int Priority;
+	};
+	std::vector<Candidate> upgrades;
+	std::vector<Candidate> downgrades;
+	//textures holding finer mips than they currently need, only dropped under budget pressure
+	std::vector<Candidate> surplus;
+
+	for (NameId id = 0; id < _states.size(); id++)
+	{
+		State& state = _states[id];
+		if (!state.Tracked)
+		{
+			continue;
+		}
+
+		if (state.Desired != INT32_MAX)
+		{
+			state.LastUsed = _frame;
+		}
+
+		//nothing coarser than the tail is ever needed
+		const int desired = std::min(state.Desired, state.TailMip);
+		state.Desired = INT32_MAX;
+
+		if (desired <= state.Resident)
+		{
+			state.LastNeeded = _frame;
+			if (desired < state.Resident)
+			{
+				upgrades.push_back({ { id, desired }, state.Resident - desired });
+			}
+		}
+		else if (_frame - state.LastNeeded > static_cast<std::uint64_t>(DowngradeDelay))
+		{
+			downgrades.push_back({ { id, desired }, desired - state.Resident });
+		}
+		else
+		{
+			surplus.push_back({ { id, desired }, desired - state.Resident });
+		}
+	}
+	_frame++;
+
+	const auto byPriority = [](const Candidate& a, const Candidate& b) { return a.Priority > b.Priority; };
+	std::sort(upgrades.begin(), upgrades.end(), byPriority);
+	std::sort(downgrades.begin(), downgrades.end(), byPriority);
+
+	std::vector<Change> changes;
+	std::uint64_t projected = _residentBytes;
+	const auto full = [&]() { return static_cast<int>(changes.size()) >= maxChanges; };
+	const auto apply = [&](const Change& change)
+	{
+		const State& state = _states[change.Id];
+		projected = projected - BytesAt(state, state.Resident) + BytesAt(state, change.TargetMip);
+		changes.push_back(change);
+	};
+
+	if (BudgetBytes > 0)
+	{
+		std::uint64_t wanted = projected;
+		for (size_t i = 0; i < upgrades.size() && static_cast<int>(i) < maxChanges; i++)
+		{
+			const State& state = _states[upgrades[i].Value.Id];
+			wanted += BytesAt(state, upgrades[i].Value.TargetMip) - BytesAt(state, state.Resident);
+		}
+
+		if (wanted > BudgetBytes)
+		{
+			//least recently used first, bigger savings break ties
+			std::vector<Candidate> evictions = downgrades;
+			evictions.insert(evictions.end(), surplus.begin(), surplus.end());
+			std::sort(evictions.begin(), evictions.end(), [this](const Candidate& a, const Candidate& b)
+				{
+					const State& stateA = _states[a.Value.Id];
+					const State& stateB = _states[b.Value.Id];
+					if (stateA.LastUsed != stateB.LastUsed)
+						return stateA.LastUsed < stateB.LastUsed;
+					return BytesAt(stateA, stateA.Resident) - BytesAt(stateA, a.Value.TargetMip) >
+						BytesAt(stateB, stateB.Resident) - BytesAt(stateB, b.Value.TargetMip);
+				});
+
+			for (const auto& candidate : evictions)
+			{
+				if (full() || wanted <= BudgetBytes) break;
+				const State& state = _states[candidate.Value.Id];
+				wanted -= BytesAt(state, state.Resident) - BytesAt(state, candidate.Value.TargetMip);
+				apply(candidate.Value);
+			}
+		}
+	}
+
+	for (const auto& candidate : upgrades)
+	{
+		if (full()) break;
+
+		const State& state = _states[candidate.Value.Id];
+		int target = candidate.Value.TargetMip;
+		//settle for the finest mip that still fits
+		while (BudgetBytes > 0 && target < state.Resident &&
+			projected - BytesAt(state, state.Resident) + BytesAt(state, target) > BudgetBytes)
+		{
+			target++;
+		}
+		if (target < state.Resident)
+		{
+			apply({ candidate.Value.Id, target });
+		}
+	}
+
+	for (const auto& candidate : downgrades)
+	{
+		if (full()) break;
+		const bool scheduled = std::any_of(changes.begin(), changes.end(),
+			[&](const Change& change) { return change.Id == candidate.Value.Id; });
+		if (!scheduled)
+		{
+			apply(candidate.Value);
+		}
+	}
+	return changes;
+}
+
+void MipStreamer::SetResident(const NameId id, const int mip)
+{
+	if (IsTracked(id))
+	{
+		State& state = _states[id];
+		_residentBytes = _residentBytes - BytesAt(state, state.Resident) + BytesAt(state, mip);
+		state.Resident = mip;
+		state.LastNeeded = _frame;
+	}
+}
+
+int MipStreamer::Resident(const NameId id) const
+{
+	return IsTracked(id) ? _states[id].Resident : 0;
+}
+
+std::uint64_t MipStreamer::LastUsed(const NameId id) const
+{
+	return IsTracked(id) ? _states[id].LastUsed : 0;
+}
+
+std::uint64_t MipStreamer::BytesAt(const State& state, const int mip)
+{
+	return state.BytesFrom[std::min(std::max(mip, 0), state.MipCount)];
+}
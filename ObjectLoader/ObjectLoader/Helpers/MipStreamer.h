@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "NameTable.h"
+
+//cpu side of texture mip streaming. collects per-frame mip requests and decides
+//which textures have to be reallocated with a finer or coarser top mip.
+//with a budget set, least recently used textures drop to their tail to make room
+class MipStreamer
+{
+public:
+	struct Change
+	{
+		NameId Id = gInvalidNameId;
+		int TargetMip = 0;
+	};
+
+	//mip which gives about one texel per pixel for the given uv footprint of a pixel
+	static int MipForFootprint(float uvPerPixel, size_t textureSize, int mipCount);
+	//finest mip that is always kept resident
+	static int TailMip(size_t width, size_t height, int mipCount, size_t tailSize = 128);
+
+	//mipBytes holds the size of every level, finest first
+	void Track(NameId id, const std::vector<std::uint64_t>& mipBytes, int tailMip, int residentMip);
+	void Untrack(NameId id);
+	bool IsTracked(NameId id) const;
+	//keeps the finest mip requested during the frame
+	void Request(NameId id, int mip);
+	//evictions when over budget, then upgrades with the biggest gaps first, then expired downgrades.
+	//clears this frame's requests
+	std::vector<Change> Schedule(int maxChanges);
+	void SetResident(NameId id, int mip);
+	int Resident(NameId id) const;
+	std::uint64_t LastUsed(NameId id) const;
+	std::uint64_t ResidentBytes() const { return _residentBytes; }
+
+	//frames a texture keeps its mips after it stopped needing them
+	int DowngradeDelay = 240;
+	//0 disables the budget
+	std::uint64_t BudgetBytes = 0;
+
+private:
+	struct State
+	{
+		bool Tracked = false;
+		int MipCount = 1;
+		int TailMip = 0;
+		int Resident = 0;
+		int Desired = INT32_MAX;
+		std::uint64_t LastNeeded = 0;
+		std::uint64_t LastUsed = 0;
+		//bytes resident when a mip is the top one
+		std::vector<std::uint64_t> BytesFrom;
+	};
+
+	static std::uint64_t BytesAt(const State& state, int mip);
+
+	std::vector<State> _states;
+	std::uint64_t _frame = 0;
+	std::uint64_t _residentBytes = 0;
+};
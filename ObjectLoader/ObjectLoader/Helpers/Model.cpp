@@ -66,6 +66,9 @@ Mesh Model::ParseMesh(aiMesh* mesh, Lod& lod, DirectX::XMMATRIX parentWorld)
 	meshData.MaterialIndex = mesh->mMaterialIndex;
 	meshData.DefaultWorld = parentWorld;
 
+	XMFLOAT3 meshMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+	XMFLOAT3 meshMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 	{
 		Vertex v;
@@ -93,6 +96,13 @@ Mesh Model::ParseMesh(aiMesh* mesh, Lod& lod, DirectX::XMMATRIX parentWorld)
 		lod.VMax.y = std::max(pos.y, lod.VMax.y);
 		lod.VMax.z = std::max(pos.z, lod.VMax.z);
 
+		meshMin.x = std::min(pos.x, meshMin.x);
+		meshMin.y = std::min(pos.y, meshMin.y);
+		meshMin.z = std::min(pos.z, meshMin.z);
+		meshMax.x = std::max(pos.x, meshMax.x);
+		meshMax.y = std::max(pos.y, meshMax.y);
+		meshMax.z = std::max(pos.z, meshMax.z);
+
 		v.TexC = { tex.x, tex.y };
 		v.Normal = { normal.x, normal.y, normal.z };
 		v.Tangent = { tangent.x, tangent.y, tangent.z };
@@ -113,6 +123,33 @@ Mesh Model::ParseMesh(aiMesh* mesh, Lod& lod, DirectX::XMMATRIX parentWorld)
 
 	meshData.IndexCount = lod.Indices.size() - meshData.IndexStart;
 
+	if (mesh->mNumVertices > 0)
+	{
+		BoundingBox::CreateFromPoints(meshData.Aabb, XMLoadFloat3(&meshMin), XMLoadFloat3(&meshMax));
+	}
+
+	//ratio of uv area to surface area, a texture covers sqrt of it per unit of length
+	float uvArea = 0.0f;
+	float surfaceArea = 0.0f;
+	for (size_t i = meshData.IndexStart; i + 2 < lod.Indices.size(); i += 3)
+	{
+		const Vertex& v0 = lod.Vertices[meshData.VertexStart + lod.Indices[i]];
+		const Vertex& v1 = lod.Vertices[meshData.VertexStart + lod.Indices[i + 1]];
+		const Vertex& v2 = lod.Vertices[meshData.VertexStart + lod.Indices[i + 2]];
+
+		const XMVECTOR p0 = XMLoadFloat3(&v0.Pos);
+		const XMVECTOR cross = XMVector3Cross(XMLoadFloat3(&v1.Pos) - p0, XMLoadFloat3(&v2.Pos) - p0);
+		surfaceArea += 0.5f * XMVectorGetX(XMVector3Length(cross));
+
+		const float du1 = v1.TexC.x - v0.TexC.x, dv1 = v1.TexC.y - v0.TexC.y;
+		const float du2 = v2.TexC.x - v0.TexC.x, dv2 = v2.TexC.y - v0.TexC.y;
+		uvArea += 0.5f * std::abs(du1 * dv2 - du2 * dv1);
+	}
+	if (surfaceArea > 0.0f && uvArea > 0.0f)
+	{
+		meshData.UvDensity = std::sqrt(uvArea / surfaceArea);
+	}
+
 	return std::move(meshData);
 }
 
@@ -123,7 +160,7 @@ void Model::ParseMaterial(aiMaterial* material, aiTexture** textures)
 
 	auto& newMaterial = std::make_unique<Material>();
 
-	newMaterial->name = material->GetName().C_Str();
+	newMaterial->name = NameTable::Intern(material->GetName().C_Str());
 
 	aiColor4D color;
 
@@ -249,12 +286,12 @@ bool Model::LoadMatPropTexture(aiMaterial* material, Material* newMaterial, aiTe
 			int texIndex = atoi(texPath.C_Str() + 1);
 			aiTexture* embeddedTex = textures[texIndex];
 			std::wstring texName = std::wstring(name.begin(), name.end()) + L"__embedded_" + std::to_wstring(texIndex);
-			newMaterial->properties[BasicUtil::EnumIndex(property)].texture = TextureManager::LoadEmbeddedTexture(texName, embeddedTex);
+			newMaterial->properties[BasicUtil::EnumIndex(property)].texture = TextureManager::LoadEmbeddedTexture(texName, embeddedTex, TextureRoleOf(property), _fileLocation);
 			return true;
 		}
 
 		std::wstring textureFileNameW = std::wstring(textureFilename.begin(), textureFilename.end());
-		newMaterial->properties[BasicUtil::EnumIndex(property)].texture = TextureManager::LoadTexture((_fileLocation + textureFileNameW).c_str(), 0, 1);
+		newMaterial->properties[BasicUtil::EnumIndex(property)].texture = TextureManager::LoadTextureAsync((_fileLocation + textureFileNameW).c_str(), TextureRoleOf(property), PlaceholderOf(property));
 		return true;
 	}
 	return false;
@@ -273,12 +310,12 @@ bool Model::LoadMatTexture(aiMaterial* material, Material* newMaterial, aiTextur
 			int texIndex = atoi(texPath.C_Str() + 1);
 			aiTexture* embeddedTex = textures[texIndex];
 			std::wstring texName = std::wstring(name.begin(), name.end()) + L"__embedded_" + std::to_wstring(texIndex);
-			newMaterial->textures[BasicUtil::EnumIndex(property)] = TextureManager::LoadEmbeddedTexture(texName, embeddedTex);
+			newMaterial->textures[BasicUtil::EnumIndex(property)] = TextureManager::LoadEmbeddedTexture(texName, embeddedTex, TextureRoleOf(property), _fileLocation);
 			return true;
 		}
 
 		std::wstring textureFileNameW = std::wstring(textureFilename.begin(), textureFilename.end());
-		newMaterial->textures[BasicUtil::EnumIndex(property)] = TextureManager::LoadTexture((_fileLocation + textureFileNameW).c_str(), 0, 1);
+		newMaterial->textures[BasicUtil::EnumIndex(property)] = TextureManager::LoadTextureAsync((_fileLocation + textureFileNameW).c_str(), TextureRoleOf(property), PlaceholderOf(property));
 		return true;
 	}
 	return false;
@@ -319,5 +356,12 @@ void Model::AlignMeshes()
 			vertex.Pos.y += offset.y;
 			vertex.Pos.z += offset.z;
 		}
+
+		for (auto& mesh : lodIt->Meshes)
+		{
+			mesh.Aabb.Center.x += offset.x;
+			mesh.Aabb.Center.y += offset.y;
+			mesh.Aabb.Center.z += offset.z;
+		}
 	}
 }
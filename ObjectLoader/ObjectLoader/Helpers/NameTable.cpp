@@ -0,0 +1,55 @@
+#include "NameTable.h"
+
+NameId NameTable::Intern(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(Mutex());
+	const auto it = Ids().find(name);
+	if (it != Ids().end())
+	{
+		return it->second;
+	}
+
+	const auto id = static_cast<NameId>(Names().size());
+	Names().push_back(name);
+	Ids()[name] = id;
+	return id;
+}
+
+NameId NameTable::Find(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(Mutex());
+	const auto it = Ids().find(name);
+	return it == Ids().end() ? gInvalidNameId : it->second;
+}
+
+const std::string& NameTable::Name(const NameId id)
+{
+	static const std::string empty;
+	std::lock_guard<std::mutex> lock(Mutex());
+	return id < Names().size() ? Names()[id] : empty;
+}
+
+size_t NameTable::Count()
+{
+	std::lock_guard<std::mutex> lock(Mutex());
+	return Names().size();
+}
+
+std::unordered_map<std::string, NameId>& NameTable::Ids()
+{
+	static std::unordered_map<std::string, NameId> ids;
+	return ids;
+}
+
+std::deque<std::string>& NameTable::Names()
+{
+	//deque keeps handed out references valid while names are added
+	static std::deque<std::string> names;
+	return names;
+}
+
+std::mutex& NameTable::Mutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+//compact id of an interned name, usable as an index into dense arrays
+using NameId = std::uint32_t;
+constexpr NameId gInvalidNameId = UINT32_MAX;
+
+//maps strings to ids once at import time, so hot paths never hash strings.
+//the string form is kept for ui and debugging only. safe to call from worker threads,
+//returned names stay valid for the whole run
+class NameTable
+{
+public:
+	//returns the id of the name, adding it if it was not interned yet
+	static NameId Intern(const std::string& name);
+	//returns gInvalidNameId if the name was never interned
+	static NameId Find(const std::string& name);
+	static const std::string& Name(NameId id);
+	static size_t Count();
+
+private:
+	static std::unordered_map<std::string, NameId>& Ids();
+	static std::deque<std::string>& Names();
+	static std::mutex& Mutex();
+};
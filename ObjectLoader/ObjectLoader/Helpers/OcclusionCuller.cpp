@@ -0,0 +1,455 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	//clip space w below this is treated as crossing the camera plane
+	constexpr float gMinW = 1e-4f;
+
+	enum class Voxel : uint8_t
+	{
+		Unknown = 0,
+		Surface,
+		Outside
+	};
+
+	struct VoxelBox
+	{
+		int Min[3];
+		int Max[3];	//exclusive
+		int Volume;
+	};
+}
+
+OcclusionCuller::OcclusionCuller(const int width, const int height)
+	: _width((std::max)((width + 3) & ~3, 4)), _height((std::max)(height, 1))
+{
+	XMStoreFloat4x4(&_viewProj, XMMatrixIdentity());
+
+	int levelWidth = _width;
+	int levelHeight = _height;
+	while (true)
+	{
+		_levels.emplace_back(static_cast<size_t>(levelWidth) * levelHeight, 1.0f);
+		_levelWidths.push_back(levelWidth);
+		_levelHeights.push_back(levelHeight);
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+OccluderMesh OcclusionCuller::BuildOccluder(const std::vector<XMFLOAT3>& triangles, const int resolution, const int maxBoxes)
+{
+	OccluderMesh occluder;
+	if (triangles.size() < 3 || resolution < 3)
+		return occluder;
+
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const auto& position : triangles)
+	{
+		const float* p = &position.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = (std::min)(boundsMin[axis], p[axis]);
+			boundsMax[axis] = (std::max)(boundsMax[axis], p[axis]);
+		}
+	}
+
+	float cell[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		cell[axis] = (boundsMax[axis] - boundsMin[axis]) / static_cast<float>(resolution);
+		//flat along an axis, nothing can be enclosed
+		if (cell[axis] <= 0.0f)
+			return occluder;
+	}
+
+	//one layer of empty voxels around the mesh so the outside is connected
+	const int size = resolution + 2;
+	const auto voxelIndex = [size](const int x, const int y, const int z) { return (static_cast<size_t>(z) * size + y) * size + x; };
+	std::vector<Voxel> voxels(static_cast<size_t>(size) * size * size, Voxel::Unknown);
+
+	//mark voxels the triangles pass through by sampling each triangle finer than the grid,
+	//a missed voxel only lets the outside leak in and shrinks the occluder
+	for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+	{
+		const float* p0 = &triangles[t].x;
+		const float* p1 = &triangles[t + 1].x;
+		const float* p2 = &triangles[t + 2].x;
+
+		float longestEdge = 0.0f;
+		for (const auto& edge : { std::make_pair(p0, p1), std::make_pair(p1, p2), std::make_pair(p2, p0) })
+		{
+			float length = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const float d = (edge.second[axis] - edge.first[axis]) / cell[axis];
+				length += d * d;
+			}
+			longestEdge = (std::max)(longestEdge, std::sqrt(length));
+		}
+
+		const int steps = (std::max)(1, static_cast<int>(std::ceil(longestEdge * 3.0f)));
+		for (int i = 0; i <= steps; i++)
+		{
+			for (int j = 0; j <= steps - i; j++)
+			{
+				const float u = static_cast<float>(i) / steps;
+				const float v = static_cast<float>(j) / steps;
+				int coords[3];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float p = p0[axis] + (p1[axis] - p0[axis]) * u + (p2[axis] - p0[axis]) * v;
+					const int c = static_cast<int>((p - boundsMin[axis]) / cell[axis]);
+					coords[axis] = (std::min)((std::max)(c, 0), resolution - 1) + 1;
+				}
+				voxels[voxelIndex(coords[0], coords[1], coords[2])] = Voxel::Surface;
+			}
+		}
+	}
+
+	//flood the outside through face neighbours, whatever stays unknown is enclosed
+	std::vector<size_t> stack{ voxelIndex(0, 0, 0) };
+	voxels[stack.back()] = Voxel::Outside;
+	while (!stack.empty())
+	{
+		const size_t index = stack.back();
+		stack.pop_back();
+		const int x = static_cast<int>(index % size);
+		const int y = static_cast<int>(index / size % size);
+		const int z = static_cast<int>(index / (static_cast<size_t>(size) * size));
+		const int neighbours[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+		for (const auto& n : neighbours)
+		{
+			if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= size || n[1] >= size || n[2] >= size)
+				continue;
+			const size_t neighbour = voxelIndex(n[0], n[1], n[2]);
+			if (voxels[neighbour] != Voxel::Unknown)
+				continue;
+			voxels[neighbour] = Voxel::Outside;
+			stack.push_back(neighbour);
+		}
+	}
+
+	//greedy merge of enclosed voxels into boxes, x runs first, then rows, then slabs
+	std::vector<bool> used(voxels.size(), false);
+	const auto isFree = [&](const int x, const int y, const int z)
+	{
+		const size_t index = voxelIndex(x, y, z);
+		return voxels[index] == Voxel::Unknown && !used[index];
+	};
+
+	std::vector<VoxelBox> boxes;
+	for (int z = 1; z <= resolution; z++)
+	{
+		for (int y = 1; y <= resolution; y++)
+		{
+			for (int x = 1; x <= resolution; x++)
+			{
+				if (!isFree(x, y, z))
+					continue;
+
+				int endX = x + 1;
+				while (endX <= resolution && isFree(endX, y, z))
+					endX++;
+
+				const auto rowFree = [&](const int row, const int slab)
+				{
+					for (int i = x; i < endX; i++)
+					{
+						if (!isFree(i, row, slab))
+							return false;
+					}
+					return true;
+				};
+				int endY = y + 1;
+				while (endY <= resolution && rowFree(endY, z))
+					endY++;
+
+				int endZ = z + 1;
+				while (endZ <= resolution)
+				{
+					bool slabFree = true;
+					for (int row = y; row < endY && slabFree; row++)
+						slabFree = rowFree(row, endZ);
+					if (!slabFree)
+						break;
+					endZ++;
+				}
+
+				for (int k = z; k < endZ; k++)
+					for (int j = y; j < endY; j++)
+						for (int i = x; i < endX; i++)
+							used[voxelIndex(i, j, k)] = true;
+
+				boxes.push_back({ { x, y, z }, { endX, endY, endZ }, (endX - x) * (endY - y) * (endZ - z) });
+			}
+		}
+	}
+
+	//the biggest boxes hide the most for the same raster cost
+	std::sort(boxes.begin(), boxes.end(), [](const VoxelBox& a, const VoxelBox& b) { return a.Volume > b.Volume; });
+	if (static_cast<int>(boxes.size()) > maxBoxes)
+		boxes.resize(maxBoxes);
+
+	static const uint32_t boxIndices[24] =
+	{
+		0, 1, 3, 2,	//-x
+		4, 6, 7, 5,	//+x
+		0, 4, 5, 1,	//-y
+		2, 3, 7, 6,	//+y
+		0, 2, 6, 4,	//-z
+		1, 5, 7, 3	//+z
+	};
+
+	for (const auto& box : boxes)
+	{
+		const auto base = static_cast<uint32_t>(occluder.Vertices.size());
+		float corner[2][3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			//grid coordinates are shifted by the border layer
+			corner[0][axis] = boundsMin[axis] + static_cast<float>(box.Min[axis] - 1) * cell[axis];
+			corner[1][axis] = boundsMin[axis] + static_cast<float>(box.Max[axis] - 1) * cell[axis];
+		}
+		//vertex i takes x from bit 2, y from bit 1, z from bit 0
+		for (int i = 0; i < 8; i++)
+			occluder.Vertices.emplace_back(corner[i >> 2 & 1][0], corner[i >> 1 & 1][1], corner[i & 1][2]);
+		for (const uint32_t index : boxIndices)
+			occluder.Indices.push_back(base + index);
+	}
+
+	return occluder;
+}
+
+void OcclusionCuller::BeginFrame(const FXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&_viewProj, viewProj);
+	std::fill(_levels[0].begin(), _levels[0].end(), 1.0f);
+	_rasterizedQuads = 0;
+}
+
+void OcclusionCuller::RasterizeOccluder(const OccluderMesh& mesh, const FXMMATRIX world)
+{
+	const XMMATRIX worldViewProj = world * XMLoadFloat4x4(&_viewProj);
+
+	std::vector<ScreenVertex> screen(mesh.Vertices.size());
+	std::vector<bool> clipped(mesh.Vertices.size());
+	for (size_t i = 0; i < mesh.Vertices.size(); i++)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&mesh.Vertices[i]), worldViewProj));
+		clipped[i] = clip.w < gMinW || clip.z < 0.0f;
+		if (clipped[i])
+			continue;
+		const float invW = 1.0f / clip.w;
+		screen[i] = { (clip.x * invW * 0.5f + 0.5f) * _width, (0.5f - clip.y * invW * 0.5f) * _height, clip.z * invW };
+	}
+
+	for (size_t i = 0; i + 3 < mesh.Indices.size(); i += 4)
+	{
+		//faces reaching past the near plane are skipped, leaving a hole is always safe
+		bool skip = false;
+		ScreenVertex quad[4];
+		for (int k = 0; k < 4; k++)
+		{
+			const uint32_t index = mesh.Indices[i + k];
+			skip = skip || clipped[index];
+			quad[k] = screen[index];
+		}
+		if (!skip)
+			RasterizeQuad(quad);
+	}
+}
+
+void OcclusionCuller::RasterizeQuad(ScreenVertex v[4])
+{
+	float area = 0.0f;
+	for (int k = 0; k < 4; k++)
+		area += v[k].X * v[(k + 1) % 4].Y - v[(k + 1) % 4].X * v[k].Y;
+	//both windings are drawn, the depth test keeps the nearer side
+	if (area < 0.0f)
+	{
+		std::swap(v[1], v[3]);
+		area = -area;
+	}
+	if (area < 1e-6f)
+		return;
+
+	float minXf = FLT_MAX, maxXf = -FLT_MAX, minYf = FLT_MAX, maxYf = -FLT_MAX;
+	for (int k = 0; k < 4; k++)
+	{
+		minXf = (std::min)(minXf, v[k].X);
+		maxXf = (std::max)(maxXf, v[k].X);
+		minYf = (std::min)(minYf, v[k].Y);
+		maxYf = (std::max)(maxYf, v[k].Y);
+	}
+	const int minX = (std::max)(static_cast<int>(std::floor(minXf)), 0);
+	const int maxX = (std::min)(static_cast<int>(std::ceil(maxXf)), _width - 1);
+	const int minY = (std::max)(static_cast<int>(std::floor(minYf)), 0);
+	const int maxY = (std::min)(static_cast<int>(std::ceil(maxYf)), _height - 1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	_rasterizedQuads++;
+
+	//edge functions a * x + b * y + c, positive inside, shifted by the half pixel
+	//reach so only pixels the quad covers completely pass
+	float edgeA[4], edgeB[4], edgeC[4];
+	for (int e = 0; e < 4; e++)
+	{
+		const ScreenVertex& from = v[e];
+		const ScreenVertex& to = v[(e + 1) % 4];
+		edgeA[e] = from.Y - to.Y;
+		edgeB[e] = to.X - from.X;
+		edgeC[e] = (to.Y - from.Y) * from.X - (to.X - from.X) * from.Y - 0.5f * (std::abs(edgeA[e]) + std::abs(edgeB[e]));
+	}
+
+	//depth plane from the larger half of the quad, pushed to the farthest value inside each pixel
+	const ScreenVertex& p0 = v[0];
+	const float area012 = std::abs((v[1].X - p0.X) * (v[2].Y - p0.Y) - (v[2].X - p0.X) * (v[1].Y - p0.Y));
+	const float area023 = std::abs((v[2].X - p0.X) * (v[3].Y - p0.Y) - (v[3].X - p0.X) * (v[2].Y - p0.Y));
+	const ScreenVertex& p1 = area012 >= area023 ? v[1] : v[2];
+	const ScreenVertex& p2 = area012 >= area023 ? v[2] : v[3];
+	const float det = (p1.X - p0.X) * (p2.Y - p0.Y) - (p2.X - p0.X) * (p1.Y - p0.Y);
+	const float dzdx = ((p1.Z - p0.Z) * (p2.Y - p0.Y) - (p2.Z - p0.Z) * (p1.Y - p0.Y)) / det;
+	const float dzdy = ((p2.Z - p0.Z) * (p1.X - p0.X) - (p1.Z - p0.Z) * (p2.X - p0.X)) / det;
+	const float dzc = p0.Z - dzdx * p0.X - dzdy * p0.Y + 0.5f * (std::abs(dzdx) + std::abs(dzdy));
+
+	std::vector<float>& depth = _levels[0];
+	const int startX = minX & ~3;
+
+#if defined(_XM_SSE_INTRINSICS_)
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (int y = minY; y <= maxY; y++)
+	{
+		const float centerY = static_cast<float>(y) + 0.5f;
+		__m128 rowEdge[4];
+		for (int e = 0; e < 4; e++)
+			rowEdge[e] = _mm_set1_ps(edgeB[e] * centerY + edgeC[e]);
+		const __m128 rowDepth = _mm_set1_ps(dzdy * centerY + dzc);
+		float* row = depth.data() + static_cast<size_t>(y) * _width;
+
+		for (int x = startX; x <= maxX; x += 4)
+		{
+			const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[0]), centerX), rowEdge[0]), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[1]), centerX), rowEdge[1]), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[2]), centerX), rowEdge[2]), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[3]), centerX), rowEdge[3]), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), centerX), rowDepth);
+			const __m128 current = _mm_loadu_ps(row + x);
+			const __m128 nearer = _mm_min_ps(current, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+		}
+	}
+#else
+	for (int y = minY; y <= maxY; y++)
+	{
+		const float centerY = static_cast<float>(y) + 0.5f;
+		float* row = depth.data() + static_cast<size_t>(y) * _width;
+		for (int x = startX; x <= maxX; x++)
+		{
+			const float centerX = static_cast<float>(x) + 0.5f;
+			bool inside = true;
+			for (int e = 0; e < 4; e++)
+				inside = inside && edgeA[e] * centerX + edgeB[e] * centerY + edgeC[e] >= 0.0f;
+			if (inside)
+				row[x] = (std::min)(row[x], dzdx * centerX + dzdy * centerY + dzc);
+		}
+	}
+#endif
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	for (size_t level = 1; level < _levels.size(); level++)
+	{
+		const std::vector<float>& source = _levels[level - 1];
+		std::vector<float>& target = _levels[level];
+		const int sourceWidth = _levelWidths[level - 1];
+		const int sourceHeight = _levelHeights[level - 1];
+		const int width = _levelWidths[level];
+		const int height = _levelHeights[level];
+
+		for (int y = 0; y < height; y++)
+		{
+			const int y0 = y * 2;
+			const int y1 = (std::min)(y0 + 1, sourceHeight - 1);
+			for (int x = 0; x < width; x++)
+			{
+				const int x0 = x * 2;
+				const int x1 = (std::min)(x0 + 1, sourceWidth - 1);
+				target[static_cast<size_t>(y) * width + x] = (std::max)(
+					(std::max)(source[static_cast<size_t>(y0) * sourceWidth + x0], source[static_cast<size_t>(y0) * sourceWidth + x1]),
+					(std::max)(source[static_cast<size_t>(y1) * sourceWidth + x0], source[static_cast<size_t>(y1) * sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& worldBox) const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	worldBox.GetCorners(corners);
+	const XMMATRIX viewProj = XMLoadFloat4x4(&_viewProj);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearestZ = FLT_MAX;
+	for (const auto& corner : corners)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), viewProj));
+		//box reaches the camera, nothing can be in front of it
+		if (clip.w < gMinW)
+			return true;
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * _width;
+		const float y = (0.5f - clip.y * invW * 0.5f) * _height;
+		minX = (std::min)(minX, x);
+		maxX = (std::max)(maxX, x);
+		minY = (std::min)(minY, y);
+		maxY = (std::max)(maxY, y);
+		nearestZ = (std::min)(nearestZ, clip.z * invW);
+	}
+	if (nearestZ <= 0.0f)
+		return true;
+
+	//off screen boxes are left to frustum culling
+	const int x0 = (std::max)(static_cast<int>(std::floor(minX)), 0);
+	const int x1 = (std::min)(static_cast<int>(std::ceil(maxX)) - 1, _width - 1);
+	const int y0 = (std::max)(static_cast<int>(std::floor(minY)), 0);
+	const int y1 = (std::min)(static_cast<int>(std::ceil(maxY)) - 1, _height - 1);
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	//coarsest level where the rectangle spans at most four texels a side
+	size_t level = 0;
+	while (level + 1 < _levels.size() && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4))
+		level++;
+
+	const std::vector<float>& depth = _levels[level];
+	const int width = _levelWidths[level];
+	const int height = _levelHeights[level];
+	for (int y = y0 >> level; y <= (std::min)(y1 >> level, height - 1); y++)
+	{
+		for (int x = x0 >> level; x <= (std::min)(x1 >> level, width - 1); x++)
+		{
+			if (nearestZ < depth[static_cast<size_t>(y) * width + x])
+				return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+//conservative stand in for an occluder, boxes that lie inside the closed source mesh
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> Vertices;
+	//four per face, planar convex quads so no diagonal seam is left uncovered
+	std::vector<uint32_t> Indices;
+
+	bool Empty() const { return Indices.empty(); }
+};
+
+//coarse cpu depth buffer, occluders are rasterized into it and boxes are tested
+//against a max depth pyramid built on top of it
+class OcclusionCuller
+{
+public:
+	//width is rounded up to a multiple of four for the simd rows
+	explicit OcclusionCuller(int width = 256, int height = 128);
+
+	//voxelizes a triangle soup and merges the voxels it encloses into at most maxBoxes boxes,
+	//open meshes enclose nothing and give an empty occluder
+	static OccluderMesh BuildOccluder(const std::vector<DirectX::XMFLOAT3>& triangles, int resolution = 16, int maxBoxes = 16);
+
+	//clears the buffer, viewProj maps world space to d3d clip space with depth 0 at the near plane
+	void BeginFrame(DirectX::FXMMATRIX viewProj);
+	//only pixels fully covered by a face are written, with the farthest depth inside the pixel
+	void RasterizeOccluder(const OccluderMesh& mesh, DirectX::FXMMATRIX world);
+	//builds the max depth pyramid, call after the last occluder
+	void BuildHierarchy();
+	//false only when the whole box is behind rasterized occluders
+	bool IsVisible(const DirectX::BoundingBox& worldBox) const;
+
+	int Width() const { return _width; }
+	int Height() const { return _height; }
+	const std::vector<float>& Depth() const { return _levels[0]; }
+	int RasterizedQuads() const { return _rasterizedQuads; }
+
+private:
+	//screen space x, y in pixels and depth
+	struct ScreenVertex
+	{
+		float X;
+		float Y;
+		float Z;
+	};
+
+	void RasterizeQuad(ScreenVertex v[4]);
+
+	int _width;
+	int _height;
+	DirectX::XMFLOAT4X4 _viewProj;
+	//level 0 is the depth buffer, every next level keeps the max of 2x2 texels
+	std::vector<std::vector<float>> _levels;
+	std::vector<int> _levelWidths;
+	std::vector<int> _levelHeights;
+	int _rasterizedQuads = 0;
+};
@@ -0,0 +1,586 @@
+#include "PvsBaker.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+#include "SceneBvh.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t gPvsMagic = 0x31535650; //PVS1
+
+	enum SetEncoding : uint8_t
+	{
+		RawBits,
+		Runs
+	};
+
+	void Corners(const BoundingBox& box, float min[3], float max[3])
+	{
+		const float* center = &box.Center.x;
+		const float* extents = &box.Extents.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = center[axis] - extents[axis];
+			max[axis] = center[axis] + extents[axis];
+		}
+	}
+
+	void TransformPoint(const XMFLOAT4X4& m, const float p[3], float result[3])
+	{
+		for (int axis = 0; axis < 3; axis++)
+			result[axis] = p[0] * m.m[0][axis] + p[1] * m.m[1][axis] + p[2] * m.m[2][axis] + m.m[3][axis];
+	}
+
+	bool Inside(const float p[3], const float min[3], const float max[3])
+	{
+		return p[0] > min[0] && p[0] < max[0] && p[1] > min[1] && p[1] < max[1] && p[2] > min[2] && p[2] < max[2];
+	}
+
+	//segment a-b against the box, grazing a face or an edge does not count
+	bool SegmentCrossesBox(const float a[3], const float b[3], const float min[3], const float max[3])
+	{
+		float enter = 0.0f;
+		float exit = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float d = b[axis] - a[axis];
+			if (std::abs(d) < 1e-12f)
+			{
+				if (a[axis] <= min[axis] || a[axis] >= max[axis])
+					return false;
+				continue;
+			}
+			float t0 = (min[axis] - a[axis]) / d;
+			float t1 = (max[axis] - a[axis]) / d;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			enter = (std::max)(enter, t0);
+			exit = (std::min)(exit, t1);
+			if (enter >= exit)
+				return false;
+		}
+		return true;
+	}
+
+	//lets SceneBvh::Query walk the nodes a segment passes through
+	struct SegmentVolume
+	{
+		float A[3];
+		float B[3];
+
+		ContainmentType Contains(const BoundingBox& box) const
+		{
+			float min[3];
+			float max[3];
+			Corners(box, min, max);
+			//closed box here, a segment along a node face still has to reach its leaves
+			for (int axis = 0; axis < 3; axis++)
+			{
+				min[axis] -= 1e-4f;
+				max[axis] += 1e-4f;
+			}
+			return SegmentCrossesBox(A, B, min, max) ? INTERSECTS : DISJOINT;
+		}
+	};
+
+	struct BlockerScene
+	{
+		const std::vector<PvsBlocker>& Blockers;
+		SceneBvh Bvh;
+
+		bool InsideAny(const float p[3]) const
+		{
+			for (const auto& blocker : Blockers)
+			{
+				if (Contains(blocker, p))
+					return true;
+			}
+			return false;
+		}
+
+		static bool Contains(const PvsBlocker& blocker, const float p[3])
+		{
+			float local[3];
+			float min[3];
+			float max[3];
+			TransformPoint(blocker.WorldToLocal, p, local);
+			Corners(blocker.LocalBox, min, max);
+			return Inside(local, min, max);
+		}
+
+		//candidates is scratch space of the calling thread
+		bool Blocked(const float a[3], const float b[3], const int target, std::vector<int>& candidates) const
+		{
+			SegmentVolume segment;
+			std::memcpy(segment.A, a, sizeof(segment.A));
+			std::memcpy(segment.B, b, sizeof(segment.B));
+			candidates.clear();
+			Bvh.Query(segment, candidates);
+
+			for (const int i : candidates)
+			{
+				const PvsBlocker& blocker = Blockers[i];
+				if (blocker.Object == target)
+					continue;
+
+				float localA[3];
+				float localB[3];
+				float min[3];
+				float max[3];
+				TransformPoint(blocker.WorldToLocal, a, localA);
+				TransformPoint(blocker.WorldToLocal, b, localB);
+				Corners(blocker.LocalBox, min, max);
+				//a sample inside a wall sees nothing through it, but it should not hide anything either
+				if (Inside(localA, min, max))
+					continue;
+				if (SegmentCrossesBox(localA, localB, min, max))
+					return true;
+			}
+			return false;
+		}
+	};
+
+	//corners first, then the center, then random points
+	void CellSamples(const float min[3], const float max[3], const int count, std::mt19937& rng, std::vector<XMFLOAT3>& samples)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		samples.clear();
+		for (int i = 0; i < count; i++)
+		{
+			float t[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (i < 8)
+					t[axis] = (i >> axis & 1) ? 0.999f : 0.001f;
+				else if (i == 8)
+					t[axis] = 0.5f;
+				else
+					t[axis] = unit(rng);
+			}
+			samples.emplace_back(min[0] + (max[0] - min[0]) * t[0], min[1] + (max[1] - min[1]) * t[1], min[2] + (max[2] - min[2]) * t[2]);
+		}
+	}
+
+	//corners, then face centers, then random points on the faces
+	void SurfaceSamples(const float min[3], const float max[3], const int count, std::mt19937& rng, std::vector<XMFLOAT3>& samples)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		samples.clear();
+		for (int i = 0; i < count; i++)
+		{
+			float t[3];
+			if (i < 8)
+			{
+				for (int axis = 0; axis < 3; axis++)
+					t[axis] = static_cast<float>(i >> axis & 1);
+			}
+			else
+			{
+				const int face = (i - 8) % 6;
+				for (int axis = 0; axis < 3; axis++)
+					t[axis] = i < 14 ? 0.5f : unit(rng);
+				t[face >> 1] = static_cast<float>(face & 1);
+			}
+			samples.emplace_back(min[0] + (max[0] - min[0]) * t[0], min[1] + (max[1] - min[1]) * t[1], min[2] + (max[2] - min[2]) * t[2]);
+		}
+	}
+
+	float BoxGap(const float minA[3], const float maxA[3], const float minB[3], const float maxB[3])
+	{
+		float gap = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float d = (std::max)((std::max)(minA[axis] - maxB[axis], minB[axis] - maxA[axis]), 0.0f);
+			gap += d * d;
+		}
+		return std::sqrt(gap);
+	}
+
+	void WriteVarint(size_t value, std::vector<uint8_t>& out)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	size_t ReadVarint(const uint8_t*& p, const uint8_t* end)
+	{
+		size_t value = 0;
+		int shift = 0;
+		while (p < end)
+		{
+			const uint8_t byte = *p++;
+			value |= static_cast<size_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+			shift += 7;
+		}
+		return value;
+	}
+
+	template <typename T>
+	void Write(std::ofstream& file, const T* data, const size_t count)
+	{
+		file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * count));
+	}
+
+	template <typename T>
+	bool Read(std::ifstream& file, T* data, const size_t count)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(sizeof(T) * count)));
+	}
+}
+
+int PotentiallyVisibleSet::CellAt(const XMFLOAT3& point) const
+{
+	if (Empty())
+		return -1;
+
+	const float p[3] = { point.x, point.y, point.z };
+	int cell[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float t = std::floor((p[axis] - _min[axis]) / _cellSize);
+		if (t < 0.0f || t >= static_cast<float>(_res[axis]))
+			return -1;
+		cell[axis] = static_cast<int>(t);
+	}
+
+	const int index = (cell[2] * _res[1] + cell[1]) * _res[0] + cell[0];
+	return _offsets[index] == SolidCell ? -1 : index;
+}
+
+void PotentiallyVisibleSet::Decode(const int cell, VisibilityMask& mask) const
+{
+	mask.Reset(_objectCount);
+	PvsBaker::Decode(_sets.data() + _offsets[cell], _sets.size() - _offsets[cell], mask);
+}
+
+bool PotentiallyVisibleSet::Matches(const std::vector<BoundingBox>& bounds) const
+{
+	return !Empty() && bounds.size() == _objectCount && HashBounds(bounds) == _sceneHash;
+}
+
+uint64_t PotentiallyVisibleSet::HashBounds(const std::vector<BoundingBox>& bounds)
+{
+	//fnv-1a over the raw floats, any edit to the scene changes it
+	uint64_t hash = 14695981039346656037ull;
+	const auto bytes = reinterpret_cast<const uint8_t*>(bounds.data());
+	for (size_t i = 0; i < bounds.size() * sizeof(BoundingBox); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool PotentiallyVisibleSet::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	const uint32_t offsetCount = static_cast<uint32_t>(_offsets.size());
+	const uint32_t setBytes = static_cast<uint32_t>(_sets.size());
+	Write(file, &gPvsMagic, 1);
+	Write(file, _min, 3);
+	Write(file, &_cellSize, 1);
+	Write(file, _res, 3);
+	Write(file, &_objectCount, 1);
+	Write(file, &_sceneHash, 1);
+	Write(file, &offsetCount, 1);
+	Write(file, _offsets.data(), _offsets.size());
+	Write(file, &setBytes, 1);
+	Write(file, _sets.data(), _sets.size());
+	return static_cast<bool>(file);
+}
+
+bool PotentiallyVisibleSet::Load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	PotentiallyVisibleSet loaded;
+	uint32_t magic = 0;
+	uint32_t offsetCount = 0;
+	uint32_t setBytes = 0;
+	if (!Read(file, &magic, 1) || magic != gPvsMagic)
+		return false;
+	if (!Read(file, loaded._min, 3) || !Read(file, &loaded._cellSize, 1) || !Read(file, loaded._res, 3) ||
+		!Read(file, &loaded._objectCount, 1) || !Read(file, &loaded._sceneHash, 1) || !Read(file, &offsetCount, 1))
+		return false;
+
+	for (const int res : loaded._res)
+	{
+		if (res < 1 || res > PvsBaker::MaxCellsPerAxis)
+			return false;
+	}
+	if (offsetCount != static_cast<uint32_t>(loaded.CellCount()))
+		return false;
+
+	loaded._offsets.resize(offsetCount);
+	if (!Read(file, loaded._offsets.data(), offsetCount) || !Read(file, &setBytes, 1))
+		return false;
+	loaded._sets.resize(setBytes);
+	if (!Read(file, loaded._sets.data(), setBytes))
+		return false;
+	for (const uint32_t offset : loaded._offsets)
+	{
+		if (offset != SolidCell && offset >= setBytes)
+			return false;
+	}
+
+	*this = std::move(loaded);
+	return true;
+}
+
+void PvsBaker::AddBlockers(const OccluderMesh& occluder, const FXMMATRIX world, const int object, std::vector<PvsBlocker>& blockers)
+{
+	XMFLOAT4X4 worldToLocal;
+	XMStoreFloat4x4(&worldToLocal, XMMatrixInverse(nullptr, world));
+
+	//eight vertices per box, the first is its min corner and the last its max
+	for (size_t i = 0; i + 8 <= occluder.Vertices.size(); i += 8)
+	{
+		PvsBlocker blocker;
+		blocker.WorldToLocal = worldToLocal;
+		BoundingBox::CreateFromPoints(blocker.LocalBox, XMLoadFloat3(&occluder.Vertices[i]), XMLoadFloat3(&occluder.Vertices[i + 7]));
+		blocker.LocalBox.Transform(blocker.WorldBounds, world);
+		blocker.Object = object;
+		blockers.push_back(blocker);
+	}
+}
+
+PotentiallyVisibleSet PvsBaker::Bake(const std::vector<BoundingBox>& objectBounds, const std::vector<PvsBlocker>& blockers,
+                                     const PvsBakeSettings& settings, WorkerPool& pool)
+{
+	PotentiallyVisibleSet pvs;
+	if (objectBounds.empty())
+		return pvs;
+
+	//the grid covers every object, cells grow when it would get too fine
+	const int objectCount = static_cast<int>(objectBounds.size());
+	std::vector<float> objectMin(objectBounds.size() * 3);
+	std::vector<float> objectMax(objectBounds.size() * 3);
+	float sceneMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float sceneMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < objectCount; i++)
+	{
+		Corners(objectBounds[i], &objectMin[i * 3], &objectMax[i * 3]);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			sceneMin[axis] = (std::min)(sceneMin[axis], objectMin[i * 3 + axis]);
+			sceneMax[axis] = (std::max)(sceneMax[axis], objectMax[i * 3 + axis]);
+		}
+	}
+
+	const float longest = (std::max)((std::max)(sceneMax[0] - sceneMin[0], sceneMax[1] - sceneMin[1]), sceneMax[2] - sceneMin[2]);
+	pvs._cellSize = (std::max)((std::max)(settings.CellSize, longest / MaxCellsPerAxis), 1e-3f);
+	do
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			pvs._min[axis] = sceneMin[axis];
+			pvs._res[axis] = (std::min)((std::max)(static_cast<int>(std::ceil((sceneMax[axis] - sceneMin[axis]) / pvs._cellSize)), 1), MaxCellsPerAxis);
+		}
+		if (pvs.CellCount() > MaxCells)
+			pvs._cellSize *= 1.25f;
+	} while (pvs.CellCount() > MaxCells);
+	pvs._objectCount = static_cast<uint32_t>(objectCount);
+	pvs._sceneHash = PotentiallyVisibleSet::HashBounds(objectBounds);
+
+	BlockerScene scene{ blockers, {} };
+	std::vector<BoundingBox> blockerBounds;
+	blockerBounds.reserve(blockers.size());
+	for (const auto& blocker : blockers)
+		blockerBounds.push_back(blocker.WorldBounds);
+	scene.Bvh.Build(blockerBounds);
+
+	const int cellSamples = (std::max)(settings.CellSamples, 1);
+	const int targetSamples = (std::max)(settings.TargetSamples, 1);
+	const size_t cellCount = static_cast<size_t>(pvs.CellCount());
+	std::vector<VisibilityMask> cellSets(cellCount);
+	std::vector<bool> solid(cellCount, false);
+
+	//a row of cells per job, every job owns its scratch
+	for (int z = 0; z < pvs._res[2]; z++)
+	{
+		for (int y = 0; y < pvs._res[1]; y++)
+		{
+			pool.Submit([&, y, z]()
+			{
+				std::vector<XMFLOAT3> origins;
+				std::vector<XMFLOAT3> targets;
+				std::vector<int> candidates;
+
+				for (int x = 0; x < pvs._res[0]; x++)
+				{
+					const int cell = (z * pvs._res[1] + y) * pvs._res[0] + x;
+					const int coords[3] = { x, y, z };
+					float cellMin[3];
+					float cellMax[3];
+					for (int axis = 0; axis < 3; axis++)
+					{
+						cellMin[axis] = pvs._min[axis] + coords[axis] * pvs._cellSize;
+						cellMax[axis] = cellMin[axis] + pvs._cellSize;
+					}
+
+					//the same seed for the same cell keeps bakes reproducible
+					std::mt19937 rng(static_cast<uint32_t>(cell) * 2654435761u);
+					CellSamples(cellMin, cellMax, cellSamples, rng, origins);
+					origins.erase(std::remove_if(origins.begin(), origins.end(),
+						[&](const XMFLOAT3& p) { return scene.InsideAny(&p.x); }), origins.end());
+					//nobody stands inside a wall
+					if (origins.empty())
+					{
+						solid[cell] = true;
+						continue;
+					}
+
+					VisibilityMask& visible = cellSets[cell];
+					visible.Reset(objectBounds.size());
+					for (int object = 0; object < objectCount; object++)
+					{
+						const float* min = &objectMin[object * 3];
+						const float* max = &objectMax[object * 3];
+						if (BoxGap(cellMin, cellMax, min, max) <= settings.NearDistance)
+						{
+							visible.Set(object);
+							continue;
+						}
+
+						SurfaceSamples(min, max, targetSamples, rng, targets);
+						bool seen = false;
+						for (size_t t = 0; t < targets.size() && !seen; t++)
+						{
+							for (size_t o = 0; o < origins.size() && !seen; o++)
+								seen = !scene.Blocked(&origins[o].x, &targets[t].x, object, candidates);
+						}
+						if (seen)
+							visible.Set(object);
+					}
+				}
+			});
+		}
+	}
+	pool.WaitIdle();
+
+	//neighbours' sets are merged in, solid cells have none to give
+	const int ring = (std::max)(settings.Dilation, 0);
+	std::vector<VisibilityMask> dilated(cellCount);
+	for (int z = 0; z < pvs._res[2]; z++)
+	{
+		pool.Submit([&, z]()
+		{
+			for (int y = 0; y < pvs._res[1]; y++)
+			{
+				for (int x = 0; x < pvs._res[0]; x++)
+				{
+					const int cell = (z * pvs._res[1] + y) * pvs._res[0] + x;
+					if (solid[cell])
+						continue;
+					dilated[cell] = cellSets[cell];
+					auto& words = dilated[cell].Words();
+					for (int nz = (std::max)(z - ring, 0); nz <= (std::min)(z + ring, pvs._res[2] - 1); nz++)
+						for (int ny = (std::max)(y - ring, 0); ny <= (std::min)(y + ring, pvs._res[1] - 1); ny++)
+							for (int nx = (std::max)(x - ring, 0); nx <= (std::min)(x + ring, pvs._res[0] - 1); nx++)
+							{
+								const int neighbour = (nz * pvs._res[1] + ny) * pvs._res[0] + nx;
+								if (solid[neighbour])
+									continue;
+								const auto& other = cellSets[neighbour].Words();
+								for (size_t w = 0; w < words.size(); w++)
+									words[w] |= other[w];
+							}
+				}
+			}
+		});
+	}
+	pool.WaitIdle();
+
+	//neighbouring cells often see the same objects, identical sets are stored once
+	std::unordered_map<std::string, uint32_t> shared;
+	std::vector<uint8_t> set;
+	pvs._offsets.resize(cellCount);
+	for (size_t cell = 0; cell < cellCount; cell++)
+	{
+		if (solid[cell])
+		{
+			pvs._offsets[cell] = PotentiallyVisibleSet::SolidCell;
+			continue;
+		}
+
+		Encode(dilated[cell], set);
+		const auto inserted = shared.emplace(std::string(set.begin(), set.end()), static_cast<uint32_t>(pvs._sets.size()));
+		if (inserted.second)
+			pvs._sets.insert(pvs._sets.end(), set.begin(), set.end());
+		pvs._offsets[cell] = inserted.first->second;
+	}
+	return pvs;
+}
+
+void PvsBaker::Encode(const VisibilityMask& mask, std::vector<uint8_t>& set)
+{
+	set.clear();
+	set.push_back(Runs);
+	bool value = false;
+	size_t i = 0;
+	while (i < mask.Size())
+	{
+		const size_t start = i;
+		while (i < mask.Size() && mask.Test(i) == value)
+			i++;
+		WriteVarint(i - start, set);
+		value = !value;
+	}
+
+	//scattered objects make short runs, then the bits themselves are smaller
+	const size_t rawBytes = (mask.Size() + 7) / 8;
+	if (set.size() > rawBytes + 1)
+	{
+		set.assign(1, RawBits);
+		for (size_t byte = 0; byte < rawBytes; byte++)
+			set.push_back(static_cast<uint8_t>(mask.Words()[byte / 4] >> (byte % 4 * 8)));
+	}
+}
+
+void PvsBaker::Decode(const uint8_t* set, const size_t size, VisibilityMask& mask)
+{
+	if (size == 0)
+		return;
+
+	const uint8_t* end = set + size;
+	if (*set++ == RawBits)
+	{
+		const size_t rawBytes = (std::min)((mask.Size() + 7) / 8, static_cast<size_t>(end - set));
+		auto& words = mask.Words();
+		for (size_t byte = 0; byte < rawBytes; byte++)
+			words[byte / 4] |= static_cast<uint32_t>(set[byte]) << (byte % 4 * 8);
+		return;
+	}
+
+	bool value = false;
+	size_t i = 0;
+	while (set < end && i < mask.Size())
+	{
+		const size_t length = (std::min)(ReadVarint(set, end), mask.Size() - i);
+		if (value)
+		{
+			for (size_t j = i; j < i + length; j++)
+				mask.Set(j);
+		}
+		i += length;
+		value = !value;
+	}
+}
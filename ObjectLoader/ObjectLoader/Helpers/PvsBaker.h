@@ -0,0 +1,91 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CullingKernel.h"
+#include "OcclusionCuller.h"
+#include "WorkerPool.h"
+
+//solid box that blocks sight, kept in the local space of its object so rotated objects stay tight
+struct PvsBlocker
+{
+	//row vectors, like the rest of DirectXMath
+	DirectX::XMFLOAT4X4 WorldToLocal;
+	DirectX::BoundingBox LocalBox;
+	DirectX::BoundingBox WorldBounds;
+	//an object never hides itself
+	int Object = -1;
+};
+
+struct PvsBakeSettings
+{
+	//edge of a cubic cell in world units
+	float CellSize = 4.0f;
+	//points spread over each cell and over each object box, every pair of them is one ray
+	int CellSamples = 16;
+	int TargetSamples = 16;
+	//objects this close to a cell are always in its set, rays miss the most up close
+	float NearDistance = 2.0f;
+	//rings of neighbouring cells merged into each set, covers views the samples fell just short of
+	int Dilation = 1;
+};
+
+//uniform grid over the scene with a compressed set of visible objects per cell
+class PotentiallyVisibleSet
+{
+public:
+	bool Empty() const { return _offsets.empty(); }
+	//cell holding the point, -1 outside the grid and inside walls
+	int CellAt(const DirectX::XMFLOAT3& point) const;
+	//fills mask with the objects visible from the cell
+	void Decode(int cell, VisibilityMask& mask) const;
+	//true while the boxes are the ones the set was baked for
+	bool Matches(const std::vector<DirectX::BoundingBox>& bounds) const;
+	static uint64_t HashBounds(const std::vector<DirectX::BoundingBox>& bounds);
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	int CellCount() const { return _res[0] * _res[1] * _res[2]; }
+	size_t CompressedBytes() const { return _sets.size(); }
+
+	//offset of cells nothing can stand in
+	static constexpr uint32_t SolidCell = 0xffffffffu;
+
+private:
+	friend class PvsBaker;
+
+	float _min[3] = {};
+	float _cellSize = 1.0f;
+	int _res[3] = {};
+	uint32_t _objectCount = 0;
+	uint64_t _sceneHash = 0;
+	//start of every cell's set in _sets, cells with the same set share it
+	std::vector<uint32_t> _offsets;
+	//encoded sets, see PvsBaker::Encode
+	std::vector<uint8_t> _sets;
+};
+
+//bakes a PotentiallyVisibleSet on the cpu by casting rays between cells and object boxes,
+//has no device dependency so it runs the same in tools as in the editor
+class PvsBaker
+{
+public:
+	//one blocker per box of an occluder built by OcclusionCuller::BuildOccluder
+	static void AddBlockers(const OccluderMesh& occluder, DirectX::FXMMATRIX world, int object, std::vector<PvsBlocker>& blockers);
+
+	//an object is in a cell's set when some ray from the cell reaches its box past every blocker.
+	//blockers lie inside the real geometry, so a miss only comes from the sampling
+	static PotentiallyVisibleSet Bake(const std::vector<DirectX::BoundingBox>& objectBounds, const std::vector<PvsBlocker>& blockers,
+	                                  const PvsBakeSettings& settings, WorkerPool& pool);
+
+	//a mode byte, then either the raw bits or varint lengths of alternating hidden and visible runs,
+	//whichever is shorter. the set size is not stored, mask has to be Reset to it before decoding
+	static void Encode(const VisibilityMask& mask, std::vector<uint8_t>& set);
+	static void Decode(const uint8_t* set, size_t size, VisibilityMask& mask);
+
+	//cells grow until the grid fits, every cell keeps a full mask during the bake
+	static constexpr int MaxCellsPerAxis = 256;
+	static constexpr int MaxCells = 1 << 16;
+};
@@ -1,7 +1,11 @@
 #pragma once
 #include <string>
 #include "BasicUtil.h"
+#include "DisplacementBounds.h"
 #include "Material.h"
+#include "NameTable.h"
+#include "OcclusionCuller.h"
+#include "SubmeshBounds.h"
 #include "VertexData.h"
 
 using namespace DirectX;
@@ -17,7 +21,8 @@ struct RenderItem
 
 	int NumFramesDirty = gNumFrameResources;
 
-	std::vector<std::shared_ptr<MeshGeometry>>* Geo{ nullptr };
+	//index into GeometryManager::Geometries()
+	NameId GeoId = gInvalidNameId;
 
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -32,8 +37,18 @@ struct Mesh
 	size_t MaterialIndex;
 	int CbOffset;
 	int MatOffset;
+	//uv units per object space unit, drives texture mip streaming
+	float UvDensity = 1.0f;
+	//bounds of this submesh's own vertices, before DefaultWorld
+	BoundingBox Aabb;
 };
 
+//world space box of one submesh, for culling it apart from the rest of the object
+inline BoundingBox MeshWorldBounds(const Mesh& mesh, FXMMATRIX world)
+{
+	return SubmeshWorldBounds(mesh.Aabb, mesh.DefaultWorld, world);
+}
+
 struct Lod
 {
 	std::vector<Vertex> Vertices{};
@@ -48,6 +63,8 @@ struct LodData
 {
 	int TriangleCount = 0;
 	std::vector<Mesh> Meshes{};
+	//farthest the lod strays from lod 0, in object space units
+	float Error = 0.0f;
 };
 
 struct EditableRenderItem : public RenderItem
@@ -60,12 +77,36 @@ struct EditableRenderItem : public RenderItem
 	std::vector<LodData> LodsData;
 	int CurrentLodIdx = 0;
 	bool IsTesselated = false;
+	//world units displacement can move the surface, one per material, empty while nothing is displaced
+	std::vector<float> MaterialReach;
 	DirectX::XMMATRIX World = DirectX::XMMatrixIdentity();
 	DirectX::XMMATRIX PrevWorld = DirectX::XMMatrixIdentity();
 
 	bool RayTracingDirty = true;
+
+	//shared with every item of the same geometry, null when nothing is enclosed
+	std::shared_ptr<const OccluderMesh> Occluder;
+	//marked in the editor, occludes regardless of its size on screen
+	bool IsOccluder = false;
 };
 
+//world space box of the whole object, grown by the largest displacement of its materials
+inline BoundingBox ObjectWorldBounds(const EditableRenderItem& ri)
+{
+	BoundingBox bounds;
+	ri.Bounds.Transform(bounds, ri.World);
+	if (ri.MaterialReach.empty())
+		return bounds;
+	return InflateBounds(bounds, *std::max_element(ri.MaterialReach.begin(), ri.MaterialReach.end()));
+}
+
+//world space box of one submesh of the item, grown by the displacement of its own material
+inline BoundingBox MeshWorldBounds(const Mesh& mesh, const EditableRenderItem& ri)
+{
+	return SubmeshWorldBounds(mesh.Aabb, mesh.DefaultWorld, ri.World,
+		mesh.MaterialIndex < ri.MaterialReach.size() ? ri.MaterialReach[mesh.MaterialIndex] : 0.0f);
+}
+
 struct UnlitRenderItem : public RenderItem
 {
 	XMFLOAT4 Color = {.0f, .0f, .0f, 1.f};
@@ -0,0 +1,288 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr int gBinCount = 12;
+
+	float HalfArea(const BoundingBox& box)
+	{
+		const XMFLOAT3& e = box.Extents;
+		return 4.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	//levels of median splits until count items fit in leaves
+	int MedianDepth(int count)
+	{
+		int depth = 0;
+		for (; count > SceneBvh::MaxLeafSize; count = (count + 1) / 2)
+			depth++;
+		return depth;
+	}
+}
+
+SceneBvh::Bounds SceneBvh::Bounds::Empty()
+{
+	return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+SceneBvh::Bounds SceneBvh::Bounds::From(const BoundingBox& box)
+{
+	const XMFLOAT3& c = box.Center;
+	const XMFLOAT3& e = box.Extents;
+	return { { c.x - e.x, c.y - e.y, c.z - e.z }, { c.x + e.x, c.y + e.y, c.z + e.z } };
+}
+
+void SceneBvh::Bounds::Grow(const Bounds& other)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		Min[axis] = (std::min)(Min[axis], other.Min[axis]);
+		Max[axis] = (std::max)(Max[axis], other.Max[axis]);
+	}
+}
+
+float SceneBvh::Bounds::HalfArea() const
+{
+	const float x = Max[0] - Min[0];
+	const float y = Max[1] - Min[1];
+	const float z = Max[2] - Min[2];
+	return x * y + y * z + z * x;
+}
+
+BoundingBox SceneBvh::Bounds::Box() const
+{
+	float center[3];
+	float extents[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] = (Min[axis] + Max[axis]) * 0.5f;
+		//center plus extents can round below max, pad so children never poke out
+		extents[axis] = (Max[axis] - Min[axis]) * 0.5f;
+		extents[axis] += 1e-6f * (std::abs(center[axis]) + extents[axis]);
+	}
+	return BoundingBox(XMFLOAT3(center[0], center[1], center[2]), XMFLOAT3(extents[0], extents[1], extents[2]));
+}
+
+void SceneBvh::Update(const std::vector<BoundingBox>& bounds)
+{
+	if (bounds.size() != _indices.size() || _nodes.empty())
+	{
+		Build(bounds);
+		return;
+	}
+
+	Refit(bounds);
+	if (Degradation() > RebuildThreshold)
+		Build(bounds);
+}
+
+void SceneBvh::Build(const std::vector<BoundingBox>& bounds)
+{
+	const int count = static_cast<int>(bounds.size());
+	_nodes.clear();
+	_indices.resize(count);
+	std::iota(_indices.begin(), _indices.end(), 0);
+	_items.resize(count);
+	_buildCount++;
+	_version++;
+	_depth = 0;
+
+	if (count == 0)
+	{
+		_itemsSoa.Resize(0);
+		_cost = _buildCost = 0.0f;
+		return;
+	}
+
+	std::vector<Bounds> boxes(count);
+	std::vector<XMFLOAT3> centroids(count);
+	for (int i = 0; i < count; i++)
+	{
+		boxes[i] = Bounds::From(bounds[i]);
+		centroids[i] = bounds[i].Center;
+	}
+
+	//a binary tree with single item leaves at most
+	_nodes.reserve(static_cast<size_t>(2) * count);
+	BuildNode(0, count, 0, boxes, centroids);
+
+	_itemsSoa.Resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		_items[i] = bounds[_indices[i]];
+		_itemsSoa.Set(i, _items[i]);
+	}
+
+	_cost = _buildCost = ComputeCost();
+}
+
+int SceneBvh::BuildNode(const int start, const int count, const int depth, const std::vector<Bounds>& boxes, const std::vector<XMFLOAT3>& centroids)
+{
+	assert(depth <= MaxDepth);
+	_depth = (std::max)(_depth, depth);
+	const int nodeIndex = static_cast<int>(_nodes.size());
+	_nodes.emplace_back();
+
+	Bounds nodeBounds = Bounds::Empty();
+	Bounds centroidBounds = Bounds::Empty();
+	for (int i = start; i < start + count; i++)
+	{
+		const int index = _indices[i];
+		nodeBounds.Grow(boxes[index]);
+		const XMFLOAT3& c = centroids[index];
+		centroidBounds.Grow({ { c.x, c.y, c.z }, { c.x, c.y, c.z } });
+	}
+
+	_nodes[nodeIndex].Box = nodeBounds.Box();
+	_nodes[nodeIndex].Start = start;
+	_nodes[nodeIndex].Count = count;
+
+	if (count <= MaxLeafSize)
+		return nodeIndex;
+
+	//split along the axis the centroids spread the most
+	int axis = 0;
+	for (int i = 1; i < 3; i++)
+	{
+		if (centroidBounds.Max[i] - centroidBounds.Min[i] > centroidBounds.Max[axis] - centroidBounds.Min[axis])
+			axis = i;
+	}
+	const float low = centroidBounds.Min[axis];
+	const float extent = centroidBounds.Max[axis] - low;
+	const auto centroidOf = [&](const int index) { return (&centroids[index].x)[axis]; };
+
+	//a sah split may leave all but one item on a side, which must still fit under MaxDepth by median splits
+	int mid = start;
+	if (extent > 0.0f && depth + 1 + MedianDepth(count) <= MaxDepth)
+	{
+		const float scale = gBinCount / extent;
+		const auto binOf = [&](const int index)
+		{
+			return (std::min)(static_cast<int>((centroidOf(index) - low) * scale), gBinCount - 1);
+		};
+
+		Bounds binBounds[gBinCount];
+		int binCounts[gBinCount] = {};
+		for (auto& bin : binBounds)
+			bin = Bounds::Empty();
+		for (int i = start; i < start + count; i++)
+		{
+			const int bin = binOf(_indices[i]);
+			binCounts[bin]++;
+			binBounds[bin].Grow(boxes[_indices[i]]);
+		}
+
+		//sweep from the left, then from the right picking the cheapest plane
+		float leftCosts[gBinCount - 1];
+		Bounds accumulated = Bounds::Empty();
+		int accumulatedCount = 0;
+		for (int i = 0; i < gBinCount - 1; i++)
+		{
+			accumulated.Grow(binBounds[i]);
+			accumulatedCount += binCounts[i];
+			leftCosts[i] = accumulatedCount > 0 ? accumulated.HalfArea() * accumulatedCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int bestSplit = 1;
+		accumulated = Bounds::Empty();
+		accumulatedCount = 0;
+		for (int i = gBinCount - 1; i > 0; i--)
+		{
+			accumulated.Grow(binBounds[i]);
+			accumulatedCount += binCounts[i];
+			const float cost = leftCosts[i - 1] + (accumulatedCount > 0 ? accumulated.HalfArea() * accumulatedCount : 0.0f);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		mid = static_cast<int>(std::partition(_indices.begin() + start, _indices.begin() + start + count,
+			[&](const int index) { return binOf(index) < bestSplit; }) - _indices.begin());
+	}
+
+	//all centroids in one spot, out of depth for sah, or a split that left a side empty
+	if (mid == start || mid == start + count)
+	{
+		mid = start + count / 2;
+		std::nth_element(_indices.begin() + start, _indices.begin() + mid, _indices.begin() + start + count,
+			[&](const int a, const int b) { return centroidOf(a) < centroidOf(b); });
+	}
+
+	BuildNode(start, mid - start, depth + 1, boxes, centroids);
+	const int right = BuildNode(mid, start + count - mid, depth + 1, boxes, centroids);
+	_nodes[nodeIndex].Right = right;
+	return nodeIndex;
+}
+
+void SceneBvh::TestLeaf(const CullingPlanes& planes, const Node& node, std::vector<int>& result) const
+{
+	//leaves hold at most one kernel group
+	static_assert(MaxLeafSize <= CullingKernel::GroupSize, "leaf does not fit one culling group");
+	const uint32_t visible = CullingKernel::TestGroup(planes, _itemsSoa, node.Start);
+	for (int i = 0; i < node.Count; i++)
+	{
+		if (visible >> i & 1u)
+			result.push_back(_indices[node.Start + i]);
+	}
+}
+
+void SceneBvh::Refit(const std::vector<BoundingBox>& bounds)
+{
+	if (bounds.size() != _indices.size())
+	{
+		Build(bounds);
+		return;
+	}
+
+	for (size_t i = 0; i < _indices.size(); i++)
+	{
+		_items[i] = bounds[_indices[i]];
+		_itemsSoa.Set(i, _items[i]);
+	}
+	_version++;
+
+	//children always come after their parent, so walking backwards is bottom up
+	for (int n = static_cast<int>(_nodes.size()) - 1; n >= 0; n--)
+	{
+		Node& node = _nodes[n];
+		Bounds nodeBounds = Bounds::Empty();
+		if (node.Right < 0)
+		{
+			for (int i = node.Start; i < node.Start + node.Count; i++)
+				nodeBounds.Grow(Bounds::From(_items[i]));
+		}
+		else
+		{
+			nodeBounds = Bounds::From(_nodes[n + 1].Box);
+			nodeBounds.Grow(Bounds::From(_nodes[node.Right].Box));
+		}
+		node.Box = nodeBounds.Box();
+	}
+
+	_cost = ComputeCost();
+}
+
+float SceneBvh::ComputeCost() const
+{
+	if (_nodes.empty())
+		return 0.0f;
+
+	//one unit per traversal step and per leaf item, weighted by the chance of hitting the node
+	float cost = 0.0f;
+	for (const auto& node : _nodes)
+		cost += HalfArea(node.Box) * (node.Right < 0 ? static_cast<float>(node.Count) : 1.0f);
+
+	const float rootArea = HalfArea(_nodes[0].Box);
+	return rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cassert>
+#include <vector>
+#include "CullingKernel.h"
+
+//bounding volume hierarchy over world space boxes, built with binned sah
+//and refit in place while the boxes move
+class SceneBvh
+{
+public:
+	//refits, or rebuilds when the box count changed or the refit tree got too loose
+	void Update(const std::vector<DirectX::BoundingBox>& bounds);
+	void Build(const std::vector<DirectX::BoundingBox>& bounds);
+	//keeps the topology and recomputes node boxes bottom up
+	void Refit(const std::vector<DirectX::BoundingBox>& bounds);
+
+	//appends indices of the boxes the volume does not reject, any DirectX bounding type works
+	template<typename Volume>
+	void Query(const Volume& volume, std::vector<int>& result) const;
+
+	size_t Size() const { return _indices.size(); }
+	//sah cost of the current tree relative to the one it had right after the last build
+	float Degradation() const { return _buildCost > 0.0f ? _cost / _buildCost : 1.0f; }
+	int BuildCount() const { return _buildCount; }
+	//changes on every build and refit, results cached against an older value are stale
+	uint32_t Version() const { return _version; }
+	//deepest node of the last build, the root is 0
+	int Depth() const { return _depth; }
+	//box around every item, empty before the first build
+	DirectX::BoundingBox RootBox() const { return _nodes.empty() ? DirectX::BoundingBox(DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f)) : _nodes[0].Box; }
+
+	//refit trees this much worse than a fresh build get rebuilt
+	static constexpr float RebuildThreshold = 1.5f;
+	static constexpr int MaxLeafSize = 4;
+	//no node goes deeper, sah splits give way to median ones while the items left can still reach
+	//single leaves within it. bounds the query stack
+	static constexpr int MaxDepth = 48;
+
+private:
+	struct Node
+	{
+		DirectX::BoundingBox Box;
+		//range of _indices under this node, subtrees are contiguous
+		int Start = 0;
+		int Count = 0;
+		//left child is the next node, -1 for leaves
+		int Right = -1;
+	};
+
+	struct Bounds
+	{
+		float Min[3];
+		float Max[3];
+
+		static Bounds Empty();
+		static Bounds From(const DirectX::BoundingBox& box);
+		void Grow(const Bounds& other);
+		float HalfArea() const;
+		DirectX::BoundingBox Box() const;
+	};
+
+	//tests the boxes of a leaf one by one, plane sets go through the simd kernel instead
+	template<typename Volume>
+	void TestLeaf(const Volume& volume, const Node& node, std::vector<int>& result) const;
+	void TestLeaf(const CullingPlanes& planes, const Node& node, std::vector<int>& result) const;
+
+	int BuildNode(int start, int count, int depth, const std::vector<Bounds>& boxes, const std::vector<DirectX::XMFLOAT3>& centroids);
+	float ComputeCost() const;
+
+	std::vector<Node> _nodes;
+	std::vector<int> _indices;
+	//boxes in _indices order so leaves test them without indirection
+	std::vector<DirectX::BoundingBox> _items;
+	AabbSoa _itemsSoa;
+	float _cost = 0.0f;
+	float _buildCost = 0.0f;
+	int _buildCount = 0;
+	uint32_t _version = 0;
+	int _depth = 0;
+};
+
+template<typename Volume>
+void SceneBvh::Query(const Volume& volume, std::vector<int>& result) const
+{
+	if (_nodes.empty())
+		return;
+
+	//a node at depth k leaves at most k right siblings waiting when it pushes its two children
+	int stack[MaxDepth + 1];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = _nodes[stack[--top]];
+		const DirectX::ContainmentType containment = volume.Contains(node.Box);
+		if (containment == DirectX::DISJOINT)
+			continue;
+
+		//whole subtree is inside, no need to test the children
+		if (containment == DirectX::CONTAINS)
+		{
+			result.insert(result.end(), _indices.begin() + node.Start, _indices.begin() + node.Start + node.Count);
+			continue;
+		}
+
+		if (node.Right < 0)
+		{
+			TestLeaf(volume, node, result);
+			continue;
+		}
+
+		const int left = static_cast<int>(&node - _nodes.data()) + 1;
+		assert(top + 2 <= MaxDepth + 1);
+		stack[top++] = node.Right;
+		stack[top++] = left;
+	}
+}
+
+template<typename Volume>
+void SceneBvh::TestLeaf(const Volume& volume, const Node& node, std::vector<int>& result) const
+{
+	for (int i = node.Start; i < node.Start + node.Count; i++)
+	{
+		if (volume.Contains(_items[i]) != DirectX::DISJOINT)
+			result.push_back(_indices[i]);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cmath>
+
+//projected size of world space boxes, shared by lod picking, texture streaming and contribution culling
+
+//pixels one world unit covers at distance one through a perspective projection
+inline float PixelsAtUnitDistance(const float fovY, const float pixelsHigh)
+{
+	return pixelsHigh / (2.0f * tanf(fovY * 0.5f));
+}
+
+//distance from eye to the nearest point of the box's bounding sphere, never closer than nearZ
+inline float NearestDistance(const DirectX::BoundingBox& bounds, DirectX::FXMVECTOR eye, const float nearZ)
+{
+	using namespace DirectX;
+	const float distanceToCenter = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - eye));
+	const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+	return (std::max)(distanceToCenter - radius, nearZ);
+}
+
+//pixels the bounding sphere of the box covers across, perspective projection
+inline float ProjectedSize(const DirectX::BoundingBox& bounds, DirectX::FXMVECTOR eye, const float pixelsAtOne, const float nearZ)
+{
+	using namespace DirectX;
+	const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+	return 2.0f * radius * pixelsAtOne / NearestDistance(bounds, eye, nearZ);
+}
+
+//pixels the bounding sphere of the box covers across, orthographic projection
+inline float ProjectedSize(const DirectX::BoundingBox& bounds, const float pixelsPerUnit)
+{
+	using namespace DirectX;
+	return 2.0f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents))) * pixelsPerUnit;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <DirectXCollision.h>
+#include "DisplacementBounds.h"
+
+//culling the submeshes of an object that already passed as a whole. each submesh keeps a box
+//around its own vertices, before the transform that places it inside the object. has no device dependency
+
+//world space box of a submesh, grown by the displacement reach of its material
+inline DirectX::BoundingBox SubmeshWorldBounds(const DirectX::BoundingBox& local, DirectX::FXMMATRIX meshWorld, DirectX::CXMMATRIX objectWorld,
+	const float reach = 0.0f)
+{
+	DirectX::BoundingBox bounds;
+	local.Transform(bounds, meshWorld * objectWorld);
+	return reach > 0.0f ? InflateBounds(bounds, reach) : bounds;
+}
+
+//a single submesh already passed with its object
+inline bool CullsSubmeshes(const size_t submeshCount)
+{
+	return submeshCount > 1;
+}
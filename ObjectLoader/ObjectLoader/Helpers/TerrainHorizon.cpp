@@ -0,0 +1,243 @@
+#include "TerrainHorizon.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	struct ScreenPoint
+	{
+		float X;
+		float Y;
+	};
+
+	float Turn(const ScreenPoint& o, const ScreenPoint& a, const ScreenPoint& b)
+	{
+		return (a.X - o.X) * (b.Y - o.Y) - (a.Y - o.Y) * (b.X - o.X);
+	}
+
+	//height of a hull chain running left to right at x inside its span
+	float ChainAt(const ScreenPoint* chain, const int count, const float x)
+	{
+		for (int i = 1; i < count; i++)
+		{
+			if (x > chain[i].X && i < count - 1)
+				continue;
+			const ScreenPoint& a = chain[i - 1];
+			const ScreenPoint& b = chain[i];
+			const float span = b.X - a.X;
+			const float t = span > 0.0f ? (std::min)((std::max)((x - a.X) / span, 0.0f), 1.0f) : 1.0f;
+			return a.Y + (b.Y - a.Y) * t;
+		}
+		return chain[0].Y;
+	}
+}
+
+void TerrainHorizon::Begin(FXMMATRIX view, CXMMATRIX proj, const float nearZ, const int columns)
+{
+	XMStoreFloat4x4(&_view, view);
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, proj);
+	_xScale = projection._11;
+	_yScale = projection._22;
+	_xOffset = projection._31;
+	_yOffset = projection._32;
+	_nearZ = nearZ;
+	_columns.assign(static_cast<size_t>((std::max)(columns, 1)), HorizonColumn());
+}
+
+void TerrainHorizon::AddOccluder(const BoundingBox& box)
+{
+	XMFLOAT3 points[MaxPoints];
+	bool clipped = false;
+	const int count = ViewPoints(box, points, clipped);
+	if (count < 3)
+		return;
+
+	//everything the box covers lies no farther than its farthest point
+	ScreenPoint projected[MaxPoints];
+	float depth = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		projected[i] = { points[i].x * _xScale / points[i].z + _xOffset, points[i].y * _yScale / points[i].z + _yOffset };
+		depth = (std::max)(depth, points[i].z);
+	}
+
+	//convex hull as a lower and an upper chain, both left to right
+	std::sort(projected, projected + count, [](const ScreenPoint& a, const ScreenPoint& b)
+	{
+		return a.X < b.X || (a.X == b.X && a.Y < b.Y);
+	});
+	ScreenPoint lower[MaxPoints];
+	ScreenPoint upper[MaxPoints];
+	int lowerCount = 0;
+	int upperCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		while (lowerCount >= 2 && Turn(lower[lowerCount - 2], lower[lowerCount - 1], projected[i]) <= 0.0f)
+			lowerCount--;
+		lower[lowerCount++] = projected[i];
+	}
+	for (int i = count - 1; i >= 0; i--)
+	{
+		while (upperCount >= 2 && Turn(upper[upperCount - 2], upper[upperCount - 1], projected[i]) <= 0.0f)
+			upperCount--;
+		upper[upperCount++] = projected[i];
+	}
+	std::reverse(upper, upper + upperCount);
+
+	const float minX = lower[0].X;
+	const float maxX = lower[lowerCount - 1].X;
+	const int columns = Columns();
+	const int first = (std::max)(static_cast<int>((minX + 1.0f) * 0.5f * static_cast<float>(columns)), 0);
+	const int last = (std::min)(static_cast<int>((maxX + 1.0f) * 0.5f * static_cast<float>(columns)), columns - 1);
+	for (int c = first; c <= last; c++)
+	{
+		//only columns the hull spans from edge to edge count
+		const float left = ColumnEdge(c);
+		const float right = ColumnEdge(c + 1);
+		if (left <= minX || right >= maxX)
+			continue;
+
+		//the upper chain is concave and the lower convex, so the band shared by the whole column is set at its edges
+		const float low = (std::max)(ChainAt(lower, lowerCount, left), ChainAt(lower, lowerCount, right));
+		const float high = (std::min)(ChainAt(upper, upperCount, left), ChainAt(upper, upperCount, right));
+		if (low >= high)
+			continue;
+
+		HorizonColumn& column = _columns[c];
+		if (column.Low > column.High)
+		{
+			column = { low, high, depth };
+		}
+		else if (low >= column.Low && high <= column.High)
+		{
+			//nothing new is covered, taking its depth would only weaken the band
+			continue;
+		}
+		else if (low <= column.High && high >= column.Low)
+		{
+			column.Low = (std::min)(column.Low, low);
+			column.High = (std::max)(column.High, high);
+			column.Depth = (std::max)(column.Depth, depth);
+		}
+		else if (high - low > column.High - column.Low)
+		{
+			//one band per column, the taller one hides more
+			column = { low, high, depth };
+		}
+	}
+}
+
+bool TerrainHorizon::IsOccluded(const BoundingBox& box) const
+{
+	XMFLOAT3 points[MaxPoints];
+	bool clipped = false;
+	ViewPoints(box, points, clipped);
+	if (clipped || _columns.empty())
+		return false;
+
+	//the eight corners come first and bound the projection
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		const float x = points[i].x * _xScale / points[i].z + _xOffset;
+		const float y = points[i].y * _yScale / points[i].z + _yOffset;
+		minX = (std::min)(minX, x);
+		maxX = (std::max)(maxX, x);
+		minY = (std::min)(minY, y);
+		maxY = (std::max)(maxY, y);
+		minZ = (std::min)(minZ, points[i].z);
+	}
+	//whether it is on screen at all is the frustum's call
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+		return false;
+	minY = (std::max)(minY, -1.0f);
+	maxY = (std::min)(maxY, 1.0f);
+
+	const int columns = Columns();
+	const int first = (std::max)(static_cast<int>((minX + 1.0f) * 0.5f * static_cast<float>(columns)), 0);
+	const int last = (std::min)(static_cast<int>((maxX + 1.0f) * 0.5f * static_cast<float>(columns)), columns - 1);
+	for (int c = first; c <= last; c++)
+	{
+		const HorizonColumn& column = _columns[c];
+		if (column.Low > minY || column.High < maxY || column.Depth > minZ)
+			return false;
+	}
+	return true;
+}
+
+uint64_t TerrainHorizon::Signature() const
+{
+	uint64_t signature = _columns.size();
+	for (const HorizonColumn& column : _columns)
+	{
+		for (const float value : { column.Low, column.High, column.Depth })
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			signature = signature * 31 + bits;
+		}
+	}
+	return signature;
+}
+
+int TerrainHorizon::ViewPoints(const BoundingBox& box, XMFLOAT3 (&points)[MaxPoints], bool& clipped) const
+{
+	//corner i takes the max side on axis k when bit k is set
+	XMFLOAT3 corners[8];
+	bool inFront[8];
+	for (int i = 0; i < 8; i++)
+	{
+		const float x = box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x);
+		const float y = box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y);
+		const float z = box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z);
+		corners[i] =
+		{
+			x * _view._11 + y * _view._21 + z * _view._31 + _view._41,
+			x * _view._12 + y * _view._22 + z * _view._32 + _view._42,
+			x * _view._13 + y * _view._23 + z * _view._33 + _view._43
+		};
+		inFront[i] = corners[i].z >= _nearZ;
+	}
+
+	int count = 0;
+	clipped = false;
+	for (int i = 0; i < 8; i++)
+	{
+		if (inFront[i])
+			points[count++] = corners[i];
+		else
+			clipped = true;
+	}
+	if (!clipped)
+		return count;
+
+	//edges join corners one bit apart, those crossing the near plane add where they cross it
+	for (int i = 0; i < 8; i++)
+	{
+		for (int bit = 1; bit < 8; bit <<= 1)
+		{
+			const int j = i ^ bit;
+			if (j < i || inFront[i] == inFront[j])
+				continue;
+			const XMFLOAT3& a = corners[i];
+			const XMFLOAT3& b = corners[j];
+			const float t = (_nearZ - a.z) / (b.z - a.z);
+			points[count++] = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, _nearZ };
+		}
+	}
+	return count;
+}
+
+float TerrainHorizon::ColumnEdge(const int i) const
+{
+	return -1.0f + 2.0f * static_cast<float>(i) / static_cast<float>(Columns());
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+//one screen column of the horizon: every pixel of it between Low and High (ndc y) is known to be covered
+//by something no farther than Depth (view z). empty while Low > High
+struct HorizonColumn
+{
+	float Low = 1.0f;
+	float High = -1.0f;
+	float Depth = 0.0f;
+};
+
+//1d occlusion buffer over screen columns for heightfield terrain. tiles are swept front to back,
+//the solid part under each drawn tile widens the covered band of the columns it spans,
+//later tiles and objects are hidden when they fall inside the band and behind it in all their columns.
+//has no device dependency
+class TerrainHorizon
+{
+public:
+	//starts an empty buffer, proj is a left handed perspective projection with w equal to view z
+	void Begin(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, float nearZ, int columns = DefaultColumns);
+	//world space box every camera ray reaching its inside has to pass something drawn for.
+	//only the part in front of the near plane is used
+	void AddOccluder(const DirectX::BoundingBox& box);
+	//true when the box is in front of the camera and covered in every column it spans
+	bool IsOccluded(const DirectX::BoundingBox& box) const;
+
+	int Columns() const { return static_cast<int>(_columns.size()); }
+	const HorizonColumn& Column(const int i) const { return _columns[i]; }
+	//changes with the contents, for caches keyed on what the buffer hides
+	uint64_t Signature() const;
+
+	static constexpr int DefaultColumns = 256;
+
+private:
+	//box corners plus the points its edges cross the near plane at, view space
+	static constexpr int MaxPoints = 20;
+	int ViewPoints(const DirectX::BoundingBox& box, DirectX::XMFLOAT3 (&points)[MaxPoints], bool& clipped) const;
+	//ndc column edge of column i, i == Columns() is the right edge of the screen
+	float ColumnEdge(int i) const;
+
+	DirectX::XMFLOAT4X4 _view = {};
+	//the only projection terms a perspective lens uses, x = (x * _xScale + z * _xOffset) / z
+	float _xScale = 1.0f;
+	float _yScale = 1.0f;
+	float _xOffset = 0.0f;
+	float _yOffset = 0.0f;
+	float _nearZ = 0.0f;
+	std::vector<HorizonColumn> _columns;
+};
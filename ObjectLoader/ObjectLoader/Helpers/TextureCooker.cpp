@@ -0,0 +1,275 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	const wchar_t* gCacheFolder = L".texcache";
+	//fnv-1a, good enough to tell edited sources apart
+	const std::uint64_t gHashSeed = 14695981039346656037ull;
+
+	bool IsBc7(const DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_BC7_UNORM || format == DXGI_FORMAT_BC7_UNORM_SRGB;
+	}
+}
+
+std::wstring TextureCooker::CachePath(const std::wstring& sourceFile, const TextureRole role)
+{
+	std::uint64_t hash = 0;
+	if (!ContentHash(sourceFile, hash))
+	{
+		return L"";
+	}
+
+	const std::filesystem::path source(sourceFile);
+	return CacheFile(source.parent_path().wstring(), source.stem().wstring(), hash, role);
+}
+
+std::wstring TextureCooker::EmbeddedCachePath(const std::wstring& modelFolder, const std::wstring& textureName,
+	const void* data, const size_t size, const TextureRole role)
+{
+	if (data == nullptr || size == 0)
+	{
+		return L"";
+	}
+	return CacheFile(modelFolder, textureName, HashBytes(data, size, gHashSeed), role);
+}
+
+std::wstring TextureCooker::FastCachePath(const std::wstring& cachePath)
+{
+	if (cachePath.empty())
+	{
+		return L"";
+	}
+	return cachePath.substr(0, cachePath.size() - 4) + L"_fast.dds";
+}
+
+bool TextureCooker::IsCached(const std::wstring& cachePath)
+{
+	std::error_code error;
+	return !cachePath.empty() && std::filesystem::is_regular_file(cachePath, error);
+}
+
+void TextureCooker::Remove(const std::wstring& cachePath)
+{
+	std::error_code error;
+	if (!cachePath.empty())
+	{
+		std::filesystem::remove(cachePath, error);
+	}
+}
+
+DXGI_FORMAT TextureCooker::CookedFormat(const DirectX::TexMetadata& metadata, const TextureRole role)
+{
+	if (DirectX::FormatDataType(metadata.format) == DirectX::FORMAT_TYPE_FLOAT)
+	{
+		return DXGI_FORMAT_BC6H_UF16;
+	}
+
+	switch (role)
+	{
+	case TextureRole::Normal:
+		//z is reconstructed in the shader
+		return DXGI_FORMAT_BC5_UNORM;
+	case TextureRole::Mask:
+		return DXGI_FORMAT_BC4_UNORM;
+	case TextureRole::Color:
+		//the sampler decodes to linear, like the uncompressed upload of the same texture
+		return DXGI_FORMAT_BC7_UNORM_SRGB;
+	case TextureRole::Data:
+	default:
+		return DXGI_FORMAT_BC7_UNORM;
+	}
+}
+
+bool TextureCooker::HasRefinement(const DirectX::TexMetadata& metadata, const TextureRole role)
+{
+	return IsBc7(CookedFormat(metadata, role));
+}
+
+HRESULT TextureCooker::Cook(const DirectX::ScratchImage& scratch, const TextureRole role, const CookQuality quality, DirectX::ScratchImage& cooked,
+	const std::atomic<bool>* cancel)
+{
+	const DirectX::TexMetadata& metadata = scratch.GetMetadata();
+	if (DirectX::IsCompressed(metadata.format))
+	{
+		return S_FALSE;
+	}
+
+	//block compressed textures need the top level to be made of whole blocks
+	if (metadata.width % 4 != 0 || metadata.height % 4 != 0)
+	{
+		return E_INVALIDARG;
+	}
+
+	//fast sticks to bc7 mode 6 and uses every core since the user waits for it.
+	//high also searches the 3-subset modes but stays on its own thread to keep the editor responsive
+	DirectX::TEX_COMPRESS_FLAGS flags = quality == CookQuality::Fast
+		? DirectX::TEX_COMPRESS_BC7_QUICK
+		: DirectX::TEX_COMPRESS_BC7_USE_3SUBSETS;
+#ifdef _OPENMP
+	if (quality == CookQuality::Fast)
+	{
+		flags |= DirectX::TEX_COMPRESS_PARALLEL;
+	}
+#endif
+
+	//color texels are gamma-encoded even when the source format does not say so, they must not be encoded twice
+	const DXGI_FORMAT format = CookedFormat(metadata, role);
+	if (DirectX::IsSRGB(format) && !DirectX::IsSRGB(metadata.format))
+	{
+		flags |= DirectX::TEX_COMPRESS_SRGB_IN;
+	}
+
+	if (cancel == nullptr)
+	{
+		return DirectX::Compress(scratch.GetImages(), scratch.GetImageCount(), metadata,
+			format, flags, DirectX::TEX_THRESHOLD_DEFAULT, cooked);
+	}
+
+	//only the single image overload reports progress per row of blocks, so every subresource is compressed on its own
+	DirectX::TexMetadata cookedMetadata = metadata;
+	cookedMetadata.format = format;
+	HRESULT hr = cooked.Initialize(cookedMetadata);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	const DirectX::CompressOptions options = { flags, DirectX::TEX_THRESHOLD_DEFAULT, DirectX::TEX_ALPHA_WEIGHT_DEFAULT };
+	const auto keepGoing = [cancel](size_t, size_t) { return !cancel->load(std::memory_order_relaxed); };
+	const DirectX::Image* sources = scratch.GetImages();
+	const DirectX::Image* targets = cooked.GetImages();
+	for (size_t i = 0; i < scratch.GetImageCount(); i++)
+	{
+		DirectX::ScratchImage single;
+		hr = DirectX::CompressEx(sources[i], format, options, single, keepGoing);
+		if (FAILED(hr))
+		{
+			cooked.Release();
+			return hr;
+		}
+		const DirectX::Image* compressed = single.GetImage(0, 0, 0);
+		memcpy(targets[i].pixels, compressed->pixels, (std::min)(targets[i].slicePitch, compressed->slicePitch));
+	}
+	return S_OK;
+}
+
+HRESULT TextureCooker::Store(const DirectX::ScratchImage& scratch, const std::wstring& cachePath)
+{
+	if (cachePath.empty())
+	{
+		return E_INVALIDARG;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+	if (error)
+	{
+		return E_FAIL;
+	}
+
+	return DirectX::SaveToDDSFile(scratch.GetImages(), scratch.GetImageCount(), scratch.GetMetadata(),
+		DirectX::DDS_FLAGS_NONE, cachePath.c_str());
+}
+
+std::uint64_t TextureCooker::HashBytes(const void* data, const size_t size, std::uint64_t hash)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool TextureCooker::HashFile(const std::wstring& filename, std::uint64_t& hash)
+{
+	std::ifstream file(std::filesystem::path(filename), std::ios::binary);
+	if (!file.good())
+	{
+		return false;
+	}
+
+	hash = gHashSeed;
+	std::vector<char> buffer(1 << 16);
+	while (file)
+	{
+		file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		hash = HashBytes(buffer.data(), static_cast<size_t>(file.gcount()), hash);
+	}
+	return true;
+}
+
+bool TextureCooker::ContentHash(const std::wstring& sourceFile, std::uint64_t& hash)
+{
+	const std::filesystem::path source(sourceFile);
+	std::error_code error;
+	const std::uintmax_t size = std::filesystem::file_size(source, error);
+	if (error)
+	{
+		return false;
+	}
+	const auto writeTime = static_cast<long long>(std::filesystem::last_write_time(source, error).time_since_epoch().count());
+	if (error)
+	{
+		return false;
+	}
+
+	//one stamp per source file, the extension is kept so tree.png and tree.jpg do not share one
+	const std::filesystem::path stampPath = source.parent_path() / gCacheFolder / (source.filename().wstring() + L".stamp");
+	{
+		std::ifstream stamp(stampPath);
+		std::uintmax_t stampSize = 0;
+		long long stampTime = 0;
+		std::uint64_t stampHash = 0;
+		if (stamp >> stampSize >> stampTime >> std::hex >> stampHash && stampSize == size && stampTime == writeTime)
+		{
+			hash = stampHash;
+			return true;
+		}
+	}
+
+	if (!HashFile(sourceFile, hash))
+	{
+		return false;
+	}
+
+	//a missing stamp only costs the next load another hash
+	std::filesystem::create_directories(stampPath.parent_path(), error);
+	std::ofstream stamp(stampPath, std::ios::trunc);
+	stamp << size << ' ' << writeTime << ' ' << std::hex << hash << '\n';
+	return true;
+}
+
+std::wstring TextureCooker::CacheFile(const std::wstring& folder, const std::wstring& name, const std::uint64_t hash, const TextureRole role)
+{
+	std::wstringstream file;
+	file << name << L'_' << std::hex << std::setw(16) << std::setfill(L'0') << hash << RoleSuffix(role) << L".dds";
+	return (std::filesystem::path(folder) / gCacheFolder / file.str()).wstring();
+}
+
+const wchar_t* TextureCooker::RoleSuffix(const TextureRole role)
+{
+	switch (role)
+	{
+	case TextureRole::Color:
+		//_c held linear bc7 before color was cooked to srgb
+		return L"_cs";
+	case TextureRole::Normal:
+		return L"_n";
+	case TextureRole::Mask:
+		return L"_m";
+	case TextureRole::Data:
+	default:
+		return L"_d";
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <DirectXTex.h>
+#include "TextureRole.h"
+
+//how much time the bc7 encoder may spend. fast is used while importing, high replaces it in the background
+enum class CookQuality : int8_t
+{
+	Fast = 0,
+	High
+};
+
+//converts decoded images into block-compressed dds files that live next to the source assets,
+//so the next load of the same content goes straight through the dds path.
+//has no device dependency, decoding the source image is up to the caller
+class TextureCooker
+{
+public:
+	//returns the cache file for the given source, keyed by the hash of its content.
+	//the hash is remembered next to the cache with the size and write time of the source,
+	//so the file is only read again once one of them changed. empty if the source can not be read
+	static std::wstring CachePath(const std::wstring& sourceFile, TextureRole role);
+	//cache file for a texture embedded in a model, keyed by the hash of its encoded bytes
+	static std::wstring EmbeddedCachePath(const std::wstring& modelFolder, const std::wstring& textureName,
+		const void* data, size_t size, TextureRole role);
+	//where the fast encode waits until the high quality one replaces it
+	static std::wstring FastCachePath(const std::wstring& cachePath);
+	static bool IsCached(const std::wstring& cachePath);
+	static void Remove(const std::wstring& cachePath);
+
+	static DXGI_FORMAT CookedFormat(const DirectX::TexMetadata& metadata, TextureRole role);
+	//only bc7 has a quality gap worth a second pass
+	static bool HasRefinement(const DirectX::TexMetadata& metadata, TextureRole role);
+	//compresses every subresource, image must already contain its mip chain.
+	//S_FALSE if it is compressed already. with a cancel flag the encoder checks it between rows of blocks
+	//and gives up with E_ABORT once it is set
+	static HRESULT Cook(const DirectX::ScratchImage& scratch, TextureRole role, CookQuality quality, DirectX::ScratchImage& cooked,
+		const std::atomic<bool>* cancel = nullptr);
+	static HRESULT Store(const DirectX::ScratchImage& scratch, const std::wstring& cachePath);
+
+private:
+	static std::uint64_t HashBytes(const void* data, size_t size, std::uint64_t hash);
+	static bool HashFile(const std::wstring& filename, std::uint64_t& hash);
+	//content hash of the source, read from its stamp while size and write time still match
+	static bool ContentHash(const std::wstring& sourceFile, std::uint64_t& hash);
+	static std::wstring CacheFile(const std::wstring& folder, const std::wstring& name, std::uint64_t hash, TextureRole role);
+	static const wchar_t* RoleSuffix(TextureRole role);
+};
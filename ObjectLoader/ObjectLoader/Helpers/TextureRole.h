@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+
+//how texel data is interpreted when mips are built
+enum class TextureRole : std::int8_t
+{
+	Color = 0,	//gamma-encoded albedo/emissive
+	Data,		//linear multi-channel data, roughness/metallic/arm
+	Mask,		//single channel read from .r, e.g. height
+	Normal
+};
@@ -0,0 +1,143 @@
+#include "TextureSlots.h"
+
+#include <stdexcept>
+
+TextureSlots::TextureSlots()
+{
+	for (auto& chunk : _chunks)
+	{
+		chunk.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+TextureSlots::~TextureSlots()
+{
+	for (auto& chunk : _chunks)
+	{
+		delete[] chunk.load(std::memory_order_relaxed);
+	}
+}
+
+bool TextureSlots::TryAcquire(const NameId id, const int count)
+{
+	Slot* found = Find(id);
+	if (found == nullptr || found->State.load(std::memory_order_acquire) == TextureState::Empty)
+	{
+		return false;
+	}
+
+	//a count that already reached zero belongs to a texture on its way out, it is never revived
+	auto& used = found->Used;
+	int current = used.load(std::memory_order_relaxed);
+	while (current > 0)
+	{
+		if (used.compare_exchange_weak(current, current + count, std::memory_order_acq_rel))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TextureSlots::Release(const NameId id, const int count)
+{
+	Slot* found = Find(id);
+	if (found == nullptr)
+	{
+		return false;
+	}
+	const int previous = found->Used.fetch_sub(count, std::memory_order_acq_rel);
+	return previous > 0 && previous - count <= 0;
+}
+
+void TextureSlots::Publish(const NameId id, const TextureState state, const int count, const std::uint32_t srvIndex, const NameId label)
+{
+	Slot& slot = Get(id);
+	slot.SrvIndex.store(srvIndex, std::memory_order_relaxed);
+	slot.Label.store(label, std::memory_order_relaxed);
+	slot.Used.store(count, std::memory_order_relaxed);
+	//released last, whoever sees the state also sees the rest
+	slot.State.store(state, std::memory_order_release);
+}
+
+void TextureSlots::SetState(const NameId id, const TextureState state)
+{
+	Get(id).State.store(state, std::memory_order_release);
+}
+
+void TextureSlots::SetSrvIndex(const NameId id, const std::uint32_t srvIndex)
+{
+	Get(id).SrvIndex.store(srvIndex, std::memory_order_release);
+}
+
+void TextureSlots::Clear(const NameId id)
+{
+	if (Slot* found = Find(id))
+	{
+		Slot& slot = *found;
+		slot.State.store(TextureState::Empty, std::memory_order_release);
+		slot.Used.store(0, std::memory_order_relaxed);
+		slot.SrvIndex.store(0, std::memory_order_relaxed);
+		slot.Label.store(gInvalidNameId, std::memory_order_relaxed);
+	}
+}
+
+TextureState TextureSlots::State(const NameId id) const
+{
+	Slot* found = Find(id);
+	return found ? found->State.load(std::memory_order_acquire) : TextureState::Empty;
+}
+
+int TextureSlots::Used(const NameId id) const
+{
+	Slot* found = Find(id);
+	return found ? found->Used.load(std::memory_order_acquire) : 0;
+}
+
+std::uint32_t TextureSlots::SrvIndex(const NameId id) const
+{
+	Slot* found = Find(id);
+	return found ? found->SrvIndex.load(std::memory_order_acquire) : 0;
+}
+
+NameId TextureSlots::Label(const NameId id) const
+{
+	Slot* found = Find(id);
+	return found ? found->Label.load(std::memory_order_acquire) : gInvalidNameId;
+}
+
+TextureSlots::Slot* TextureSlots::Find(const NameId id) const
+{
+	const size_t chunk = static_cast<size_t>(id) / gChunkSize;
+	if (chunk >= gMaxChunks)
+	{
+		return nullptr;
+	}
+	Slot* slots = _chunks[chunk].load(std::memory_order_acquire);
+	return slots ? &slots[id % gChunkSize] : nullptr;
+}
+
+TextureSlots::Slot& TextureSlots::Get(const NameId id)
+{
+	const size_t chunk = static_cast<size_t>(id) / gChunkSize;
+	if (chunk >= gMaxChunks)
+	{
+		throw std::out_of_range("texture id past the slot capacity");
+	}
+
+	Slot* slots = _chunks[chunk].load(std::memory_order_acquire);
+	if (slots == nullptr)
+	{
+		//two threads may race for a fresh chunk, the loser frees its copy
+		Slot* fresh = new Slot[gChunkSize];
+		if (_chunks[chunk].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+		{
+			slots = fresh;
+		}
+		else
+		{
+			delete[] fresh;
+		}
+	}
+	return slots[id % gChunkSize];
+}
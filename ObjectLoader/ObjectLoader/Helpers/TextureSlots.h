@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "NameTable.h"
+
+enum class TextureState : std::uint8_t
+{
+	Empty = 0,
+	//srv shows a placeholder until the worker decode is uploaded
+	Pending,
+	Loaded
+};
+
+//reference count, load state and view of every texture, addressed by its NameId.
+//slots live in chunks that never move, so a texture that is already loaded can be acquired
+//from any thread without the registry lock. publishing and clearing slots is left to the
+//owner of that lock. has no device dependency
+class TextureSlots
+{
+public:
+	TextureSlots();
+	~TextureSlots();
+
+	TextureSlots(const TextureSlots&) = delete;
+	TextureSlots& operator=(const TextureSlots&) = delete;
+
+	//adds count references to a pending or loaded texture. false if its slot is empty or its
+	//last reference is being released, the caller has to take the lock and load it then
+	bool TryAcquire(NameId id, int count = 1);
+	//true when this dropped the last reference and the texture has to be retired
+	bool Release(NameId id, int count = 1);
+	//makes the slot acquirable with count references
+	void Publish(NameId id, TextureState state, int count, std::uint32_t srvIndex, NameId label);
+	void SetState(NameId id, TextureState state);
+	void SetSrvIndex(NameId id, std::uint32_t srvIndex);
+	void Clear(NameId id);
+
+	TextureState State(NameId id) const;
+	bool IsLoaded(NameId id) const { return State(id) != TextureState::Empty; }
+	int Used(NameId id) const;
+	std::uint32_t SrvIndex(NameId id) const;
+	NameId Label(NameId id) const;
+
+private:
+	struct Slot
+	{
+		std::atomic<int> Used{ 0 };
+		std::atomic<TextureState> State{ TextureState::Empty };
+		std::atomic<std::uint32_t> SrvIndex{ 0 };
+		std::atomic<NameId> Label{ gInvalidNameId };
+	};
+
+	static constexpr size_t gChunkSize = 1024;
+	static constexpr size_t gMaxChunks = 1024;
+
+	//null if the chunk of the id was never touched
+	Slot* Find(NameId id) const;
+	//allocates the chunk of the id on first use
+	Slot& Get(NameId id);
+
+	std::array<std::atomic<Slot*>, gMaxChunks> _chunks;
+};
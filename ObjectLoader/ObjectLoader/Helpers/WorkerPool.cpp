@@ -0,0 +1,106 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned threadCount)
+{
+	if (threadCount == 0)
+	{
+		const unsigned hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	_threads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		_threads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	Shutdown();
+}
+
+void WorkerPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_stopping)
+		{
+			return;
+		}
+		_jobs.push_back(std::move(job));
+	}
+	_jobAvailable.notify_one();
+}
+
+void WorkerPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _jobs.empty() && _activeJobs == 0; });
+}
+
+size_t WorkerPool::PendingCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _jobs.size() + _activeJobs;
+}
+
+size_t WorkerPool::DropPending()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const size_t dropped = _jobs.size();
+	_jobs.clear();
+	if (_activeJobs == 0)
+	{
+		_idle.notify_all();
+	}
+	return dropped;
+}
+
+void WorkerPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_jobAvailable.notify_all();
+
+	for (auto& thread : _threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_jobAvailable.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+			//queued jobs are still finished when stopping
+			if (_jobs.empty())
+			{
+				return;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+			_activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_activeJobs--;
+			if (_jobs.empty() && _activeJobs == 0)
+			{
+				_idle.notify_all();
+			}
+		}
+	}
+}
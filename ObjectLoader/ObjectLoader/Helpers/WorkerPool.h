@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//fixed set of threads running submitted jobs in fifo order
+class WorkerPool
+{
+public:
+	//0 means one thread less than the hardware has, but at least one
+	explicit WorkerPool(unsigned threadCount = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void Submit(std::function<void()> job);
+	//blocks until the queue is empty and no job is running
+	void WaitIdle();
+	size_t PendingCount() const;
+	//forgets queued jobs that have not started, returns how many were dropped
+	size_t DropPending();
+	//finishes what is queued and joins the threads, later submits are dropped.
+	//owners of function-static pools call it while everything their jobs touch is still alive
+	void Shutdown();
+	size_t ThreadCount() const { return _threads.size(); }
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> _threads;
+	std::deque<std::function<void()>> _jobs;
+	mutable std::mutex _mutex;
+	std::condition_variable _jobAvailable;
+	std::condition_variable _idle;
+	size_t _activeJobs = 0;
+	bool _stopping = false;
+};
@@ -1,6 +1,130 @@
 #include "CubeMapManager.h"
 
 #include "UploadManager.h"
+#include "../Helpers/IblBaker.h"
+#include "../Helpers/TextureCooker.h"
+
+#include <DirectXTex.h>
+
+namespace
+{
+	constexpr int gIrradianceSize = 32;
+	//sh projection does not need the full sky resolution
+	constexpr int gShProjectionSize = 64;
+	constexpr int gPrefilteredSize = 128;
+	//MAX_REFLECTION_LOD in Lighting.hlsl is the last of these mips
+	constexpr int gPrefilteredMips = 8;
+	constexpr int gPrefilterSamples = 256;
+	constexpr int gMaxSkySize = 1024;
+
+	bool LoadRadiance(const std::wstring& filename, DirectX::ScratchImage& image)
+	{
+		std::wstring ext = filename.substr(filename.find_last_of(L'.') + 1);
+		for (auto& c : ext) c = towlower(c);
+
+		DirectX::ScratchImage loaded;
+		HRESULT hr;
+		if (ext == L"hdr")
+		{
+			hr = DirectX::LoadFromHDRFile(filename.c_str(), nullptr, loaded);
+		}
+		else if (ext == L"dds")
+		{
+			hr = DirectX::LoadFromDDSFile(filename.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, loaded);
+		}
+		else
+		{
+			//srgb formats make the conversion below linearize ldr images
+			hr = DirectX::LoadFromWICFile(filename.c_str(), DirectX::WIC_FLAGS_DEFAULT_SRGB, nullptr, loaded);
+		}
+		if (FAILED(hr))
+		{
+			return false;
+		}
+
+		const DirectX::TexMetadata& metadata = loaded.GetMetadata();
+		if (DirectX::IsCompressed(metadata.format))
+		{
+			hr = DirectX::Decompress(loaded.GetImages(), loaded.GetImageCount(), metadata, DXGI_FORMAT_R32G32B32A32_FLOAT, image);
+		}
+		else if (metadata.format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+		{
+			hr = DirectX::Convert(loaded.GetImages(), loaded.GetImageCount(), metadata, DXGI_FORMAT_R32G32B32A32_FLOAT,
+				DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, image);
+		}
+		else
+		{
+			image = std::move(loaded);
+		}
+		return SUCCEEDED(hr);
+	}
+
+	IblCube RadianceCube(const DirectX::ScratchImage& image, WorkerPool& pool)
+	{
+		const DirectX::TexMetadata& metadata = image.GetMetadata();
+		if (!metadata.IsCubemap())
+		{
+			const DirectX::Image* equirect = image.GetImage(0, 0, 0);
+			const int faceSize = (std::min)(gMaxSkySize, static_cast<int>(equirect->width / 4));
+			return IblBaker::CubeFromEquirect(reinterpret_cast<const float*>(equirect->pixels),
+				static_cast<int>(equirect->width), static_cast<int>(equirect->height), faceSize, pool);
+		}
+
+		IblCube cube(static_cast<int>(metadata.width));
+		for (int face = 0; face < 6; face++)
+		{
+			const DirectX::Image* faceImage = image.GetImage(0, face, 0);
+			for (int y = 0; y < cube.Size; y++)
+			{
+				const float* row = reinterpret_cast<const float*>(faceImage->pixels + y * faceImage->rowPitch);
+				for (int x = 0; x < cube.Size; x++)
+				{
+					cube.At(face, x, y) = { row[x * 4], row[x * 4 + 1], row[x * 4 + 2] };
+				}
+			}
+		}
+		return cube;
+	}
+
+	HRESULT StoreCube(const std::vector<IblCube>& mips, const std::wstring& path)
+	{
+		DirectX::ScratchImage image;
+		HRESULT hr = image.InitializeCube(DXGI_FORMAT_R32G32B32A32_FLOAT, mips[0].Size, mips[0].Size, 1, mips.size());
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		for (size_t mip = 0; mip < mips.size(); mip++)
+		{
+			for (int face = 0; face < 6; face++)
+			{
+				const DirectX::Image* faceImage = image.GetImage(mip, face, 0);
+				for (int y = 0; y < mips[mip].Size; y++)
+				{
+					float* row = reinterpret_cast<float*>(faceImage->pixels + y * faceImage->rowPitch);
+					for (int x = 0; x < mips[mip].Size; x++)
+					{
+						const IblColor& color = mips[mip].At(face, x, y);
+						row[x * 4] = color.R;
+						row[x * 4 + 1] = color.G;
+						row[x * 4 + 2] = color.B;
+						row[x * 4 + 3] = 1.0f;
+					}
+				}
+			}
+		}
+
+		DirectX::ScratchImage halfImage;
+		hr = DirectX::Convert(image.GetImages(), image.GetImageCount(), image.GetMetadata(), DXGI_FORMAT_R16G16B16A16_FLOAT,
+			DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, halfImage);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+		return TextureCooker::Store(halfImage, path);
+	}
+}
 
 CubeMapManager::CubeMapManager(ID3D12Device* device)
 {
@@ -27,11 +151,12 @@ void CubeMapManager::Init()
 		TextureHandle texHandle;
 		if (i == static_cast<int>(CubeMap::Brdf))
 		{
-			texHandle = TextureManager::LoadTexture(filenames[i].c_str(), 0, 1);
+			texHandle = TextureManager::LoadTexture(filenames[i].c_str(), gInvalidNameId, 1);
 		}
-		else
+		else if (!TextureManager::LoadCubeTexture(filenames[i].c_str(), texHandle))
 		{
-			TextureManager::LoadCubeTexture(filenames[i].c_str(), texHandle);
+			//keeps the ibl table in one piece until an environment gets baked
+			TextureManager::ReserveCubeSlot(texHandle);
 		}
 		_maps.push_back(texHandle);
 	}
@@ -61,7 +186,7 @@ void CubeMapManager::Draw(ID3D12GraphicsCommandList4* cmdList, const FrameResour
 
 	const auto staticObjectCb = currFrameResource->StaticObjCb->Resource();
 
-	const auto geo = GeometryManager::Geometries()["shapeGeo"].begin()->get();
+	const auto geo = GeometryManager::ShapeGeo();
 
 	const auto vertexBuffer = geo->VertexBufferView();
 	const auto indexBuffer = geo->IndexBufferView();
@@ -74,11 +199,60 @@ void CubeMapManager::Draw(ID3D12GraphicsCommandList4* cmdList, const FrameResour
 
 	cmdList->SetGraphicsRootConstantBufferView(2, objCbAddress);
 
-	const SubmeshGeometry mesh = geo->DrawArgs["sphere"];
+	const SubmeshGeometry& mesh = GeometryManager::ShapeSubmesh(Shape::Sphere);
 
 	cmdList->DrawIndexedInstanced(mesh.IndexCount, 1, mesh.StartIndexLocation, mesh.BaseVertexLocation, 0);
 }
 
+bool CubeMapManager::BakeEnvironment(const std::wstring& sourceFile)
+{
+	const std::wstring cachePath = TextureCooker::CachePath(sourceFile, TextureRole::Data);
+	if (cachePath.empty())
+	{
+		return false;
+	}
+
+	const std::wstring cacheBase = cachePath.substr(0, cachePath.size() - 4);
+	const CubeMap bakedMaps[] = { CubeMap::Skybox, CubeMap::Irradiance, CubeMap::Prefiltered };
+	const std::wstring paths[] = { cacheBase + L"_sky.dds", cacheBase + L"_irradiance.dds", cacheBase + L"_prefiltered.dds" };
+
+	const bool cached = TextureCooker::IsCached(paths[0]) && TextureCooker::IsCached(paths[1]) && TextureCooker::IsCached(paths[2]);
+	if (!cached)
+	{
+		DirectX::ScratchImage radianceImage;
+		if (!LoadRadiance(sourceFile, radianceImage))
+		{
+			return false;
+		}
+
+		WorkerPool pool;
+		const IblCube sky = RadianceCube(radianceImage, pool);
+
+		IblCube shSource = sky;
+		while (shSource.Size > gShProjectionSize)
+		{
+			shSource = IblBaker::Downsample(shSource);
+		}
+		const IblSh sh = IblBaker::ProjectIrradiance(shSource);
+
+		if (FAILED(StoreCube({ sky }, paths[0])) ||
+			FAILED(StoreCube({ IblBaker::IrradianceCube(sh, gIrradianceSize) }, paths[1])) ||
+			FAILED(StoreCube(IblBaker::PrefilterGgx(sky, gPrefilteredSize, gPrefilteredMips, gPrefilterSamples, pool), paths[2])))
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (!TextureManager::ReplaceCubeTexture(paths[i].c_str(), _maps[static_cast<int>(bakedMaps[i])]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 void CubeMapManager::AddMap(CubeMap type, const TextureHandle& handle)
 {
 	_maps[static_cast<int>(type)] = handle;
@@ -181,6 +355,6 @@ void CubeMapManager::BuildRenderItem()
 	_skyRItem = std::make_unique<EditableRenderItem>();
 	_skyRItem->World = XMMatrixScaling(5000.0f, 5000.0f, 5000.0f);
 	_skyRItem->Uid = FrameResource::StaticObjectCount++;
-	_skyRItem->Geo = &GeometryManager::Geometries()["shapeGeo"];
+	_skyRItem->GeoId = GeometryManager::ShapeGeoId();
 	_skyRItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 }
@@ -32,10 +32,12 @@ public:
 
 	std::string EnvironmentName(CubeMap type) const
 	{
-		return _maps[static_cast<int>(type)].Name;
+		return _maps[static_cast<int>(type)].Name();
 	}
 
 	void AddMap(CubeMap type, const TextureHandle& handle);
+	//builds sky, irradiance and prefiltered maps from an equirect or cube map, cached by source hash
+	bool BakeEnvironment(const std::wstring& sourceFile);
 
 	D3D12_GPU_DESCRIPTOR_HANDLE GetCubeMapGpuHandle() const;
 	D3D12_GPU_DESCRIPTOR_HANDLE GetIblMapsGpuHandle() const;
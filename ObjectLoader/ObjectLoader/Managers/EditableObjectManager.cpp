@@ -4,18 +4,65 @@
 #include "UploadManager.h"
 #include "../../../Common/GBuffer.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	//textures of the first material, objects sharing them end up next to each other
+	uint64_t MaterialSortKey(const EditableRenderItem* ri)
+	{
+		if (ri->Materials.empty())
+			return 0;
+		const Material* material = ri->Materials[0].get();
+		const uint64_t baseColor = material->properties[BasicUtil::EnumIndex(MatProp::BaseColor)].texture.Index;
+		const uint64_t normal = material->textures[BasicUtil::EnumIndex(MatTex::Normal)].Index;
+		return baseColor << 32 | normal;
+	}
+
+	//how far each material's displacement map can push the surface, true when any of it moved
+	bool UpdateMaterialReach(EditableRenderItem& ri)
+	{
+		ri.MaterialReach.resize(ri.Materials.size(), 0.0f);
+		bool changed = false;
+		for (size_t j = 0; j < ri.Materials.size(); j++)
+		{
+			const Material* material = ri.Materials[j].get();
+			const TextureHandle& map = material->textures[BasicUtil::EnumIndex(MatTex::Displacement)];
+			const float reach = map.UseTexture
+				? DisplacementReach(TextureManager::Heights(map.Id), material->additionalInfo[BasicUtil::EnumIndex(MatAddInfo::Displacement)])
+				: 0.0f;
+			changed = changed || reach != ri.MaterialReach[j];
+			ri.MaterialReach[j] = reach;
+		}
+		return changed;
+	}
+}
+
 void EditableObjectManager::UpdateObjectCBs(FrameResource* currFrameResource)
 {
 	auto& currObjectsCb = currFrameResource->OpaqueObjCb;
 	auto& currMaterialCb = currFrameResource->MaterialCb;
 
-	//for frustum culling
-	_visibleTesselatedObjects.clear();
-	_visibleUntesselatedObjects.clear();
-
 	XMMATRIX view = _camera->GetView();
 	XMMATRIX invView = XMMatrixInverse(nullptr, view);
 
+	//boxes of objects that did not move stay valid until objects are added or removed
+	const bool boundsStale = _worldBounds.size() != _objects.size() || _bvh.Size() != _objects.size();
+	_worldBounds.resize(_objects.size());
+	bool boundsChanged = boundsStale;
+	uint64_t cullSignature = _occlusionCulling ? 1 : 0;
+	//the visible lists also depend on the contribution threshold and the screen it is measured on
+	for (const float value : { _minScreenSize, _screenHeight })
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		cullSignature = cullSignature * 31 + bits;
+	}
+	//the terrain in front moves with the camera and with its heightmap
+	cullSignature = cullSignature * 31 + (_terrainHorizon ? _terrainHorizon->Signature() : 0);
+
 	for (int i = 0; i < _objects.size(); i++)
 	{
 		auto& ri = _objects[i];
@@ -37,7 +84,54 @@ void EditableObjectManager::UpdateObjectCBs(FrameResource* currFrameResource)
 		{
 			ri->NumFramesDirty = gNumFrameResources;
 		}
-		
+
+		//heights land with late decodes and scales change in the ui, the box follows either
+		const bool reachChanged = ri->IsTesselated && UpdateMaterialReach(*ri);
+		if (boundsStale || reachChanged || std::memcmp(&worldF, &prevWorldF, sizeof(XMFLOAT4X4)) != 0)
+		{
+			_worldBounds[i] = ObjectWorldBounds(*ri);
+			boundsChanged = true;
+		}
+		cullSignature = cullSignature * 31 + (ri->IsOccluder ? 2 : 1);
+	}
+
+	//frustum culling against world space boxes, leaves are tested four at a time,
+	//a still scene keeps its tree and so the version the cull cache checks
+	if (boundsChanged)
+	{
+		_bvh.Update(_worldBounds);
+		_pvsStats.Matches = _pvs.Matches(_worldBounds);
+	}
+
+	//a new cell brings a new set, decoded once on entering it
+	const int pvsCell = _usePvs && _pvsStats.Matches ? _pvs.CellAt(_camera->GetPosition3F()) : -1;
+	if (pvsCell != _pvsStats.Cell)
+	{
+		_pvsStats.Cell = pvsCell;
+		if (pvsCell >= 0)
+			_pvs.Decode(pvsCell, _pvsMask);
+	}
+	cullSignature = cullSignature * 31 + static_cast<uint64_t>(pvsCell + 1);
+	if (cullSignature != _cullSignature)
+	{
+		_cullSignature = cullSignature;
+		_cullCache.Invalidate();
+	}
+
+	BoundingFrustum worldFrustum;
+	_camera->CameraFrustum().Transform(worldFrustum, invView);
+	_cameraPlanes = CullingPlanes::FromFrustum(worldFrustum);
+	//same camera over the same scene, last frame's lists are still right
+	if (_cullCache.Cull(_bvh, _worldBounds, _cameraPlanes, _bvh.Version(), _candidates) != CullCache::Reuse::Exact)
+		BuildVisibleLists();
+
+	//constants follow the lods picked above, a switch is drawn with its own meshes this frame
+	SelectLods();
+
+	for (const auto& ri : _objects)
+	{
+		const XMMATRIX& world = ri->World;
+
 		//updating object data
 		if (ri->NumFramesDirty > 0)
 		{
@@ -94,23 +188,312 @@ void EditableObjectManager::UpdateObjectCBs(FrameResource* currFrameResource)
 				materialConstants.UseRoughnessMap = material->properties[BasicUtil::EnumIndex(MatProp::Roughness)].texture.UseTexture;
 				materialConstants.UseArmMap = material->textures[BasicUtil::EnumIndex(MatTex::ARM)].UseTexture && material->useARMTexture;
 				materialConstants.ArmLayout = static_cast<int>(material->armLayout);
+				//by register, the same way DrawObjects binds the texture tables
+				constexpr size_t offset = BasicUtil::EnumIndex(MatProp::Count) - 1;
+				for (int index = 0; index < offset; index++)
+				{
+					if (index == BasicUtil::EnumIndex(MatProp::Opacity)) index++;
+					materialConstants.UvRects[index] = material->properties[index].texture.UvRect;
+				}
+				for (int i1 = 0; i1 < BasicUtil::EnumIndex(MatTex::Count); i1++)
+				{
+					materialConstants.UvRects[offset + i1] = material->textures[i1].UvRect;
+				}
 
 				currMaterialCb[ri->Uid].get()->CopyData(static_cast<int>(j), materialConstants);
 
 				material->numFramesDirty--;
 			}
 		}
+	}
+}
 
-		//frustum culling
-		XMMATRIX invWorld = XMMatrixInverse(nullptr, world);
+void EditableObjectManager::BuildVisibleLists()
+{
+	_visibleTesselatedObjects.clear();
+	_visibleUntesselatedObjects.clear();
 
-		XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+	_cameraVisibility.Reset(_objects.size());
+	for (const int i : _candidates)
+		_cameraVisibility.Set(i);
 
-		BoundingFrustum localSpaceFrustum;
-		_camera->CameraFrustum().Transform(localSpaceFrustum, viewToLocal);
-		if ((localSpaceFrustum.Contains(ri->Bounds) != DirectX::DISJOINT))
+	//whatever the camera's cell does not list is hidden from anywhere inside it
+	_pvsStats.Hidden = 0;
+	if (_pvsStats.Cell >= 0)
+	{
+		const size_t before = _cameraVisibility.Count();
+		auto& words = _cameraVisibility.Words();
+		const auto& pvsWords = _pvsMask.Words();
+		for (size_t w = 0; w < words.size(); w++)
+			words[w] &= pvsWords[w];
+		_pvsStats.Hidden = static_cast<int>(before - _cameraVisibility.Count());
+	}
+
+	CullSmallObjects();
+	CullBehindTerrain();
+	if (_occlusionCulling)
+		CullOccluded();
+	else
+		_occlusionStats = {};
+
+	_cameraVisibility.ForEach([this](const size_t i)
+	{
+		const auto& ri = _objects[i];
+		(ri->IsTesselated ? _visibleTesselatedObjects : _visibleUntesselatedObjects).push_back(ri.get());
+	});
+
+	//order by material so consecutive draws can keep their texture tables bound
+	for (auto objects : { &_visibleUntesselatedObjects, &_visibleTesselatedObjects })
+	{
+		std::stable_sort(objects->begin(), objects->end(), [](const EditableRenderItem* a, const EditableRenderItem* b)
+		{
+			return MaterialSortKey(a) < MaterialSortKey(b);
+		});
+	}
+}
+
+bool EditableObjectManager::BakePvs(const PvsBakeSettings& settings, const std::string& path)
+{
+	std::vector<BoundingBox> bounds(_objects.size());
+	std::vector<PvsBlocker> blockers;
+	for (size_t i = 0; i < _objects.size(); i++)
+	{
+		const auto& ri = _objects[i];
+		bounds[i] = ObjectWorldBounds(*ri);
+		if (ri->Occluder)
+			PvsBaker::AddBlockers(*ri->Occluder, ri->World, static_cast<int>(i), blockers);
+	}
+
+	WorkerPool pool;
+	_pvs = PvsBaker::Bake(bounds, blockers, settings, pool);
+	_pvsStats = {};
+	_pvsStats.Bytes = _pvs.CompressedBytes();
+	_pvsStats.Matches = _pvs.Matches(_worldBounds);
+	return _pvs.Save(path);
+}
+
+bool EditableObjectManager::LoadPvs(const std::string& path)
+{
+	if (!_pvs.Load(path))
+		return false;
+
+	_pvsStats = {};
+	_pvsStats.Bytes = _pvs.CompressedBytes();
+	_pvsStats.Matches = _pvs.Matches(_worldBounds);
+	return _pvsStats.Matches;
+}
+
+AtlasStats EditableObjectManager::PackMaterialTextures()
+{
+	std::vector<TextureHandle*> handles;
+	for (const auto& object : _objects)
+	{
+		for (const auto& material : object->Materials)
+		{
+			for (auto& property : material->properties)
+				handles.push_back(&property.texture);
+			for (auto& texture : material->textures)
+				handles.push_back(&texture);
+		}
+	}
+
+	const AtlasStats stats = TextureManager::PackAtlases(handles);
+	if (stats.Textures > 0)
+	{
+		for (const auto& object : _objects)
 		{
-			(_tesselatedObjects.find(ri->Uid) != _tesselatedObjects.end() ? _visibleTesselatedObjects : _visibleUntesselatedObjects).push_back(ri->Uid);
+			for (const auto& material : object->Materials)
+				material->numFramesDirty = gNumFrameResources;
+		}
+	}
+	return stats;
+}
+
+void EditableObjectManager::CullSmallObjects()
+{
+	_smallObjectsCulled = 0;
+	if (_minScreenSize <= 0.0f)
+		return;
+
+	//dropped before they cost an occlusion test, marked occluders are kept for the ones behind them
+	const XMVECTOR cameraPos = _camera->GetPosition();
+	const float pixelsAtOne = PixelsAtUnitDistance(_camera->GetFovY(), _screenHeight);
+	_cameraVisibility.ForEach([&](const size_t i)
+	{
+		if (_objects[i]->IsOccluder)
+			return;
+		if (ProjectedSize(_worldBounds[i], cameraPos, pixelsAtOne, _camera->GetNearZ()) < _minScreenSize)
+		{
+			_cameraVisibility.Clear(i);
+			_smallObjectsCulled++;
+		}
+	});
+}
+
+void EditableObjectManager::CullBehindTerrain()
+{
+	_terrainOccluded = 0;
+	if (_terrainHorizon == nullptr)
+		return;
+
+	//tiles were swept first, whatever their bands cover from behind is as hidden as a tile would be
+	_cameraVisibility.ForEach([&](const size_t i)
+	{
+		if (_terrainHorizon->IsOccluded(_worldBounds[i]))
+		{
+			_cameraVisibility.Clear(i);
+			_terrainOccluded++;
+		}
+	});
+}
+
+void EditableObjectManager::SelectLods()
+{
+	_lodStats = {};
+	_lodScales.clear();
+
+	const XMVECTOR cameraPos = _camera->GetPosition();
+	const float pixelsAtOne = PixelsAtUnitDistance(_camera->GetFovY(), _screenHeight);
+	for (const auto& objects : { &_visibleUntesselatedObjects, &_visibleTesselatedObjects })
+	{
+		for (const auto ri : *objects)
+		{
+			if (_lodSettings.Fixed || ri->LodsData.size() == 1)
+			{
+				_lodStats.Triangles += ri->LodsData[ri->CurrentLodIdx].TriangleCount;
+				continue;
+			}
+
+			const BoundingBox worldBounds = ObjectWorldBounds(*ri);
+			const float distance = NearestDistance(worldBounds, cameraPos, _camera->GetNearZ());
+
+			const XMFLOAT3& scale = ri->Transform[BasicUtil::EnumIndex(Transform::Scale)];
+			const float maxScale = std::max(std::max(std::abs(scale.x), std::abs(scale.y)), std::abs(scale.z));
+			_lodScales.emplace_back(ri, pixelsAtOne * maxScale / distance);
+		}
+	}
+
+	//too many triangles, grow the tolerance until they fit
+	const int fixedTriangles = _lodStats.Triangles;
+	const float tolerance = _lodScales.empty() ? _lodSettings.Tolerance : LodSelector::FitBudget(_lodSettings.Tolerance, _lodSettings.TriangleBudget,
+		[&](const float candidate)
+		{
+			int triangles = fixedTriangles;
+			for (const auto& object : _lodScales)
+			{
+				const auto ri = object.first;
+				triangles += ri->LodsData[LodSelector::Select(ri->LodsData, object.second, candidate, _lodSettings.Hysteresis, ri->CurrentLodIdx)].TriangleCount;
+			}
+			return triangles;
+		});
+
+	for (const auto& object : _lodScales)
+	{
+		const auto ri = object.first;
+		const int lod = LodSelector::Select(ri->LodsData, object.second, tolerance, _lodSettings.Hysteresis, ri->CurrentLodIdx);
+		if (lod != ri->CurrentLodIdx)
+		{
+			ri->CurrentLodIdx = lod;
+			//the blas and the per mesh constants follow the lod
+			ri->RayTracingDirty = true;
+			ri->NumFramesDirty = gNumFrameResources;
+			_lodStats.Switches++;
+		}
+		_lodStats.Triangles += ri->LodsData[lod].TriangleCount;
+	}
+	_lodStats.Tolerance = tolerance;
+}
+
+void EditableObjectManager::CullOccluded()
+{
+	const auto start = std::chrono::steady_clock::now();
+	_occlusionStats = {};
+
+	//the biggest objects on screen hide the most, marked ones always take part
+	const XMVECTOR cameraPos = _camera->GetPosition();
+	const float tanHalfFov = tanf(_camera->GetFovY() * 0.5f);
+	_occluders.clear();
+	_cameraVisibility.ForEach([&](const size_t i)
+	{
+		const auto& ri = _objects[i];
+		if (!ri->Occluder)
+			return;
+		const BoundingBox& bounds = _worldBounds[i];
+		const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+		const float distance = std::max(XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - cameraPos)), _camera->GetNearZ());
+		const float screenSize = radius / (distance * tanHalfFov);
+		if (ri->IsOccluder || screenSize >= OccluderScreenSize)
+			_occluders.emplace_back(ri->IsOccluder ? FLT_MAX : screenSize, static_cast<int>(i));
+	});
+
+	if (!_occluders.empty())
+	{
+		std::sort(_occluders.begin(), _occluders.end(), std::greater<std::pair<float, int>>());
+		if (_occluders.size() > MaxOccluders)
+			_occluders.resize(MaxOccluders);
+
+		_occlusionCuller.BeginFrame(_camera->GetView() * _camera->GetProj());
+		_occluderMask.Reset(_objects.size());
+		for (const auto& occluder : _occluders)
+		{
+			const auto& ri = _objects[occluder.second];
+			_occlusionCuller.RasterizeOccluder(*ri->Occluder, ri->World);
+			_occluderMask.Set(occluder.second);
+		}
+		_occlusionCuller.BuildHierarchy();
+		_occlusionStats.Occluders = static_cast<int>(_occluders.size());
+
+		//occluders are drawn anyway and must not hide themselves
+		_cameraVisibility.ForEach([&](const size_t i)
+		{
+			if (_occluderMask.Test(i))
+				return;
+			_occlusionStats.Tested++;
+			if (!_occlusionCuller.IsVisible(_worldBounds[i]))
+			{
+				_cameraVisibility.Clear(i);
+				_occlusionStats.Occluded++;
+			}
+		});
+	}
+
+	_occlusionStats.Milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void EditableObjectManager::RequestMipsAndSyncHandles(const float screenHeight)
+{
+	const XMVECTOR cameraPos = _camera->GetPosition();
+	//world size of one pixel at distance 1
+	const float pixelSize = 1.0f / PixelsAtUnitDistance(_camera->GetFovY(), screenHeight);
+
+	for (const auto& objects : { &_visibleUntesselatedObjects, &_visibleTesselatedObjects })
+	{
+		for (const auto ri : *objects)
+		{
+			const BoundingBox worldBounds = ObjectWorldBounds(*ri);
+			const float distance = NearestDistance(worldBounds, cameraPos, _camera->GetNearZ());
+
+			const XMFLOAT3& scale = ri->Transform[BasicUtil::EnumIndex(Transform::Scale)];
+			const float maxScale = std::max(std::max(std::abs(scale.x), std::abs(scale.y)), std::max(std::abs(scale.z), 1e-4f));
+			//object space units covered by one pixel
+			const float footprint = distance * pixelSize / maxScale;
+
+			for (const auto& meshData : ri->LodsData[ri->CurrentLodIdx].Meshes)
+			{
+				//also moves the handles to the views the textures live in now, before they are bound
+				Material* material = ri->Materials[meshData.MaterialIndex].get();
+				const float uvPerPixel = footprint * meshData.UvDensity;
+				for (auto& property : material->properties)
+				{
+					if (property.texture.UseTexture)
+						TextureManager::RequestMip(property.texture, uvPerPixel);
+				}
+				for (auto& texture : material->textures)
+				{
+					if (texture.UseTexture)
+						TextureManager::RequestMip(texture, uvPerPixel);
+				}
+			}
 		}
 	}
 }
@@ -292,55 +675,6 @@ void EditableObjectManager::CountLodOffsets(LodData* lod) const
 	}
 }
 
-void EditableObjectManager::CountLodIndex(EditableRenderItem* ri, const float screenHeight) const
-{
-	if (ri->LodsData.size() == 1)
-		return;
-
-	BoundingSphere riSphere;
-	riSphere.Center = ri->Bounds.Center;
-	riSphere.Radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->Bounds.Extents)));
-
-	BoundingSphere worldSphere;
-	riSphere.Transform(worldSphere, ri->World);
-	XMVECTOR worldPos = XMLoadFloat3(&worldSphere.Center);
-
-	const float size = ComputeScreenSize(worldPos, worldSphere.Radius, screenHeight);
-
-	int preferableLod;
-
-	if (size > 200.0f) preferableLod = 0;
-	else if (size > 150.0f)  preferableLod = 1;
-	else if (size > 100.0f)  preferableLod = 2;
-	else if (size > 70.0f)  preferableLod = 3; 
-	else if (size > 30.0f)  preferableLod = 4;
-	else preferableLod = 5;
-
-	const int maxIndex = static_cast<int>(ri->LodsData.size()) - 1;
-
-	const int prevLodIdx = ri->CurrentLodIdx;
-
-	ri->CurrentLodIdx = std::min(preferableLod, maxIndex);
-
-	if (prevLodIdx != ri->CurrentLodIdx)
-	{
-		ri->RayTracingDirty = true; 
-	}
-}
-
-float EditableObjectManager::ComputeScreenSize(XMVECTOR& center, const float radius, const float screenHeight) const
-{
-	center = XMVector3TransformCoord(center, _camera->GetView());
-
-	const float dist = XMVectorGetZ(center);
-	if (dist <= 0.0f)
-		return FLT_MAX; // behind camera treat as very large
-
-	const float projectedSize = (radius / dist) * (screenHeight / (2.0f * tanf(_camera->GetFovY() * 0.5f)));
-
-	return projectedSize; // in pixels (height of sphere on screen)
-}
-
 void EditableObjectManager::AddObjectToResource(const Microsoft::WRL::ComPtr<ID3D12Device5> device, FrameResource* currFrameResource)
 {
 	for (const auto& obj : _objects)
@@ -357,13 +691,13 @@ int EditableObjectManager::AddRenderItem(ID3D12Device5* device, ModelData&& mode
 	const bool isTesselated = modelData.IsTesselated;
 
 	auto modelRitem = std::make_shared<EditableRenderItem>();
-	_objectLoaded[itemName]++;
+	_objectLoaded[modelData.GeoId]++;
 
 	modelRitem->Uid = _uidCount++;
 	modelRitem->Name = name;
-	modelRitem->NameCount = _objectCounters[itemName]++;
+	modelRitem->NameCount = _objectCounters[modelData.GeoId]++;
 
-	modelRitem->Geo = &GeometryManager::Geometries()[itemName];
+	modelRitem->GeoId = modelData.GeoId;
 	modelRitem->PrimitiveType = isTesselated ?
 		D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST :
 		D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -379,6 +713,7 @@ int EditableObjectManager::AddRenderItem(ID3D12Device5* device, ModelData&& mode
 	modelRitem->Bounds = std::move(modelData.Aabb);
 	modelRitem->LodsData = std::move(modelData.LodsData);
 	modelRitem->Transform = std::move(modelData.Transform);
+	modelRitem->Occluder = std::move(modelData.Occluder);
 
 	const auto& lod = modelRitem->LodsData.begin();
 
@@ -401,8 +736,6 @@ int EditableObjectManager::AddRenderItem(ID3D12Device5* device, ModelData&& mode
 			                                                          size()) + 1, static_cast<int>(modelRitem->Materials.size()));
 	}
 
-	(isTesselated ? _tesselatedObjects : _untesselatedObjects)[modelRitem->Uid] = modelRitem.get();
-
 	_rayTracingManager->AddRtObject(modelRitem.get());
 
 	_objects.push_back(std::move(modelRitem));
@@ -430,7 +763,7 @@ void EditableObjectManager::DeleteLod(EditableRenderItem* ri, const int index)
 {
 	ri->LodsData.erase(ri->LodsData.begin() + index);
 	ri->CurrentLodIdx = std::min(ri->CurrentLodIdx, static_cast<int>(ri->LodsData.size()) - 1);
-	GeometryManager::DeleteLodGeometry(ri->Name, index);
+	GeometryManager::DeleteLodGeometry(ri->GeoId, index);
 }
 
 bool EditableObjectManager::DeleteObject(const int selectedObject)
@@ -443,48 +776,30 @@ bool EditableObjectManager::DeleteObject(const int selectedObject)
 	{
 		for (int i = 0; i < BasicUtil::EnumIndex(MatProp::Count); i++)
 		{
-			const std::string texName = materialToDelete->properties[i].texture.Name;
-			TextureManager::DeleteTexture(std::wstring(texName.begin(), texName.end()));
+			TextureManager::DeleteTexture(materialToDelete->properties[i].texture.Id);
 		}
 		for (int i = 0; i < BasicUtil::EnumIndex(MatTex::Count); i++)
 		{
-			const std::string texName = materialToDelete->textures[i].Name;
-			TextureManager::DeleteTexture(std::wstring(texName.begin(), texName.end()));
+			TextureManager::DeleteTexture(materialToDelete->textures[i].Id);
 		}
 	}
 
-	const std::string name = objectToDelete->Name;
-	_objectLoaded[name]--;
+	const NameId geoId = objectToDelete->GeoId;
+	_objectLoaded[geoId]--;
 
 	//need for deleting from frame resource
 	std::uint32_t uid = objectToDelete->Uid;
 
-	if (_tesselatedObjects.find(uid) != _tesselatedObjects.end())
+	auto& visibleObjects = objectToDelete->IsTesselated ? _visibleTesselatedObjects : _visibleUntesselatedObjects;
+	const auto visibleIt = std::find(visibleObjects.begin(), visibleObjects.end(), objectToDelete);
+	if (visibleIt != visibleObjects.end())
 	{
-		_tesselatedObjects.erase(uid);
-		for (int i = 0; i < _visibleTesselatedObjects.size(); i++)
-		{
-			if (_visibleTesselatedObjects[i] == uid)
-			{
-				_visibleTesselatedObjects.erase(_visibleTesselatedObjects.begin() + i);
-				break;
-			}
-		}
-	}
-	else
-	{
-		_untesselatedObjects.erase(uid);
-		for (int i = 0; i < _visibleUntesselatedObjects.size(); i++)
-		{
-			if (_visibleUntesselatedObjects[i] == uid)
-			{
-				_visibleUntesselatedObjects.erase(_visibleUntesselatedObjects.begin() + i);
-				break;
-			}
-		}
+		visibleObjects.erase(visibleIt);
 	}
 
 	_objects.erase(_objects.begin() + selectedObject);
+	//later objects moved down an index
+	_worldBounds.clear();
 
 	UploadManager::Flush();
 
@@ -493,10 +808,10 @@ bool EditableObjectManager::DeleteObject(const int selectedObject)
 		FrameResource::FrameResources()[i]->RemoveOpaqueObjectBuffer(_device.Get(), uid);
 	}
 
-	if (_objectLoaded[name] == 0)
+	if (_objectLoaded[geoId] == 0)
 	{
-		GeometryManager::UnloadModel(name);
-		_objectLoaded.erase(name);
+		GeometryManager::UnloadModel(geoId);
+		_objectLoaded.erase(geoId);
 
 		return true;
 	}
@@ -520,7 +835,7 @@ EditableRenderItem* EditableObjectManager::Object(const int i)
 	return _objects[i].get();
 }
 
-void EditableObjectManager::Draw(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource, const float screenHeight, const bool isWireframe, const bool fixedLod) const
+void EditableObjectManager::Draw(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource, const bool isWireframe) const
 {
 	cmdList->SetGraphicsRootSignature(_rootSignature.Get());
 
@@ -531,14 +846,20 @@ void EditableObjectManager::Draw(ID3D12GraphicsCommandList4* cmdList, FrameResou
 	cmdList->SetGraphicsRootConstantBufferView(10, passCb->GetGPUVirtualAddress());
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	DrawObjects(cmdList, currFrameResource, _visibleUntesselatedObjects, _untesselatedObjects, screenHeight, fixedLod);
+	//root signature was just set, so every table has to be bound again
+	_boundTextures.fill(UINT_MAX);
+	_textureBinds = 0;
+	_submeshesDrawn = 0;
+	_submeshesCulled = 0;
+
+	DrawObjects(cmdList, currFrameResource, _visibleUntesselatedObjects);
 
 	//draw with tesselation
 	cmdList->SetPipelineState(isWireframe ? _wireframeTesselatedPso.Get() : _tesselatedPso.Get());
 
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
 
-	DrawObjects(cmdList, currFrameResource, _visibleTesselatedObjects, _tesselatedObjects, screenHeight, fixedLod);
+	DrawObjects(cmdList, currFrameResource, _visibleTesselatedObjects);
 
 	if (_drawDebug)
 	{
@@ -549,19 +870,13 @@ void EditableObjectManager::Draw(ID3D12GraphicsCommandList4* cmdList, FrameResou
 }
 
 void EditableObjectManager::DrawObjects(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource,
-                                        const std::vector<uint32_t>& indices,
-                                        std::unordered_map<uint32_t, EditableRenderItem*> objects,
-                                        const float screenHeight, const bool fixedLod) const
+                                        const std::vector<EditableRenderItem*>& objects) const
 {
-	for (auto& idx : indices)
+	for (const auto ri : objects)
 	{
-		const auto& ri = objects[idx];
 		const auto objectCb = currFrameResource->OpaqueObjCb[ri->Uid]->Resource();
-		if (!fixedLod)
-			CountLodIndex(ri, screenHeight);
-
 		const int curLodIdx = ri->CurrentLodIdx;
-		const MeshGeometry* curLodGeo = ri->Geo->at(curLodIdx).get();
+		const MeshGeometry* curLodGeo = GeometryManager::Geometry(ri->GeoId)[curLodIdx].get();
 		const auto vertexBuffer = curLodGeo->VertexBufferView();
 		cmdList->IASetVertexBuffers(0, 1, &vertexBuffer);
 		const auto indexBuffer = curLodGeo->IndexBufferView();
@@ -569,10 +884,18 @@ void EditableObjectManager::DrawObjects(ID3D12GraphicsCommandList4* cmdList, Fra
 		const auto materialCb = currFrameResource->MaterialCb[ri->Uid]->Resource();
 
 		auto currentLod = ri->LodsData[curLodIdx];
+		const bool cullSubmeshes = CullsSubmeshes(currentLod.Meshes.size());
 
 		for (size_t i = 0; i < currentLod.Meshes.size(); i++)
 		{
 			const auto& meshData = currentLod.Meshes.at(i);
+			if (cullSubmeshes && _cameraPlanes.Contains(MeshWorldBounds(meshData, *ri)) == DISJOINT)
+			{
+				_submeshesCulled++;
+				continue;
+			}
+			_submeshesDrawn++;
+
 			const D3D12_GPU_VIRTUAL_ADDRESS meshCbAddress = objectCb->GetGPUVirtualAddress() + meshData.CbOffset;
 
 			cmdList->SetGraphicsRootConstantBufferView(8, meshCbAddress);
@@ -580,19 +903,16 @@ void EditableObjectManager::DrawObjects(ID3D12GraphicsCommandList4* cmdList, Fra
 			const D3D12_GPU_VIRTUAL_ADDRESS materialCbAddress = materialCb->GetGPUVirtualAddress() + meshData.MatOffset;
 			cmdList->SetGraphicsRootConstantBufferView(9, materialCbAddress);
 
-			const auto heapAlloc = TextureManager::SrvHeapAllocator.get();
 			const auto material = ri->Materials[meshData.MaterialIndex].get();
 			constexpr size_t offset = BasicUtil::EnumIndex(MatProp::Count) - 1;
 			for (int index = 0; index < offset; index++)
 			{
 				if (index == BasicUtil::EnumIndex(MatProp::Opacity)) index++;
-				const CD3DX12_GPU_DESCRIPTOR_HANDLE tex(heapAlloc->GetGpuHandle(material->properties[index].texture.Index));
-				cmdList->SetGraphicsRootDescriptorTable(index, tex);
+				BindTexture(cmdList, index, material->properties[index].texture.Index);
 			}
 			for (int i1 = 0; i1 < BasicUtil::EnumIndex(MatTex::Count); i1++)
 			{
-				const CD3DX12_GPU_DESCRIPTOR_HANDLE tex(heapAlloc->GetGpuHandle(material->textures[i1].Index));
-				cmdList->SetGraphicsRootDescriptorTable(offset + i1, tex);
+				BindTexture(cmdList, static_cast<UINT>(offset + i1), material->textures[i1].Index);
 			}
 
 			cmdList->DrawIndexedInstanced(static_cast<UINT>(meshData.IndexCount), 1,
@@ -602,6 +922,18 @@ void EditableObjectManager::DrawObjects(ID3D12GraphicsCommandList4* cmdList, Fra
 	}
 }
 
+void EditableObjectManager::BindTexture(ID3D12GraphicsCommandList4* cmdList, const UINT rootIndex, const UINT srvIndex) const
+{
+	//skip tables that already point at this descriptor
+	if (_boundTextures[rootIndex] == srvIndex)
+		return;
+
+	const CD3DX12_GPU_DESCRIPTOR_HANDLE tex(TextureManager::SrvHeapAllocator->GetGpuHandle(srvIndex));
+	cmdList->SetGraphicsRootDescriptorTable(rootIndex, tex);
+	_boundTextures[rootIndex] = srvIndex;
+	_textureBinds++;
+}
+
 void EditableObjectManager::DrawAabbs(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource) const
 {
 	for (const auto& ri : _objects)
@@ -610,14 +942,14 @@ void EditableObjectManager::DrawAabbs(ID3D12GraphicsCommandList4* cmdList, Frame
 		const D3D12_GPU_VIRTUAL_ADDRESS aabbcbAddress = objectCb->GetGPUVirtualAddress() + ri->LodsData.begin()->Meshes.size() * _cbMeshElementSize;
 
 		//draw local lights
-		MeshGeometry* geo = (GeometryManager::Geometries()["shapeGeo"].begin())->get();
+		MeshGeometry* geo = GeometryManager::ShapeGeo();
 
 		const auto vertexBuffer = geo->VertexBufferView();
 		cmdList->IASetVertexBuffers(0, 1, &vertexBuffer);
 		const auto indexBuffer = geo->IndexBufferView();
 		cmdList->IASetIndexBuffer(&indexBuffer);
 
-		const SubmeshGeometry mesh = geo->DrawArgs["box"];
+		const SubmeshGeometry& mesh = GeometryManager::ShapeSubmesh(Shape::Box);
 
 		cmdList->SetGraphicsRootConstantBufferView(8, aabbcbAddress);
 
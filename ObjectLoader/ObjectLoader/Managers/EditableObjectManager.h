@@ -3,6 +3,48 @@
 #include "ObjectManager.h"
 #include "RayTracingManager.h"
 #include "../Helpers/Camera.h"
+#include "../Helpers/SceneBvh.h"
+#include "../Helpers/CullCache.h"
+#include "../Helpers/ScreenSize.h"
+#include "../Helpers/PvsBaker.h"
+#include "../Helpers/TerrainHorizon.h"
+
+struct OcclusionStats
+{
+	int Occluders = 0;
+	int Tested = 0;
+	int Occluded = 0;
+	float Milliseconds = 0.0f;
+};
+
+struct PvsStats
+{
+	//-1 when the camera is outside the baked grid or no set matches the scene
+	int Cell = -1;
+	int Hidden = 0;
+	size_t Bytes = 0;
+	bool Matches = false;
+};
+
+struct LodSettings
+{
+	//largest geometric error in pixels a lod may show
+	float Tolerance = 1.0f;
+	//share of the tolerance an error has to cross before the lod changes
+	float Hysteresis = 0.25f;
+	//visible triangles per frame, the tolerance is raised until they fit, 0 for no limit
+	int TriangleBudget = 0;
+	//lods are picked by hand in the editor
+	bool Fixed = false;
+};
+
+struct LodStats
+{
+	int Triangles = 0;
+	//tolerance after fitting the triangle budget
+	float Tolerance = 0.0f;
+	int Switches = 0;
+};
 
 class EditableObjectManager : public ObjectManager
 {
@@ -21,12 +63,18 @@ public:
 
 	std::string ObjectName(int i) override;
 	EditableRenderItem* Object(int i) override;
-	void Draw(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource, float screenHeight, bool isWireframe = false, bool fixedLod = false) const;
+	void Draw(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource, bool isWireframe = false) const;
+	//reports texture mips needed by visible objects to the texture streamer and points their material
+	//texture handles at the views their textures have now
+	void RequestMipsAndSyncHandles(float screenHeight);
 	auto DrawObjects(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource,
-	                 const std::vector<uint32_t>& indices, std::unordered_map<uint32_t, EditableRenderItem*> objects,
-	                 float screenHeight,
-	                 bool fixedLod) const -> void;
+	                 const std::vector<EditableRenderItem*>& objects) const -> void;
 	void DrawAabbs(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource) const;
+	//descriptor table changes issued by the last Draw
+	int TextureBindsCount() const { return _textureBinds; }
+	//submeshes of visible objects issued and skipped by the last Draw
+	int SubmeshesDrawn() const { return _submeshesDrawn; }
+	int SubmeshesCulled() const { return _submeshesCulled; }
 
 	std::vector< D3D12_INPUT_ELEMENT_DESC > InputLayout() const
 	{
@@ -38,6 +86,101 @@ public:
 		return _objects;
 	}
 
+	//world space bounds of Objects(), refreshed in UpdateObjectCBs
+	const SceneBvh& Bvh() const
+	{
+		return _bvh;
+	}
+
+	//world space box of every entry of Objects(), the boxes the bvh is built over
+	const std::vector<BoundingBox>& WorldBounds() const
+	{
+		return _worldBounds;
+	}
+
+	//bit per entry of Objects(), set when it is inside the camera frustum and not occluded
+	const VisibilityMask& CameraVisibility() const
+	{
+		return _cameraVisibility;
+	}
+
+	bool* OcclusionCulling()
+	{
+		return &_occlusionCulling;
+	}
+
+	const OcclusionStats& Occlusion() const
+	{
+		return _occlusionStats;
+	}
+
+	//render target height lods are picked for
+	void SetScreenHeight(float screenHeight)
+	{
+		_screenHeight = screenHeight;
+	}
+
+	LodSettings* LodSelection()
+	{
+		return &_lodSettings;
+	}
+
+	const LodStats& Lods() const
+	{
+		return _lodStats;
+	}
+
+	//bakes a set over the current objects with their occluders as blockers and saves it
+	bool BakePvs(const PvsBakeSettings& settings, const std::string& path);
+	//false when the file is missing or was baked for a different scene
+	bool LoadPvs(const std::string& path);
+	//moves the small textures of every material into shared atlas pages, so fewer views get bound
+	AtlasStats PackMaterialTextures();
+
+	bool* UsePvs()
+	{
+		return &_usePvs;
+	}
+
+	const PvsStats& Pvs() const
+	{
+		return _pvsStats;
+	}
+
+	//objects whose bounding sphere covers fewer pixels are not drawn, 0 draws everything
+	float* MinScreenSize()
+	{
+		return &_minScreenSize;
+	}
+
+	//objects the last cull found too small to draw
+	int SmallObjectsCulled() const
+	{
+		return _smallObjectsCulled;
+	}
+
+	//objects are also culled behind the terrain tiles the horizon was built from, null turns that off
+	void BindTerrainHorizon(const TerrainHorizon* horizon)
+	{
+		_terrainHorizon = horizon;
+	}
+
+	//objects the last cull found hidden behind the terrain
+	int TerrainOccluded() const
+	{
+		return _terrainOccluded;
+	}
+
+	//how the last camera cull reused the one before it
+	CullCache::Reuse CameraCullReuse() const
+	{
+		return _cullCache.LastReuse();
+	}
+
+	//objects covering this share of the screen height are used as occluders
+	static constexpr float OccluderScreenSize = 0.2f;
+	static constexpr int MaxOccluders = 32;
+
 private:
 	std::vector<std::shared_ptr<EditableRenderItem>> _objects;
 	RayTracingManager* _rayTracingManager;
@@ -48,8 +191,13 @@ private:
 	void BuildShaders() override;
 
 	void CountLodOffsets(LodData* lod) const;
-	void CountLodIndex(EditableRenderItem* ri, float screenHeight) const;
-	float ComputeScreenSize(XMVECTOR& center, float radius, float screenHeight) const;
+	void CullSmallObjects();
+	void CullBehindTerrain();
+	void CullOccluded();
+	void BuildVisibleLists();
+	//picks lods of visible objects from their projected error, within the triangle budget
+	void SelectLods();
+	void BindTexture(ID3D12GraphicsCommandList4* cmdList, UINT rootIndex, UINT srvIndex) const;
 
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> _wireframePso;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> _tesselatedPso;
@@ -60,11 +208,49 @@ private:
 	Microsoft::WRL::ComPtr<ID3DBlob> _tessDsShader;
 	Microsoft::WRL::ComPtr<ID3DBlob> _wireframePsShader;
 
-	std::unordered_map<uint32_t, EditableRenderItem*> _tesselatedObjects{};
-	std::unordered_map<uint32_t, EditableRenderItem*> _untesselatedObjects{};
+	std::vector<EditableRenderItem*> _visibleTesselatedObjects{};
+	std::vector<EditableRenderItem*> _visibleUntesselatedObjects{};
+
+	SceneBvh _bvh;
+	std::vector<BoundingBox> _worldBounds;
+	std::vector<int> _candidates;
+	VisibilityMask _cameraVisibility;
+	//world space camera frustum, submeshes are tested against it at draw time
+	CullingPlanes _cameraPlanes;
+	CullCache _cullCache;
+	//occluder marks and the occlusion toggle, the cache is dropped when they change
+	uint64_t _cullSignature = 0;
+
+	OcclusionCuller _occlusionCuller;
+	bool _occlusionCulling = true;
+	OcclusionStats _occlusionStats;
+	//screen size and index of this frame's occluders, largest first
+	std::vector<std::pair<float, int>> _occluders;
+	VisibilityMask _occluderMask;
+
+	PotentiallyVisibleSet _pvs;
+	bool _usePvs = true;
+	PvsStats _pvsStats;
+	//decoded set of _pvsStats.Cell
+	VisibilityMask _pvsMask;
+
+	float _minScreenSize = 1.0f;
+	int _smallObjectsCulled = 0;
+
+	const TerrainHorizon* _terrainHorizon = nullptr;
+	int _terrainOccluded = 0;
+
+	LodSettings _lodSettings;
+	LodStats _lodStats;
+	float _screenHeight = 1.0f;
+	//visible objects with their pixels per object space unit
+	std::vector<std::pair<EditableRenderItem*, float>> _lodScales;
 
-	std::vector<uint32_t> _visibleTesselatedObjects{};
-	std::vector<uint32_t> _visibleUntesselatedObjects{};
+	//srv index currently set on each texture root table
+	mutable std::array<UINT, 8> _boundTextures{};
+	mutable int _textureBinds = 0;
+	mutable int _submeshesDrawn = 0;
+	mutable int _submeshesCulled = 0;
 
 	UINT _cbMeshElementSize = d3dUtil::CalcConstantBufferByteSize(sizeof(OpaqueObjectConstants));
 	UINT _cbMaterialElementSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
@@ -2,18 +2,91 @@
 
 #include "UploadManager.h"
 
-std::unordered_map<std::string, std::vector<std::shared_ptr<MeshGeometry>>>& GeometryManager::Geometries()
+std::vector<std::vector<std::shared_ptr<MeshGeometry>>>& GeometryManager::Geometries()
 {
-	static std::unordered_map<std::string, std::vector<std::shared_ptr<MeshGeometry>>> geometries;
+	static std::vector<std::vector<std::shared_ptr<MeshGeometry>>> geometries;
 	return geometries;
 }
 
-std::unordered_map<std::string, bool>& GeometryManager::Tesselatable()
+std::vector<std::shared_ptr<MeshGeometry>>& GeometryManager::Geometry(const NameId id)
 {
-	static std::unordered_map<std::string, bool> tesselatable;
+	if (id >= Geometries().size())
+	{
+		Geometries().resize(static_cast<size_t>(id) + 1);
+	}
+	return Geometries()[id];
+}
+
+std::vector<bool>& GeometryManager::Tesselatable()
+{
+	static std::vector<bool> tesselatable;
 	return tesselatable;
 }
 
+std::shared_ptr<const OccluderMesh>& GeometryManager::Occluder(const NameId id)
+{
+	static std::vector<std::shared_ptr<const OccluderMesh>> occluders;
+	if (id >= occluders.size())
+	{
+		occluders.resize(static_cast<size_t>(id) + 1);
+	}
+	return occluders[id];
+}
+
+std::vector<XMFLOAT3>& GeometryManager::LodReference(const NameId id)
+{
+	static std::vector<std::vector<XMFLOAT3>> references;
+	if (id >= references.size())
+	{
+		references.resize(static_cast<size_t>(id) + 1);
+	}
+	return references[id];
+}
+
+float GeometryManager::LodError(const NameId id, const Lod& lod)
+{
+	return LodSelector::GeometricError(LodReference(id), LodTriangles(lod));
+}
+
+std::vector<XMFLOAT3> GeometryManager::LodTriangles(const Lod& lod)
+{
+	std::vector<XMFLOAT3> triangles;
+	triangles.reserve(lod.Indices.size());
+	for (const auto& mesh : lod.Meshes)
+	{
+		for (size_t i = mesh.IndexStart; i < mesh.IndexStart + mesh.IndexCount; i++)
+		{
+			const XMFLOAT3& pos = lod.Vertices[mesh.VertexStart + lod.Indices[i]].Pos;
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&pos), mesh.DefaultWorld));
+			triangles.push_back(position);
+		}
+	}
+	return triangles;
+}
+
+NameId GeometryManager::ShapeGeoId()
+{
+	static const NameId id = NameTable::Intern("shapeGeo");
+	return id;
+}
+
+MeshGeometry* GeometryManager::ShapeGeo()
+{
+	return Geometry(ShapeGeoId()).begin()->get();
+}
+
+const SubmeshGeometry& GeometryManager::ShapeSubmesh(const Shape shape)
+{
+	return ShapeSubmeshes()[BasicUtil::EnumIndex(shape)];
+}
+
+std::array<SubmeshGeometry, BasicUtil::EnumIndex(Shape::Count)>& GeometryManager::ShapeSubmeshes()
+{
+	static std::array<SubmeshGeometry, BasicUtil::EnumIndex(Shape::Count)> submeshes;
+	return submeshes;
+}
+
 void GeometryManager::BuildNecessaryGeometry()
 {
 	UploadManager::Reset();
@@ -101,10 +174,12 @@ void GeometryManager::BuildNecessaryGeometry()
 	geo->DrawArgs["sphere"] = sphereSubmesh;
 	geo->DrawArgs["terrainGrid"] = terrainGridSubmesh;
 
-	Geometries().emplace(
-		geo->Name,
-		std::vector<std::shared_ptr<MeshGeometry>>{ geo }
-	);
+	ShapeSubmeshes()[BasicUtil::EnumIndex(Shape::Grid)] = gridSubmesh;
+	ShapeSubmeshes()[BasicUtil::EnumIndex(Shape::Box)] = boxSubmesh;
+	ShapeSubmeshes()[BasicUtil::EnumIndex(Shape::Sphere)] = sphereSubmesh;
+	ShapeSubmeshes()[BasicUtil::EnumIndex(Shape::TerrainGrid)] = terrainGridSubmesh;
+
+	Geometry(ShapeGeoId()) = std::vector<std::shared_ptr<MeshGeometry>>{ geo };
 }
 
 ModelData GeometryManager::BuildModelGeometry(Model* model)
@@ -112,13 +187,27 @@ ModelData GeometryManager::BuildModelGeometry(Model* model)
 	//check if geometry already exists
 	ModelData data;
 	data.CroppedName = model->name;
+	data.GeoId = NameTable::Intern(model->name);
 	data.Materials = std::move(model->materials());
 
-	for (auto& lod : model->lods())
+	const std::vector<Lod> lods = model->lods();
+	std::vector<XMFLOAT3> firstLodTriangles;
+	if (!lods.empty())
+	{
+		firstLodTriangles = LodTriangles(lods.front());
+		LodReference(data.GeoId) = LodSelector::ReferencePoints(firstLodTriangles);
+	}
+
+	for (auto& lod : lods)
 	{
 		LodData lodData;
 		lodData.Meshes = lod.Meshes;
 		lodData.TriangleCount = static_cast<int>(lod.Indices.size()) / 3;
+		//a coarser lod never looks better than the one before it
+		if (!data.LodsData.empty())
+		{
+			lodData.Error = std::max(LodError(data.GeoId, lod), data.LodsData.back().Error);
+		}
 		data.LodsData.push_back(lodData);
 	}
 
@@ -126,13 +215,14 @@ ModelData GeometryManager::BuildModelGeometry(Model* model)
 	data.IsTesselated = model->isTesselated();
 	data.Aabb = model->AABB();
 
-	if (Geometries().find(model->name) != Geometries().end())
+	if (!Geometry(data.GeoId).empty())
 	{
+		data.Occluder = Occluder(data.GeoId);
 		return data;
 	}
 
 	//verifying that model does actually have some data
-	if (model->lods().empty())
+	if (lods.empty())
 	{
 		OutputDebugString(L"[ERROR] Model data is empty! Aborting geometry creation.\n");
 		return {};
@@ -140,7 +230,7 @@ ModelData GeometryManager::BuildModelGeometry(Model* model)
 
 	//making different buffers for different lods
 	std::vector <std::shared_ptr<MeshGeometry>> lodBuffers{};
-	for (auto& lod : model->lods())
+	for (auto& lod : lods)
 	{
 		// Pack the indices of all the meshes into one index buffer.
 		const UINT vbByteSize = static_cast<UINT>(lod.Vertices.size()) * sizeof(Vertex);
@@ -169,24 +259,29 @@ ModelData GeometryManager::BuildModelGeometry(Model* model)
 		lodBuffers.push_back(std::move(geo));
 	}
 
-	Geometries().emplace(
-		model->name,
-		std::move(lodBuffers)
-	);
+	Geometry(data.GeoId) = std::move(lodBuffers);
 
-	Tesselatable()[model->name] = data.IsTesselated;
+	//displacement can push the surface inwards, so tesselated meshes never occlude
+	if (!data.IsTesselated)
+	{
+		auto occluder = std::make_shared<OccluderMesh>(OcclusionCuller::BuildOccluder(firstLodTriangles));
+		if (!occluder->Empty())
+			Occluder(data.GeoId) = std::move(occluder);
+	}
+	data.Occluder = Occluder(data.GeoId);
+
+	if (data.GeoId >= Tesselatable().size())
+	{
+		Tesselatable().resize(static_cast<size_t>(data.GeoId) + 1);
+	}
+	Tesselatable()[data.GeoId] = data.IsTesselated;
 
 	return data;
 }
 
-void GeometryManager::AddLodGeometry(const std::string& name, const int lodIdx, const Lod& lod)
+void GeometryManager::AddLodGeometry(const NameId id, const int lodIdx, const Lod& lod)
 {
-	LodData data;
-
-	data.Meshes = lod.Meshes;
-	data.TriangleCount = static_cast<int>(lod.Indices.size());
-
-	if (Geometries().find(name) == Geometries().end())
+	if (id >= Geometries().size() || Geometries()[id].empty())
 	{
 		return;
 	}
@@ -224,20 +319,20 @@ void GeometryManager::AddLodGeometry(const std::string& name, const int lodIdx,
 	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	auto& geos = Geometries()[name];
+	auto& geos = Geometries()[id];
 
 	geos.emplace(geos.begin() + lodIdx, std::move(geo));
 
 	UploadManager::ExecuteUploadCommandList();
 }
 
-void GeometryManager::DeleteLodGeometry(const std::string& name, const int lodIdx)
+void GeometryManager::DeleteLodGeometry(const NameId id, const int lodIdx)
 {
-	if (Geometries().find(name) == Geometries().end())
+	if (id >= Geometries().size())
 	{
 		return;
 	}
-	auto& geos = Geometries()[name];
+	auto& geos = Geometries()[id];
 	if (lodIdx < 0 || lodIdx >= geos.size())
 	{
 		return;
@@ -307,12 +402,16 @@ void GeometryManager::BuildBlasForMesh(MeshGeometry& geo)
 	cmdList->ResourceBarrier(1, &barrier);
 }
 
-void GeometryManager::UnloadModel(const std::string& modelName)
+void GeometryManager::UnloadModel(const NameId id)
 {
-	if (Geometries().find(modelName) != Geometries().end())
+	//the id stays interned, only the buffers are released
+	if (id < Geometries().size())
 	{
-		Geometries().erase(modelName);
+		Geometries()[id].clear();
 	}
+	Occluder(id).reset();
+	LodReference(id).clear();
+	LodReference(id).shrink_to_fit();
 }
 
 
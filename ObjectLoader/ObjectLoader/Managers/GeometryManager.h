@@ -3,27 +3,62 @@
 #include "../../../Common/GeometryGenerator.h"
 #include "../../../Common/d3dUtil.h"
 #include "../Helpers/Model.h"
+#include "../Helpers/NameTable.h"
+#include "../Helpers/OcclusionCuller.h"
+#include "../Helpers/LodSelector.h"
 
 struct ModelData
 {
 	std::string CroppedName = "";
+	NameId GeoId = gInvalidNameId;
 	bool IsTesselated = false;
 	std::vector<std::unique_ptr<Material>> Materials;
 	std::vector<LodData> LodsData{};
 	BoundingBox Aabb;
 	std::array<DirectX::XMFLOAT3, 3> Transform = {};
+	//empty for open and tesselated meshes
+	std::shared_ptr<const OccluderMesh> Occluder;
+};
+
+//submeshes of the shared shape geometry
+enum class Shape
+{
+	Grid,
+	Box,
+	Sphere,
+	TerrainGrid,
+	Count
 };
 
 class GeometryManager
 {
 public:
-	static std::unordered_map<std::string, std::vector<std::shared_ptr<MeshGeometry>>>& Geometries();
-	static std::unordered_map<std::string, bool>& Tesselatable();
+	//lod buffers indexed by interned geometry name
+	static std::vector<std::vector<std::shared_ptr<MeshGeometry>>>& Geometries();
+	static std::vector<std::shared_ptr<MeshGeometry>>& Geometry(NameId id);
+	//indexed like Geometries()
+	static std::vector<bool>& Tesselatable();
+	//simplified occlusion geometry built from the first lod, indexed like Geometries()
+	static std::shared_ptr<const OccluderMesh>& Occluder(NameId id);
+	//sampled first lod corners the error of the other lods is measured from, indexed like Geometries()
+	static std::vector<DirectX::XMFLOAT3>& LodReference(NameId id);
+	//geometric error of a lod added to an already built geometry
+	static float LodError(NameId id, const Lod& lod);
+
+	static NameId ShapeGeoId();
+	static MeshGeometry* ShapeGeo();
+	static const SubmeshGeometry& ShapeSubmesh(Shape shape);
 
 	static void BuildNecessaryGeometry();
 	static ModelData BuildModelGeometry(Model* model);
-	static void UnloadModel(const std::string& modelName);
-	static void AddLodGeometry(const std::string& name, int lodIdx, const Lod& lod);
-	static void DeleteLodGeometry(const std::string& name, int lodIdx);
+	static void UnloadModel(NameId id);
+	static void AddLodGeometry(NameId id, int lodIdx, const Lod& lod);
+	static void DeleteLodGeometry(NameId id, int lodIdx);
 	static void BuildBlasForMesh(MeshGeometry& geo);
+
+private:
+	//triangle corners with every mesh's DefaultWorld applied
+	static std::vector<DirectX::XMFLOAT3> LodTriangles(const Lod& lod);
+
+	static std::array<SubmeshGeometry, BasicUtil::EnumIndex(Shape::Count)>& ShapeSubmeshes();
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "LightingManager.h"
 
 #include "UploadManager.h"
+#include "../Helpers/JobSystem.h"
+
+#include <chrono>
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -38,6 +41,7 @@ void LightingManager::AddLight(ID3D12Device* device)
 	lightItem->ShadowMapDsv = CreateShadowTextureDsv(false, lightIndex);
 
 	_localLights.push_back(std::move(lightItem));
+	_lightBoundsDirty = true;
 }
 
 void LightingManager::DeleteLight(const int deletedLight)
@@ -45,6 +49,9 @@ void LightingManager::DeleteLight(const int deletedLight)
 	_freeLightIndices.push_back(_localLights[deletedLight]->LightIndex);
 	DeleteShadowTexture(_localLights[deletedLight]->ShadowMapDsv);
 	_localLights.erase(_localLights.begin() + deletedLight);
+	//indices after the deleted light moved, nothing is visible until the next cull
+	_lightVisibility.Reset(_localLights.size());
+	_lightBoundsDirty = true;
 }
 
 void LightingManager::UpdateDirectionalLightCb(const FrameResource* currFrameResource)
@@ -59,6 +66,13 @@ void LightingManager::UpdateDirectionalLightCb(const FrameResource* currFrameRes
 	DirectX::XMStoreFloat3(&dirLightCb.MainLightDirection, direction);
 	dirLightCb.MainSpotlight = _handSpotlight;
 	dirLightCb.LightsContainingFrustum = static_cast<int>(_lightsContainingFrustum.size());
+	dirLightCb.Clustered = static_cast<int>(_lightsClustered);
+	dirLightCb.CameraLook = _camera->GetLook3F();
+	dirLightCb.ClusterCounts[0] = _lightClusters.TilesX();
+	dirLightCb.ClusterCounts[1] = _lightClusters.TilesY();
+	dirLightCb.ClusterCounts[2] = _lightClusters.Slices();
+	dirLightCb.SliceScale = _lightClusters.SliceScale();
+	dirLightCb.SliceBias = _lightClusters.SliceBias();
 
 	const auto currShadowDirLightCb = currFrameResource->ShadowDirLightCb.get();
 
@@ -119,17 +133,37 @@ void LightingManager::UpdateLightCBs(const FrameResource* currFrameResource)
 			currShadowLightsCb->CopyData(light->LightIndex, lightConstants);
 			light->NumFramesDirty--;
 		}
+	}
+
+	if (_lightBoundsDirty)
+	{
+		_lightBounds.resize(_localLights.size());
+		for (size_t i = 0; i < _localLights.size(); i++)
+			BoundingBox::CreateFromSphere(_lightBounds[i], _localLights[i]->Bounds);
+		_lightBvh.Update(_lightBounds);
+		_lightBoundsDirty = false;
+	}
 
-		// Transform the camera frustum from view space to the object's local space.
-		BoundingFrustum localSpaceFrustum;
-		_camera->CameraFrustum().Transform(localSpaceFrustum, invView);
+	//the tree rejects whole groups of lights by their boxes, the spheres it lets through are tested exactly
+	BoundingFrustum worldFrustum;
+	_camera->CameraFrustum().Transform(worldFrustum, invView);
+	_lightCandidates.clear();
+	_lightBvh.Query(CullingPlanes::FromFrustum(worldFrustum), _lightCandidates);
 
-		// Perform the box/frustum intersection test in local space.
-		if (localSpaceFrustum.Contains(light->Bounds) == DirectX::DISJOINT)
+	//the mask hands the lights out in list order, same as the shadow pass expects
+	_lightVisibility.Reset(_localLights.size());
+	for (const int i : _lightCandidates)
+		_lightVisibility.Set(i);
+
+	const XMVECTOR cameraPos = _camera->GetPosition();
+	_lightVisibility.ForEach([&](const size_t i)
+	{
+		const auto& light = _localLights[i];
+		if (worldFrustum.Contains(light->Bounds) == DirectX::DISJOINT)
 		{
-			continue;
+			_lightVisibility.Clear(i);
 		}
-		else if (light->Bounds.Contains(_camera->GetPosition()))
+		else if (light->Bounds.Contains(cameraPos))
 		{
 			//we are inside the light
 			currLightsContainingFrustumCb->CopyData(lightsContainingFrustum++, LightIndex(light->LightIndex));
@@ -141,7 +175,9 @@ void LightingManager::UpdateLightCBs(const FrameResource* currFrameResource)
 			currLightsInsideFrustumCb->CopyData(lightsInsideFrustum++, LightIndex(light->LightIndex));
 			_lightsInsideFrustum.push_back(light->LightIndex);
 		}
-	}
+	});
+
+	BuildLightClusters(currFrameResource);
 }
 
 void LightingManager::UpdateWorld(const int lightIndex) const
@@ -188,6 +224,7 @@ void LightingManager::UpdateWorld(const int lightIndex) const
 	}
 	_localLights[lightIndex]->LightData.World = XMMatrixTranspose(world);
 	_localLights[lightIndex]->NumFramesDirty = gNumFrameResources;
+	_lightBoundsDirty = true;
 }
 
 int LightingManager::LightsCount() const
@@ -293,6 +330,35 @@ void LightingManager::CalculateCascadesViewProjs()
 		_cascades[i].Cascade.ViewProj = _cascades[i].LightView * cascadeProj;
 		BoundingBox::CreateFromPoints(_cascades[i].Aabb, cascadeMinV, cascadeMaxV);
 	}
+
+	BuildCasterVolumes(lightDir);
+}
+
+void LightingManager::BuildCasterVolumes(const FXMVECTOR lightDir)
+{
+	//the shader samples the first cascade whose split is farther than the pixel is from the eye,
+	//and a pixel that far away is at least that times the cosine of the widest corner ray deep in view space
+	const BoundingFrustum viewFrustum = _camera->CameraFrustum();
+	XMFLOAT3 frustumCorners[BoundingFrustum::CORNER_COUNT];
+	viewFrustum.GetCorners(frustumCorners);
+	float minCos = 1.0f;
+	for (const auto& corner : frustumCorners)
+		minCos = (std::min)(minCos, corner.z / XMVectorGetX(XMVector3Length(XMLoadFloat3(&corner))));
+
+	const XMMATRIX invView = _camera->GetInvView();
+	const float nearZ = _camera->GetNearZ();
+	const float farZ = _camera->GetFarZ();
+	for (int i = 0; i < gCascadesCount; i++)
+	{
+		//receivers nearer than that take a finer cascade, casters shadowing only them are left out of this one
+		const float nearDepth = i == 0 ? nearZ : (std::max)(nearZ, _cascades[i - 1].Cascade.SplitFar * minCos);
+		const float farDepth = i == gCascadesCount - 1 ? farZ : (std::min)(farZ, _cascades[i].Cascade.SplitFar);
+
+		XMFLOAT3 receivers[8];
+		CasterVolume::FrustumSlice(viewFrustum, invView, nearDepth, farDepth, receivers);
+		_casterVolumes[i] = CasterVolume::FromReceivers(receivers, lightDir);
+		_casterVolumes[i].Clip(CascadePlanes(i));
+	}
 }
 
 void LightingManager::DrawDirLight(ID3D12GraphicsCommandList4* cmdList, const FrameResource* currFrameResource, const bool rayTracingEnabled)
@@ -325,6 +391,11 @@ void LightingManager::DrawDirLight(ID3D12GraphicsCommandList4* cmdList, const Fr
 		cmdList->SetGraphicsRootDescriptorTable(10, srvAllocator->GetGpuHandle(_localLightsShadowTextureArray.Srv));
 	}
 
+	//the cluster lists follow the shadow maps, which take one slot less with ray tracing
+	const UINT clusterRangesSlot = rayTracingEnabled ? 10 : 11;
+	cmdList->SetGraphicsRootShaderResourceView(clusterRangesSlot, currFrameResource->LightClusterRanges->Resource()->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(clusterRangesSlot + 1, currFrameResource->LightClusterIndices->Resource()->GetGPUVirtualAddress());
+
 	cmdList->SetPipelineState(rayTracingEnabled ? _dirLightPsoRt.Get() : _dirLightPsoCsm.Get());
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -353,7 +424,7 @@ void LightingManager::DrawLocalLights(ID3D12GraphicsCommandList4* cmdList, const
 		return;
 	
 	//draw local lights
-	MeshGeometry* geo = GeometryManager::Geometries()["shapeGeo"].begin()->get();
+	MeshGeometry* geo = GeometryManager::ShapeGeo();
 
 	const auto& vertexBuffer = geo->VertexBufferView();
 	cmdList->IASetVertexBuffers(0, 1, &vertexBuffer);
@@ -362,9 +433,13 @@ void LightingManager::DrawLocalLights(ID3D12GraphicsCommandList4* cmdList, const
 
 	cmdList->SetGraphicsRootShaderResourceView(4, currFrameResource->LightsInsideFrustum.get()->Resource()->GetGPUVirtualAddress());
 
+	//the full screen pass already lit them from the clusters, the volumes stay bound for the debug draw
+	if (_lightsClustered)
+		return;
+
 	cmdList->SetPipelineState(rayTracingEnabled ? _localLightsPsoRt.Get() : _localLightsPsoCsm.Get());
 
-	const SubmeshGeometry mesh = geo->DrawArgs["box"];
+	const SubmeshGeometry& mesh = GeometryManager::ShapeSubmesh(Shape::Box);
 	cmdList->DrawIndexedInstanced(mesh.IndexCount, static_cast<UINT>(_lightsInsideFrustum.size()), mesh.StartIndexLocation,
 		mesh.BaseVertexLocation, 0);
 }
@@ -373,8 +448,7 @@ void LightingManager::DrawDebug(ID3D12GraphicsCommandList4* cmdList, FrameResour
 {
 	if (_lightsInsideFrustum.empty())
 		return;
-	const auto geo = GeometryManager::Geometries()["shapeGeo"].begin()->get();
-	const SubmeshGeometry mesh = geo->DrawArgs["box"];
+	const SubmeshGeometry& mesh = GeometryManager::ShapeSubmesh(Shape::Box);
 	cmdList->SetPipelineState(_localLightsWireframePso.Get());
 	cmdList->DrawIndexedInstanced(mesh.IndexCount, static_cast<UINT>(_lightsInsideFrustum.size()),
 	                              mesh.StartIndexLocation, mesh.BaseVertexLocation, 0);
@@ -388,7 +462,8 @@ void LightingManager::DrawEmissive(ID3D12GraphicsCommandList4* cmdList, FrameRes
 }
 
 void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource,
-                                  const std::vector<std::shared_ptr<EditableRenderItem>>& objects)
+                                  const std::vector<std::shared_ptr<EditableRenderItem>>& objects, const SceneBvh& bvh,
+                                  const std::vector<BoundingBox>& worldBounds)
 {
 	cmdList->RSSetViewports(1, &_shadowViewport);
 	cmdList->RSSetScissorRects(1, &_shadowScissorRect);
@@ -397,6 +472,9 @@ void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameReso
 	cmdList->SetPipelineState(_shadowPso.Get());
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	_smallCasters = {};
+	_cascadeCasters = {};
+
 	if (_isMainLightOn)
 	{
 	
@@ -407,14 +485,48 @@ void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameReso
 
 		const auto dsvAllocator = TextureManager::DsvHeapAllocator.get();
 
+		//every cascade culls against its own cache, so the lists are made side by side on the job system and recorded in order
+		struct CascadeCull
+		{
+			std::vector<int> Objects;
+			int NoReceivers = 0;
+			int SmallCasters = 0;
+		};
+		CascadeCull culls[gCascadesCount];
+		JobSystem::Shared().ParallelFor(0, gCascadesCount, 1, [&](const size_t first, const size_t last)
+		{
+			for (size_t c = first; c < last; c++)
+			{
+				const int i = static_cast<int>(c);
+				CascadeCull& cull = culls[i];
+				//check frustum culling so we do not need to load gpu with unnecessary commands
+				const CullingPlanes cascadePlanes = CascadePlanes(i);
+				cull.Objects = FrustumCulling(bvh, worldBounds, i, cascadePlanes);
+				//the box also holds casters whose shadows land off screen or only where a finer cascade is sampled
+				const CasterVolume& casterVolume = _casterVolumes[i];
+				const size_t inCascadeBox = cull.Objects.size();
+				cull.Objects.erase(std::remove_if(cull.Objects.begin(), cull.Objects.end(),
+				                                  [&](const int obj) { return casterVolume.Contains(worldBounds[obj]) == DISJOINT; }),
+				                   cull.Objects.end());
+				cull.NoReceivers = static_cast<int>(inCascadeBox - cull.Objects.size());
+				//orthographic, the same texel size everywhere in the cascade
+				const BoundingBox& cascadeBox = _cascades[i].Aabb;
+				const float texelsPerUnit = _shadowMapResolution / (2.0f * (std::max)(cascadeBox.Extents.x, cascadeBox.Extents.y));
+				cull.SmallCasters = CullSmallCasters(cull.Objects, worldBounds, _minCascadeTexels,
+					[texelsPerUnit](const BoundingBox& bounds) { return ProjectedSize(bounds, texelsPerUnit); });
+			}
+		});
+
 		//render each cascade shadow map
 		for (UINT i = 0; i < gCascadesCount; i++)
 		{
 			CD3DX12_CPU_DESCRIPTOR_HANDLE tex(dsvAllocator->GetCpuHandle(_cascades[i].ShadowMapDsv));
 			cmdList->ClearDepthStencilView(tex, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-			//check frustum culling so we do not need to load gpu with unnecessary commands
-			std::vector<int> visibleObjects = FrustumCulling(objects, i);
+			const std::vector<int>& visibleObjects = culls[i].Objects;
+			_cascadeCasters.NoReceivers += culls[i].NoReceivers;
+			_smallCasters.Cascades += culls[i].SmallCasters;
+			_cascadeCasters.Drawn[i] = static_cast<int>(visibleObjects.size());
 			if (visibleObjects.empty())
 				continue;
 
@@ -422,7 +534,7 @@ void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameReso
 			cmdList->SetGraphicsRootConstantBufferView(
 				1, currFrameResource->ShadowDirLightCb->Resource()->GetGPUVirtualAddress() + i * _shadowCbSize);
 
-			ShadowPass(currFrameResource, cmdList, visibleObjects, objects);
+			ShadowPass(currFrameResource, cmdList, visibleObjects, objects, _casterVolumes[i]);
 		}
 		//changing state back to srv
 		const auto& barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(_cascadeShadowTextureArray.TextureArray.Get(),
@@ -431,11 +543,8 @@ void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameReso
 		cmdList->ResourceBarrier(1, &barrier2);
 	}
 
-	//the same for local lights
-	std::vector<int> visibleLights = _lightsContainingFrustum;
-	visibleLights.insert(visibleLights.end(), _lightsInsideFrustum.begin(), _lightsInsideFrustum.end());
-
-	if (visibleLights.empty())
+	//the same for local lights, the ones UpdateLightCBs found in the camera frustum
+	if (_lightsContainingFrustum.empty() && _lightsInsideFrustum.empty())
 		return;
 	
 	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(_localLightsShadowTextureArray.TextureArray.Get(),
@@ -445,20 +554,44 @@ void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameReso
 	cmdList->ResourceBarrier(1, &barrier);
 
 	const auto dsvAllocator = TextureManager::DsvHeapAllocator.get();
-	for (const auto& light : _localLights)
+	const float texelsAtOne = PixelsAtUnitDistance(0.25f * XM_PI, _shadowMapResolution);
+	//the bvh is only read, so every light culls on the job system and the maps are recorded in the usual order after
+	struct LightCull
 	{
-		if (!light->LightData.Active || light->LightData.Type == 0)
-			continue;
-
-		if (std::find(visibleLights.begin(), visibleLights.end(), light->LightIndex) == visibleLights.end())
-			continue;
+		size_t Light;
+		BoundingSphere Bounds;
+		std::vector<int> Objects;
+		int SmallCasters = 0;
+	};
+	std::vector<LightCull> culls;
+	_lightVisibility.ForEach([&](const size_t lightIdx)
+	{
+		const auto& light = _localLights[lightIdx];
+		if (light->LightData.Active && light->LightData.Type != 0)
+			culls.push_back({ lightIdx });
+	});
+	JobSystem::Shared().ParallelFor(0, culls.size(), 0, [&](const size_t first, const size_t last)
+	{
+		for (size_t c = first; c < last; c++)
+		{
+			LightCull& cull = culls[c];
+			const auto& light = _localLights[cull.Light];
+			light->Bounds.Transform(cull.Bounds, light->LightData.World);
+			cull.Objects = FrustumCulling(bvh, cull.Bounds);
+			//same lens as the light matrix in UpdateLightCBs
+			const XMVECTOR lightPos = XMLoadFloat3(&light->LightData.Position);
+			cull.SmallCasters = CullSmallCasters(cull.Objects, worldBounds, _minLocalLightTexels,
+				[lightPos, texelsAtOne](const BoundingBox& bounds) { return ProjectedSize(bounds, lightPos, texelsAtOne, 1.0f); });
+		}
+	});
 
-		BoundingSphere lightWorldAabb;
-		light->Bounds.Transform(lightWorldAabb, light->LightData.World);
-		std::vector<int> visibleObjects = FrustumCulling(objects, lightWorldAabb);
-		if (visibleObjects.empty())
+	for (const LightCull& cull : culls)
+	{
+		_smallCasters.LocalLights += cull.SmallCasters;
+		if (cull.Objects.empty())
 			continue;
 
+		const auto& light = _localLights[cull.Light];
 		CD3DX12_CPU_DESCRIPTOR_HANDLE tex(dsvAllocator->GetCpuHandle(light->ShadowMapDsv));
 		cmdList->OMSetRenderTargets(0, nullptr, false, &tex);
 		cmdList->ClearDepthStencilView(tex, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
@@ -468,8 +601,7 @@ void LightingManager::DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameReso
 			LightIndex * sizeof(ShadowLightConstants);
 		cmdList->SetGraphicsRootConstantBufferView(1, localLightCbAddress);
 
-		ShadowPass(currFrameResource, cmdList, visibleObjects, objects);
-
+		ShadowPass(currFrameResource, cmdList, cull.Objects, objects, cull.Bounds);
 	}
 	
 	barrier = CD3DX12_RESOURCE_BARRIER::Transition(_localLightsShadowTextureArray.TextureArray.Get(),
@@ -543,8 +675,7 @@ void LightingManager::AddShadowMask(const TextureHandle& handle)
 
 void LightingManager::DeleteShadowMask(const size_t i)
 {
-	const std::string texName = _shadowMasks[i].Name;
-	TextureManager::DeleteTexture(std::wstring(texName.begin(), texName.end()), 1);
+	TextureManager::DeleteTexture(_shadowMasks[i].Id, 1);
 	_shadowMasks.erase(_shadowMasks.begin() + i);
 	if (_selectedShadowMask >= _shadowMasks.size())
 	{
@@ -587,7 +718,7 @@ void LightingManager::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE skyTexTable;
 	skyTexTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 2);
 
-	constexpr int rootParameterCountCsm = 11;
+	constexpr int rootParameterCountCsm = 13;
 
 	CD3DX12_ROOT_PARAMETER lightingSlotRootParameterCsm[rootParameterCountCsm];
 
@@ -602,6 +733,8 @@ void LightingManager::BuildRootSignature()
 	lightingSlotRootParameterCsm[8].InitAsConstants(1, 2);
 	lightingSlotRootParameterCsm[9].InitAsDescriptorTable(1, &cascadesShadowTexTable, D3D12_SHADER_VISIBILITY_PIXEL);
 	lightingSlotRootParameterCsm[10].InitAsDescriptorTable(1, &shadowTexTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	lightingSlotRootParameterCsm[11].InitAsShaderResourceView(2, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+	lightingSlotRootParameterCsm[12].InitAsShaderResourceView(3, 1, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	CD3DX12_ROOT_SIGNATURE_DESC lightingRootSigDesc(rootParameterCountCsm, lightingSlotRootParameterCsm,
 	                                                static_cast<UINT>(TextureManager::GetLinearSamplers().size()),
@@ -633,7 +766,7 @@ void LightingManager::BuildRootSignature()
 		CD3DX12_DESCRIPTOR_RANGE rtShadowTexTable;
 		rtShadowTexTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, afterShadowMaskIndex);
         	
-        constexpr int rtRootParameterCount = 10;
+        constexpr int rtRootParameterCount = 12;
     
         CD3DX12_ROOT_PARAMETER lightingSlotRootParameterRt[rtRootParameterCount];
     
@@ -647,6 +780,8 @@ void LightingManager::BuildRootSignature()
 		lightingSlotRootParameterRt[7].InitAsDescriptorTable(1, &shadowMaskTexTable, D3D12_SHADER_VISIBILITY_PIXEL);
 		lightingSlotRootParameterRt[8].InitAsConstants(1, 2);
 		lightingSlotRootParameterRt[9].InitAsDescriptorTable(1, &rtShadowTexTable, D3D12_SHADER_VISIBILITY_PIXEL);
+		lightingSlotRootParameterRt[10].InitAsShaderResourceView(2, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+		lightingSlotRootParameterRt[11].InitAsShaderResourceView(3, 1, D3D12_SHADER_VISIBILITY_PIXEL);
     
         CD3DX12_ROOT_SIGNATURE_DESC lightingRootSigDescRt(rtRootParameterCount, lightingSlotRootParameterRt,
                                                         static_cast<UINT>(TextureManager::GetLinearSamplers().size()),
@@ -1035,50 +1170,55 @@ void LightingManager::DeleteShadowTexture(const int texDsv)
 	TextureManager::DsvHeapAllocator->Free(texDsv);
 }
 
-std::vector<int> LightingManager::FrustumCulling(const std::vector<std::shared_ptr<EditableRenderItem>>& objects, const int cascadeIdx) const
+CullingPlanes LightingManager::CascadePlanes(const int cascadeIdx) const
 {
-	const BoundingBox lightAabb = _cascades[cascadeIdx].Aabb;
-	std::vector<int> visibleObjects;
-
-	for (int i = 0; i < objects.size(); i++)
-	{
-		BoundingBox objectLsBounds;
-		BoundingBox objectWorldBounds;
-
-		objects[i]->Bounds.Transform(objectLsBounds, objects[i]->World * _cascades[cascadeIdx].LightView);
-		objects[i]->Bounds.Transform(objectWorldBounds, objects[i]->World);
-		float distance;
-		XMStoreFloat(&distance, XMVector3Length(XMLoadFloat3(&objectWorldBounds.Center) - _camera->GetPosition()));
-		if (lightAabb.Contains(objectLsBounds) != DirectX::DISJOINT)
-		{
-			visibleObjects.push_back(i);
-		}
-	}
+	//cascade box moved back to world space and tested as six planes against world space object boxes
+	BoundingOrientedBox cascadeWorldBox;
+	BoundingOrientedBox::CreateFromBoundingBox(cascadeWorldBox, _cascades[cascadeIdx].Aabb);
+	cascadeWorldBox.Transform(cascadeWorldBox, XMMatrixInverse(nullptr, _cascades[cascadeIdx].LightView));
 
-	return visibleObjects;
+	return CullingPlanes::FromOrientedBox(cascadeWorldBox);
 }
 
-std::vector<int> LightingManager::FrustumCulling(const std::vector<std::shared_ptr<EditableRenderItem>>& objects, const DirectX::BoundingSphere lightAabb)
+std::vector<int> LightingManager::FrustumCulling(const SceneBvh& bvh, const std::vector<BoundingBox>& worldBounds,
+                                                 const int cascadeIdx, const CullingPlanes& cascadePlanes)
 {
+	//comes back sorted, same as the local light path
 	std::vector<int> visibleObjects;
+	_cascadeCullCaches[cascadeIdx].Cull(bvh, worldBounds, cascadePlanes, bvh.Version(), visibleObjects);
 
-	for (int i = 0; i < objects.size(); i++)
-	{
-		BoundingBox worldBounds;
+	return visibleObjects;
+}
 
-		objects[i]->Bounds.Transform(worldBounds, objects[i]->World);
-		if (lightAabb.Contains(worldBounds) != DirectX::DISJOINT)
-		{
-			visibleObjects.push_back(i);
-		}
-	}
+std::vector<int> LightingManager::FrustumCulling(const SceneBvh& bvh, const DirectX::BoundingSphere lightAabb)
+{
+	//the bvh holds the same world boxes, so its result is already exact
+	std::vector<int> visibleObjects;
+	bvh.Query(lightAabb, visibleObjects);
+	std::sort(visibleObjects.begin(), visibleObjects.end());
 
 	return visibleObjects;
 }
 
+template <typename ProjectedSizeFn>
+int LightingManager::CullSmallCasters(std::vector<int>& visibleObjects, const std::vector<BoundingBox>& worldBounds,
+                                      const float minSize, ProjectedSizeFn projectedSize)
+{
+	if (minSize <= 0.0f)
+		return 0;
+
+	const size_t before = visibleObjects.size();
+	visibleObjects.erase(std::remove_if(visibleObjects.begin(), visibleObjects.end(),
+	                                    [&](const int i) { return projectedSize(worldBounds[i]) < minSize; }),
+	                     visibleObjects.end());
+	return static_cast<int>(before - visibleObjects.size());
+}
+
+template <typename Volume>
 void LightingManager::ShadowPass(FrameResource* currFrameResource, ID3D12GraphicsCommandList4* cmdList,
                                  const std::vector<int>& visibleObjects,
-                                 const std::vector<std::shared_ptr<EditableRenderItem>>& objects)
+                                 const std::vector<std::shared_ptr<EditableRenderItem>>& objects,
+                                 const Volume& volume)
 {
 	for (auto& idx : visibleObjects)
 	{
@@ -1086,16 +1226,20 @@ void LightingManager::ShadowPass(FrameResource* currFrameResource, ID3D12Graphic
 		const auto objectCb = currFrameResource->OpaqueObjCb[ri.Uid]->Resource();
 		const int curLodIdx = ri.CurrentLodIdx;
 
-		const MeshGeometry* curLodGeo = ri.Geo->at(curLodIdx).get();
+		const MeshGeometry* curLodGeo = GeometryManager::Geometry(ri.GeoId)[curLodIdx].get();
 		const auto& vertexBuffer = curLodGeo->VertexBufferView();
 		cmdList->IASetVertexBuffers(0, 1, &vertexBuffer);
 		const auto& indexBuffer = curLodGeo->IndexBufferView();
 		cmdList->IASetIndexBuffer(&indexBuffer);
 
 		auto currentLod = ri.LodsData[curLodIdx];
+		const bool cullSubmeshes = CullsSubmeshes(currentLod.Meshes.size());
 		for (size_t i = 0; i < currentLod.Meshes.size(); i++)
 		{
 			const auto& meshData = currentLod.Meshes.at(i);
+			if (cullSubmeshes && volume.Contains(MeshWorldBounds(meshData, ri)) == DISJOINT)
+				continue;
+
 			const D3D12_GPU_VIRTUAL_ADDRESS meshCbAddress = objectCb->GetGPUVirtualAddress() + meshData.CbOffset;
 			cmdList->SetGraphicsRootConstantBufferView(0, meshCbAddress);
 			cmdList->DrawIndexedInstanced(static_cast<UINT>(meshData.IndexCount), 1, static_cast<UINT>(meshData.IndexStart),
@@ -1104,6 +1248,55 @@ void LightingManager::ShadowPass(FrameResource* currFrameResource, ID3D12Graphic
 	}
 }
 
+void LightingManager::BuildLightClusters(const FrameResource* currFrameResource)
+{
+	_lightsClustered = false;
+	_clusterStats = ClusterStats();
+	if (!_clusteredLighting)
+		return;
+
+	const auto start = std::chrono::steady_clock::now();
+	_lightClusters.SetLens(_camera->GetFovY(), _camera->GetAspect(), _camera->GetNearZ(), _camera->GetFarZ());
+
+	//the clusters live in view space
+	const XMMATRIX view = _camera->GetView();
+	_clusterLights.clear();
+	_lightVisibility.ForEach([&](const size_t i)
+	{
+		const Light& data = _localLights[i]->LightData;
+		if (data.Active == 0)
+			return;
+
+		ClusterLight light;
+		XMStoreFloat3(&light.Position, XMVector3TransformCoord(XMLoadFloat3(&data.Position), view));
+		light.Radius = data.Radius;
+		const XMVECTOR direction = XMLoadFloat3(&data.Direction);
+		//a spot without a direction has no cone to test
+		light.Spot = data.Type == 1 && XMVectorGetX(XMVector3LengthSq(direction)) > 1e-6f;
+		if (light.Spot)
+			XMStoreFloat3(&light.Direction, XMVector3Normalize(XMVector3TransformNormal(direction, view)));
+		light.Angle = data.Angle;
+		light.Index = static_cast<uint32_t>(_localLights[i]->LightIndex);
+		_clusterLights.push_back(light);
+	});
+
+	_lightsClustered = _lightClusters.Assign(_clusterLights, gMaxClusterLightIndices);
+	if (_lightsClustered)
+	{
+		const auto& ranges = _lightClusters.Ranges();
+		for (size_t i = 0; i < ranges.size(); i++)
+			currFrameResource->LightClusterRanges->CopyData(static_cast<int>(i), ranges[i]);
+		const auto& indices = _lightClusters.Indices();
+		for (size_t i = 0; i < indices.size(); i++)
+			currFrameResource->LightClusterIndices->CopyData(static_cast<int>(i), indices[i]);
+	}
+
+	_clusterStats.Lights = static_cast<int>(_clusterLights.size());
+	_clusterStats.Indices = static_cast<int>(_lightClusters.Indices().size());
+	_clusterStats.Overflowed = !_lightsClustered;
+	_clusterStats.Milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 void LightingManager::SnapToTexel(DirectX::XMFLOAT3& minPt, DirectX::XMFLOAT3& maxPt) const
 {
 	const float worldUnitsPerTexelX = (maxPt.x - minPt.x) / static_cast<float>(_shadowMapResolution);
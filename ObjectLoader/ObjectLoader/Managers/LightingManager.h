@@ -4,6 +4,11 @@
 #include "../Helpers/FrameResource.h"
 #include "GeometryManager.h"
 #include "../Helpers/Camera.h"
+#include "../Helpers/SceneBvh.h"
+#include "../Helpers/CullCache.h"
+#include "../Helpers/ScreenSize.h"
+#include "../Helpers/LightClusters.h"
+#include "../Helpers/CasterVolume.h"
 #include "TextureManager.h"
 #include "CubeMapManager.h"
 #include "RayTracingManager.h"
@@ -15,6 +20,31 @@ struct ShadowTextureArray
 	int Srv = -1;
 };
 
+//shadow casters left out of the last DrawShadows for covering too few texels
+struct SmallCasterStats
+{
+	int Cascades = 0;
+	int LocalLights = 0;
+};
+
+//cascade casters of the last DrawShadows
+struct CascadeCasterStats
+{
+	int Drawn[gCascadesCount] = {};
+	//inside the cascade box but throwing no shadow on anything that samples the cascade
+	int NoReceivers = 0;
+};
+
+//what the last UpdateLightCBs sorted into the light clusters
+struct ClusterStats
+{
+	int Lights = 0;
+	int Indices = 0;
+	//the lists did not fit, the frame fell back to light volumes
+	bool Overflowed = false;
+	float Milliseconds = 0.0f;
+};
+
 struct LightRenderItem
 {
 	Light LightData;
@@ -46,7 +76,8 @@ public:
 	void DrawLocalLights(ID3D12GraphicsCommandList4* cmdList, const FrameResource* currFrameResource, bool rayTracingEnabled) const;
 	void DrawDebug(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource) const;
 	void DrawEmissive(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource) const;
-	void DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource, const std::vector<std::shared_ptr<EditableRenderItem>>& objects);
+	void DrawShadows(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource, const std::vector<std::shared_ptr<EditableRenderItem>>& objects,
+	                 const SceneBvh& bvh, const std::vector<DirectX::BoundingBox>& worldBounds);
 	void DrawIntoBackBuffer(ID3D12GraphicsCommandList4* cmdList, FrameResource* currFrameResource);
 
 	void Init();
@@ -89,6 +120,38 @@ public:
 		return static_cast<int>(_lightsInsideFrustum.size());
 	}
 
+	//casters whose bounding sphere covers fewer shadow map texels are not drawn into it, 0 draws everything
+	float* MinCascadeTexels()
+	{
+		return &_minCascadeTexels;
+	}
+
+	float* MinLocalLightTexels()
+	{
+		return &_minLocalLightTexels;
+	}
+
+	const SmallCasterStats& SmallCasters() const
+	{
+		return _smallCasters;
+	}
+
+	const CascadeCasterStats& CascadeCasters() const
+	{
+		return _cascadeCasters;
+	}
+
+	//local lights are shaded in the full screen pass from per cluster lists instead of as light volumes
+	bool* ClusteredLighting()
+	{
+		return &_clusteredLighting;
+	}
+
+	const ClusterStats& Clusters() const
+	{
+		return _clusterStats;
+	}
+
 	ID3DBlob* GetFullScreenVsWithSamplers() const;
 
 	ID3DBlob* GetFullScreenVs() const
@@ -132,7 +195,7 @@ public:
 	}
 	std::string ShadowMaskName(const size_t i) const
 	{
-		return _shadowMasks[i].Name;
+		return _shadowMasks[i].Name();
 	}
 	size_t SelectedShadowMask() const
 	{
@@ -149,6 +212,11 @@ private:
 
 	//shadow cascades for directional light
 	CascadeOnCpu _cascades[gCascadesCount];
+	//cascades only slide while the camera moves without turning
+	CullCache _cascadeCullCaches[gCascadesCount];
+	//the receivers each cascade is sampled for swept toward the light, clipped by the cascade box
+	CasterVolume _casterVolumes[gCascadesCount];
+	CascadeCasterStats _cascadeCasters;
 	ShadowTextureArray _cascadeShadowTextureArray;
 	ShadowTextureArray _localLightsShadowTextureArray;
 
@@ -216,10 +284,28 @@ private:
 	D3D12_RECT _shadowScissorRect{ 0, 0, 0, 0 };
 	float _shadowMapResolution{1028.f};
 	UINT _shadowCbSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ShadowLightConstants));
+	//a cascade texel spans more world than a screen pixel, so casters get a coarser cut than the camera
+	float _minCascadeTexels = 2.0f;
+	float _minLocalLightTexels = 2.0f;
+	SmallCasterStats _smallCasters;
 
 	//lights culling
 	std::vector<int> _lightsInsideFrustum{};
 	std::vector<int> _lightsContainingFrustum{};
+	//boxes around the light spheres, the tree is refit only after a light was moved, added or deleted
+	SceneBvh _lightBvh;
+	std::vector<DirectX::BoundingBox> _lightBounds;
+	mutable bool _lightBoundsDirty = true;
+	std::vector<int> _lightCandidates;
+	//bit per entry of _localLights touching the camera frustum
+	VisibilityMask _lightVisibility;
+	//froxels over the camera frustum with the visible lights sorted into them
+	LightClusters _lightClusters;
+	std::vector<ClusterLight> _clusterLights;
+	bool _clusteredLighting = true;
+	//the lists of this frame are uploaded, light volumes are skipped
+	bool _lightsClustered = false;
+	ClusterStats _clusterStats;
 
 	//middleware to backbuffer
 	RtvSrvTexture _middlewareTexture;
@@ -247,10 +333,21 @@ private:
 	//helpers
 	int CreateShadowTextureDsv(bool forCascade, int index) const;
 	static void DeleteShadowTexture(int texDsv);
-	std::vector<int> FrustumCulling(const std::vector<std::shared_ptr<EditableRenderItem>>& objects, int cascadeIdx) const;
-	static std::vector<int> FrustumCulling(const std::vector<std::shared_ptr<EditableRenderItem>>& objects, DirectX::BoundingSphere lightAabb);
+	CullingPlanes CascadePlanes(int cascadeIdx) const;
+	void BuildCasterVolumes(DirectX::FXMVECTOR lightDir);
+	std::vector<int> FrustumCulling(const SceneBvh& bvh, const std::vector<DirectX::BoundingBox>& worldBounds, int cascadeIdx,
+	                                const CullingPlanes& cascadePlanes);
+	static std::vector<int> FrustumCulling(const SceneBvh& bvh, DirectX::BoundingSphere lightAabb);
+	//drops objects whose projected size is below minSize, returns how many went
+	template <typename ProjectedSizeFn>
+	static int CullSmallCasters(std::vector<int>& visibleObjects, const std::vector<DirectX::BoundingBox>& worldBounds, float minSize,
+	                            ProjectedSizeFn projectedSize);
+	//submeshes of multi mesh objects are tested against the same volume as their objects
+	template <typename Volume>
 	static void ShadowPass(FrameResource* currFrameResource, ID3D12GraphicsCommandList4* cmdList,
-	                       const std::vector<int>& visibleObjects, const std::vector<std::shared_ptr<EditableRenderItem>>& objects);
+	                       const std::vector<int>& visibleObjects, const std::vector<std::shared_ptr<EditableRenderItem>>& objects,
+	                       const Volume& volume);
+	void BuildLightClusters(const FrameResource* currFrameResource);
 	void SnapToTexel(DirectX::XMFLOAT3& minPt, DirectX::XMFLOAT3& maxPt) const;
 	void CreateMiddlewareTexture();
 };
\ No newline at end of file
@@ -29,8 +29,9 @@ public:
 
 
 protected:
-	std::unordered_map<std::string, int> _objectCounters;
-	std::unordered_map<std::string, int> _objectLoaded;
+	//keyed by the interned object name
+	std::unordered_map<NameId, int> _objectCounters;
+	std::unordered_map<NameId, int> _objectLoaded;
 
 	std::uint32_t _uidCount;
 
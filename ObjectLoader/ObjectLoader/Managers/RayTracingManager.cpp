@@ -82,7 +82,7 @@ void RayTracingManager::BuildTlas()
             desc.Transform[2][3] = worldF._43;
         }
 
-        const auto& mesh = GeometryManager::Geometries()[ri->Name][ri->CurrentLodIdx];
+        const auto& mesh = GeometryManager::Geometry(ri->GeoId)[ri->CurrentLodIdx];
         desc.AccelerationStructure = mesh->Rt->Blas->GetGPUVirtualAddress();
 
         desc.InstanceID = ri->Uid;
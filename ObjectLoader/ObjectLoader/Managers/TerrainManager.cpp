@@ -1,6 +1,12 @@
 #include "TerrainManager.h"
+#include "UploadManager.h"
 #include "../../../Common/GBuffer.h"
 
+#include <DirectXTex.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
 TerrainManager::TerrainManager(ID3D12Device* device) : _visibleGrids(0)
 {
 	_device = device;
@@ -28,7 +34,6 @@ void TerrainManager::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* cur
 	if (_heightmapTexture.UseTexture == false)
 		return;
 
-	FrustumCulling(currFrameResource);
 	if (_visibleGrids == 0)
 		return;
 
@@ -45,14 +50,14 @@ void TerrainManager::Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* cur
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	cmdList->SetGraphicsRootConstantBufferView(5, currFrameResource->TerrainTexturesCb->Resource()->GetGPUVirtualAddress());
 
-	const auto& geo = GeometryManager::Geometries()["shapeGeo"].begin()->get();
+	const auto geo = GeometryManager::ShapeGeo();
 
 	const auto vertexBuffer = geo->VertexBufferView();
 	cmdList->IASetVertexBuffers(0, 1, &vertexBuffer);
 	const auto indexBuffer = geo->IndexBufferView();
 	cmdList->IASetIndexBuffer(&indexBuffer);
 
-	const SubmeshGeometry gridSubmesh = geo->DrawArgs["terrainGrid"];
+	const SubmeshGeometry& gridSubmesh = GeometryManager::ShapeSubmesh(Shape::TerrainGrid);
 	cmdList->DrawIndexedInstanced(gridSubmesh.IndexCount, _visibleGrids, gridSubmesh.StartIndexLocation, gridSubmesh.BaseVertexLocation, 0);
 }
 
@@ -63,10 +68,14 @@ void TerrainManager::BindToOtherData(Camera* camera)
 
 void TerrainManager::InitTerrain()
 {
-	const auto& texDesc = TextureManager::Textures()[std::wstring(_heightmapTexture.Name.begin(), _heightmapTexture.Name.end())]
-		->Resource->GetDesc();
+	const Texture* heightmap = TextureManager::GetTexture(_heightmapTexture.Id);
+	const auto& texDesc = heightmap->Resource->GetDesc();
 	if (texDesc.Width == _heightmapTextureWidth && texDesc.Height == _heightmapTextureHeight)
+	{
+		//same grids, the heights under them can still be new
+		LoadHeights(heightmap->Filename);
 		return;
+	}
 
 	_heightmapTextureWidth =static_cast<int>(texDesc.Width);
 	_heightmapTextureHeight = texDesc.Height;
@@ -86,6 +95,8 @@ void TerrainManager::InitTerrain()
 				(float)(yTexelStart - _heightmapTextureHeight * 0.5f), 8)));
 		}
 	}
+
+	LoadHeights(heightmap->Filename);
 }
 
 void TerrainManager::UpdateTerrainCb(const FrameResource* currFrameResource)
@@ -244,26 +255,55 @@ std::unique_ptr<GridQuadNode> TerrainManager::CreateQuadNode(const int xTexelSta
 		}
 	}
 
+	node->FootprintMin = { node->Aabb.Center.x - node->Aabb.Extents.x, node->Aabb.Center.z - node->Aabb.Extents.z };
+	node->FootprintMax = { node->Aabb.Center.x + node->Aabb.Extents.x, node->Aabb.Center.z + node->Aabb.Extents.z };
+	for (const auto& child : node->Children)
+	{
+		if (child == nullptr)
+			continue;
+		node->FootprintMin = { (std::min)(node->FootprintMin.x, child->FootprintMin.x), (std::min)(node->FootprintMin.y, child->FootprintMin.y) };
+		node->FootprintMax = { (std::max)(node->FootprintMax.x, child->FootprintMax.x), (std::max)(node->FootprintMax.y, child->FootprintMax.y) };
+	}
+
 	return std::move(node);
 }
 
-void TerrainManager::FrustumCulling(FrameResource* currFrameResource)
+void TerrainManager::CullGrids(FrameResource* currFrameResource)
 {
 	_visibleGrids = 0;
+	_occludedGrids = 0;
+	_horizon.Begin(_camera->GetView(), _camera->GetProj(), _camera->GetNearZ());
+	if (_heightmapTexture.UseTexture == false)
+		return;
 
 	const auto& viewToLocal = _camera->GetInvView();
 	BoundingFrustum localFrustum;
 	_camera->CameraFrustum().Transform(localFrustum, viewToLocal);
 
-	for (const auto& grid : _grids)
+	//rays from below come in through the open bottom of the tiles, nothing is solid for them
+	const XMFLOAT3 eye = _camera->GetPosition3F();
+	_horizonActive = _horizonCulling && eye.y >= 0.0f;
+
+	//nearer tiles have to be in the horizon before the ones behind them are tested
+	_gridOrder.clear();
+	for (size_t i = 0; i < _grids.size(); i++)
+	{
+		const BoundingBox& aabb = _grids[i]->Aabb;
+		const float distX = aabb.Center.x - eye.x;
+		const float distZ = aabb.Center.z - eye.z;
+		_gridOrder.emplace_back(distX * distX + distZ * distZ, static_cast<int>(i));
+	}
+	std::sort(_gridOrder.begin(), _gridOrder.end());
+
+	for (const auto& grid : _gridOrder)
 	{
-		CullQuad(grid.get(), localFrustum, currFrameResource);
+		CullQuad(_grids[grid.second].get(), localFrustum, currFrameResource);
 	}
 }
 
 void TerrainManager::CullQuad(GridQuadNode* grid, BoundingFrustum& localFrustum, FrameResource* currFrameResource)
 {
-	const ContainmentType ct = localFrustum.Contains(grid->Aabb);
+	const ContainmentType ct = localFrustum.Contains(NodeBounds(grid));
 	if (ct == CONTAINS)
 	{
 		AddQuadToVisible(grid, currFrameResource);
@@ -274,11 +314,11 @@ void TerrainManager::CullQuad(GridQuadNode* grid, BoundingFrustum& localFrustum,
 		{
 			AddQuadToVisible(grid, currFrameResource);
 		}
-		else
+		else if (!HiddenByHorizon(grid))
 		{
-			for (const auto& child : grid->Children)
+			for (const int i : ChildrenFrontToBack(grid))
 			{
-				CullQuad(child.get(), localFrustum, currFrameResource);
+				CullQuad(grid->Children[i].get(), localFrustum, currFrameResource);
 			}
 		}
 	}
@@ -286,9 +326,13 @@ void TerrainManager::CullQuad(GridQuadNode* grid, BoundingFrustum& localFrustum,
 
 void TerrainManager::AddQuadToVisible(GridQuadNode* grid, FrameResource* currFrameResource)
 {
+	if (HiddenByHorizon(grid))
+		return;
+
 	if (grid->Children[0] == nullptr)
 	{
 		currFrameResource->GridInfoCb->CopyData(_visibleGrids++, grid->Info);
+		AddOccluder(grid);
 		return;
 	}
 
@@ -304,13 +348,147 @@ void TerrainManager::AddQuadToVisible(GridQuadNode* grid, FrameResource* currFra
 	if (distSquare > lodDist)
 	{
 		currFrameResource->GridInfoCb->CopyData(_visibleGrids++, grid->Info);
+		AddOccluder(grid);
 		return;
 	}
 	else
 	{
+		for (const int i : ChildrenFrontToBack(grid))
+		{
+			AddQuadToVisible(grid->Children[i].get(), currFrameResource);
+		}
+	}
+}
+
+void TerrainManager::LoadHeights(const std::wstring& filename)
+{
+	//the texels the vertex shader loads, read once more on the cpu. grids keep the full range if that fails
+	_heights.clear();
+	_heightsWidth = 0;
+	_heightsHeight = 0;
+
+	DirectX::ScratchImage source;
+	DirectX::ScratchImage decompressed;
+	const DirectX::Image* top = nullptr;
+	if (UploadManager::LoadTextureSource(filename, TextureRole::Data, source))
+	{
+		top = source.GetImage(0, 0, 0);
+		if (DirectX::IsCompressed(top->format))
+		{
+			top = SUCCEEDED(DirectX::Decompress(*top, DXGI_FORMAT_UNKNOWN, decompressed)) ? decompressed.GetImage(0, 0, 0) : nullptr;
+		}
+	}
+
+	if (top != nullptr)
+	{
+		const int width = static_cast<int>(top->width);
+		std::vector<float> heights(top->width * top->height);
+		const HRESULT hr = DirectX::EvaluateImage(*top, [&](const XMVECTOR* pixels, const size_t count, const size_t y)
+			{
+				for (size_t x = 0; x < count; x++)
+				{
+					heights[y * width + x] = XMVectorGetX(pixels[x]);
+				}
+			});
+		if (SUCCEEDED(hr))
+		{
+			_heights = std::move(heights);
+			_heightsWidth = width;
+			_heightsHeight = static_cast<int>(top->height);
+		}
+	}
+
+	for (const auto& grid : _grids)
+	{
+		MeasureHeights(grid.get());
+	}
+}
+
+void TerrainManager::MeasureHeights(GridQuadNode* grid) const
+{
+	if (grid->Children[0] != nullptr)
+	{
+		//children cover the same texels, the parent only draws some of them
+		grid->MinHeight = FLT_MAX;
+		grid->MaxHeight = -FLT_MAX;
 		for (const auto& child : grid->Children)
 		{
-			AddQuadToVisible(child.get(), currFrameResource);
+			MeasureHeights(child.get());
+			grid->MinHeight = (std::min)(grid->MinHeight, child->MinHeight);
+			grid->MaxHeight = (std::max)(grid->MaxHeight, child->MaxHeight);
 		}
+		return;
+	}
+
+	if (_heights.empty())
+	{
+		grid->MinHeight = 0.0f;
+		grid->MaxHeight = 1.0f;
+		return;
+	}
+
+	//every texel of the range is a vertex, the ones past the map load as zero
+	grid->MinHeight = FLT_MAX;
+	grid->MaxHeight = -FLT_MAX;
+	const int span = (_gridSize - 1) * grid->Info.TexelStride;
+	for (int y = grid->Info.TexelYStart; y <= grid->Info.TexelYStart + span; y++)
+	{
+		for (int x = grid->Info.TexelXStart; x <= grid->Info.TexelXStart + span; x++)
+		{
+			const bool inside = x < _heightsWidth && y < _heightsHeight;
+			const float height = inside ? _heights[static_cast<size_t>(y) * _heightsWidth + x] : 0.0f;
+			grid->MinHeight = (std::min)(grid->MinHeight, height);
+			grid->MaxHeight = (std::max)(grid->MaxHeight, height);
+		}
+	}
+}
+
+BoundingBox TerrainManager::NodeBounds(const GridQuadNode* grid) const
+{
+	//skirts reach down to zero, the surface never rises above the highest texel under the node
+	const float top = (std::max)(grid->MaxHeight * MaxTerrainHeight, 0.0f);
+	const XMFLOAT3 center = { (grid->FootprintMin.x + grid->FootprintMax.x) * 0.5f, top * 0.5f,
+		(grid->FootprintMin.y + grid->FootprintMax.y) * 0.5f };
+	const XMFLOAT3 extents = { (grid->FootprintMax.x - grid->FootprintMin.x) * 0.5f, top * 0.5f,
+		(grid->FootprintMax.y - grid->FootprintMin.y) * 0.5f };
+	return BoundingBox(center, extents);
+}
+
+std::array<int, 4> TerrainManager::ChildrenFrontToBack(const GridQuadNode* grid) const
+{
+	const XMFLOAT3 eye = _camera->GetPosition3F();
+	float distances[4];
+	for (int i = 0; i < 4; i++)
+	{
+		const BoundingBox& aabb = grid->Children[i]->Aabb;
+		distances[i] = (aabb.Center.x - eye.x) * (aabb.Center.x - eye.x) + (aabb.Center.z - eye.z) * (aabb.Center.z - eye.z);
 	}
+
+	std::array<int, 4> order = { 0, 1, 2, 3 };
+	std::sort(order.begin(), order.end(), [&](const int a, const int b) { return distances[a] < distances[b]; });
+	return order;
+}
+
+bool TerrainManager::HiddenByHorizon(const GridQuadNode* grid)
+{
+	if (!_horizonActive || !_horizon.IsOccluded(NodeBounds(grid)))
+		return false;
+	_occludedGrids++;
+	return true;
+}
+
+void TerrainManager::AddOccluder(const GridQuadNode* grid)
+{
+	//a drawn tile is solid from the ground up to its lowest texel, seen from anywhere but under its surface
+	const float floor = grid->MinHeight * MaxTerrainHeight;
+	if (!_horizonActive || floor <= 0.0f)
+		return;
+
+	const XMFLOAT3 eye = _camera->GetPosition3F();
+	const BoundingBox& aabb = grid->Aabb;
+	const bool overTile = std::abs(eye.x - aabb.Center.x) <= aabb.Extents.x && std::abs(eye.z - aabb.Center.z) <= aabb.Extents.z;
+	if (overTile && eye.y < grid->MaxHeight * MaxTerrainHeight)
+		return;
+
+	_horizon.AddOccluder(BoundingBox({ aabb.Center.x, floor * 0.5f, aabb.Center.z }, { aabb.Extents.x, floor * 0.5f, aabb.Extents.z }));
 }
@@ -2,7 +2,9 @@
 #include "TextureManager.h"
 #include "../Helpers/FrameResource.h"
 #include "../Helpers/Camera.h"
+#include "../Helpers/TerrainHorizon.h"
 #include "GeometryManager.h"
+#include <array>
 
 enum class TerrainTexture : int8_t
 {
@@ -16,6 +18,12 @@ struct GridQuadNode
 {
 	DirectX::BoundingBox Aabb;
 	GridInfo Info;
+	//heightmap values under the node before MaxTerrainHeight scales them, the full range until they are read
+	float MinHeight = 0.0f;
+	float MaxHeight = 1.0f;
+	//xz reach of the node and everything under it, children are laid out slightly off their parent
+	DirectX::XMFLOAT2 FootprintMin = { 0.0f, 0.0f };
+	DirectX::XMFLOAT2 FootprintMax = { 0.0f, 0.0f };
 	std::unique_ptr<GridQuadNode> Children[4] = {nullptr};
 };
 
@@ -33,6 +41,8 @@ public:
 	void Init();
 	void BindToOtherData(Camera* camera);
 	void Draw(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrameResource);
+	//fills the frame's grid list and the horizon, runs before objects are culled against it
+	void CullGrids(FrameResource* currFrameResource);
 
 	void InitTerrain();
 	void UpdateTerrainCb(const FrameResource* currFrameResource);
@@ -55,6 +65,23 @@ public:
 	{
 		return _visibleGrids;
 	}
+
+	//tiles the last cull skipped as hidden behind nearer ones
+	int OccludedGrids() const
+	{
+		return _occludedGrids;
+	}
+
+	bool* HorizonCulling()
+	{
+		return &_horizonCulling;
+	}
+
+	//covered screen bands left by the last cull, empty while it is off
+	const TerrainHorizon& Horizon() const
+	{
+		return _horizon;
+	}
 	
 	MaterialProperty* TerrainTexture(int index);
 	
@@ -64,6 +91,7 @@ private:
 	std::vector<std::unique_ptr<GridQuadNode>> _grids;
 	TextureHandle _heightmapTexture;
 	int _visibleGrids;
+	int _occludedGrids = 0;
 	int _heightmapTextureWidth = 0;
 	int _heightmapTextureHeight = 0;
 	
@@ -83,6 +111,18 @@ private:
 	
 	int _numFramesDirty = gNumFrameResources;
 
+	//cpu copy of the heightmap the tiles are measured from, row major
+	std::vector<float> _heights;
+	int _heightsWidth = 0;
+	int _heightsHeight = 0;
+
+	TerrainHorizon _horizon;
+	bool _horizonCulling = true;
+	//off for this cull, also while the camera is under the terrain
+	bool _horizonActive = false;
+	//squared distance and index of every root grid, nearest first
+	std::vector<std::pair<float, int>> _gridOrder;
+
 private:
 	void BuildInputLayout();
 	void BuildRootSignature();
@@ -91,7 +131,15 @@ private:
 	
 	std::unique_ptr<GridQuadNode> CreateQuadNode(int xTexelStart, int yTexelStart, float worldOffsetX, float worldOffsetY, int stride);
 
-	void FrustumCulling(FrameResource* currFrameResource);
+	//reads the heightmap back and measures every grid against it
+	void LoadHeights(const std::wstring& filename);
+	void MeasureHeights(GridQuadNode* grid) const;
+	//world space box around everything the node and its children can draw
+	DirectX::BoundingBox NodeBounds(const GridQuadNode* grid) const;
+	std::array<int, 4> ChildrenFrontToBack(const GridQuadNode* grid) const;
+	bool HiddenByHorizon(const GridQuadNode* grid);
+	void AddOccluder(const GridQuadNode* grid);
+
 	void CullQuad(GridQuadNode* grid, BoundingFrustum& localFrustum, FrameResource* currFrameResource);
 	void AddQuadToVisible(GridQuadNode* grid, FrameResource* currFrameResource);
 };
\ No newline at end of file
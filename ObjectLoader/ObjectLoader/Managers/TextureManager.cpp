@@ -2,6 +2,37 @@
 
 #include "UploadManager.h"
 
+#include <DirectXTex.h>
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+	struct DecodedTexture
+	{
+		NameId Id;
+		std::uint32_t Generation;
+		std::wstring Filename;
+		//null when decoding failed
+		std::shared_ptr<DirectX::ScratchImage> Source;
+		//high quality encode replacing an earlier fast one
+		bool Refined;
+		HeightRange Heights;
+	};
+
+	std::mutex& DecodedMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	std::vector<DecodedTexture>& Decoded()
+	{
+		static std::vector<DecodedTexture> decoded;
+		return decoded;
+	}
+}
+
 std::unique_ptr<DescriptorHeapAllocator> TextureManager::SrvHeapAllocator = nullptr;
 Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> TextureManager::SrvDescriptorHeap = nullptr;
 std::unique_ptr<DescriptorHeapAllocator> TextureManager::RtvHeapAllocator = nullptr;
@@ -13,73 +44,147 @@ UINT TextureManager::_srvDescriptorSize = 0;
 UINT TextureManager::_rtvDescriptorSize = 0;
 UINT TextureManager::_dsvDescriptorSize = 0;
 
-std::unordered_map<std::wstring, std::unique_ptr<Texture>>& TextureManager::Textures()
+Texture* TextureManager::GetTexture(const NameId id)
 {
-	static std::unordered_map<std::wstring, std::unique_ptr<Texture>> textures;
-	return textures;
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	return IsLoaded(id) ? Records()[id].Tex.get() : nullptr;
 }
 
-TextureHandle TextureManager::LoadTexture(const WCHAR* filename, int prevIndex, int texCount)
+TextureHandle TextureManager::LoadTexture(const WCHAR* filename, const NameId prevId, int texCount, const TextureRole role, const bool streamed)
 {
-	std::wstring croppedName = BasicUtil::GetCroppedName(filename);
+	const NameId id = PathKey(filename);
+	//handles that already showed this texture are not counted again
+	const auto acquire = [id, prevId, texCount]()
+	{
+		return Slots().TryAcquire(id, prevId != id ? texCount : 0);
+	};
+	if (acquire())
+	{
+		return Handle(id);
+	}
 
-	if (Textures().find(croppedName) != Textures().end())
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	//loaded by another thread while this one waited
+	if (acquire())
 	{
-		if (TexIndices()[croppedName] != prevIndex)
-		{
-			TexUsed()[croppedName] += texCount;
-		}
-		return { BasicUtil::WStringToUtf8(croppedName), TexIndices()[croppedName], true };
+		return Handle(id);
 	}
+	std::wstring croppedName = BasicUtil::GetCroppedName(filename);
 
 	auto tex = std::make_unique<Texture>();
 	tex->Name = croppedName;
 	tex->Filename = filename;
 
-	if (!UploadManager::CreateTexture(tex.get()))
+	std::shared_ptr<DirectX::ScratchImage> source = nullptr;
+	int residentMip = 0;
+	HeightRange heights;
+	if (streamed)
+	{
+		//only the tail goes to the gpu now, finer mips come when something needs them
+		source = std::make_shared<DirectX::ScratchImage>();
+		if (!UploadManager::LoadTextureSource(tex->Filename, role, *source))
+		{
+			OutputDebugStringA(("Failed to load texture: " + BasicUtil::WStringToUtf8(tex->Filename) + "\n").c_str());
+			return { NameTable::Intern(BasicUtil::WStringToUtf8(croppedName)), 0, false, id };
+		}
+		if (role == TextureRole::Mask)
+		{
+			heights = MeasureHeights(*source);
+		}
+		residentMip = StreamingTailMip(*source);
+		UploadManager::UploadScratchImage(tex.get(), *source, residentMip);
+		if (residentMip == 0)
+		{
+			source.reset();
+		}
+	}
+	else if (!UploadManager::CreateTexture(tex.get(), role))
 	{
 		OutputDebugStringA(("Failed to load texture: " + BasicUtil::WStringToUtf8(tex->Filename) + "\n").c_str());
-		return { BasicUtil::WStringToUtf8(croppedName), 0, false };
+		return { NameTable::Intern(BasicUtil::WStringToUtf8(croppedName)), 0, false, id };
 	}
 
 	UINT index = SrvHeapAllocator.get()->Allocate();
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = SrvHeapAllocator.get()->GetCpuHandle(index);
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = tex.get()->Resource->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = tex.get()->Resource.Get()->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	_device->CreateShaderResourceView(tex.get()->Resource.Get(), &srvDesc, srvHandle);
+	CreateSrv(tex.get(), index);
 
 	UploadManager::ExecuteUploadCommandList();
 
-	Textures()[croppedName] = std::move(tex);
-	TexIndices()[croppedName] = index;
-	TexUsed()[croppedName] = texCount;
+	auto& record = Record(id);
+	record.Tex = std::move(tex);
+	record.Source = source;
+	record.Heights = heights;
+	Slots().Publish(id, TextureState::Loaded, texCount, index, NameTable::Intern(BasicUtil::WStringToUtf8(croppedName)));
 
-	return { BasicUtil::WStringToUtf8(croppedName), index, true };
+	if (source)
+	{
+		Streamer().Track(id, MipBytes(*source), residentMip, residentMip);
+	}
+
+	return Handle(id);
 }
 
 void TextureManager::LoadTexture(const WCHAR* filename, TextureHandle& texHandle)
 {
-	std::wstring croppedName = BasicUtil::GetCroppedName(filename);
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	const NameId previous = texHandle.Id;
+	const TextureHandle loaded = LoadTexture(filename, previous, 1);
+	if (!loaded.UseTexture)
+	{
+		//the slot keeps showing the previous texture, its reference goes with the next load
+		texHandle.UseTexture = false;
+		return;
+	}
+
+	texHandle.Label = loaded.Label;
+	texHandle.UseTexture = true;
+	if (loaded.Id == previous)
+	{
+		return;
+	}
+
+	Records()[loaded.Id].TableViews.push_back(texHandle.Index);
+	if (IsLoaded(previous))
+	{
+		//frames in flight read the previous texture through the slot until the swap
+		auto& views = Records()[previous].TableViews;
+		views.erase(std::remove(views.begin(), views.end(), texHandle.Index), views.end());
+		SwapView(texHandle.Index, ShownResource(loaded.Id), ShownResource(previous));
+		DeleteTexture(previous);
+	}
+	else
+	{
+		//nothing reads a slot that never showed a texture, and the frames recorded from now on run after the upload
+		CreateSrv(ShownResource(loaded.Id), texHandle.Index);
+	}
+	texHandle.Id = loaded.Id;
+}
+
+TextureHandle TextureManager::LoadEmbeddedTexture(const std::wstring& texName, const aiTexture* embeddedTex, const TextureRole role,
+	const std::wstring& modelFolder)
+{
+	const NameId id = NameTable::Intern(BasicUtil::WStringToUtf8(texName));
+	if (Slots().TryAcquire(id))
+	{
+		return Handle(id);
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	if (Slots().TryAcquire(id))
+	{
+		return Handle(id);
+	}
 
 	auto tex = std::make_unique<Texture>();
-	tex->Name = croppedName;
-	tex->Filename = filename;
+	tex->Name = texName;
 
-	if (!UploadManager::CreateTexture(tex.get()))
+	if (!UploadManager::CreateEmbeddedTexture(tex.get(), embeddedTex, role, modelFolder))
 	{
-		OutputDebugStringA(("Failed to load texture: " + BasicUtil::WStringToUtf8(tex->Filename) + "\n").c_str());
-		texHandle.UseTexture = false;
-		return;
+		OutputDebugStringW((L"Failed to load embedded texture: " + texName + L"\n").c_str());
+		return { NameTable::Intern(BasicUtil::WStringToUtf8(texName)), 0, false, id };
 	}
 
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = SrvHeapAllocator.get()->GetCpuHandle(texHandle.Index);
+	UINT index = SrvHeapAllocator.get()->Allocate();
+	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = SrvHeapAllocator.get()->GetCpuHandle(index);
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -93,57 +198,165 @@ void TextureManager::LoadTexture(const WCHAR* filename, TextureHandle& texHandle
 
 	UploadManager::ExecuteUploadCommandList();
 
-	Textures()[croppedName] = std::move(tex);
-	TexIndices()[croppedName] = texHandle.Index;
-	TexUsed()[croppedName] = 1;
+	Record(id).Tex = std::move(tex);
+	Slots().Publish(id, TextureState::Loaded, 1, index, id);
 
-	texHandle.Name = BasicUtil::WStringToUtf8(croppedName);
-	texHandle.UseTexture = true;
-	return;
+	return Handle(id);
 }
 
-TextureHandle TextureManager::LoadEmbeddedTexture(const std::wstring& texName, const aiTexture* embeddedTex)
+TextureHandle TextureManager::LoadTextureAsync(const WCHAR* filename, const TextureRole role, const TexturePlaceholder placeholder)
 {
-	auto tex = std::make_unique<Texture>();
-	tex->Name = texName;
+	const NameId id = PathKey(filename);
+	if (Slots().TryAcquire(id))
+	{
+		return Handle(id);
+	}
 
-	if (Textures().find(texName) != Textures().end())
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	if (Slots().TryAcquire(id))
 	{
-		TexUsed()[texName]++;
-		return { BasicUtil::WStringToUtf8(texName), TexIndices()[texName], true };
+		return Handle(id);
 	}
+	std::wstring croppedName = BasicUtil::GetCroppedName(filename);
 
-	UploadManager::CreateEmbeddedTexture(tex.get(), embeddedTex);
+	//a view of its own showing the placeholder, FinishPendingLoads rewrites it in place once the texture is uploaded
+	const UINT index = SrvHeapAllocator->Allocate();
+	CreateSrv(Records()[PlaceholderIds()[BasicUtil::EnumIndex(placeholder)]].Tex.get(), index);
 
-	UINT index = SrvHeapAllocator.get()->Allocate();
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = SrvHeapAllocator.get()->GetCpuHandle(index);
+	auto& record = Record(id);
+	record.Generation++;
+	record.Placeholder = PlaceholderIds()[BasicUtil::EnumIndex(placeholder)];
+	Slots().Publish(id, TextureState::Pending, 1, index, NameTable::Intern(BasicUtil::WStringToUtf8(croppedName)));
 
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = tex.get()->Resource->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = tex.get()->Resource.Get()->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	const std::uint32_t generation = record.Generation;
+	const std::wstring file = filename;
+	DecodePool().Submit([id, generation, file, role]()
+		{
+			//wic needs com on every thread that decodes
+			static thread_local const bool comReady = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+			(void)comReady;
+
+			//measured here so the main thread never walks the texels
+			const auto heightsOf = [role](const DirectX::ScratchImage& image)
+			{
+				return role == TextureRole::Mask ? MeasureHeights(image) : HeightRange();
+			};
+
+			const auto onRefined = [id, generation, file, heightsOf](std::shared_ptr<DirectX::ScratchImage> refined)
+			{
+				const HeightRange heights = heightsOf(*refined);
+				std::lock_guard<std::mutex> lock(DecodedMutex());
+				Decoded().push_back({ id, generation, file, refined, true, heights });
+			};
+
+			auto source = std::make_shared<DirectX::ScratchImage>();
+			HeightRange heights;
+			if (!UploadManager::LoadTextureSource(file, role, *source, onRefined))
+			{
+				source.reset();
+			}
+			else
+			{
+				heights = heightsOf(*source);
+			}
+
+			std::lock_guard<std::mutex> lock(DecodedMutex());
+			Decoded().push_back({ id, generation, file, source, false, heights });
+		});
+
+	return Handle(id);
+}
 
-	_device->CreateShaderResourceView(tex.get()->Resource.Get(), &srvDesc, srvHandle);
+void TextureManager::FinishPendingLoads()
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	std::vector<DecodedTexture> decoded;
+	{
+		std::lock_guard<std::mutex> lock(DecodedMutex());
+		decoded.swap(Decoded());
+	}
 
-	UploadManager::ExecuteUploadCommandList();
+	bool uploaded = false;
+	for (const auto& result : decoded)
+	{
+		//deleted or reloaded while the worker was busy
+		if (result.Id >= Records().size() || Records()[result.Id].Generation != result.Generation)
+		{
+			continue;
+		}
+
+		auto& record = Records()[result.Id];
+		if (result.Refined)
+		{
+			//a refinement that beat its own first decode is only kept in the cache
+			if (Slots().State(result.Id) != TextureState::Loaded || record.Tex == nullptr)
+			{
+				continue;
+			}
+
+			//frames in flight keep sampling the quick encode until the view is swapped
+			Microsoft::WRL::ComPtr<ID3D12Resource> previous = std::move(record.Tex->Resource);
+			Microsoft::WRL::ComPtr<ID3D12Resource> previousUpload = std::move(record.Tex->UploadHeap);
+			const int residentMip = Streamer().IsTracked(result.Id) ? Streamer().Resident(result.Id) : 0;
+			UploadManager::UploadScratchImage(record.Tex.get(), *result.Source, residentMip);
+			SwapViews(result.Id, record.Tex->Resource, previous, previousUpload);
+			if (record.Source)
+			{
+				record.Source = result.Source;
+			}
+			record.Heights = result.Heights;
+			uploaded = true;
+			continue;
+		}
+
+		if (Slots().State(result.Id) != TextureState::Pending)
+		{
+			continue;
+		}
+
+		if (result.Source == nullptr)
+		{
+			//stays on the placeholder, the slot is still released by DeleteTexture
+			OutputDebugStringA(("Failed to load texture: " + BasicUtil::WStringToUtf8(result.Filename) + "\n").c_str());
+			continue;
+		}
+
+		auto tex = std::make_unique<Texture>();
+		tex->Name = BasicUtil::GetCroppedName(result.Filename.c_str());
+		tex->Filename = result.Filename;
+
+		const int residentMip = StreamingTailMip(*result.Source);
+		UploadManager::UploadScratchImage(tex.get(), *result.Source, residentMip);
 
-	Textures()[texName] = std::move(tex);
-	TexIndices()[texName] = index;
-	TexUsed()[texName] = 1;
+		//the view reserved with the placeholder gets the texture, the placeholder's resource lives in its own record
+		SwapViews(result.Id, tex->Resource, nullptr);
+		record.Tex = std::move(tex);
+		record.Source = residentMip > 0 ? result.Source : nullptr;
+		record.Heights = result.Heights;
+		Slots().SetState(result.Id, TextureState::Loaded);
+		if (record.Source)
+		{
+			Streamer().Track(result.Id, MipBytes(*record.Source), residentMip, residentMip);
+		}
+		uploaded = true;
+	}
 
-	return  {  BasicUtil::WStringToUtf8(texName), index, true};
+	//the copies run before the next frame on the same queue, nothing has to wait for them
+	if (uploaded)
+	{
+		UploadManager::SubmitUploadCommandList();
+	}
 }
 
 bool TextureManager::LoadCubeTexture(const WCHAR* texturePath, TextureHandle& cubeMapHandle)
 {
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
 	std::wstring croppedName = BasicUtil::GetCroppedName(texturePath);
+	const NameId id = PathKey(texturePath);
 
-	if (Textures().find(croppedName) != Textures().end())
+	if (IsLoaded(id))
 	{
-		cubeMapHandle = { BasicUtil::WStringToUtf8(croppedName), TexIndices()[croppedName], true };
+		cubeMapHandle = Handle(id);
 		return true;
 	}
 
@@ -166,48 +379,296 @@ bool TextureManager::LoadCubeTexture(const WCHAR* texturePath, TextureHandle& cu
 	}
 
 	UINT index = SrvHeapAllocator.get()->Allocate();
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = SrvHeapAllocator.get()->GetCpuHandle(index);
+	CreateCubeSrv(tex.get(), index);
 
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = tex.get()->Resource->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.MipLevels = tex.get()->Resource->GetDesc().MipLevels;
-	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+	UploadManager::ExecuteUploadCommandList();
 
-	_device->CreateShaderResourceView(tex.get()->Resource.Get(), &srvDesc, srvHandle);
+	Record(id).Tex = std::move(tex);
+	Slots().Publish(id, TextureState::Loaded, 1, index, NameTable::Intern(BasicUtil::WStringToUtf8(croppedName)));
+
+	cubeMapHandle = Handle(id);
+
+	return true;
+}
 
+bool TextureManager::ReplaceCubeTexture(const WCHAR* texturePath, TextureHandle& cubeMapHandle)
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	std::wstring croppedName = BasicUtil::GetCroppedName(texturePath);
+	const NameId id = PathKey(texturePath);
+
+	auto tex = std::make_unique<Texture>();
+	tex->Name = croppedName;
+	tex->Filename = texturePath;
+
+	if (!UploadManager::CreateTexture(tex.get()))
+	{
+		OutputDebugStringA(("Failed to load texture: " + BasicUtil::WStringToUtf8(tex->Filename) + "\n").c_str());
+		return false;
+	}
+
+	//also waits for the frames still sampling the old map
 	UploadManager::ExecuteUploadCommandList();
 
-	Textures()[croppedName] = std::move(tex);
-	TexIndices()[croppedName] = index;
-	TexUsed()[croppedName] = 1;
+	D3D12_RESOURCE_DESC texDesc = tex->Resource->GetDesc();
+	if (texDesc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || texDesc.DepthOrArraySize != 6)
+	{
+		return false;
+	}
+
+	//already living in another slot
+	const NameId oldId = cubeMapHandle.Id;
+	if (id != oldId && IsLoaded(id))
+	{
+		return false;
+	}
+
+	//the old map gives up its resource but not its slot
+	if (IsLoaded(oldId) && Slots().SrvIndex(oldId) == cubeMapHandle.Index)
+	{
+		auto& oldRecord = Records()[oldId];
+		const std::uint32_t generation = oldRecord.Generation;
+		oldRecord = {};
+		oldRecord.Generation = generation;
+		Slots().Clear(oldId);
+	}
+
+	CreateCubeSrv(tex.get(), cubeMapHandle.Index);
 
-	cubeMapHandle = { BasicUtil::WStringToUtf8(croppedName), index, true };
+	Record(id).Tex = std::move(tex);
+	Slots().Publish(id, TextureState::Loaded, 1, cubeMapHandle.Index, NameTable::Intern(BasicUtil::WStringToUtf8(croppedName)));
 
+	cubeMapHandle = Handle(id);
 	return true;
 }
 
-void TextureManager::DeleteTexture(const std::wstring& name, const int texCount)
+void TextureManager::ReserveCubeSlot(TextureHandle& cubeMapHandle)
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	cubeMapHandle.Index = SrvHeapAllocator->Allocate();
+	cubeMapHandle.UseTexture = false;
+	cubeMapHandle.Id = gInvalidNameId;
+	CreateCubeSrv(nullptr, cubeMapHandle.Index);
+}
+
+void TextureManager::DeleteTexture(const NameId id, const int texCount)
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	if (!IsLoaded(id))
+	{
+		return;
+	}
+
+	//acquires racing with the last release fail and wait for this lock, they find the slot empty
+	if (Slots().Release(id, texCount))
+	{
+		auto& record = Records()[id];
+		RetireView(record.Tex.get(), Slots().SrvIndex(id));
+		record.Tex.reset();
+		Streamer().Untrack(id);
+		const std::uint32_t generation = record.Generation;
+		record = {};
+		record.Generation = generation;
+		Slots().Clear(id);
+	}
+}
+
+HeightRange TextureManager::Heights(const NameId id)
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	return id < Records().size() ? Records()[id].Heights : HeightRange();
+}
+
+void TextureManager::RequestMip(TextureHandle& handle, const float uvPerPixel)
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	const NameId id = handle.Id;
+	if (!IsLoaded(id))
+	{
+		return;
+	}
+
+	handle.Index = Slots().SrvIndex(id);
+	if (!Streamer().IsTracked(id))
+	{
+		return;
+	}
+
+	const DirectX::TexMetadata& metadata = Records()[id].Source->GetMetadata();
+	const int mipCount = static_cast<int>(metadata.mipLevels);
+	const int mip = MipStreamer::MipForFootprint(uvPerPixel, (std::max)(metadata.width, metadata.height), mipCount);
+	Streamer().Request(id, mip);
+}
+
+void TextureManager::UpdateStreaming(const int maxChanges)
+{
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+	const auto changes = Streamer().Schedule(maxChanges);
+	if (changes.empty())
+	{
+		return;
+	}
+
+	for (const auto& change : changes)
+	{
+		if (!IsLoaded(change.Id) || Records()[change.Id].Source == nullptr)
+		{
+			continue;
+		}
+
+		//frames in flight still read the old resource through the view, it is swapped instead of waiting for the gpu
+		auto& record = Records()[change.Id];
+		Microsoft::WRL::ComPtr<ID3D12Resource> previous = std::move(record.Tex->Resource);
+		Microsoft::WRL::ComPtr<ID3D12Resource> previousUpload = std::move(record.Tex->UploadHeap);
+		UploadManager::UploadScratchImage(record.Tex.get(), *record.Source, change.TargetMip);
+		SwapViews(change.Id, record.Tex->Resource, previous, previousUpload);
+		Streamer().SetResident(change.Id, change.TargetMip);
+	}
+
+	UploadManager::SubmitUploadCommandList();
+}
+
+AtlasStats TextureManager::PackAtlases(const std::vector<TextureHandle*>& handles, const AtlasSettings& settings)
 {
-	TexUsed()[name] -= texCount;
-	if (TexUsed()[name] == 0)
+	std::lock_guard<std::recursive_mutex> lock(RegistryMutex());
+
+	//one entry per texture, every handle showing it moves along
+	std::vector<NameId> ids;
+	std::vector<AtlasEntry> entries;
+	std::vector<std::vector<TextureHandle*>> users;
+	std::unordered_map<NameId, size_t> entryOf;
+	for (TextureHandle* handle : handles)
+	{
+		const NameId id = handle->Id;
+		if (!handle->UseTexture || !IsLoaded(id) || Streamer().IsTracked(id) || Records()[id].Atlas || Records()[id].Tex == nullptr)
+		{
+			continue;
+		}
+		const auto found = entryOf.find(id);
+		if (found != entryOf.end())
+		{
+			users[found->second].push_back(handle);
+			continue;
+		}
+
+		const D3D12_RESOURCE_DESC desc = Records()[id].Tex->Resource->GetDesc();
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || desc.DepthOrArraySize != 1)
+		{
+			continue;
+		}
+		entryOf[id] = entries.size();
+		ids.push_back(id);
+		users.push_back({ handle });
+		entries.push_back({ static_cast<int>(desc.Width), static_cast<int>(desc.Height), desc.MipLevels,
+			static_cast<std::uint32_t>(desc.Format), DirectX::IsCompressed(desc.Format) ? 4 : 1 });
+	}
+
+	const AtlasLayout layout = AtlasPacker::Pack(entries, settings);
+	AtlasStats stats;
+	if (layout.Pages.empty())
+	{
+		return stats;
+	}
+
+	static int pagesCreated = 0;
+	std::vector<NameId> pageIds;
+	for (size_t page = 0; page < layout.Pages.size(); page++)
+	{
+		const AtlasPage& atlasPage = layout.Pages[page];
+		std::vector<UploadManager::AtlasCopy> copies;
+		int handleCount = 0;
+		int gutter = 0;
+		HeightRange heights = { 1.0f, 0.0f };
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const AtlasPlacement& placement = layout.Placements[i];
+			if (placement.Page != static_cast<int>(page))
+			{
+				continue;
+			}
+			const TextureRecord& record = Records()[ids[i]];
+			copies.push_back({ record.Tex->Resource.Get(), static_cast<UINT>(placement.X), static_cast<UINT>(placement.Y) });
+			handleCount += static_cast<int>(users[i].size());
+			gutter = AtlasPacker::Alignment(entries[i], settings);
+			heights.Min = (std::min)(heights.Min, record.Heights.Min);
+			heights.Max = (std::max)(heights.Max, record.Heights.Max);
+		}
+
+		auto tex = std::make_unique<Texture>();
+		tex->Name = L"atlas_" + std::to_wstring(pagesCreated++);
+		UploadManager::CreateAtlas(tex.get(), static_cast<DXGI_FORMAT>(atlasPage.Group), atlasPage.Width, atlasPage.Height,
+			settings.MipCount, gutter, copies);
+		const UINT index = SrvHeapAllocator->Allocate();
+		CreateSrv(tex.get(), index);
+
+		const NameId id = NameTable::Intern(BasicUtil::WStringToUtf8(tex->Name));
+		auto& record = Record(id);
+		record.Tex = std::move(tex);
+		record.Heights = heights;
+		record.Atlas = true;
+		Slots().Publish(id, TextureState::Loaded, handleCount, index, id);
+		pageIds.push_back(id);
+		stats.Pages++;
+	}
+
+	//the copies are queued ahead of the frames that retire the sources below
+	UploadManager::SubmitUploadCommandList();
+
+	for (size_t i = 0; i < entries.size(); i++)
 	{
-		UploadManager::Flush();
-		Textures()[name].release();
-		Textures().erase(name);
-		TexUsed().erase(name);
-		SrvHeapAllocator->Free(TexIndices()[name]);
-		TexIndices().erase(name);
+		const AtlasPlacement& placement = layout.Placements[i];
+		if (placement.Page < 0)
+		{
+			continue;
+		}
+
+		const AtlasUvRect rect = AtlasPacker::UvRect(entries[i], placement, layout.Pages[placement.Page]);
+		for (TextureHandle* handle : users[i])
+		{
+			handle->Id = pageIds[placement.Page];
+			handle->Index = Slots().SrvIndex(handle->Id);
+			handle->UvRect = { rect.ScaleU, rect.ScaleV, rect.OffsetU, rect.OffsetV };
+		}
+		//the references moved to the page, the texture goes once no other handle shows it
+		DeleteTexture(ids[i], static_cast<int>(users[i].size()));
+		stats.Textures++;
 	}
+	return stats;
+}
+
+void TextureManager::SetStreamingBudget(const std::uint64_t bytes)
+{
+	Streamer().BudgetBytes = bytes;
+}
+
+std::uint64_t TextureManager::StreamingBudget()
+{
+	return Streamer().BudgetBytes;
+}
+
+std::uint64_t TextureManager::StreamedBytes()
+{
+	return Streamer().ResidentBytes();
 }
 
 void TextureManager::Init(ID3D12Device* device)
 {
 	_device = device;
 
+	//streamed textures get half of what the os grants the process in local video memory
+	Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> adapter;
+	DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo = {};
+	if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) &&
+		SUCCEEDED(factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(&adapter))) &&
+		SUCCEEDED(adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo)))
+	{
+		SetStreamingBudget(memoryInfo.Budget / 2);
+	}
+
 	//Create the SRV heap.
+	//a texture keeps one view for its whole life, async loads, refinements and streaming rewrite it in place.
+	//a deleted texture's view comes back once the frames in flight are done with it
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
 	srvHeapDesc.NumDescriptors = 100;
 
@@ -233,6 +694,7 @@ void TextureManager::Init(ID3D12Device* device)
 	DsvHeapAllocator = std::make_unique<DescriptorHeapAllocator>(DsvDescriptorHeap.Get(), _dsvDescriptorSize, dsvHeapDesc.NumDescriptors);
 
 	LoadTexture();
+	CreatePlaceholders();
 }
 
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 8> TextureManager::GetStaticSamplers()
@@ -354,14 +816,254 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 1> TextureManager::GetLinearWrapSa
 	return { linearWrap };
 }
 
-std::unordered_map<std::wstring, UINT>& TextureManager::TexIndices()
+std::vector<TextureRecord>& TextureManager::Records()
+{
+	static std::vector<TextureRecord> records;
+	return records;
+}
+
+TextureRecord& TextureManager::Record(const NameId id)
+{
+	if (id >= Records().size())
+	{
+		Records().resize(static_cast<size_t>(id) + 1);
+	}
+	return Records()[id];
+}
+
+bool TextureManager::IsLoaded(const NameId id)
+{
+	return Slots().IsLoaded(id);
+}
+
+TextureHandle TextureManager::Handle(const NameId id)
+{
+	return { Slots().Label(id), Slots().SrvIndex(id), true, id };
+}
+
+NameId TextureManager::PathKey(const WCHAR* filename)
+{
+	return NameTable::Intern(BasicUtil::WStringToUtf8(BasicUtil::CanonicalPath(filename)));
+}
+
+std::recursive_mutex& TextureManager::RegistryMutex()
+{
+	static std::recursive_mutex mutex;
+	return mutex;
+}
+
+TextureSlots& TextureManager::Slots()
+{
+	static TextureSlots slots;
+	return slots;
+}
+
+MipStreamer& TextureManager::Streamer()
+{
+	static MipStreamer streamer;
+	return streamer;
+}
+
+void TextureManager::ShutdownWorkers()
+{
+	DecodePool().DropPending();
+	DecodePool().Shutdown();
+}
+
+WorkerPool& TextureManager::DecodePool()
+{
+	//results outlive the pool, shut down in ShutdownWorkers before anything else goes
+	Decoded();
+	static WorkerPool pool;
+	return pool;
+}
+
+std::array<NameId, BasicUtil::EnumIndex(TexturePlaceholder::Count)>& TextureManager::PlaceholderIds()
+{
+	static std::array<NameId, BasicUtil::EnumIndex(TexturePlaceholder::Count)> ids;
+	return ids;
+}
+
+void TextureManager::CreatePlaceholders()
+{
+	struct PlaceholderDesc
+	{
+		const WCHAR* Name;
+		uint8_t Color[4];
+	};
+	const std::array<PlaceholderDesc, BasicUtil::EnumIndex(TexturePlaceholder::Count)> descs = { {
+		{ L"placeholder_grey", { 128, 128, 128, 255 } },
+		{ L"placeholder_white", { 255, 255, 255, 255 } },
+		{ L"placeholder_black", { 0, 0, 0, 255 } },
+		{ L"placeholder_normal", { 128, 128, 255, 255 } },
+		{ L"placeholder_orm", { 255, 128, 0, 255 } },
+	} };
+
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		DirectX::ScratchImage image;
+		ThrowIfFailed(image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, 1));
+		uint8_t* pixels = image.GetPixels();
+		for (size_t p = 0; p < image.GetPixelsSize(); p += 4)
+		{
+			memcpy(pixels + p, descs[i].Color, 4);
+		}
+
+		const NameId id = NameTable::Intern(BasicUtil::WStringToUtf8(descs[i].Name));
+		auto tex = std::make_unique<Texture>();
+		tex->Name = descs[i].Name;
+		UploadManager::UploadScratchImage(tex.get(), image);
+
+		const UINT index = SrvHeapAllocator->Allocate();
+		CreateSrv(tex.get(), index);
+		Record(id).Tex = std::move(tex);
+		Slots().Publish(id, TextureState::Loaded, 1, index, id);
+		PlaceholderIds()[i] = id;
+	}
+
+	UploadManager::ExecuteUploadCommandList();
+}
+
+void TextureManager::RetireView(Texture* tex, const UINT srvIndex)
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D12Resource> uploadHeap;
+	if (tex != nullptr)
+	{
+		resource = std::move(tex->Resource);
+		uploadHeap = std::move(tex->UploadHeap);
+	}
+
+	//the captured references are the last ones, they go when the release does
+	UploadManager::Retire([resource, uploadHeap, srvIndex]()
+		{
+			SrvHeapAllocator->Free(srvIndex);
+		});
+}
+
+void TextureManager::SwapView(const UINT srvIndex, Microsoft::WRL::ComPtr<ID3D12Resource> next, Microsoft::WRL::ComPtr<ID3D12Resource> previous,
+	Microsoft::WRL::ComPtr<ID3D12Resource> previousUpload)
+{
+	//retired views are freed after this runs, so the index still belongs to the texture here
+	UploadManager::Retire([srvIndex, next, previous, previousUpload]()
+		{
+			CreateSrv(next.Get(), srvIndex);
+			UploadManager::Retire([previous, previousUpload]() {});
+		});
+}
+
+void TextureManager::SwapViews(const NameId id, Microsoft::WRL::ComPtr<ID3D12Resource> next, Microsoft::WRL::ComPtr<ID3D12Resource> previous,
+	Microsoft::WRL::ComPtr<ID3D12Resource> previousUpload)
+{
+	SwapView(Slots().SrvIndex(id), next, previous, previousUpload);
+	for (const UINT index : Records()[id].TableViews)
+	{
+		SwapView(index, next, previous);
+	}
+}
+
+ID3D12Resource* TextureManager::ShownResource(const NameId id)
+{
+	const TextureRecord& record = Records()[id];
+	return record.Tex ? record.Tex->Resource.Get() : Records()[record.Placeholder].Tex->Resource.Get();
+}
+
+void TextureManager::CreateSrv(Texture* tex, const UINT index)
 {
-	static std::unordered_map<std::wstring, UINT> texIndices;
-	return texIndices;
+	CreateSrv(tex->Resource.Get(), index);
 }
 
-std::unordered_map<std::wstring, int>& TextureManager::TexUsed()
+void TextureManager::CreateSrv(ID3D12Resource* resource, const UINT index)
 {
-	static std::unordered_map<std::wstring, int> texUsed;
-	return texUsed;
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = resource->GetDesc().Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = resource->GetDesc().MipLevels;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+	_device->CreateShaderResourceView(resource, &srvDesc, SrvHeapAllocator->GetCpuHandle(index));
+}
+
+void TextureManager::CreateCubeSrv(Texture* tex, const UINT index)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	//a null view needs some format, black is read through it
+	srvDesc.Format = tex ? tex->Resource->GetDesc().Format : DXGI_FORMAT_R16G16B16A16_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	srvDesc.TextureCube.MipLevels = tex ? tex->Resource->GetDesc().MipLevels : 1;
+	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+
+	_device->CreateShaderResourceView(tex ? tex->Resource.Get() : nullptr, &srvDesc, SrvHeapAllocator->GetCpuHandle(index));
+}
+
+std::vector<std::uint64_t> TextureManager::MipBytes(const DirectX::ScratchImage& source)
+{
+	std::vector<std::uint64_t> bytes(source.GetMetadata().mipLevels);
+	for (size_t mip = 0; mip < bytes.size(); mip++)
+	{
+		bytes[mip] = source.GetImage(mip, 0, 0)->slicePitch;
+	}
+	return bytes;
+}
+
+int TextureManager::StreamingTailMip(const DirectX::ScratchImage& source)
+{
+	const DirectX::TexMetadata& metadata = source.GetMetadata();
+	if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || metadata.arraySize != 1 || metadata.IsCubemap())
+	{
+		return 0;
+	}
+
+	const int mipCount = static_cast<int>(metadata.mipLevels);
+	int tailMip = MipStreamer::TailMip(metadata.width, metadata.height, mipCount);
+
+	//block compressed resources need a top mip made of whole blocks
+	if (DirectX::IsCompressed(metadata.format))
+	{
+		int alignedMip = 0;
+		while (alignedMip + 1 <= tailMip)
+		{
+			const DirectX::Image* image = source.GetImage(alignedMip + 1, 0, 0);
+			if (image->width % 4 != 0 || image->height % 4 != 0)
+				break;
+			alignedMip++;
+		}
+		tailMip = alignedMip;
+	}
+	return tailMip;
+}
+
+HeightRange TextureManager::MeasureHeights(const DirectX::ScratchImage& source)
+{
+	//the top mip bounds the rest, filtered mips only average its texels
+	const DirectX::Image* top = source.GetImage(0, 0, 0);
+	DirectX::ScratchImage decompressed;
+	if (DirectX::IsCompressed(top->format))
+	{
+		if (FAILED(DirectX::Decompress(*top, DXGI_FORMAT_UNKNOWN, decompressed)))
+		{
+			return {};
+		}
+		top = decompressed.GetImage(0, 0, 0);
+	}
+
+	DirectX::XMVECTOR minValue = DirectX::g_XMFltMax;
+	DirectX::XMVECTOR maxValue = DirectX::XMVectorNegate(DirectX::g_XMFltMax);
+	const HRESULT hr = DirectX::EvaluateImage(*top, [&](const DirectX::XMVECTOR* pixels, const size_t width, size_t)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				minValue = DirectX::XMVectorMin(minValue, pixels[x]);
+				maxValue = DirectX::XMVectorMax(maxValue, pixels[x]);
+			}
+		});
+	if (FAILED(hr))
+	{
+		return {};
+	}
+	return { DirectX::XMVectorGetX(minValue), DirectX::XMVectorGetX(maxValue) };
 }
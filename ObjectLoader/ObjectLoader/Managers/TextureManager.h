@@ -3,7 +3,18 @@
 #include "unordered_map"
 #include "../../../Common/d3dUtil.h"
 #include "../Helpers/DescriptorHeapAllocator.h"
+#include "../Helpers/AtlasPacker.h"
+#include "../Helpers/NameTable.h"
+#include "../Helpers/MipStreamer.h"
+#include "../Helpers/TextureSlots.h"
+#include "../Helpers/WorkerPool.h"
 #include <assimp/scene.h>
+#include <mutex>
+
+namespace DirectX
+{
+	class ScratchImage;
+}
 
 struct RtvSrvTexture
 {
@@ -18,16 +29,73 @@ struct RtvSrvTexture
 	}
 };
 
+//texture slot addressed by the interned canonical path (or embedded name).
+//only touched while holding the registry mutex, the reference count, load state, view and
+//ui name live in TextureSlots where they can be read without it
+struct TextureRecord
+{
+	std::unique_ptr<Texture> Tex = nullptr;
+	//full mip chain in cpu memory, only kept for streamed textures
+	std::shared_ptr<DirectX::ScratchImage> Source = nullptr;
+	//bumped on every load so late decodes of a deleted texture are dropped
+	std::uint32_t Generation = 0;
+	//red channel range of mask textures, grows displaced bounds
+	HeightRange Heights;
+	//page shared by small textures, never packed again
+	bool Atlas = false;
+	//placeholder the view shows until an async decode lands
+	NameId Placeholder = gInvalidNameId;
+	//slots handles own in descriptor tables, they show the texture as well and follow its view
+	std::vector<UINT> TableViews;
+};
+
+struct AtlasStats
+{
+	int Textures = 0;
+	int Pages = 0;
+};
+
 class TextureManager
 {
 public:
-	static std::unordered_map<std::wstring, std::unique_ptr<Texture>>& Textures();
+	static Texture* GetTexture(NameId id);
 
-	static TextureHandle LoadTexture(const WCHAR* filename = L"default.dds", int prevIndex = 0, int texCount = 1);
+	//prevId is the texture the caller's handles showed so far, picking the same one again adds no references
+	static TextureHandle LoadTexture(const WCHAR* filename = L"default.dds", NameId prevId = gInvalidNameId, int texCount = 1,
+		TextureRole role = TextureRole::Data, bool streamed = false);
+	//shared like the one above, the slot the handle already owns shows it too, for descriptor tables that expect maps side by side.
+	//the texture the handle showed before is released
 	static void LoadTexture(const WCHAR* filename, TextureHandle& texHandle);
-	static TextureHandle LoadEmbeddedTexture(const std::wstring& texName, const aiTexture* embeddedTex);
+	//modelFolder is where the cooked copy is cached
+	static TextureHandle LoadEmbeddedTexture(const std::wstring& texName, const aiTexture* embeddedTex, TextureRole role = TextureRole::Data,
+		const std::wstring& modelFolder = L"");
+	//decodes on a worker thread, the handle shows the placeholder until FinishPendingLoads swaps the view
+	static TextureHandle LoadTextureAsync(const WCHAR* filename, TextureRole role, TexturePlaceholder placeholder);
+	static void FinishPendingLoads();
 	static bool LoadCubeTexture(const WCHAR* texturePath, TextureHandle& cubeMapHandle);
-	static void DeleteTexture(const std::wstring& name, int texCount = 1);
+	//loads into the slot the handle already owns, for descriptor tables that expect maps side by side
+	static bool ReplaceCubeTexture(const WCHAR* texturePath, TextureHandle& cubeMapHandle);
+	//takes a slot holding a null cube view, so a missing map still leaves its place in the table
+	static void ReserveCubeSlot(TextureHandle& cubeMapHandle);
+	static void DeleteTexture(NameId id, int texCount = 1);
+	//range a displacement map was measured to cover, the full unorm range until its decode lands
+	static HeightRange Heights(NameId id);
+
+	//mip streaming: draw code reports how many uv units a pixel covers, textures get reallocated once per frame.
+	//a texture keeps its view while it is reallocated, the handle is still pointed at the view its texture has now
+	static void RequestMip(TextureHandle& handle, float uvPerPixel);
+	static void UpdateStreaming(int maxChanges = 2);
+	//least recently drawn textures fall back to their tail mips above this, 0 means unlimited
+	static void SetStreamingBudget(std::uint64_t bytes);
+	static std::uint64_t StreamingBudget();
+	static std::uint64_t StreamedBytes();
+
+	//moves the small textures the handles show into shared atlas pages, the handles get the page's view and
+	//their rect on it. streamed, still loading and big textures keep their own views
+	static AtlasStats PackAtlases(const std::vector<TextureHandle*>& handles, const AtlasSettings& settings = AtlasSettings());
+
+	//drops queued decodes and joins the decode threads, before the upload manager's refine thread goes
+	static void ShutdownWorkers();
 
 	static void Init(ID3D12Device* device);
 	static std::array<const CD3DX12_STATIC_SAMPLER_DESC, 8> GetStaticSamplers();
@@ -47,6 +115,33 @@ private:
 	static UINT _rtvDescriptorSize;
 	static UINT _dsvDescriptorSize;
 
-	static std::unordered_map<std::wstring, UINT>& TexIndices();
-	static std::unordered_map<std::wstring, int>& TexUsed();
+	static std::vector<TextureRecord>& Records();
+	static TextureRecord& Record(NameId id);
+	static bool IsLoaded(NameId id);
+	static TextureHandle Handle(NameId id);
+	static NameId PathKey(const WCHAR* filename);
+	//held while loading, deleting and replacing textures. acquiring one that is already loaded only touches Slots()
+	static std::recursive_mutex& RegistryMutex();
+	static TextureSlots& Slots();
+	static MipStreamer& Streamer();
+	static WorkerPool& DecodePool();
+	static std::array<NameId, BasicUtil::EnumIndex(TexturePlaceholder::Count)>& PlaceholderIds();
+	static void CreatePlaceholders();
+	//resource and view stay alive until frames in flight are done with them, tex may be null for a placeholder view
+	static void RetireView(Texture* tex, UINT srvIndex);
+	//frames already submitted can run before the upload of next and keep reading previous through the view. once they are
+	//done the view is rewritten in place, previous goes after the frames recorded until then
+	static void SwapView(UINT srvIndex, Microsoft::WRL::ComPtr<ID3D12Resource> next, Microsoft::WRL::ComPtr<ID3D12Resource> previous,
+		Microsoft::WRL::ComPtr<ID3D12Resource> previousUpload = nullptr);
+	//the texture's own view and the table slots showing it
+	static void SwapViews(NameId id, Microsoft::WRL::ComPtr<ID3D12Resource> next, Microsoft::WRL::ComPtr<ID3D12Resource> previous,
+		Microsoft::WRL::ComPtr<ID3D12Resource> previousUpload = nullptr);
+	//what the texture's view shows, its placeholder while it is pending
+	static ID3D12Resource* ShownResource(NameId id);
+	static void CreateSrv(Texture* tex, UINT index);
+	static void CreateSrv(ID3D12Resource* resource, UINT index);
+	static void CreateCubeSrv(Texture* tex, UINT index);
+	static std::vector<std::uint64_t> MipBytes(const DirectX::ScratchImage& source);
+	static int StreamingTailMip(const DirectX::ScratchImage& source);
+	static HeightRange MeasureHeights(const DirectX::ScratchImage& source);
 };
\ No newline at end of file
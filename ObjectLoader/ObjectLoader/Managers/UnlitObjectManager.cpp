@@ -112,8 +112,8 @@ int UnlitObjectManager::AddRenderItem(ID3D12Device5* device, ModelData&& modelDa
 	const std::string name(itemName.begin(), itemName.end());
 
 	renderItem->Name = name;
-	renderItem->NameCount = _objectCounters[itemName]++;
-	renderItem->Geo = &GeometryManager::Geometries()["shapeGeo"];
+	renderItem->NameCount = _objectCounters[NameTable::Intern(itemName)]++;
+	renderItem->GeoId = GeometryManager::ShapeGeoId();
 	renderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_LINELIST;
 
 	for (int i = 0; i < FrameResource::FrameResources().size(); ++i)
@@ -130,8 +130,8 @@ int UnlitObjectManager::AddRenderItem(ID3D12Device5* device, ModelData&& modelDa
 
 bool UnlitObjectManager::DeleteObject(const int selectedObject)
 {
-	const std::string name = _objects[selectedObject]->Name;
-	_objectLoaded[name]--;
+	const NameId nameId = NameTable::Intern(_objects[selectedObject]->Name);
+	_objectLoaded[nameId]--;
 
 	//need for deleting from frame resource
 	std::uint32_t uid = _objects[selectedObject]->Uid;
@@ -145,10 +145,10 @@ bool UnlitObjectManager::DeleteObject(const int selectedObject)
 		FrameResource::FrameResources()[i]->RemoveOpaqueObjectBuffer(UploadManager::Device, uid);
 	}
 
-	if (_objectLoaded[name] == 0)
+	if (_objectLoaded[nameId] == 0)
 	{
-		GeometryManager::UnloadModel(name);
-		_objectLoaded.erase(name);
+		GeometryManager::UnloadModel(nameId);
+		_objectLoaded.erase(nameId);
 
 		return true;
 	}
@@ -180,7 +180,7 @@ void UnlitObjectManager::Draw(ID3D12GraphicsCommandList* cmdList, const FrameRes
 		const auto& ri = _objects[i];
 		const auto objectCb = currFrameResource->StaticObjCb->Resource();
 
-		const auto geo = ri->Geo->begin()->get();
+		const auto geo = GeometryManager::Geometry(ri->GeoId).begin()->get();
 		const auto vertexBuffer = geo->VertexBufferView();
 		cmdList->IASetVertexBuffers(0, 1, &vertexBuffer);
 		const auto& indexBuffer = geo->IndexBufferView();
@@ -191,6 +191,6 @@ void UnlitObjectManager::Draw(ID3D12GraphicsCommandList* cmdList, const FrameRes
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCbAddress);
 
-		cmdList->DrawIndexedInstanced(geo->DrawArgs["grid"].IndexCount, 1, 0, 0, 0);
+		cmdList->DrawIndexedInstanced(GeometryManager::ShapeSubmesh(Shape::Grid).IndexCount, 1, 0, 0, 0);
 	}
 }
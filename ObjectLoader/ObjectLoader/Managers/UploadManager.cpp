@@ -1,22 +1,83 @@
 #include "UploadManager.h"
 
 #include <DirectXTex.h>
+#include "../Helpers/TextureCooker.h"
+#include "../Helpers/DdsFile.h"
+#include "../Helpers/MipFilter.h"
+
+namespace
+{
+	//read-only view of a whole file, unmapped when it goes out of scope
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::wstring& filename)
+		{
+			_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (_file == INVALID_HANDLE_VALUE)
+			{
+				return;
+			}
+
+			LARGE_INTEGER fileSize = {};
+			if (!GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				return;
+			}
+
+			_mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (_mapping == nullptr)
+			{
+				return;
+			}
+
+			_data = static_cast<const std::uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+			_size = _data ? static_cast<size_t>(fileSize.QuadPart) : 0;
+		}
+
+		~MappedFile()
+		{
+			if (_data) UnmapViewOfFile(_data);
+			if (_mapping) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const std::uint8_t* Data() const { return _data; }
+		size_t Size() const { return _size; }
+
+	private:
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+		const std::uint8_t* _data = nullptr;
+		size_t _size = 0;
+	};
+}
 
 ID3D12Device5* UploadManager::Device = nullptr;
 Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> UploadManager::UploadCmdList = nullptr;
 Microsoft::WRL::ComPtr<ID3D12CommandQueue> UploadManager::_commandQueue = nullptr;
-Microsoft::WRL::ComPtr<ID3D12CommandAllocator> UploadManager::_uploadCmdAlloc = nullptr;
+std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, 3> UploadManager::_uploadCmdAllocs = {};
+std::array<UINT64, 3> UploadManager::_uploadAllocFences = {};
+size_t UploadManager::_uploadAllocIndex = 0;
 Microsoft::WRL::ComPtr<ID3D12Fence> UploadManager::_uploadFence = nullptr;
 UINT64 UploadManager::_uploadFenceValue = 0;
 HANDLE UploadManager::_uploadFenceEvent = nullptr;
+std::vector<std::function<void()>> UploadManager::_retiring = {};
+std::deque<UploadManager::RetiredRelease> UploadManager::_retired = {};
 
 void UploadManager::InitUploadCmdList(ID3D12Device5* device, const Microsoft::WRL::ComPtr<ID3D12CommandQueue>& cmdQueue)
 {
 	Device = device;
 	_commandQueue = cmdQueue;
 
-	ThrowIfFailed(Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&_uploadCmdAlloc)));
-	ThrowIfFailed(Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, _uploadCmdAlloc.Get(), nullptr,
+	for (auto& allocator : _uploadCmdAllocs)
+	{
+		ThrowIfFailed(Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)));
+	}
+	ThrowIfFailed(Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, _uploadCmdAllocs[_uploadAllocIndex].Get(), nullptr,
 		IID_PPV_ARGS(&UploadCmdList)));
 	ThrowIfFailed(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_uploadFence)));
 	_uploadFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -32,220 +93,641 @@ void UploadManager::ExecuteUploadCommandList()
 	Flush();
 
 	//Reset upload allocator + list for next use
-	ThrowIfFailed(_uploadCmdAlloc->Reset());
-	ThrowIfFailed(UploadCmdList->Reset(_uploadCmdAlloc.Get(), nullptr));
+	ThrowIfFailed(_uploadCmdAllocs[_uploadAllocIndex]->Reset());
+	ThrowIfFailed(UploadCmdList->Reset(_uploadCmdAllocs[_uploadAllocIndex].Get(), nullptr));
 }
 
-bool UploadManager::CreateTexture(Texture* tex)
+void UploadManager::SubmitUploadCommandList()
+{
+	ThrowIfFailed(UploadCmdList->Close());
+	ID3D12CommandList* cmds[] = { UploadCmdList.Get() };
+	_commandQueue->ExecuteCommandLists(1, cmds);
+
+	_uploadFenceValue++;
+	ThrowIfFailed(_commandQueue->Signal(_uploadFence.Get(), _uploadFenceValue));
+	_uploadAllocFences[_uploadAllocIndex] = _uploadFenceValue;
+
+	//the next allocator was submitted a few lists ago, it is usually done by now
+	_uploadAllocIndex = (_uploadAllocIndex + 1) % _uploadCmdAllocs.size();
+	WaitForFence(_uploadAllocFences[_uploadAllocIndex]);
+	ThrowIfFailed(_uploadCmdAllocs[_uploadAllocIndex]->Reset());
+	ThrowIfFailed(UploadCmdList->Reset(_uploadCmdAllocs[_uploadAllocIndex].Get(), nullptr));
+}
+
+void UploadManager::Retire(std::function<void()> release)
+{
+	_retiring.push_back(std::move(release));
+}
+
+void UploadManager::ReleaseRetired()
+{
+	//the previous frame is submitted by now, a signal behind it covers everything retired while it was recorded
+	if (!_retiring.empty())
+	{
+		_uploadFenceValue++;
+		ThrowIfFailed(_commandQueue->Signal(_uploadFence.Get(), _uploadFenceValue));
+		for (auto& release : _retiring)
+		{
+			_retired.push_back({ _uploadFenceValue, std::move(release) });
+		}
+		_retiring.clear();
+	}
+
+	const UINT64 completed = _uploadFence->GetCompletedValue();
+	while (!_retired.empty() && _retired.front().Fence <= completed)
+	{
+		_retired.front().Release();
+		_retired.pop_front();
+	}
+}
+
+void UploadManager::ReleaseAllRetired()
+{
+	//a release can retire more, swapped views retire what they showed before
+	while (!_retired.empty() || !_retiring.empty())
+	{
+		std::deque<RetiredRelease> retired;
+		retired.swap(_retired);
+		for (auto& release : retired)
+		{
+			release.Release();
+		}
+		std::vector<std::function<void()>> retiring;
+		retiring.swap(_retiring);
+		for (auto& release : retiring)
+		{
+			release();
+		}
+	}
+}
+
+bool UploadManager::CreateTexture(Texture* tex, const TextureRole role)
 {
     std::wstring ext = tex->Filename.substr(tex->Filename.find_last_of(L'.') + 1);
     for (auto& c : ext) c = towlower(c);
 
     if (ext == L"dds")
     {
-        // Original path
-        ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(Device,
-            UploadCmdList.Get(), tex->Filename.c_str(),
-            tex->Resource, tex->UploadHeap));
+        //formats and layouts the mapped path does not cover go through the generic loader
+        if (!CreateMappedDdsTexture(tex))
+        {
+            ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(Device,
+                UploadCmdList.Get(), tex->Filename.c_str(),
+                tex->Resource, tex->UploadHeap));
+        }
     }
     else
     {
-        DirectX::TexMetadata metadata;
         DirectX::ScratchImage scratch;
-
-        const HRESULT res = DirectX::LoadFromWICFile(
-            tex->Filename.c_str(),
-            DirectX::WIC_FLAGS_FORCE_RGB, // or _SRGB/_NONE if you care
-            &metadata,
-            scratch
-        );
-
-        if (FAILED(res))
+        if (!LoadTextureSource(tex->Filename, role, scratch))
         {
             return false;
         }
 
-        Microsoft::WRL::ComPtr<ID3D12Resource> texture;
-        const CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-            metadata.format,
-            static_cast<UINT>(metadata.width),
-            static_cast<UINT>(metadata.height),
-            static_cast<UINT16>(metadata.arraySize),
-            static_cast<UINT16>(metadata.mipLevels)
-        );
-
-        const auto heapPropertiesDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-        ThrowIfFailed(Device->CreateCommittedResource(
-            &heapPropertiesDefault,
-            D3D12_HEAP_FLAG_NONE,
-            &texDesc,
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            nullptr,
-            IID_PPV_ARGS(&texture)));
-
-        UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, static_cast<UINT>(metadata.mipLevels));
-
-        Microsoft::WRL::ComPtr<ID3D12Resource> textureUploadHeap;
-        const auto heapPropertiesUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-        const auto buffer = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
-        ThrowIfFailed(Device->CreateCommittedResource(
-            &heapPropertiesUpload,
-            D3D12_HEAP_FLAG_NONE,
-            &buffer,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&textureUploadHeap)));
-
-        ThrowIfFailed(Device->CreateCommittedResource(
-            &heapPropertiesUpload,
-            D3D12_HEAP_FLAG_NONE,
-            &buffer,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&tex->UploadHeap)
-        ));
-
-        const UINT numSubresources = static_cast<UINT>(metadata.mipLevels * metadata.arraySize);
-        std::vector<D3D12_SUBRESOURCE_DATA> subresources;
-        subresources.reserve(numSubresources);
-
-        const DirectX::Image* images = scratch.GetImages();
-        for (UINT i = 0; i < numSubresources; ++i)
+        UploadScratchImage(tex, scratch);
+    }
+    return true;
+}
+
+bool UploadManager::LoadTextureSource(const std::wstring& filename, const TextureRole role, DirectX::ScratchImage& scratch,
+    const RefinedCallback& onRefined)
+{
+    std::wstring ext = filename.substr(filename.find_last_of(L'.') + 1);
+    for (auto& c : ext) c = towlower(c);
+
+    if (ext == L"dds")
+    {
+        return SUCCEEDED(DirectX::LoadFromDDSFile(filename.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, scratch));
+    }
+
+    const Decoder decode = [filename, role](DirectX::ScratchImage& image)
+    {
+        return DecodeSource(filename, role, image);
+    };
+    return LoadCooked(TextureCooker::CachePath(filename, role), role, decode, scratch, onRefined);
+}
+
+void UploadManager::CancelBackgroundWork()
+{
+    RefineCancelled() = true;
+    RefinePool().DropPending();
+    RefinePool().Shutdown();
+}
+
+bool UploadManager::LoadCooked(const std::wstring& cachePath, const TextureRole role, const Decoder& decode,
+    DirectX::ScratchImage& scratch, const RefinedCallback& onRefined)
+{
+    //already cooked into dds, take the fast path
+    if (TextureCooker::IsCached(cachePath) &&
+        SUCCEEDED(DirectX::LoadFromDDSFile(cachePath.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, scratch)))
+    {
+        return true;
+    }
+
+    //quick encode from an earlier run whose refinement never finished
+    const std::wstring fastPath = TextureCooker::FastCachePath(cachePath);
+    if (TextureCooker::IsCached(fastPath) &&
+        SUCCEEDED(DirectX::LoadFromDDSFile(fastPath.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, scratch)))
+    {
+        RefineInBackground(decode, cachePath, role, onRefined);
+        return true;
+    }
+
+    if (!decode(scratch))
+    {
+        return false;
+    }
+
+    //the import only pays for the quick encode, the slow one follows in the background
+    const bool refine = TextureCooker::HasRefinement(scratch.GetMetadata(), role);
+    const CookQuality quality = refine ? CookQuality::Fast : CookQuality::High;
+
+    //uncompressed data is still uploaded if cooking is not possible
+    DirectX::ScratchImage cooked;
+    if (TextureCooker::Cook(scratch, role, quality, cooked) == S_OK)
+    {
+        scratch = std::move(cooked);
+        const std::wstring& storePath = refine ? fastPath : cachePath;
+        if (FAILED(TextureCooker::Store(scratch, storePath)))
         {
-            D3D12_SUBRESOURCE_DATA sr = {};
-            sr.pData = images[i].pixels;
-            sr.RowPitch = static_cast<long long>(images[i].rowPitch);
-            sr.SlicePitch = static_cast<long long>(images[i].slicePitch);
-            subresources.push_back(sr);
+            OutputDebugStringW((L"[WARNING] Failed to store cooked texture " + storePath + L"\n").c_str());
+        }
+        if (refine)
+        {
+            RefineInBackground(decode, cachePath, role, onRefined);
         }
+    }
 
-        tex->Resource = texture;
+    return true;
+}
 
-        UpdateSubresources(UploadCmdList.Get(), tex->Resource.Get(), tex->UploadHeap.Get(),
-            0, 0, numSubresources, subresources.data());
+bool UploadManager::DecodeSource(const std::wstring& filename, const TextureRole role, DirectX::ScratchImage& scratch)
+{
+    DirectX::TexMetadata metadata;
+
+    const HRESULT res = DirectX::LoadFromWICFile(
+        filename.c_str(),
+        DirectX::WIC_FLAGS_FORCE_RGB, // or _SRGB/_NONE if you care
+        &metadata,
+        scratch
+    );
+
+    if (FAILED(res))
+    {
+        return false;
+    }
 
-        const auto resourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
-            tex->Resource.Get(),
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_GENERIC_READ
-        );
-        UploadCmdList->ResourceBarrier(1, &resourceBarrier);
+    if (FAILED(GenerateMipChain(scratch, role)))
+    {
+        OutputDebugStringW((L"[WARNING] Failed to generate mips for " + filename + L"\n").c_str());
     }
+    MarkGammaEncoded(scratch, role);
     return true;
 }
 
-void UploadManager::CreateEmbeddedTexture(Texture* tex, const aiTexture* texture)
+bool UploadManager::DecodeEmbedded(const std::uint8_t* data, const size_t size, const UINT width, const UINT height,
+    const TextureRole role, DirectX::ScratchImage& scratch)
+{
+    if (height == 0)
+    {
+        // Compressed texture (PNG, JPG, etc.)
+        if (FAILED(DirectX::LoadFromWICMemory(data, size, DirectX::WIC_FLAGS_FORCE_RGB, nullptr, scratch)))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // Raw uncompressed texture (RGBA8888)
+        DirectX::Image image = {};
+        image.width = width;
+        image.height = height;
+        image.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        image.rowPitch = static_cast<size_t>(width) * 4;
+        image.slicePitch = image.rowPitch * height;
+        image.pixels = const_cast<std::uint8_t*>(data);
+
+        if (FAILED(scratch.InitializeFromImage(image)))
+        {
+            return false;
+        }
+    }
+
+    if (FAILED(GenerateMipChain(scratch, role)))
+    {
+        OutputDebugStringW(L"[WARNING] Failed to generate mips for an embedded texture\n");
+    }
+    MarkGammaEncoded(scratch, role);
+    return true;
+}
+
+void UploadManager::MarkGammaEncoded(DirectX::ScratchImage& scratch, const TextureRole role)
+{
+    //the sampler decodes srgb views to linear, so lighting gets linear albedo whether or not the texture was cooked
+    if (role == TextureRole::Color)
+    {
+        scratch.OverrideFormat(DirectX::MakeSRGB(scratch.GetMetadata().format));
+    }
+}
+
+void UploadManager::RefineInBackground(const Decoder& decode, const std::wstring& cachePath, const TextureRole role,
+    const RefinedCallback& onRefined)
+{
+    RefinePool().Submit([decode, cachePath, role, onRefined]()
+        {
+            //wic needs com on every thread that decodes
+            static thread_local const bool comReady = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+            (void)comReady;
+
+            DirectX::ScratchImage source;
+            if (RefineCancelled() || !decode(source))
+            {
+                return;
+            }
+
+            //a cancelled encode leaves the fast one in the cache, it is refined again on the next load
+            auto refined = std::make_shared<DirectX::ScratchImage>();
+            if (TextureCooker::Cook(source, role, CookQuality::High, *refined, &RefineCancelled()) != S_OK)
+            {
+                return;
+            }
+
+            if (SUCCEEDED(TextureCooker::Store(*refined, cachePath)))
+            {
+                TextureCooker::Remove(TextureCooker::FastCachePath(cachePath));
+            }
+
+            if (onRefined)
+            {
+                onRefined(refined);
+            }
+        });
+}
+
+WorkerPool& UploadManager::RefinePool()
+{
+    //a single thread, refinement must never compete with the decodes the user is waiting for
+    static WorkerPool pool(1);
+    return pool;
+}
+
+std::atomic<bool>& UploadManager::RefineCancelled()
+{
+    static std::atomic<bool> cancelled{ false };
+    return cancelled;
+}
+
+bool UploadManager::CreateEmbeddedTexture(Texture* tex, const aiTexture* texture, const TextureRole role, const std::wstring& modelFolder)
 {
     if (!texture || !tex)
-        return;
+        return false;
 
-    DirectX::TexMetadata metadata;
+    //compressed files keep their byte count in mWidth, raw ones are mWidth x mHeight texels.
+    //copied, the refine job still decodes them after the scene is gone
+    const auto* data = reinterpret_cast<const std::uint8_t*>(texture->pcData);
+    const size_t size = texture->mHeight == 0 ? texture->mWidth : static_cast<size_t>(texture->mWidth) * texture->mHeight * sizeof(aiTexel);
+    const auto bytes = std::make_shared<const std::vector<std::uint8_t>>(data, data + size);
+    const UINT width = texture->mWidth;
+    const UINT height = texture->mHeight;
+
+    const Decoder decode = [bytes, width, height, role](DirectX::ScratchImage& image)
+    {
+        return DecodeEmbedded(bytes->data(), bytes->size(), width, height, role, image);
+    };
+
+    //the refined encode is only picked up on the next load, embedded textures are not reloaded in place
+    const std::wstring cachePath = TextureCooker::EmbeddedCachePath(modelFolder, tex->Name, bytes->data(), bytes->size(), role);
     DirectX::ScratchImage scratch;
-    
-    if (texture->mHeight == 0)
+    if (!LoadCooked(cachePath, role, decode, scratch, nullptr))
     {
-        // Compressed texture (PNG, JPG, etc.)
-        auto imageData = reinterpret_cast<const uint8_t*>(texture->pcData);
-        size_t imageSize = texture->mWidth;
-
-        ThrowIfFailed(DirectX::LoadFromWICMemory(
-            imageData,
-            imageSize,
-            DirectX::WIC_FLAGS_FORCE_RGB,
-            &metadata,
-            scratch));
+        return false;
+    }
+
+    UploadScratchImage(tex, scratch);
+    return true;
+}
+
+HRESULT UploadManager::GenerateMipChain(DirectX::ScratchImage& scratch, const TextureRole role)
+{
+    const DirectX::TexMetadata& metadata = scratch.GetMetadata();
+    if (metadata.mipLevels > 1 || DirectX::IsCompressed(metadata.format) || (metadata.width == 1 && metadata.height == 1) ||
+        metadata.arraySize != 1 || metadata.depth != 1)
+    {
+        return S_OK;
+    }
+
+    //albedo is stored gamma-encoded, so it has to be averaged in linear space
+    const MipContent content = role == TextureRole::Color ? MipContent::Srgb
+        : role == TextureRole::Normal ? MipContent::Normal
+        : MipContent::Linear;
+
+    //8 bit rgba is what wic hands out for almost everything, the rest is filtered as float and converted back
+    const DXGI_FORMAT format = metadata.format;
+    const bool rgba8 = format == DXGI_FORMAT_R8G8B8A8_UNORM;
+    const DXGI_FORMAT filterFormat = rgba8 ? format : DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+    DirectX::ScratchImage converted;
+    const DirectX::Image* top = scratch.GetImage(0, 0, 0);
+    if (!rgba8 && format != filterFormat)
+    {
+        HRESULT hr = DirectX::Convert(*top, filterFormat, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, converted);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+        top = converted.GetImage(0, 0, 0);
+    }
+
+    const auto width = static_cast<std::uint32_t>(top->width);
+    const auto height = static_cast<std::uint32_t>(top->height);
+    MipLevel topLevel;
+    if (rgba8)
+    {
+        topLevel = MipFilter::FromRgba8(top->pixels, width, height, top->rowPitch);
     }
     else
     {
-        // Raw uncompressed texture (RGBA8888)
-        const aiTexel* texels = texture->pcData;
+        topLevel = MipLevel(width, height);
+        for (std::uint32_t y = 0; y < height; y++)
+        {
+            memcpy(topLevel.At(0, y), top->pixels + y * top->rowPitch, static_cast<size_t>(width) * 4 * sizeof(float));
+        }
+    }
 
-        metadata.width = texture->mWidth;
-        metadata.height = texture->mHeight;
-        metadata.depth = 1;
-        metadata.arraySize = 1;
-        metadata.mipLevels = 1;
-        metadata.format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        metadata.dimension = DirectX::TEX_DIMENSION_TEXTURE2D;
+    const std::vector<MipLevel> levels = MipFilter::BuildChain(std::move(topLevel), content);
 
-        DirectX::Image image = {};
-        image.width = metadata.width;
-        image.height = metadata.height;
-        image.format = metadata.format;
-        image.rowPitch = metadata.width * 4;
-        image.slicePitch = image.rowPitch * metadata.height;
-        std::unique_ptr<uint8_t[]> pixelCopy(new uint8_t[image.slicePitch]);
-        memcpy(pixelCopy.get(), texels, image.slicePitch);
-        image.pixels = pixelCopy.get();
-
-        ThrowIfFailed(scratch.InitializeFromImage(image));
+    DirectX::ScratchImage mipChain;
+    HRESULT hr = mipChain.Initialize2D(filterFormat, width, height, 1, levels.size());
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    for (size_t mip = 0; mip < levels.size(); mip++)
+    {
+        const DirectX::Image* image = mipChain.GetImage(mip, 0, 0);
+        if (rgba8)
+        {
+            MipFilter::ToRgba8(levels[mip], image->pixels, image->rowPitch);
+            continue;
+        }
+        for (std::uint32_t y = 0; y < levels[mip].Height; y++)
+        {
+            memcpy(image->pixels + y * image->rowPitch, levels[mip].At(0, y), static_cast<size_t>(levels[mip].Width) * 4 * sizeof(float));
+        }
     }
 
-    Microsoft::WRL::ComPtr<ID3D12Resource> comPtr;
-    CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+    if (filterFormat != format)
+    {
+        DirectX::ScratchImage restored;
+        hr = DirectX::Convert(mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(), format,
+            DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, restored);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+        mipChain = std::move(restored);
+    }
+
+    scratch = std::move(mipChain);
+    return S_OK;
+}
+
+void UploadManager::UploadScratchImage(Texture* tex, const DirectX::ScratchImage& scratch, size_t firstMip)
+{
+    const DirectX::TexMetadata& metadata = scratch.GetMetadata();
+    firstMip = (std::min)(firstMip, metadata.mipLevels - 1);
+    const size_t mipLevels = metadata.mipLevels - firstMip;
+    const DirectX::Image* topImage = scratch.GetImage(firstMip, 0, 0);
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+    const CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
         metadata.format,
-        static_cast<UINT>(metadata.width),
-        static_cast<UINT>(metadata.height),
+        static_cast<UINT>(topImage->width),
+        static_cast<UINT>(topImage->height),
         static_cast<UINT16>(metadata.arraySize),
-        static_cast<UINT16>(metadata.mipLevels)
+        static_cast<UINT16>(mipLevels)
     );
 
-    const auto propertiesDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    const auto heapPropertiesDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     ThrowIfFailed(Device->CreateCommittedResource(
-        &propertiesDefault,
+        &heapPropertiesDefault,
         D3D12_HEAP_FLAG_NONE,
         &texDesc,
         D3D12_RESOURCE_STATE_COPY_DEST,
         nullptr,
-        IID_PPV_ARGS(&comPtr)));
+        IID_PPV_ARGS(&texture)));
 
-    UINT64 uploadBufferSize = GetRequiredIntermediateSize(comPtr.Get(), 0, static_cast<UINT>(metadata.mipLevels));
+    const UINT numSubresources = static_cast<UINT>(mipLevels * metadata.arraySize);
+    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, numSubresources);
 
-    const auto propertiesUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    const auto desc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+    const auto heapPropertiesUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    const auto buffer = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
     ThrowIfFailed(Device->CreateCommittedResource(
-        &propertiesUpload,
+        &heapPropertiesUpload,
         D3D12_HEAP_FLAG_NONE,
-        &desc,
+        &buffer,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
         IID_PPV_ARGS(&tex->UploadHeap)
     ));
 
-    const UINT numSubresources = static_cast<UINT>(metadata.mipLevels * metadata.arraySize);
     std::vector<D3D12_SUBRESOURCE_DATA> subresources;
     subresources.reserve(numSubresources);
 
-    const DirectX::Image* images = scratch.GetImages();
-    for (UINT i = 0; i < numSubresources; ++i)
+    //d3d12 orders subresources mip first, then array slice
+    for (size_t item = 0; item < metadata.arraySize; ++item)
     {
-        D3D12_SUBRESOURCE_DATA sr = {};
-        sr.pData = images[i].pixels;
-        sr.RowPitch = static_cast<long long>(images[i].rowPitch);
-        sr.SlicePitch = static_cast<long long>(images[i].slicePitch);
-        subresources.push_back(sr);
+        for (size_t mip = firstMip; mip < metadata.mipLevels; ++mip)
+        {
+            const DirectX::Image* image = scratch.GetImage(mip, item, 0);
+            D3D12_SUBRESOURCE_DATA sr = {};
+            sr.pData = image->pixels;
+            sr.RowPitch = static_cast<long long>(image->rowPitch);
+            sr.SlicePitch = static_cast<long long>(image->slicePitch);
+            subresources.push_back(sr);
+        }
     }
 
-    tex->Resource = comPtr;
+    tex->Resource = texture;
 
     UpdateSubresources(UploadCmdList.Get(), tex->Resource.Get(), tex->UploadHeap.Get(),
         0, 0, numSubresources, subresources.data());
 
     const auto resourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
-                                         tex->Resource.Get(),
-                                         D3D12_RESOURCE_STATE_COPY_DEST,
-                                         D3D12_RESOURCE_STATE_GENERIC_READ
-                                     );
+        tex->Resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_GENERIC_READ
+    );
+    UploadCmdList->ResourceBarrier(1, &resourceBarrier);
+}
+
+void UploadManager::CreateAtlas(Texture* tex, const DXGI_FORMAT format, const UINT width, const UINT height, const UINT mipCount,
+    const UINT gutter, const std::vector<AtlasCopy>& copies)
+{
+    const CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, 1, static_cast<UINT16>(mipCount));
+    const auto heapPropertiesDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(Device->CreateCommittedResource(
+        &heapPropertiesDefault,
+        D3D12_HEAP_FLAG_NONE,
+        &texDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&tex->Resource)));
+
+    //sources stay in generic read, it includes copy source. block compressed copies go by whole blocks
+    const UINT block = DirectX::IsCompressed(format) ? 4 : 1;
+    for (const AtlasCopy& copy : copies)
+    {
+        const D3D12_RESOURCE_DESC sourceDesc = copy.Source->GetDesc();
+        for (UINT mip = 0; mip < mipCount; mip++)
+        {
+            const UINT w = (std::max)(static_cast<UINT>(sourceDesc.Width) >> mip, 1u);
+            const UINT h = (std::max)(sourceDesc.Height >> mip, 1u);
+            const UINT x = copy.X >> mip;
+            const UINT y = copy.Y >> mip;
+            const CD3DX12_TEXTURE_COPY_LOCATION dst(tex->Resource.Get(), mip);
+            const CD3DX12_TEXTURE_COPY_LOCATION src(copy.Source, mip);
+            UploadCmdList->CopyTextureRegion(&dst, x, y, 0, &src, nullptr);
+
+            //the right and bottom halves of the gap go to this texture, the left and top ones to the
+            //texture before it. nothing comes before the page border
+            const UINT gapBlocks = (gutter >> mip) / block;
+            const UINT after = (gapBlocks + 1) / 2;
+            const UINT beforeX = x > 0 ? gapBlocks / 2 : 0;
+            const UINT beforeY = y > 0 ? gapBlocks / 2 : 0;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (dx == 0 && dy == 0)
+                    {
+                        continue;
+                    }
+
+                    //edges repeat their outer row or column of blocks, corners their corner block
+                    const D3D12_BOX box = {
+                        dx > 0 ? w - block : 0, dy > 0 ? h - block : 0, 0,
+                        dx < 0 ? block : w, dy < 0 ? block : h, 1 };
+                    const UINT countX = dx < 0 ? beforeX : dx > 0 ? after : 1;
+                    const UINT countY = dy < 0 ? beforeY : dy > 0 ? after : 1;
+                    for (UINT j = 0; j < countY; j++)
+                    {
+                        for (UINT i = 0; i < countX; i++)
+                        {
+                            const UINT dstX = dx < 0 ? x - (i + 1) * block : dx > 0 ? x + w + i * block : x;
+                            const UINT dstY = dy < 0 ? y - (j + 1) * block : dy > 0 ? y + h + j * block : y;
+                            UploadCmdList->CopyTextureRegion(&dst, dstX, dstY, 0, &src, &box);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const auto resourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
+        tex->Resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_GENERIC_READ
+    );
     UploadCmdList->ResourceBarrier(1, &resourceBarrier);
 }
 
+bool UploadManager::CreateMappedDdsTexture(Texture* tex)
+{
+    const MappedFile file(tex->Filename);
+    DdsLayout layout;
+    if (file.Data() == nullptr || !DdsFile::Parse(file.Data(), file.Size(), layout))
+    {
+        return false;
+    }
+
+    const CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+        layout.Format,
+        layout.Width,
+        layout.Height,
+        static_cast<UINT16>(layout.ArraySize),
+        static_cast<UINT16>(layout.MipCount)
+    );
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+    const auto heapPropertiesDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(Device->CreateCommittedResource(
+        &heapPropertiesDefault,
+        D3D12_HEAP_FLAG_NONE,
+        &texDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&texture)));
+
+    const UINT numSubresources = static_cast<UINT>(layout.Subresources.size());
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(numSubresources);
+    UINT64 uploadBufferSize = 0;
+    Device->GetCopyableFootprints(&texDesc, 0, numSubresources, 0, footprints.data(), nullptr, nullptr, &uploadBufferSize);
+
+    const auto heapPropertiesUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    const auto buffer = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+    ThrowIfFailed(Device->CreateCommittedResource(
+        &heapPropertiesUpload,
+        D3D12_HEAP_FLAG_NONE,
+        &buffer,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&tex->UploadHeap)
+    ));
+
+    //rows go straight from the mapped file into the upload heap, only the pitch differs
+    std::uint8_t* staging = nullptr;
+    const CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(tex->UploadHeap->Map(0, &readRange, reinterpret_cast<void**>(&staging)));
+    for (UINT i = 0; i < numSubresources; ++i)
+    {
+        const DdsSubresource& subresource = layout.Subresources[i];
+        const UINT dstRowPitch = footprints[i].Footprint.RowPitch;
+        std::uint8_t* dst = staging + footprints[i].Offset;
+        const std::uint8_t* src = file.Data() + subresource.Offset;
+
+        if (dstRowPitch == subresource.RowPitch)
+        {
+            memcpy(dst, src, subresource.SlicePitch);
+            continue;
+        }
+        for (size_t row = 0; row < subresource.RowCount; ++row)
+        {
+            memcpy(dst + row * dstRowPitch, src + row * subresource.RowPitch, subresource.RowPitch);
+        }
+    }
+    tex->UploadHeap->Unmap(0, nullptr);
+
+    tex->Resource = texture;
+
+    for (UINT i = 0; i < numSubresources; ++i)
+    {
+        const CD3DX12_TEXTURE_COPY_LOCATION dst(tex->Resource.Get(), i);
+        const CD3DX12_TEXTURE_COPY_LOCATION src(tex->UploadHeap.Get(), footprints[i]);
+        UploadCmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+
+    const auto resourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
+        tex->Resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_GENERIC_READ
+    );
+    UploadCmdList->ResourceBarrier(1, &resourceBarrier);
+    return true;
+}
+
 void UploadManager::Flush()
 {
 	_uploadFenceValue++;
 	ThrowIfFailed(_commandQueue->Signal(_uploadFence.Get(), _uploadFenceValue));
-	if (_uploadFence->GetCompletedValue() < _uploadFenceValue)
+	WaitForFence(_uploadFenceValue);
+}
+
+void UploadManager::WaitForFence(const UINT64 value)
+{
+	if (_uploadFence->GetCompletedValue() < value)
 	{
-		ThrowIfFailed(_uploadFence->SetEventOnCompletion(_uploadFenceValue, _uploadFenceEvent));
+		ThrowIfFailed(_uploadFence->SetEventOnCompletion(value, _uploadFenceEvent));
 		WaitForSingleObject(_uploadFenceEvent, INFINITE);
 	}
 }
@@ -253,7 +735,7 @@ void UploadManager::Flush()
 void UploadManager::Reset()
 {
 	ThrowIfFailed(UploadCmdList->Close());
-	ThrowIfFailed(UploadCmdList->Reset(_uploadCmdAlloc.Get(), nullptr));
+	ThrowIfFailed(UploadCmdList->Reset(_uploadCmdAllocs[_uploadAllocIndex].Get(), nullptr));
 }
 
 Microsoft::WRL::ComPtr<ID3D12Resource> UploadManager::CreateUavBuffer(const UINT64 size)
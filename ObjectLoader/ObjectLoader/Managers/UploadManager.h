@@ -2,14 +2,63 @@
 #include "../../../Common/d3dUtil.h"
 #include "./../../../Common/d3dx12.h"
 #include <assimp/scene.h>
+#include "../Helpers/Material.h"
+#include "../Helpers/WorkerPool.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace DirectX
+{
+	class ScratchImage;
+}
 
 class UploadManager
 {
 public:
 	static void InitUploadCmdList(ID3D12Device5* device, const Microsoft::WRL::ComPtr<ID3D12CommandQueue>& cmdQueue);
+	//waits for the copies and every frame in flight before the list is reused
 	static void ExecuteUploadCommandList();
-	static bool CreateTexture(Texture* tex);
-	static void CreateEmbeddedTexture(Texture* tex, const aiTexture* texture);
+	//queues the copies behind the frames already submitted without waiting for them,
+	//the allocator is reused once the gpu is past it
+	static void SubmitUploadCommandList();
+	//for resources and views frames in flight may still read: release runs once the gpu
+	//finished every frame submitted before the next ReleaseRetired call. a release may retire more
+	static void Retire(std::function<void()> release);
+	//once per frame, after the previous frame was submitted
+	static void ReleaseRetired();
+	//the queue has to be flushed already, on shutdown
+	static void ReleaseAllRetired();
+	static bool CreateTexture(Texture* tex, TextureRole role = TextureRole::Data);
+	//cooked like files, into the cache folder next to the model
+	static bool CreateEmbeddedTexture(Texture* tex, const aiTexture* texture, TextureRole role = TextureRole::Data,
+		const std::wstring& modelFolder = L"");
+	//called from a worker thread once the high quality encode of a quickly cooked texture is ready
+	using RefinedCallback = std::function<void(std::shared_ptr<DirectX::ScratchImage>)>;
+
+	//decodes (or reads the cooked copy of) a texture with its full mip chain into cpu memory
+	static bool LoadTextureSource(const std::wstring& filename, TextureRole role, DirectX::ScratchImage& scratch,
+		const RefinedCallback& onRefined = nullptr);
+	//drops queued high quality encodes, stops the running one at its next row of blocks and joins the refine thread.
+	//they are picked up again on the next load.
+	//decodes queue refinements, so TextureManager::ShutdownWorkers has to run first
+	static void CancelBackgroundWork();
+	//creates the gpu texture from the given mip down to the smallest one
+	static void UploadScratchImage(Texture* tex, const DirectX::ScratchImage& scratch, size_t firstMip = 0);
+	//one texture of an atlas page and the texel its top left corner lands on
+	struct AtlasCopy
+	{
+		ID3D12Resource* Source = nullptr;
+		UINT X = 0;
+		UINT Y = 0;
+	};
+	//creates the page and copies the top mips of every texture into it. the gutter texels after each
+	//texture are split with its neighbours, both sides repeat their own edge blocks into their half
+	static void CreateAtlas(Texture* tex, DXGI_FORMAT format, UINT width, UINT height, UINT mipCount, UINT gutter,
+		const std::vector<AtlasCopy>& copies);
 	static void Flush();
 	static void Reset();
 
@@ -22,8 +71,43 @@ public:
 	static Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> UploadCmdList;
 private:
 	static Microsoft::WRL::ComPtr<ID3D12CommandQueue> _commandQueue;
-	static Microsoft::WRL::ComPtr<ID3D12CommandAllocator> _uploadCmdAlloc;
+	//submitted lists keep their allocator busy, a few of them let streaming go on without waiting
+	static std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, 3> _uploadCmdAllocs;
+	static std::array<UINT64, 3> _uploadAllocFences;
+	static size_t _uploadAllocIndex;
 	static Microsoft::WRL::ComPtr<ID3D12Fence> _uploadFence;
 	static UINT64 _uploadFenceValue;
 	static HANDLE _uploadFenceEvent;
+
+	struct RetiredRelease
+	{
+		UINT64 Fence = 0;
+		std::function<void()> Release;
+	};
+	//retired this frame, the fence covering them is signaled once the frame was submitted
+	static std::vector<std::function<void()>> _retiring;
+	static std::deque<RetiredRelease> _retired;
+
+	static void WaitForFence(UINT64 value);
+
+	//maps the file and copies every subresource from the mapping into the upload heap.
+	//false if the layout is not supported, nothing is recorded then
+	static bool CreateMappedDdsTexture(Texture* tex);
+	//decodes the source with its mip chain, called again on the refine thread
+	using Decoder = std::function<bool(DirectX::ScratchImage&)>;
+
+	//cached encode if there is one, otherwise decodes, cooks quickly and queues the slow encode
+	static bool LoadCooked(const std::wstring& cachePath, TextureRole role, const Decoder& decode,
+		DirectX::ScratchImage& scratch, const RefinedCallback& onRefined);
+	static bool DecodeSource(const std::wstring& filename, TextureRole role, DirectX::ScratchImage& scratch);
+	//height 0 means data holds an encoded file of size bytes
+	static bool DecodeEmbedded(const std::uint8_t* data, size_t size, UINT width, UINT height, TextureRole role,
+		DirectX::ScratchImage& scratch);
+	static void MarkGammaEncoded(DirectX::ScratchImage& scratch, TextureRole role);
+	static void RefineInBackground(const Decoder& decode, const std::wstring& cachePath, TextureRole role,
+		const RefinedCallback& onRefined);
+	static WorkerPool& RefinePool();
+	//set on shutdown, the refine in progress stops at its next row of blocks
+	static std::atomic<bool>& RefineCancelled();
+	static HRESULT GenerateMipChain(DirectX::ScratchImage& scratch, TextureRole role);
 };
\ No newline at end of file
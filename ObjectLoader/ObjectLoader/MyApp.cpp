@@ -8,6 +8,9 @@
 
 #pragma comment(lib, "ComCtl32.lib")
 
+//baked visibility of the scene, next to the executable
+static const char* gPvsFile = "scene.pvs";
+
 MyApp::MyApp(const HINSTANCE hInstance)
 	: D3DApp(hInstance)
 	  , _lastMousePos {0, 0}
@@ -16,6 +19,14 @@ MyApp::MyApp(const HINSTANCE hInstance)
 
 MyApp::~MyApp()
 {
+	//function-static pools would otherwise be joined during static destruction, after what their jobs use
+	TextureManager::ShutdownWorkers();
+	UploadManager::CancelBackgroundWork();
+	if (_device != nullptr)
+	{
+		FlushCommandQueue();
+		UploadManager::ReleaseAllRetired();
+	}
 	ImGui_ImplDX12_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
@@ -123,10 +134,22 @@ void MyApp::Update(const GameTimer& gt)
 		}
 	}
 
+	if (_packTextures)
+	{
+		_packTextures = false;
+		const AtlasStats atlas = _objectsManager->PackMaterialTextures();
+		AddToast(atlas.Textures == 0 ? "No small textures to pack"
+			: "Packed " + std::to_string(atlas.Textures) + " textures into " + std::to_string(atlas.Pages) + " atlas pages");
+	}
 	UpdateObjectCBs(gt);
+	//textures retired while the previous frames were recorded
+	UploadManager::ReleaseRetired();
+	TextureManager::FinishPendingLoads();
+	TextureManager::UpdateStreaming();
 
-	UpdateMainPassCBs(gt);
+	//lights go first, the directional light cb describes the lists they were culled and clustered into
 	_lightingManager->UpdateLightCBs(_currFrameResource);
+	UpdateMainPassCBs(gt);
 	_postProcessManager->UpdateSsrParameters(_currFrameResource);
 	_atmosphereManager->UpdateParameters(_currFrameResource);
 	_terrainManager->UpdateTerrainCb(_currFrameResource);
@@ -181,7 +204,8 @@ void MyApp::Draw(const GameTimer& gt)
 		const auto objects = _objectsManager->Objects();
 		//cascade maps are needed only if rt is disabled
 		if (!_rayTracingEnabled)
-			_lightingManager->DrawShadows(mCommandList.Get(), _currFrameResource, objects);
+			_lightingManager->DrawShadows(mCommandList.Get(), _currFrameResource, objects, _objectsManager->Bvh(),
+			                              _objectsManager->WorldBounds());
 		GBufferPass();
 
 		if (_rayTracingEnabled)
@@ -338,7 +362,11 @@ void MyApp::OnKeyboardInput(const GameTimer& gt)
 void MyApp::UpdateObjectCBs(const GameTimer& gt) const
 {
 	_gridManager->UpdateObjectCBs(_currFrameResource);
+	//terrain first, objects are culled against the horizon its tiles leave
+	_terrainManager->CullGrids(_currFrameResource);
+	_objectsManager->SetScreenHeight(static_cast<float>(mClientHeight));
 	_objectsManager->UpdateObjectCBs(_currFrameResource);
+	_objectsManager->RequestMipsAndSyncHandles(static_cast<float>(mClientHeight));
 }
 
 void MyApp::UpdateMainPassCBs(const GameTimer& gt)
@@ -426,6 +454,7 @@ void MyApp::DrawInterface()
 		DrawShadowMasksList(buttonId);
 		DrawTerrain(buttonId);
 		DrawAtmosphere(buttonId);
+		DrawEnvironment();
 		ImGui::EndTabItem();
 	}
 
@@ -466,11 +495,42 @@ void MyApp::DrawInterface()
 	const auto visObjectsCnt = _objectsManager->VisibleObjectsCount();
 	const auto objectsCnt = _objectsManager->ObjectsCount();
 	ImGui::Text(("Objects drawn: " + std::to_string(visObjectsCnt) + "/" + std::to_string(objectsCnt)).c_str());
+	const auto submeshesDrawn = _objectsManager->SubmeshesDrawn();
+	const auto submeshesCnt = submeshesDrawn + _objectsManager->SubmeshesCulled();
+	ImGui::Text(("Submeshes drawn: " + std::to_string(submeshesDrawn) + "/" + std::to_string(submeshesCnt)).c_str());
+	ImGui::Text(("Texture binds: " + std::to_string(_objectsManager->TextureBindsCount())).c_str());
+	static const char* cullReuseNames[] = { "full", "cached", "band" };
+	ImGui::Text("Camera cull: %s", cullReuseNames[static_cast<int>(_objectsManager->CameraCullReuse())]);
+	const auto& lodStats = _objectsManager->Lods();
+	ImGui::Text("Triangles: %d, LOD error %.2f px, %d switches", lodStats.Triangles, lodStats.Tolerance, lodStats.Switches);
+	const auto& occlusion = _objectsManager->Occlusion();
+	ImGui::Text("Occluded: %d/%d by %d occluders, %.2f ms", occlusion.Occluded, occlusion.Tested, occlusion.Occluders, occlusion.Milliseconds);
+	const auto& pvs = _objectsManager->Pvs();
+	if (pvs.Matches)
+		ImGui::Text("PVS: cell %d, %d hidden, %d KB", pvs.Cell, pvs.Hidden, static_cast<int>(pvs.Bytes >> 10));
+	else
+		ImGui::Text("PVS: none baked for this scene");
+	const auto& smallCasters = _lightingManager->SmallCasters();
+	ImGui::Text("Too small: %d objects, %d cascade casters, %d local light casters", _objectsManager->SmallObjectsCulled(),
+	            smallCasters.Cascades, smallCasters.LocalLights);
+	const auto& cascadeCasters = _lightingManager->CascadeCasters();
+	ImGui::Text("Cascade casters: %d/%d/%d, %d with no receivers", cascadeCasters.Drawn[0], cascadeCasters.Drawn[1],
+	            cascadeCasters.Drawn[2], cascadeCasters.NoReceivers);
 	const auto visLights = _lightingManager->LightsInsideFrustum();
 	const auto lightsCnt = _lightingManager->LightsCount();
 	ImGui::Text(("Lights drawn: " + std::to_string(visLights) + "/" + std::to_string(lightsCnt)).c_str());
+	const auto& clusters = _lightingManager->Clusters();
+	if (clusters.Overflowed)
+		ImGui::Text("Light clusters: overflowed by %d lights, drawn as volumes", clusters.Lights);
+	else if (*_lightingManager->ClusteredLighting())
+		ImGui::Text("Light clusters: %d lights, %d indices, %.2f ms", clusters.Lights, clusters.Indices, clusters.Milliseconds);
 	const auto visGrids = _terrainManager->VisibleGrids();
 	ImGui::Text(("Grids instances drawn: " + std::to_string(visGrids)).c_str());
+	if (*_terrainManager->HorizonCulling())
+		ImGui::Text("Behind the terrain: %d grids, %d objects", _terrainManager->OccludedGrids(), _objectsManager->TerrainOccluded());
+	const auto streamedMb = TextureManager::StreamedBytes() >> 20;
+	const auto budgetMb = TextureManager::StreamingBudget() >> 20;
+	ImGui::Text(("Streamed textures MB: " + std::to_string(streamedMb) + "/" + std::to_string(budgetMb)).c_str());
 	ImGui::End();
 
 	DrawToasts();
@@ -479,6 +539,29 @@ void MyApp::DrawInterface()
 void MyApp::DrawObjectsList(int& btnId)
 {
 	ImGui::Checkbox("Draw Debug", _objectsManager->DrawDebug());
+	ImGui::Checkbox("Occlusion Culling", _objectsManager->OcclusionCulling());
+	ImGui::Checkbox("PVS", _objectsManager->UsePvs());
+	ImGui::SameLine();
+	if (ImGui::Button("Bake PVS") && !_objectsManager->BakePvs(PvsBakeSettings(), gPvsFile))
+	{
+		AddToast("Failed to save the PVS");
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Load PVS") && !_objectsManager->LoadPvs(gPvsFile))
+	{
+		AddToast("No PVS baked for this scene");
+	}
+	if (ImGui::Button("Pack small textures"))
+	{
+		_packTextures = true;
+	}
+	auto lodSettings = _objectsManager->LodSelection();
+	ImGui::SliderFloat("LOD Error (px)", &lodSettings->Tolerance, 0.1f, 16.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+	ImGui::InputInt("Triangle Budget", &lodSettings->TriangleBudget, 10000, 100000);
+	lodSettings->TriangleBudget = (std::max)(lodSettings->TriangleBudget, 0);
+	ImGui::SliderFloat("Min Size (px)", _objectsManager->MinScreenSize(), 0.0f, 16.0f, "%.1f");
+	ImGui::SliderFloat("Min Cascade Caster (texels)", _lightingManager->MinCascadeTexels(), 0.0f, 32.0f, "%.1f");
+	ImGui::SliderFloat("Min Local Caster (texels)", _lightingManager->MinLocalLightTexels(), 0.0f, 32.0f, "%.1f");
 
 	if (ImGui::CollapsingHeader("Objects", ImGuiTreeNodeFlags_DefaultOpen))
 	{
@@ -640,7 +723,7 @@ void MyApp::DrawTerrain(int& btnId) const
 			ImGui::Text("Heightmap Texture:");
 			ImGui::PopID();
 			ImGui::PushID(btnId++);
-			if (ImGui::Button(heightTexHandle.Name.c_str()))
+			if (ImGui::Button(heightTexHandle.Name().c_str()))
 			{
 				WCHAR* texturePath;
 				if (BasicUtil::TryToOpenFile(L"Image Files", L"*.dds;*.png;*.jpg;*.jpeg;*.tga;*.bmp", texturePath))
@@ -663,6 +746,8 @@ void MyApp::DrawTerrain(int& btnId) const
 				_terrainManager->SetDirty();
 			}
 		}
+
+		ImGui::Checkbox("Horizon Culling", _terrainManager->HorizonCulling());
 		
 		{
 			for (int i = 0; i < static_cast<int>(TerrainTexture::Count); i++)
@@ -733,7 +818,7 @@ void MyApp::DrawTerrainTexture(int& btnId, const int index, const char* label) c
 			{
 				selectedTabs[index] = 1;
 				
-				const std::string name = BasicUtil::TrimName(property->texture.Name, 15);
+				const std::string name = BasicUtil::TrimName(property->texture.Name(), 15);
 
 				TextureHandle texHandle = property->texture;
 
@@ -765,6 +850,26 @@ void MyApp::DrawTerrainTexture(int& btnId, const int index, const char* label) c
 	}
 }
 
+void MyApp::DrawEnvironment()
+{
+	if (ImGui::CollapsingHeader("Environment"))
+	{
+		ImGui::Text(("Sky: " + _cubeMapManager->EnvironmentName(CubeMap::Skybox)).c_str());
+		if (ImGui::Button("Bake from file"))
+		{
+			WCHAR* environmentPath;
+			if (BasicUtil::TryToOpenFile(L"Environment Files", L"*.hdr;*.dds;*.png;*.jpg", environmentPath))
+			{
+				if (!_cubeMapManager->BakeEnvironment(environmentPath))
+				{
+					AddToast("Failed to bake the environment");
+				}
+				CoTaskMemFree(environmentPath);
+			}
+		}
+	}
+}
+
 void MyApp::DrawAtmosphere(int& btnId)
 {
 	if (ImGui::CollapsingHeader("Atmosphere"))
@@ -939,6 +1044,8 @@ void MyApp::DrawLightData(int& btnId) const
 	if (ImGui::CollapsingHeader("Local lights"))
 	{
 		ImGui::Checkbox("Debug", _lightingManager->DebugEnabled());
+		ImGui::SameLine();
+		ImGui::Checkbox("Clustered", _lightingManager->ClusteredLighting());
 		if (ImGui::Button("Add light"))
 		{
 			_lightingManager->AddLight(_device.Get());
@@ -1077,6 +1184,15 @@ void MyApp::DrawObjectInfo(int& btnId)
 		}
 	}
 
+	if (_selectedModels.size() == 1)
+	{
+		//open and tesselated meshes have no occluder to draw
+		const auto ri = _objectsManager->Object(*_selectedModels.begin());
+		ImGui::BeginDisabled(!ri->Occluder);
+		ImGui::Checkbox("Occluder", &ri->IsOccluder);
+		ImGui::EndDisabled();
+	}
+
 	ImGui::End();
 }
 
@@ -1299,7 +1415,7 @@ void MyApp::DrawMaterials(int& btnId) const
 		for (const int i : visibleMaterialIndices)
 		{
 			const bool isSelected = (selectedMaterial == i);
-			if (ImGui::Selectable(ri->Materials[i].get()->name.c_str(), isSelected))
+			if (ImGui::Selectable(NameTable::Name(ri->Materials[i]->name).c_str(), isSelected))
 				selectedMaterial = i;
 
 			if (isSelected)
@@ -1367,7 +1483,7 @@ void MyApp::DrawMaterialProperty(Material* material, const std::string& label, c
 			{
 				selectedTabs[index] = 1;
 
-				const std::string name = BasicUtil::TrimName(material->properties[index].texture.Name, 15);
+				const std::string name = BasicUtil::TrimName(material->properties[index].texture.Name(), 15);
 
 				TextureHandle texHandle = material->properties[index].texture;
 
@@ -1377,7 +1493,8 @@ void MyApp::DrawMaterialProperty(Material* material, const std::string& label, c
 					WCHAR* texturePath;
 					if (BasicUtil::TryToOpenFile(L"Image Files", L"*.dds;*.png;*.jpg;*.jpeg;*.tga;*.bmp", texturePath))
 					{
-						texHandle = TextureManager::LoadTexture(texturePath, material->properties[index].texture.Index, static_cast<int>(_selectedModels.size()));
+						texHandle = TextureManager::LoadTexture(texturePath, material->properties[index].texture.Id, static_cast<int>(_selectedModels.size()),
+							TextureRoleOf(static_cast<MatProp>(index)), true);
 						material->properties[index].texture = texHandle;
 						material->numFramesDirty = gNumFrameResources;
 						CoTaskMemFree(texturePath);
@@ -1389,8 +1506,7 @@ void MyApp::DrawMaterialProperty(Material* material, const std::string& label, c
 					ImGui::PushID(btnId++);
 					if (ImGui::Button("delete") && texHandle.UseTexture == true)
 					{
-						const std::string texName = texHandle.Name;
-						TextureManager::DeleteTexture(std::wstring(texName.begin(), texName.end()), static_cast<int>(_selectedModels.size()));
+						TextureManager::DeleteTexture(texHandle.Id, static_cast<int>(_selectedModels.size()));
 						material->properties[index].texture = TextureHandle();
 						material->properties[index].texture.UseTexture = true;
 						material->numFramesDirty = gNumFrameResources;
@@ -1436,7 +1552,7 @@ void MyApp::DrawMaterialTexture(Material* material, const std::string& label, co
 	if (ImGui::TreeNode(label.c_str()))
 	{
 		TextureHandle texHandle = material->textures[index];
-		const std::string name = BasicUtil::TrimName(texHandle.Name, 15);
+		const std::string name = BasicUtil::TrimName(texHandle.Name(), 15);
 
 		ImGui::PushID(btnId++);
 		if (ImGui::Button(name.c_str()))
@@ -1444,7 +1560,8 @@ void MyApp::DrawMaterialTexture(Material* material, const std::string& label, co
 			WCHAR* texturePath;
 			if (BasicUtil::TryToOpenFile(L"Image Files", L"*.dds;*.png;*.jpg;*.jpeg;*.tga;*.bmp", texturePath))
 			{
-				texHandle = TextureManager::LoadTexture(texturePath, material->textures[index].Index, static_cast<int>(_selectedModels.size()));
+				texHandle = TextureManager::LoadTexture(texturePath, material->textures[index].Id, static_cast<int>(_selectedModels.size()),
+					TextureRoleOf(static_cast<MatTex>(index)), true);
 				material->textures[index] = texHandle;
 				material->numFramesDirty = gNumFrameResources;
 				CoTaskMemFree(texturePath);
@@ -1456,8 +1573,7 @@ void MyApp::DrawMaterialTexture(Material* material, const std::string& label, co
 			ImGui::PushID(btnId++);
 			if (ImGui::Button("delete") && texHandle.UseTexture == true)
 			{
-				const std::string texName = texHandle.Name;
-				TextureManager::DeleteTexture(std::wstring(texName.begin(), texName.end()), static_cast<int>(_selectedModels.size()));
+				TextureManager::DeleteTexture(texHandle.Id, static_cast<int>(_selectedModels.size()));
 				material->textures[index] = TextureHandle();
 				material->numFramesDirty = gNumFrameResources;
 			}
@@ -1497,7 +1613,7 @@ void MyApp::DrawMaterialArmTexture(Material* material, const std::string& label,
 		}
 
 		TextureHandle texHandle = material->textures[index];
-		const std::string name = BasicUtil::TrimName(texHandle.Name, 15);
+		const std::string name = BasicUtil::TrimName(texHandle.Name(), 15);
 
 		ImGui::PushID(btnId++);
 		if (ImGui::Button(name.c_str()))
@@ -1505,7 +1621,8 @@ void MyApp::DrawMaterialArmTexture(Material* material, const std::string& label,
 			WCHAR* texturePath;
 			if (BasicUtil::TryToOpenFile(L"Image Files", L"*.dds;*.png;*.jpg;*.jpeg;*.tga;*.bmp", texturePath))
 			{
-				texHandle = TextureManager::LoadTexture(texturePath, material->textures[index].Index, static_cast<int>(_selectedModels.size()));
+				texHandle = TextureManager::LoadTexture(texturePath, material->textures[index].Id, static_cast<int>(_selectedModels.size()),
+					TextureRoleOf(static_cast<MatTex>(index)), true);
 				material->textures[index] = texHandle;
 				material->numFramesDirty = gNumFrameResources;
 				CoTaskMemFree(texturePath);
@@ -1517,8 +1634,7 @@ void MyApp::DrawMaterialArmTexture(Material* material, const std::string& label,
 			ImGui::PushID(btnId++);
 			if (ImGui::Button("delete") && texHandle.UseTexture == true)
 			{
-				const std::string texName = texHandle.Name;
-				TextureManager::DeleteTexture(std::wstring(texName.begin(), texName.end()), static_cast<int>(_selectedModels.size()));
+				TextureManager::DeleteTexture(texHandle.Id, static_cast<int>(_selectedModels.size()));
 				material->textures[index] = TextureHandle();
 				material->numFramesDirty = gNumFrameResources;
 			}
@@ -1542,12 +1658,15 @@ void MyApp::DrawLoDs(int& btnId)
 		{
 			const bool isSelected = ri->CurrentLodIdx == i;
 
-			std::string label = "LOD " + std::to_string(i) + " (" + std::to_string(lods[i].TriangleCount) + " triangles)";
-			if (_fixedLod)
+			char error[16];
+			snprintf(error, sizeof(error), "%.3g", lods[i].Error);
+			std::string label = "LOD " + std::to_string(i) + " (" + std::to_string(lods[i].TriangleCount) + " triangles, error " + error + ")";
+			if (_objectsManager->LodSelection()->Fixed)
 			{
 				if (ImGui::Selectable(label.c_str(), isSelected))
 				{
 					ri->CurrentLodIdx = i;
+					ri->RayTracingDirty = true;
 				}
 			}
 			else
@@ -1688,7 +1807,7 @@ void MyApp::DrawHeader()
 	ImGui::Begin("##header", nullptr, ImGuiWindowFlags_NoResize);
 	ImGui::Columns(2, "MyColumns", true); // true for borders
 	//fixed lod
-	ImGui::Checkbox("Fixed LOD", &_fixedLod);
+	ImGui::Checkbox("Fixed LOD", &_objectsManager->LodSelection()->Fixed);
 	ImGui::NextColumn();
 	DrawCameraSpeed();
 	ImGui::End();
@@ -1704,7 +1823,7 @@ void MyApp::AddRenderItem(ModelData data)
 {
 	if (_supportsRayTracing)
 	{
-		for (auto& lod : GeometryManager::Geometries()[data.CroppedName])
+		for (auto& lod : GeometryManager::Geometry(data.GeoId))
 		{
 			GeometryManager::BuildBlasForMesh(*lod.get());
 		}
@@ -1815,13 +1934,13 @@ void MyApp::AddLod()
 		if (_modelManager->ImportLodObject(pszFilePath, static_cast<int>(ri->LodsData.begin()->Meshes.size())))
 		{
 			const auto lod = _modelManager->ParseAsLodObject();
-			const LodData data = { static_cast<int>(lod.Indices.size()) / 3, lod.Meshes };
+			const LodData data = { static_cast<int>(lod.Indices.size()) / 3, lod.Meshes, GeometryManager::LodError(ri->GeoId, lod) };
 			//generating it as one mesh
 			const int lodIdx = _objectsManager->AddLod(_device.Get(), data, ri);
-			GeometryManager::AddLodGeometry(ri->Name, lodIdx, lod);
+			GeometryManager::AddLodGeometry(ri->GeoId, lodIdx, lod);
 			if (_supportsRayTracing)
 			{
-				GeometryManager::BuildBlasForMesh(*(GeometryManager::Geometries()[ri->Name].end() - 1)->get());
+				GeometryManager::BuildBlasForMesh(*(GeometryManager::Geometry(ri->GeoId).end() - 1)->get());
 				UploadManager::ExecuteUploadCommandList();
 			}
 			AddToast("Your LOD was added as LOD" + std::to_string(lodIdx) + "!");
@@ -1835,7 +1954,7 @@ void MyApp::AddShadowMask() const
 	WCHAR* texturePath;
 	if (BasicUtil::TryToOpenFile(L"Image Files", L"*.dds;*.png;*.jpg;*.jpeg;*.tga;*.bmp", texturePath))
 	{
-		const TextureHandle texHandle = TextureManager::LoadTexture(texturePath, -1, 1);
+		const TextureHandle texHandle = TextureManager::LoadTexture(texturePath, gInvalidNameId, 1);
 		_lightingManager->AddShadowMask(texHandle);
 		CoTaskMemFree(texturePath);
 	}
@@ -1909,6 +2028,7 @@ void MyApp::InitManagers()
 	_terrainManager = std::make_unique<TerrainManager>(_device.Get());
 	_terrainManager->BindToOtherData(&_camera);
 	_terrainManager->Init();
+	_objectsManager->BindTerrainHorizon(&_terrainManager->Horizon());
 
 	_taaManager = std::make_unique<TaaManager>(_device.Get());
 	_taaManager->BindToManagers(_lightingManager.get(), _gBuffer.get(), &_camera);
@@ -1950,7 +2070,7 @@ void MyApp::GBufferPass() const
 	mCommandList->OMSetRenderTargets(_gBuffer->InfoCount(), _gBuffer->Rtvs().data(),
 	                                 false, &dsv);
 
-	_objectsManager->Draw(mCommandList.Get(), _currFrameResource, static_cast<float>(mClientHeight), _isWireframe, _fixedLod);
+	_objectsManager->Draw(mCommandList.Get(), _currFrameResource, _isWireframe);
 
 	_terrainManager->Draw(mCommandList.Get(), _currFrameResource);
 }
@@ -1984,7 +2104,7 @@ void MyApp::WireframePass() const
 	const auto dsv = _gBuffer->DepthStencilView();
 	mCommandList->OMSetRenderTargets(1, &currentBackBuffer, true, &dsv);
 
-	_objectsManager->Draw(mCommandList.Get(), _currFrameResource, static_cast<float>(mClientHeight), _isWireframe);
+	_objectsManager->Draw(mCommandList.Get(), _currFrameResource, _isWireframe);
 }
 
 void MyApp::FinalPass() const
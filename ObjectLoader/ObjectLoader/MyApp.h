@@ -77,6 +77,7 @@ private:
 	void DrawTerrain(int& btnId) const;
 	void DrawTerrainTexture(int& btnId, int index, const char* label) const;
 	void DrawAtmosphere(int& btnId);
+	void DrawEnvironment();
 
 	void DrawHandSpotlight(int& btnId) const;
 	void DrawLightData(int& btnId) const;
@@ -150,7 +151,8 @@ private:
 	float _cameraSpeed = 0.01f;
 	bool _mbDown = false;
 	bool _isWireframe = false;
-	bool _fixedLod = false;
+	//set by the ui, packed before the next cbs are written so draws never see a page without its rects
+	bool _packTextures = false;
 
 	POINT _lastMousePos;
 
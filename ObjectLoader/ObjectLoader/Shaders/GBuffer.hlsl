@@ -49,6 +49,10 @@ cbuffer cbPerMaterial : register(b1)
     
     int ARMLayout;
     float3 padcpm;
+    
+    //xy scale and zw offset of the part of each texture register's view the material uses,
+    //less than all of it for textures packed into an atlas page
+    float4 uvRects[8];
 }
 
 cbuffer cbPass : register(b2)
@@ -82,6 +86,28 @@ struct VertexOut
     float3 BiNormalW : BINORMAL;
 };
 
+//atlas rects only cover their own texels, so the address mode is applied here and the sampler
+//never leaves the rect. gradients come from the unwrapped uvs, a wrap seam would pick the smallest mip otherwise
+float4 SampleRect(Texture2D map, SamplerState samp, float2 addressed, float2 uv, float4 rect)
+{
+    return map.SampleGrad(samp, addressed * rect.xy + rect.zw, ddx(uv) * rect.xy, ddy(uv) * rect.xy);
+}
+
+float4 SampleWrap(Texture2D map, SamplerState samp, float2 uv, float4 rect)
+{
+    return SampleRect(map, samp, frac(uv), uv, rect);
+}
+
+float4 SampleClamp(Texture2D map, SamplerState samp, float2 uv, float4 rect)
+{
+    return SampleRect(map, samp, saturate(uv), uv, rect);
+}
+
+float2 MirrorUv(float2 uv)
+{
+    return 1.0f - abs(frac(uv * 0.5f) * 2.0f - 1.0f);
+}
+
 float Halton(uint index, uint base)
 {
     float f = 1.0f;
@@ -273,7 +299,7 @@ VertexOut TessDS(PatchTess patchTess,
     if (useDisplacementMap)
     {
 	    // Displacement mapping
-        posW += float4(vout.NormalW, 0) * gDisplacementMap.SampleLevel(gsamLinearMirror, vout.TexC, 0).r * displacementScale;
+        posW += float4(vout.NormalW, 0) * gDisplacementMap.SampleLevel(gsamLinearMirror, MirrorUv(vout.TexC) * uvRects[6].xy + uvRects[6].zw, 0).r * displacementScale;
     }
     
     vout.PosW = posW.xyz;
@@ -305,15 +331,17 @@ GBufferInfo GBufferPS(VertexOut pin)
             normalize(pin.NormalW)
         };
         
-        pin.NormalW = gNormalMap.Sample(gsamPointWrap, pin.TexC).xyz * 2.0f - 1.0f;
+        //z is rebuilt, so two-channel (bc5) normal maps work as well
+        float2 normalXY = SampleWrap(gNormalMap, gsamPointWrap, pin.TexC, uvRects[4]).xy * 2.0f - 1.0f;
+        pin.NormalW = float3(normalXY, sqrt(saturate(1.0f - dot(normalXY, normalXY))));
         pin.NormalW = mul(pin.NormalW, tbnMat);
     }
     
-    res.BaseColor = useBaseColorMap ? gBaseColorMap.Sample(gsamLinearClamp, pin.TexC) : float4(baseColor, 1);
+    res.BaseColor = useBaseColorMap ? SampleClamp(gBaseColorMap, gsamLinearClamp, pin.TexC, uvRects[0]) : float4(baseColor, 1);
     res.Normal = float4(normalize(pin.NormalW), 1);
     if (useARMMap)
     {
-        res.ORM = saturate(gARMMap.Sample(gsamPointClamp, pin.TexC));
+        res.ORM = saturate(SampleClamp(gARMMap, gsamPointClamp, pin.TexC, uvRects[7]));
         if (ARMLayout == 1)
         {
             res.ORM.rgb = res.ORM.gbr;
@@ -321,12 +349,12 @@ GBufferInfo GBufferPS(VertexOut pin)
     }
     else
     {
-        res.ORM.r = useAOMap ? saturate(gAOMap.Sample(gsamPointClamp, pin.TexC).r) : 0.3f;
-        res.ORM.g = useRoughnessMap ? saturate(gRoughnessMap.Sample(gsamPointClamp, pin.TexC).g) : roughness;
-        res.ORM.b = useMetallicMap ? saturate(gMetallicMap.Sample(gsamPointClamp, pin.TexC).b) : metallic;
+        res.ORM.r = useAOMap ? saturate(SampleClamp(gAOMap, gsamPointClamp, pin.TexC, uvRects[5]).r) : 0.3f;
+        res.ORM.g = useRoughnessMap ? saturate(SampleClamp(gRoughnessMap, gsamPointClamp, pin.TexC, uvRects[2]).g) : roughness;
+        res.ORM.b = useMetallicMap ? saturate(SampleClamp(gMetallicMap, gsamPointClamp, pin.TexC, uvRects[3]).b) : metallic;
         res.ORM.a = 1.f;
     }
-    res.Emissive.xyz = useEmissiveMap ? gEmissiveMap.Sample(gsamPointClamp, pin.TexC).xyz : emissive;
+    res.Emissive.xyz = useEmissiveMap ? SampleClamp(gEmissiveMap, gsamPointClamp, pin.TexC, uvRects[1]).xyz : emissive;
     res.Emissive.a = emissiveIntensity;
     res.TexCoord = pin.TexC;
 	res.Velocity = clamp(pin.Velocity, -0.25f, 0.25f);
@@ -157,6 +157,15 @@ float4 ComputeLocalLighting(int lightIndex, float3 posW, float3 coords)
     return outputColor;
 }
 
+//lights of the cluster the pixel falls into, laid out the way LightClusters builds them on the cpu
+uint2 ClusterLights(float2 pixel, float3 posW)
+{
+    float viewZ = max(dot(posW - gEyePosW, cameraLook), 0.0001f);
+    int slice = clamp(int(floor(log(viewZ) * sliceScale + sliceBias)), 0, clusterCounts.z - 1);
+    int2 tile = min(int2(pixel / gRTSize * clusterCounts.xy), clusterCounts.xy - 1);
+    return lightClusters[(slice * clusterCounts.y + tile.y) * clusterCounts.x + tile.x];
+}
+
 //actually just a full quad pass, not only for directional light
 float4 DirLightingPS(VertexOut pin) : SV_Target
 {   
@@ -218,10 +227,22 @@ float4 DirLightingPS(VertexOut pin) : SV_Target
         }
     }
     
-    //lighting for every light we are inside of
-    for (int i = 0; i < lightsContainingFrustum; i++)
+    if (clustered)
     {
-        finalColor.xyz += ComputeLocalLighting(lightIndices[i].index, posW, coords).xyz;
+        //every visible light touching the pixel's cluster, no light volumes are drawn
+        uint2 range = ClusterLights(coords.xy, posW);
+        for (uint j = 0; j < range.y; j++)
+        {
+            finalColor.xyz += ComputeLocalLighting(clusterLightIndices[range.x + j], posW, coords).xyz;
+        }
+    }
+    else
+    {
+        //lighting for every light we are inside of
+        for (int i = 0; i < lightsContainingFrustum; i++)
+        {
+            finalColor.xyz += ComputeLocalLighting(lightIndices[i].index, posW, coords).xyz;
+        }
     }
     
     return finalColor;
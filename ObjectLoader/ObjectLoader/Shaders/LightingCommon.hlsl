@@ -27,6 +27,9 @@ static const float PI = 3.14159265f;
 
 StructuredBuffer<Light> lights : register(t0, space1);
 StructuredBuffer<LightIndex> lightIndices : register(t1, space1);
+//offset and count of every cluster's lights in clusterLightIndices
+StructuredBuffer<uint2> lightClusters : register(t2, space1);
+StructuredBuffer<uint> clusterLightIndices : register(t3, space1);
 
 struct Cascade
 {
@@ -43,6 +46,12 @@ cbuffer cbDirLight : register(b1)
     int lightsContainingFrustum;
     Light mainSpotlight;
     Cascade cascades[3];
+    float3 cameraLook;
+    int clustered;
+    int3 clusterCounts;
+    float sliceScale;
+    float sliceBias;
+    float3 clusterPad;
 };
 
 struct VertexIn
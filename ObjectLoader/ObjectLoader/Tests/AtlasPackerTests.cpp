@@ -0,0 +1,205 @@
+#include "Check.h"
+#include "AtlasPacker.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+	//bc7 like entries with a full chain
+	AtlasEntry Bc(const int width, const int height, const std::uint32_t group = 98)
+	{
+		return { width, height, 9, group, 4 };
+	}
+
+	//cells are the entries with their gutter, no two may overlap and all of them stay inside their page
+	bool CellsAreDisjoint(const std::vector<AtlasEntry>& entries, const AtlasLayout& layout, const AtlasSettings& settings)
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const AtlasPlacement& a = layout.Placements[i];
+			if (a.Page < 0)
+				continue;
+			const int alignA = AtlasPacker::Alignment(entries[i], settings);
+			const AtlasPage& page = layout.Pages[a.Page];
+			if (a.X < 0 || a.Y < 0 || a.X + entries[i].Width + alignA > page.Width || a.Y + entries[i].Height + alignA > page.Height)
+				return false;
+
+			for (size_t j = i + 1; j < entries.size(); j++)
+			{
+				const AtlasPlacement& b = layout.Placements[j];
+				if (b.Page != a.Page)
+					continue;
+				const int alignB = AtlasPacker::Alignment(entries[j], settings);
+				const bool apart = a.X + entries[i].Width + alignA <= b.X || b.X + entries[j].Width + alignB <= a.X ||
+					a.Y + entries[i].Height + alignA <= b.Y || b.Y + entries[j].Height + alignB <= a.Y;
+				if (!apart)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void TestAlignment()
+	{
+		AtlasSettings settings;
+		settings.MipCount = 4;
+		CHECK(AtlasPacker::Alignment(Bc(64, 64), settings) == 32);
+		CHECK(AtlasPacker::Alignment({ 64, 64, 9, 28, 1 }, settings) == 8);
+		settings.MipCount = 1;
+		CHECK(AtlasPacker::Alignment(Bc(64, 64), settings) == 4);
+	}
+
+	void TestRejects()
+	{
+		AtlasSettings settings;
+		CHECK(AtlasPacker::CanPack(Bc(64, 128), settings));
+		CHECK(!AtlasPacker::CanPack(Bc(512, 512), settings));
+		//coarser mips would split blocks
+		CHECK(!AtlasPacker::CanPack(Bc(48, 64), settings));
+		CHECK(!AtlasPacker::CanPack({ 64, 64, 2, 98, 4 }, settings));
+		CHECK(!AtlasPacker::CanPack(Bc(0, 64), settings));
+		settings.PageSize = 64;
+		CHECK(!AtlasPacker::CanPack(Bc(64, 64), settings));
+	}
+
+	void TestGridAndGutters()
+	{
+		AtlasSettings settings;
+		std::vector<AtlasEntry> entries;
+		std::mt19937 random(7);
+		const int sizes[] = { 64, 128, 256 };
+		for (int i = 0; i < 120; i++)
+			entries.push_back(Bc(sizes[random() % 3], sizes[random() % 3]));
+
+		const AtlasLayout layout = AtlasPacker::Pack(entries, settings);
+		CHECK(CellsAreDisjoint(entries, layout, settings));
+
+		int placed = 0;
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const AtlasPlacement& placement = layout.Placements[i];
+			CHECK(placement.Page >= 0);
+			placed += placement.Page >= 0;
+			CHECK(placement.X % 32 == 0 && placement.Y % 32 == 0);
+		}
+		//pages are trimmed to whole grid cells, so every mip of them is whole blocks
+		int members = 0;
+		for (const AtlasPage& page : layout.Pages)
+		{
+			CHECK(page.Width % 32 == 0 && page.Height % 32 == 0);
+			CHECK(page.Width <= settings.PageSize && page.Height <= settings.PageSize);
+			members += page.Entries;
+		}
+		CHECK(members == placed);
+	}
+
+	void TestSameSizeFillsRows()
+	{
+		//96 texel cells, 21 per row of a 2048 page
+		AtlasSettings settings;
+		const std::vector<AtlasEntry> entries(42, Bc(64, 64));
+		const AtlasLayout layout = AtlasPacker::Pack(entries, settings);
+		CHECK(layout.Pages.size() == 1);
+		CHECK(layout.Pages[0].Width == 21 * 96);
+		CHECK(layout.Pages[0].Height == 2 * 96);
+		CHECK(layout.Placements[0].X == 0 && layout.Placements[0].Y == 0);
+		CHECK(layout.Placements[21].X == 0 && layout.Placements[21].Y == 96);
+	}
+
+	void TestOverflowOpensPages()
+	{
+		AtlasSettings settings;
+		settings.PageSize = 1024;
+		//288 texel cells, 3 x 3 per page
+		const std::vector<AtlasEntry> entries(20, Bc(256, 256));
+		const AtlasLayout layout = AtlasPacker::Pack(entries, settings);
+		CHECK(layout.Pages.size() == 3);
+		CHECK(layout.Pages[0].Entries == 9);
+		CHECK(layout.Pages[1].Entries == 9);
+		CHECK(layout.Pages[2].Entries == 2);
+		CHECK(CellsAreDisjoint(entries, layout, settings));
+	}
+
+	void TestGroupsStayApart()
+	{
+		AtlasSettings settings;
+		std::vector<AtlasEntry> entries;
+		for (int i = 0; i < 6; i++)
+		{
+			entries.push_back(Bc(128, 128, 98));
+			entries.push_back(Bc(128, 128, 99));
+		}
+		const AtlasLayout layout = AtlasPacker::Pack(entries, settings);
+		CHECK(layout.Pages.size() == 2);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const AtlasPlacement& placement = layout.Placements[i];
+			CHECK(placement.Page >= 0 && layout.Pages[placement.Page].Group == entries[i].Group);
+		}
+	}
+
+	void TestLonelyEntriesStayOut()
+	{
+		AtlasSettings settings;
+		//one entry in each of two groups, and big ones that do not fit beside each other
+		settings.PageSize = 512;
+		const std::vector<AtlasEntry> entries = { Bc(64, 64, 1), Bc(64, 64, 2), Bc(256, 256, 3), Bc(256, 256, 3),
+			Bc(64, 64, 3), Bc(256, 256, 3) };
+		const AtlasLayout layout = AtlasPacker::Pack(entries, settings);
+		CHECK(layout.Placements[0].Page == -1);
+		CHECK(layout.Placements[1].Page == -1);
+		//288 texel cells, one per page: the small one joins the first, the other two are left alone
+		CHECK(layout.Pages.size() == 1);
+		CHECK(layout.Placements[2].Page == 0 && layout.Placements[4].Page == 0);
+		CHECK(layout.Placements[4].X == 288 && layout.Placements[4].Y == 0);
+		CHECK(layout.Placements[3].Page == -1);
+		CHECK(layout.Placements[5].Page == -1);
+	}
+
+	void TestDeterministic()
+	{
+		AtlasSettings settings;
+		std::vector<AtlasEntry> entries;
+		for (int i = 0; i < 30; i++)
+			entries.push_back(Bc(64 << (i % 3), 64 << ((i / 3) % 3)));
+		const AtlasLayout a = AtlasPacker::Pack(entries, settings);
+		const AtlasLayout b = AtlasPacker::Pack(entries, settings);
+		bool same = a.Pages.size() == b.Pages.size();
+		for (size_t i = 0; same && i < entries.size(); i++)
+			same = a.Placements[i].Page == b.Placements[i].Page && a.Placements[i].X == b.Placements[i].X &&
+				a.Placements[i].Y == b.Placements[i].Y;
+		CHECK(same);
+	}
+
+	void TestUvRect()
+	{
+		const AtlasEntry entry = Bc(128, 64);
+		const AtlasPage page = { 98, 1024, 512, 2 };
+		const AtlasUvRect rect = AtlasPacker::UvRect(entry, { 0, 256, 128 }, page);
+		CHECK_NEAR(rect.ScaleU, 0.125, 1e-7);
+		CHECK_NEAR(rect.ScaleV, 0.125, 1e-7);
+		CHECK_NEAR(rect.OffsetU, 0.25, 1e-7);
+		CHECK_NEAR(rect.OffsetV, 0.25, 1e-7);
+		//far corner of the texture lands on the far corner of its rect
+		CHECK_NEAR((1.0f * rect.ScaleU + rect.OffsetU) * page.Width, 256 + 128, 1e-4);
+		CHECK_NEAR((1.0f * rect.ScaleV + rect.OffsetV) * page.Height, 128 + 64, 1e-4);
+
+		const AtlasUvRect identity = AtlasPacker::UvRect(entry, {}, page);
+		CHECK(identity.ScaleU == 1.0f && identity.ScaleV == 1.0f && identity.OffsetU == 0.0f && identity.OffsetV == 0.0f);
+	}
+}
+
+int main()
+{
+	TestAlignment();
+	TestRejects();
+	TestGridAndGutters();
+	TestSameSizeFillsRows();
+	TestOverflowOpensPages();
+	TestGroupsStayApart();
+	TestLonelyEntriesStayOut();
+	TestDeterministic();
+	TestUvRect();
+	return CheckResult();
+}
@@ -0,0 +1,179 @@
+#include "Check.h"
+#include "CasterVolume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+//the volume is the receivers swept toward the light: every point whose shadow ray reaches a receiver
+//is inside it, and points past the receivers or beside the sweep are not
+namespace
+{
+	typedef XMFLOAT3 Corners[8];
+
+	//receivers of a cascade, a slice of a turned camera frustum
+	void RandomSlice(std::mt19937& random, Corners& corners)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const BoundingFrustum view(XMMatrixPerspectiveFovLH(0.25f * XM_PI + unit(random), 1.0f + unit(random), 0.1f, 100.0f));
+		const XMMATRIX invView = XMMatrixRotationRollPitchYaw(unit(random) - 0.5f, unit(random) * XM_2PI, 0.0f) *
+			XMMatrixTranslation(unit(random) * 20.0f - 10.0f, unit(random) * 4.0f, unit(random) * 20.0f - 10.0f);
+		const float nearDepth = 0.1f + unit(random) * 20.0f;
+		CasterVolume::FrustumSlice(view, invView, nearDepth, nearDepth + 1.0f + unit(random) * 40.0f, corners);
+	}
+
+	XMVECTOR RandomDirection(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		//mostly downward, like a sun
+		return XMVector3Normalize(XMVectorSet(unit(random), -1.0f - std::abs(unit(random)), unit(random), 0.0f));
+	}
+
+	//a convex combination of the corners, always inside the hexahedron
+	XMVECTOR PointInside(const Corners& corners, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const float u = unit(random);
+		const float v = unit(random);
+		const float w = unit(random);
+		XMVECTOR faces[2];
+		for (int face = 0; face < 2; face++)
+		{
+			const XMVECTOR top = XMVectorLerp(XMLoadFloat3(&corners[face * 4]), XMLoadFloat3(&corners[face * 4 + 1]), u);
+			const XMVECTOR bottom = XMVectorLerp(XMLoadFloat3(&corners[face * 4 + 3]), XMLoadFloat3(&corners[face * 4 + 2]), u);
+			faces[face] = XMVectorLerp(top, bottom, v);
+		}
+		return XMVectorLerp(faces[0], faces[1], w);
+	}
+
+	float Diameter(const Corners& corners)
+	{
+		float diameter = 0.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			for (int j = i + 1; j < 8; j++)
+				diameter = (std::max)(diameter, XMVectorGetX(XMVector3Length(XMLoadFloat3(&corners[i]) - XMLoadFloat3(&corners[j]))));
+		}
+		return diameter;
+	}
+
+	BoundingBox Speck(FXMVECTOR point)
+	{
+		BoundingBox box;
+		XMStoreFloat3(&box.Center, point);
+		box.Extents = XMFLOAT3(0.01f, 0.01f, 0.01f);
+		return box;
+	}
+
+	void TestCastersAreKept()
+	{
+		std::mt19937 random(81);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		bool kept = true;
+		for (int volumeIndex = 0; volumeIndex < 200; volumeIndex++)
+		{
+			Corners corners;
+			RandomSlice(random, corners);
+			const XMVECTOR light = RandomDirection(random);
+			const CasterVolume volume = CasterVolume::FromReceivers(corners, light);
+			CHECK(volume.PlaneCount() <= CasterVolume::MaxPlanes);
+
+			//back along the light from a receiver point, anywhere up to far away
+			for (int i = 0; i < 200; i++)
+			{
+				const XMVECTOR caster = PointInside(corners, random) - light * (unit(random) * 200.0f);
+				kept = kept && volume.Contains(Speck(caster)) != DISJOINT;
+			}
+		}
+		CHECK(kept);
+	}
+
+	void TestOthersAreRejected()
+	{
+		std::mt19937 random(82);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		bool past = true;
+		bool beside = true;
+		for (int volumeIndex = 0; volumeIndex < 200; volumeIndex++)
+		{
+			Corners corners;
+			RandomSlice(random, corners);
+			const XMVECTOR light = RandomDirection(random);
+			const CasterVolume volume = CasterVolume::FromReceivers(corners, light);
+			const float diameter = Diameter(corners);
+
+			for (int i = 0; i < 50; i++)
+			{
+				//further along the light than the receivers reach, its shadow falls on nothing
+				const XMVECTOR after = PointInside(corners, random) + light * (diameter * (1.1f + unit(random)));
+				past = past && volume.Contains(Speck(after)) == DISJOINT;
+
+				//pushed sideways out of the sweep by more than the receivers are wide
+				const XMVECTOR side = XMVector3Normalize(XMVector3Cross(light, XMVectorSet(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f, 0.0f)));
+				const XMVECTOR aside = PointInside(corners, random) + side * (diameter * 1.1f) - light * (unit(random) * 50.0f);
+				beside = beside && volume.Contains(Speck(aside)) == DISJOINT;
+			}
+		}
+		CHECK(past);
+		CHECK(beside);
+	}
+
+	//an axis aligned box lit straight down, its sides run along the light and still bound the sweep
+	void TestLightAlongFaces()
+	{
+		const Corners box =
+		{
+			XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, 1.0f, -1.0f),
+			XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, 1.0f, 1.0f)
+		};
+		const CasterVolume volume = CasterVolume::FromReceivers(box, XMVectorSet(0.0f, -1.0f, 0.0f, 0.0f));
+		//the bottom, the four sides, and a silhouette plane through every edge of the top
+		CHECK(volume.PlaneCount() == 9);
+		CHECK(volume.Contains(BoundingBox(XMFLOAT3(0.0f, 50.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))) == CONTAINS);
+		CHECK(volume.Contains(BoundingBox(XMFLOAT3(0.9f, 50.0f, 0.9f), XMFLOAT3(0.5f, 0.5f, 0.5f))) == INTERSECTS);
+		CHECK(volume.Contains(BoundingBox(XMFLOAT3(2.0f, 50.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))) == DISJOINT);
+		CHECK(volume.Contains(BoundingBox(XMFLOAT3(0.0f, -3.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))) == DISJOINT);
+
+		//clipped to a box around the scene, casters above it are gone
+		CasterVolume clipped = volume;
+		clipped.Clip(CullingPlanes::FromOrientedBox(BoundingOrientedBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 10.0f, 10.0f),
+			XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f))));
+		CHECK(clipped.PlaneCount() == 15);
+		CHECK(clipped.Contains(BoundingBox(XMFLOAT3(0.0f, 5.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))) == CONTAINS);
+		CHECK(clipped.Contains(BoundingBox(XMFLOAT3(0.0f, 50.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))) == DISJOINT);
+	}
+
+	//the slice corners sit on the frustum's corner rays at the asked depths
+	void TestFrustumSlice()
+	{
+		const BoundingFrustum view(XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.1f, 100.0f));
+		const XMMATRIX viewMatrix = XMMatrixLookAtLH(XMVectorSet(3.0f, 4.0f, -5.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const XMMATRIX invView = XMMatrixInverse(nullptr, viewMatrix);
+		Corners corners;
+		CasterVolume::FrustumSlice(view, invView, 2.0f, 30.0f, corners);
+
+		XMFLOAT3 frustumCorners[BoundingFrustum::CORNER_COUNT];
+		view.GetCorners(frustumCorners);
+		for (int i = 0; i < 8; i++)
+		{
+			XMFLOAT3 local;
+			XMStoreFloat3(&local, XMVector3TransformCoord(XMLoadFloat3(&corners[i]), viewMatrix));
+			const float depth = i < 4 ? 2.0f : 30.0f;
+			const XMFLOAT3& ray = frustumCorners[i % 4];
+			CHECK_NEAR(local.z, depth, 1e-3);
+			CHECK_NEAR(local.x, ray.x / ray.z * depth, 1e-3);
+			CHECK_NEAR(local.y, ray.y / ray.z * depth, 1e-3);
+		}
+	}
+}
+
+int main()
+{
+	TestCastersAreKept();
+	TestOthersAreRejected();
+	TestLightAlongFaces();
+	TestFrustumSlice();
+	return CheckResult();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+//just enough to keep the headless tests free of a framework: failed checks are printed and counted,
+//the test's main returns CheckResult() so ctest sees the failure
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline int CheckResult()
+{
+	if (CheckFailures() != 0)
+	{
+		std::printf("%d check(s) failed\n", CheckFailures());
+	}
+	return CheckFailures() == 0 ? 0 : 1;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			CheckFailures()++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do { \
+		const double checkActual = static_cast<double>(actual); \
+		const double checkExpected = static_cast<double>(expected); \
+		if (!(std::fabs(checkActual - checkExpected) <= static_cast<double>(tolerance))) { \
+			std::printf("%s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #actual, #expected, checkActual, checkExpected); \
+			CheckFailures()++; \
+		} \
+	} while (0)
+
+//wall time of a callable in milliseconds, for the benchmarks
+template <typename Body>
+double MeasureMs(const Body& body)
+{
+	const auto start = std::chrono::steady_clock::now();
+	body();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,86 @@
+#include "Check.h"
+#include "CullCache.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//how often the cache is reused on a camera path like an editor's: still spans, slow orbits
+//and walks, and a quick turn now and then. timed against culling every frame from scratch.
+//usage: CullCacheBench [objects = 20000] [frames = 600]
+int main(int argc, char** argv)
+{
+	const int objectCount = argc > 1 ? std::atoi(argv[1]) : 20000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 600;
+
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::vector<BoundingBox> boxes;
+	for (int i = 0; i < objectCount; i++)
+		boxes.emplace_back(XMFLOAT3(position(random), position(random) * 0.1f, position(random)), XMFLOAT3(size(random), size(random), size(random)));
+
+	//spans of 60 frames: still, orbiting slowly, walking, then a quick turn
+	std::vector<CullingPlanes> planes;
+	float yaw = 0.0f;
+	XMFLOAT3 eye(0.0f, 2.0f, 0.0f);
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const int span = frame / 60 % 4;
+		if (span == 1)
+			yaw += 2e-4f;
+		else if (span == 2)
+		{
+			eye.x += 0.02f * std::sin(yaw);
+			eye.z += 0.02f * std::cos(yaw);
+		}
+		else if (span == 3)
+			yaw += 0.02f;
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 300.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(yaw) * XMMatrixTranslation(eye.x, eye.y, eye.z));
+		planes.push_back(CullingPlanes::FromFrustum(frustum));
+	}
+
+	SceneBvh bvh;
+	bvh.Build(boxes);
+
+	size_t fullCount = 0;
+	std::vector<int> result;
+	const double fullMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				result.clear();
+				bvh.Query(frame, result);
+				fullCount += result.size();
+			}
+		});
+
+	CullCache cache;
+	int reuses[3] = {};
+	size_t cachedCount = 0;
+	const double cachedMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				reuses[static_cast<int>(cache.Cull(bvh, boxes, frame, 1, result))]++;
+				cachedCount += result.size();
+			}
+		});
+
+	//both have to find the same boxes, otherwise the comparison means nothing
+	CHECK(fullCount == cachedCount);
+
+	const double percent = frames > 0 ? 100.0 / frames : 0.0;
+	std::printf("%d objects, %d frames, %zu visible per frame\n", objectCount, frames, frames > 0 ? fullCount / frames : 0);
+	std::printf("reuse: none %5.1f%%, exact %5.1f%%, band %5.1f%%\n",
+		reuses[static_cast<int>(CullCache::Reuse::None)] * percent,
+		reuses[static_cast<int>(CullCache::Reuse::Exact)] * percent,
+		reuses[static_cast<int>(CullCache::Reuse::Band)] * percent);
+	std::printf("bvh:    %8.4f ms/frame\n", fullMs / frames);
+	std::printf("cached: %8.4f ms/frame (%.1fx)\n", cachedMs / frames, cachedMs > 0.0 ? fullMs / cachedMs : 0.0);
+	return CheckResult();
+}
@@ -0,0 +1,185 @@
+#include "Check.h"
+#include "CullCache.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//whatever the cache reuses, every frame has to give what a cull from scratch would
+namespace
+{
+	std::vector<BoundingBox> ScatteredBoxes(const int count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-80.0f, 80.0f);
+		std::uniform_real_distribution<float> size(0.2f, 3.0f);
+		std::vector<BoundingBox> boxes;
+		for (int i = 0; i < count; i++)
+			boxes.emplace_back(XMFLOAT3(position(random), position(random) * 0.1f, position(random)), XMFLOAT3(size(random), size(random), size(random)));
+		return boxes;
+	}
+
+	CullingPlanes ViewPlanes(const float yaw, const float pitch, const XMFLOAT3& position)
+	{
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 120.0f));
+		frustum.Transform(frustum, XMMatrixRotationRollPitchYaw(pitch, yaw, 0.0f) * XMMatrixTranslation(position.x, position.y, position.z));
+		return CullingPlanes::FromFrustum(frustum);
+	}
+
+	std::vector<int> BruteForce(const CullingPlanes& planes, const std::vector<BoundingBox>& boxes)
+	{
+		std::vector<int> result;
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (planes.Contains(boxes[i]) != DISJOINT)
+				result.push_back(static_cast<int>(i));
+		}
+		return result;
+	}
+
+	struct Counts
+	{
+		int None = 0;
+		int Exact = 0;
+		int Band = 0;
+	};
+
+	//culls every frame through the cache and checks it against the loop over every box
+	bool FollowPath(CullCache& cache, const SceneBvh& bvh, const std::vector<BoundingBox>& boxes, const std::vector<CullingPlanes>& path,
+	                const uint32_t sceneVersion, Counts& counts)
+	{
+		bool same = true;
+		std::vector<int> visible;
+		for (const CullingPlanes& planes : path)
+		{
+			const CullCache::Reuse reuse = cache.Cull(bvh, boxes, planes, sceneVersion, visible);
+			counts.None += reuse == CullCache::Reuse::None;
+			counts.Exact += reuse == CullCache::Reuse::Exact;
+			counts.Band += reuse == CullCache::Reuse::Band;
+			same = same && visible == BruteForce(planes, boxes);
+		}
+		return same;
+	}
+
+	void TestStillViewIsExact()
+	{
+		std::mt19937 random(41);
+		const std::vector<BoundingBox> boxes = ScatteredBoxes(3000, random);
+		SceneBvh bvh;
+		bvh.Build(boxes);
+
+		CullCache cache;
+		Counts counts;
+		const std::vector<CullingPlanes> path(10, ViewPlanes(0.3f, 0.0f, XMFLOAT3(0.0f, 2.0f, 0.0f)));
+		CHECK(FollowPath(cache, bvh, boxes, path, 1, counts));
+		CHECK(counts.None == 1);
+		CHECK(counts.Exact == 9);
+	}
+
+	//turns and steps much smaller than the margin reuse the band, big ones cull again
+	void TestSmallMovesReuseTheBand()
+	{
+		std::mt19937 random(42);
+		const std::vector<BoundingBox> boxes = ScatteredBoxes(3000, random);
+		SceneBvh bvh;
+		bvh.Build(boxes);
+
+		std::vector<CullingPlanes> path;
+		for (int frame = 0; frame < 200; frame++)
+			path.push_back(ViewPlanes(frame * 1e-4f, frame * 2e-5f, XMFLOAT3(frame * 0.01f, 2.0f, frame * -0.005f)));
+		CullCache cache;
+		Counts counts;
+		CHECK(FollowPath(cache, bvh, boxes, path, 1, counts));
+		CHECK(counts.Band > 100);
+		CHECK(counts.None > 1);
+
+		//a full turn a few degrees a frame never keeps the band for long
+		path.clear();
+		for (int frame = 0; frame < 120; frame++)
+			path.push_back(ViewPlanes(frame * XM_2PI / 120.0f, 0.0f, XMFLOAT3(0.0f, 2.0f, 0.0f)));
+		CullCache turning;
+		Counts turns;
+		CHECK(FollowPath(turning, bvh, boxes, path, 1, turns));
+		CHECK(turns.None > 100);
+	}
+
+	//random walks with every kind of step, the result is the only thing that counts
+	void TestRandomWalkMatches()
+	{
+		std::mt19937 random(43);
+		const std::vector<BoundingBox> boxes = ScatteredBoxes(2000, random);
+		SceneBvh bvh;
+		bvh.Build(boxes);
+
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_int_distribution<int> kind(0, 3);
+		float yaw = 0.0f;
+		float pitch = 0.0f;
+		XMFLOAT3 position(0.0f, 2.0f, 0.0f);
+		std::vector<CullingPlanes> path;
+		for (int frame = 0; frame < 400; frame++)
+		{
+			const int step = kind(random);
+			if (step == 1)
+			{
+				yaw += unit(random) * 1e-3f;
+				pitch += unit(random) * 1e-3f;
+			}
+			else if (step == 2)
+			{
+				position.x += unit(random) * 0.2f;
+				position.z += unit(random) * 0.2f;
+			}
+			else if (step == 3)
+			{
+				yaw += unit(random) * 0.5f;
+			}
+			path.push_back(ViewPlanes(yaw, pitch, position));
+		}
+		CullCache cache;
+		Counts counts;
+		CHECK(FollowPath(cache, bvh, boxes, path, 1, counts));
+		CHECK(counts.Exact > 0);
+		CHECK(counts.Band > 0);
+		CHECK(counts.None > 0);
+	}
+
+	//a new scene version culls again even from the same view, and so does Invalidate
+	void TestSceneChangeCullsAgain()
+	{
+		std::mt19937 random(44);
+		std::vector<BoundingBox> boxes = ScatteredBoxes(1000, random);
+		SceneBvh bvh;
+		bvh.Build(boxes);
+
+		const CullingPlanes planes = ViewPlanes(1.0f, 0.0f, XMFLOAT3(0.0f, 2.0f, 0.0f));
+		CullCache cache;
+		std::vector<int> visible;
+		CHECK(cache.Cull(bvh, boxes, planes, 1, visible) == CullCache::Reuse::None);
+		CHECK(cache.Cull(bvh, boxes, planes, 1, visible) == CullCache::Reuse::Exact);
+
+		//every box moves into the middle of the view
+		const std::vector<int> before = visible;
+		for (BoundingBox& box : boxes)
+			box.Center = XMFLOAT3(40.0f * std::sin(1.0f), 2.0f, 40.0f * std::cos(1.0f));
+		bvh.Build(boxes);
+		CHECK(cache.Cull(bvh, boxes, planes, 2, visible) == CullCache::Reuse::None);
+		CHECK(visible.size() == boxes.size());
+		CHECK(visible != before);
+		CHECK(visible == BruteForce(planes, boxes));
+
+		cache.Invalidate();
+		CHECK(cache.Cull(bvh, boxes, planes, 2, visible) == CullCache::Reuse::None);
+		CHECK(cache.LastReuse() == CullCache::Reuse::None);
+	}
+}
+
+int main()
+{
+	TestStillViewIsExact();
+	TestSmallMovesReuseTheBand();
+	TestRandomWalkMatches();
+	TestSceneChangeCullsAgain();
+	return CheckResult();
+}
@@ -0,0 +1,71 @@
+#include "Check.h"
+#include "CullingKernel.h"
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//boxes culled per frame by the scalar plane test and by the kernel, one frustum per frame.
+//usage: CullingKernelBench [boxes = 100000] [frames = 100]
+int main(int argc, char** argv)
+{
+	const int boxCount = argc > 1 ? std::atoi(argv[1]) : 100000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::vector<BoundingBox> boxes;
+	AabbSoa soa;
+	soa.Resize(boxCount);
+	for (int i = 0; i < boxCount; i++)
+	{
+		boxes.emplace_back(XMFLOAT3(position(random), position(random) * 0.1f, position(random)), XMFLOAT3(size(random), size(random), size(random)));
+		soa.Set(i, boxes.back());
+	}
+
+	std::vector<CullingPlanes> planes;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 400.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(frame * XM_2PI / frames));
+		planes.push_back(CullingPlanes::FromFrustum(frustum));
+	}
+
+	size_t scalarCount = 0;
+	const double scalarMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				for (const BoundingBox& box : boxes)
+					scalarCount += frame.Contains(box) != DISJOINT;
+			}
+		});
+
+	VisibilityMask visible;
+	size_t kernelCount = 0;
+	const double kernelMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				CullingKernel::Cull(frame, soa, visible);
+				kernelCount += visible.Count();
+			}
+		});
+
+	CHECK(scalarCount == kernelCount);
+
+#if defined(_XM_AVX_INTRINSICS_)
+	const char* path = "avx";
+#elif defined(_XM_SSE_INTRINSICS_)
+	const char* path = "sse";
+#else
+	const char* path = "scalar";
+#endif
+	std::printf("%d boxes, %d frames, %zu visible per frame\n", boxCount, frames, frames > 0 ? kernelCount / frames : 0);
+	std::printf("scalar:      %8.4f ms/frame\n", scalarMs / frames);
+	std::printf("kernel (%s): %8.4f ms/frame (%.1fx)\n", path, kernelMs / frames, kernelMs > 0.0 ? scalarMs / kernelMs : 0.0);
+	return CheckResult();
+}
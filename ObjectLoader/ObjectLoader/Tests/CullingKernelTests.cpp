@@ -0,0 +1,150 @@
+#include "Check.h"
+#include "CullingKernel.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//the vector paths against CullingPlanes::Contains, which is the scalar reference.
+//built once per instruction set the kernel has, the tests are the same for all of them
+namespace
+{
+	std::vector<BoundingBox> RandomBoxes(const int count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> size(0.0f, 6.0f);
+		std::vector<BoundingBox> boxes;
+		for (int i = 0; i < count; i++)
+			boxes.emplace_back(XMFLOAT3(position(random), position(random), position(random)), XMFLOAT3(size(random), size(random), size(random)));
+		return boxes;
+	}
+
+	AabbSoa SoaOf(const std::vector<BoundingBox>& boxes)
+	{
+		AabbSoa soa;
+		soa.Resize(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++)
+			soa.Set(i, boxes[i]);
+		return soa;
+	}
+
+	CullingPlanes RandomFrustum(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+		std::uniform_real_distribution<float> offset(-30.0f, 30.0f);
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.5f, 80.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(angle(random)) * XMMatrixTranslation(offset(random), offset(random) * 0.2f, offset(random)));
+		return CullingPlanes::FromFrustum(frustum);
+	}
+
+	bool CullMatchesReference(const CullingPlanes& planes, const std::vector<BoundingBox>& boxes)
+	{
+		const AabbSoa soa = SoaOf(boxes);
+		VisibilityMask visible;
+		CullingKernel::Cull(planes, soa, visible);
+		bool same = visible.Size() == boxes.size();
+		for (size_t i = 0; same && i < boxes.size(); i++)
+			same = visible.Test(i) == (planes.Contains(boxes[i]) != DISJOINT);
+		return same;
+	}
+
+	void TestCullMatchesScalar()
+	{
+		std::mt19937 random(11);
+		const std::vector<BoundingBox> boxes = RandomBoxes(5000, random);
+		for (int i = 0; i < 50; i++)
+			CHECK(CullMatchesReference(RandomFrustum(random), boxes));
+	}
+
+	//groups may start anywhere, also on the last box with only padding after it
+	void TestGroupsAtAnyOffset()
+	{
+		std::mt19937 random(12);
+		const std::vector<BoundingBox> boxes = RandomBoxes(37, random);
+		const AabbSoa soa = SoaOf(boxes);
+		bool same = true;
+		for (int f = 0; f < 20; f++)
+		{
+			const CullingPlanes planes = RandomFrustum(random);
+			for (size_t first = 0; first < boxes.size(); first++)
+			{
+				const uint32_t bits = CullingKernel::TestGroup(planes, soa, first);
+				for (size_t i = 0; i < CullingKernel::GroupSize && first + i < boxes.size(); i++)
+					same = same && ((bits >> i & 1u) != 0) == (planes.Contains(boxes[first + i]) != DISJOINT);
+			}
+		}
+		CHECK(same);
+	}
+
+	//every box is visible, so only the masked padding can be wrong
+	void TestPaddingIsMasked()
+	{
+		const CullingPlanes planes = CullingPlanes::FromOrientedBox(
+			BoundingOrientedBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(100.0f, 100.0f, 100.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f)));
+		for (const size_t count : { 0, 1, 3, 4, 5, 7, 8, 9, 31, 32, 33, 63, 64, 65, 100 })
+		{
+			const std::vector<BoundingBox> boxes(count, BoundingBox(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+			VisibilityMask visible;
+			CullingKernel::Cull(planes, SoaOf(boxes), visible);
+			CHECK(visible.Count() == count);
+			CHECK(visible.Words().size() == (count + 31) / 32);
+		}
+	}
+
+	//a box resting on a plane from outside is not culled, and every path has to agree on it
+	void TestTouchingCounts()
+	{
+		const CullingPlanes planes = CullingPlanes::FromOrientedBox(
+			BoundingOrientedBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f)));
+		const std::vector<BoundingBox> boxes = {
+			BoundingBox(XMFLOAT3(2.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)),
+			BoundingBox(XMFLOAT3(0.0f, -3.0f, 0.0f), XMFLOAT3(0.5f, 2.0f, 0.5f)),
+			BoundingBox(XMFLOAT3(0.0f, 0.0f, 2.5f), XMFLOAT3(1.0f, 1.0f, 1.0f)),
+			BoundingBox(XMFLOAT3(0.25f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)),
+			BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f)) };
+		CHECK(planes.Contains(boxes[0]) == INTERSECTS);
+		CHECK(planes.Contains(boxes[1]) == INTERSECTS);
+		CHECK(planes.Contains(boxes[2]) == DISJOINT);
+		CHECK(planes.Contains(boxes[3]) == CONTAINS);
+		CHECK(planes.Contains(boxes[4]) == CONTAINS);
+		CHECK(CullMatchesReference(planes, boxes));
+	}
+
+	//axis aligned volumes turn into exact box against box tests
+	void TestOrientedBoxPlanes()
+	{
+		std::mt19937 random(13);
+		const std::vector<BoundingBox> boxes = RandomBoxes(2000, random);
+		const BoundingBox volume(XMFLOAT3(5.0f, -3.0f, 10.0f), XMFLOAT3(20.0f, 10.0f, 15.0f));
+		const CullingPlanes planes = CullingPlanes::FromOrientedBox(BoundingOrientedBox(volume.Center, volume.Extents, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f)));
+		bool same = true;
+		for (const BoundingBox& box : boxes)
+			same = same && planes.Contains(box) == volume.Contains(box);
+		CHECK(same);
+		CHECK(CullMatchesReference(planes, boxes));
+
+		//turned volumes only have to agree with the reference
+		BoundingOrientedBox turned(volume.Center, volume.Extents, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+		turned.Transform(turned, XMMatrixRotationRollPitchYaw(0.3f, 1.1f, -0.4f));
+		CHECK(CullMatchesReference(CullingPlanes::FromOrientedBox(turned), boxes));
+	}
+}
+
+int main()
+{
+#if defined(_XM_AVX_INTRINSICS_)
+	std::printf("kernel: avx\n");
+#elif defined(_XM_SSE_INTRINSICS_)
+	std::printf("kernel: sse\n");
+#else
+	std::printf("kernel: scalar\n");
+#endif
+	TestCullMatchesScalar();
+	TestGroupsAtAnyOffset();
+	TestPaddingIsMasked();
+	TestTouchingCounts();
+	TestOrientedBoxPlanes();
+	return CheckResult();
+}
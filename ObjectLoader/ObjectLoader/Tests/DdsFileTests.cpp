@@ -0,0 +1,282 @@
+#include "Check.h"
+#include "DdsFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+//the mapped dds path of UploadManager::CreateTexture takes everything Parse accepts,
+//the rest falls back to CreateDDSTextureFromFile12. both sides are covered here
+namespace
+{
+	std::vector<std::uint8_t> ReadFile(const std::string& relative)
+	{
+		std::ifstream file(std::string(DATA_DIR) + "/" + relative, std::ios::binary);
+		return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void Write(std::vector<std::uint8_t>& data, const size_t offset, const std::uint32_t value)
+	{
+		memcpy(data.data() + offset, &value, sizeof(value));
+	}
+
+	//magic, header and optionally the dx10 header, followed by size bytes of payload
+	struct DdsBuilder
+	{
+		std::uint32_t Width = 16;
+		std::uint32_t Height = 16;
+		std::uint32_t Depth = 0;
+		std::uint32_t MipCount = 1;
+		std::uint32_t PfFlags = 0x40;
+		std::uint32_t FourCc = 0;
+		std::uint32_t BitCount = 32;
+		std::uint32_t Masks[4] = { 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 };
+		std::uint32_t Caps2 = 0;
+		bool Dx10 = false;
+		std::uint32_t Dx10Format = 0;
+		std::uint32_t Dx10Dimension = 3;
+		std::uint32_t Dx10Misc = 0;
+		std::uint32_t Dx10ArraySize = 1;
+
+		std::vector<std::uint8_t> Build(const size_t payload) const
+		{
+			const size_t headerBytes = 4 + 124 + (Dx10 ? 20 : 0);
+			std::vector<std::uint8_t> data(headerBytes + payload, 0);
+			Write(data, 0, 0x20534444);
+			Write(data, 4, 124);
+			Write(data, 4 + 8, Height);
+			Write(data, 4 + 12, Width);
+			Write(data, 4 + 20, Depth);
+			Write(data, 4 + 24, MipCount);
+			Write(data, 4 + 72, 32);
+			Write(data, 4 + 76, Dx10 ? 0x4 : PfFlags);
+			Write(data, 4 + 80, Dx10 ? 0x30315844 : FourCc);
+			Write(data, 4 + 84, BitCount);
+			for (int i = 0; i < 4; i++)
+				Write(data, 4 + 88 + i * 4, Masks[i]);
+			Write(data, 4 + 108, Caps2);
+			if (Dx10)
+			{
+				Write(data, 128, Dx10Format);
+				Write(data, 132, Dx10Dimension);
+				Write(data, 136, Dx10Misc);
+				Write(data, 140, Dx10ArraySize);
+			}
+			return data;
+		}
+	};
+
+	//subresources have to follow each other without gaps and stay inside the file
+	bool Contiguous(const DdsLayout& layout, const size_t headerBytes, const size_t fileSize)
+	{
+		size_t offset = headerBytes;
+		for (const auto& subresource : layout.Subresources)
+		{
+			if (subresource.Offset != offset || subresource.SlicePitch != subresource.RowPitch * subresource.RowCount)
+				return false;
+			offset += subresource.SlicePitch;
+		}
+		return offset <= fileSize;
+	}
+
+	void TestDefaultTexture()
+	{
+		const auto data = ReadFile("default1.dds");
+		CHECK(data.size() == 241992);
+		DdsLayout layout;
+		CHECK(DdsFile::Parse(data.data(), data.size(), layout));
+		CHECK(layout.Format == DXGI_FORMAT_R8_UNORM);
+		CHECK(layout.Width == 360 && layout.Height == 504);
+		CHECK(layout.MipCount == 9);
+		CHECK(layout.ArraySize == 1 && !layout.IsCubemap);
+		CHECK(layout.Subresources.size() == 9);
+		CHECK(Contiguous(layout, 128, data.size()));
+
+		//odd sizes round down, a full chain ends at 1x1 and fills the file exactly
+		const std::uint32_t widths[] = { 360, 180, 90, 45, 22, 11, 5, 2, 1 };
+		const std::uint32_t heights[] = { 504, 252, 126, 63, 31, 15, 7, 3, 1 };
+		bool footprints = layout.Subresources.size() == 9;
+		for (size_t mip = 0; footprints && mip < 9; mip++)
+		{
+			const auto& subresource = layout.Subresources[mip];
+			footprints = subresource.Width == widths[mip] && subresource.Height == heights[mip] &&
+				subresource.RowPitch == widths[mip] && subresource.RowCount == heights[mip];
+		}
+		CHECK(footprints);
+		const auto& last = layout.Subresources.back();
+		CHECK(last.Offset + last.SlicePitch == data.size());
+	}
+
+	void TestIrradianceCube()
+	{
+		const auto data = ReadFile("Sky/irradiance.dds");
+		CHECK(!data.empty());
+		DdsLayout layout;
+		CHECK(DdsFile::Parse(data.data(), data.size(), layout));
+		CHECK(layout.Format == DXGI_FORMAT_R32G32B32A32_FLOAT);
+		CHECK(layout.Width == 128 && layout.Height == 128);
+		CHECK(layout.IsCubemap);
+		CHECK(layout.ArraySize == 6);
+		CHECK(layout.MipCount == 1);
+		CHECK(layout.Subresources.size() == 6);
+		CHECK(Contiguous(layout, 128, data.size()));
+		CHECK(!layout.Subresources.empty() && layout.Subresources[0].RowPitch == 128 * 16);
+		CHECK(!layout.Subresources.empty() && layout.Subresources[5].Offset == 128 + 5 * 128 * 128 * 16);
+	}
+
+	void TestBrdfLut()
+	{
+		const auto data = ReadFile("Sky/brdfLUT.dds");
+		CHECK(!data.empty());
+		DdsLayout layout;
+		CHECK(DdsFile::Parse(data.data(), data.size(), layout));
+		CHECK(layout.Format == DXGI_FORMAT_R32G32B32A32_FLOAT);
+		CHECK(layout.Width == 256 && layout.Height == 256);
+		//a depth of 0 in a 2d file is fine
+		CHECK(!layout.IsCubemap && layout.ArraySize == 1);
+		CHECK(layout.Subresources.size() == 1);
+		CHECK(Contiguous(layout, 128, data.size()));
+		CHECK(!layout.Subresources.empty() && layout.Subresources[0].SlicePitch == 256 * 256 * 16);
+	}
+
+	void TestBlockCompressedPitch()
+	{
+		size_t rowPitch = 0;
+		size_t rowCount = 0;
+		CHECK(DdsFile::ComputePitch(DXGI_FORMAT_BC7_UNORM, 10, 6, rowPitch, rowCount));
+		CHECK(rowPitch == 3 * 16 && rowCount == 2);
+		//mips smaller than a block still take a whole one
+		CHECK(DdsFile::ComputePitch(DXGI_FORMAT_BC1_UNORM, 1, 1, rowPitch, rowCount));
+		CHECK(rowPitch == 8 && rowCount == 1);
+		CHECK(DdsFile::ComputePitch(DXGI_FORMAT_R16G16B16A16_FLOAT, 7, 3, rowPitch, rowCount));
+		CHECK(rowPitch == 56 && rowCount == 3);
+
+		DdsBuilder builder;
+		builder.Width = 64;
+		builder.Height = 32;
+		builder.MipCount = 7;
+		builder.PfFlags = 0x4;
+		builder.FourCc = 0x31545844; //DXT1
+		//32x8 + 16x4 + 8x2 + 4x1 + 2x1 + 1x1 + 1x1 blocks of 8 bytes
+		const size_t payload = (128 + 32 + 8 + 2 + 1 + 1 + 1) * 8;
+		const auto data = builder.Build(payload);
+		DdsLayout layout;
+		CHECK(DdsFile::Parse(data.data(), data.size(), layout));
+		CHECK(layout.Format == DXGI_FORMAT_BC1_UNORM);
+		CHECK(Contiguous(layout, 128, data.size()));
+		CHECK(!layout.Subresources.empty() && layout.Subresources.back().Offset + layout.Subresources.back().SlicePitch == data.size());
+	}
+
+	void TestDx10Array()
+	{
+		DdsBuilder builder;
+		builder.Dx10 = true;
+		builder.Dx10Format = DXGI_FORMAT_BC7_UNORM_SRGB;
+		builder.Dx10ArraySize = 3;
+		builder.MipCount = 2;
+		const auto data = builder.Build(3 * (16 * 16 + 8 * 8));
+		DdsLayout layout;
+		CHECK(DdsFile::Parse(data.data(), data.size(), layout));
+		CHECK(layout.Format == DXGI_FORMAT_BC7_UNORM_SRGB);
+		CHECK(layout.ArraySize == 3 && layout.Subresources.size() == 6);
+		//item major, the same order as d3d12 subresource indices
+		CHECK(layout.Subresources.size() == 6 && layout.Subresources[2].Width == 16 && layout.Subresources[3].Width == 8);
+		CHECK(Contiguous(layout, 148, data.size()));
+	}
+
+	//everything below has to be refused, so it goes through CreateDDSTextureFromFile12 instead
+	void TestFallbacks()
+	{
+		DdsLayout layout;
+		const DdsBuilder plain;
+		const size_t plainPayload = 16 * 16 * 4;
+		{
+			const auto data = plain.Build(plainPayload);
+			CHECK(DdsFile::Parse(data.data(), data.size(), layout));
+		}
+
+		//truncated payload and header
+		{
+			const auto data = plain.Build(plainPayload - 1);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+			CHECK(!DdsFile::Parse(data.data(), 100, layout));
+		}
+		//not a dds
+		{
+			auto data = plain.Build(plainPayload);
+			data[0] = 'X';
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//volume texture
+		{
+			DdsBuilder builder;
+			builder.Depth = 4;
+			builder.Caps2 = 0x200000;
+			const auto data = builder.Build(4 * plainPayload);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//cube map missing faces
+		{
+			DdsBuilder builder;
+			builder.Caps2 = 0x200 | 0x400 | 0x800;
+			const auto data = builder.Build(6 * plainPayload);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//24 bit rgb has no dxgi format
+		{
+			DdsBuilder builder;
+			builder.BitCount = 24;
+			builder.Masks[0] = 0xff0000;
+			builder.Masks[1] = 0x00ff00;
+			builder.Masks[2] = 0x0000ff;
+			builder.Masks[3] = 0;
+			const auto data = builder.Build(16 * 16 * 3);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//dx10 volume and 1d resources
+		for (const std::uint32_t dimension : { 2u, 4u })
+		{
+			DdsBuilder builder;
+			builder.Dx10 = true;
+			builder.Dx10Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			builder.Dx10Dimension = dimension;
+			const auto data = builder.Build(plainPayload);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//dx10 format the mapped path does not know how to pitch (R9G9B9E5_SHAREDEXP)
+		{
+			DdsBuilder builder;
+			builder.Dx10 = true;
+			builder.Dx10Format = 67;
+			const auto data = builder.Build(plainPayload);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//longer chain than the size allows
+		{
+			DdsBuilder builder;
+			builder.MipCount = 6;
+			const auto data = builder.Build(2 * plainPayload);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+		//zero sized
+		{
+			DdsBuilder builder;
+			builder.Width = 0;
+			const auto data = builder.Build(0);
+			CHECK(!DdsFile::Parse(data.data(), data.size(), layout));
+		}
+	}
+}
+
+int main()
+{
+	TestDefaultTexture();
+	TestIrradianceCube();
+	TestBrdfLut();
+	TestBlockCompressedPitch();
+	TestDx10Array();
+	TestFallbacks();
+	return CheckResult();
+}
@@ -0,0 +1,84 @@
+#include "Check.h"
+#include "DisplacementBounds.h"
+
+#include <random>
+
+using namespace DirectX;
+
+//surfaces displaced the way the domain shader does it never leave the inflated box
+namespace
+{
+	void TestReach()
+	{
+		CHECK_NEAR(DisplacementReach(HeightRange(), 0.5f), 0.5, 1e-6);
+		CHECK_NEAR(DisplacementReach({ 0.2f, 0.6f }, 2.0f), 1.2, 1e-6);
+		//signed maps and negative scales push inward as far as outward
+		CHECK_NEAR(DisplacementReach({ -0.8f, 0.3f }, 1.0f), 0.8, 1e-6);
+		CHECK_NEAR(DisplacementReach({ 0.2f, 0.6f }, -2.0f), 1.2, 1e-6);
+		CHECK(DisplacementReach({ 0.0f, 0.0f }, 5.0f) == 0.0f);
+		CHECK(DisplacementReach(HeightRange(), 0.0f) == 0.0f);
+	}
+
+	void TestInflate()
+	{
+		const BoundingBox box(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(0.5f, 1.0f, 2.0f));
+		const BoundingBox grown = InflateBounds(box, 0.25f);
+		CHECK(grown.Center.x == 1.0f && grown.Center.y == 2.0f && grown.Center.z == 3.0f);
+		CHECK_NEAR(grown.Extents.x, 0.75, 1e-6);
+		CHECK_NEAR(grown.Extents.y, 1.25, 1e-6);
+		CHECK_NEAR(grown.Extents.z, 2.25, 1e-6);
+		CHECK(InflateBounds(box, 0.0f).Extents.z == box.Extents.z);
+	}
+
+	//points of a mesh inside its local box, placed by a random world, then moved along random
+	//unit world normals by heights from the measured range
+	void TestDisplacedPointsStayInside()
+	{
+		std::mt19937 random(91);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		bool inside = true;
+		bool tight = true;
+		for (int object = 0; object < 200; object++)
+		{
+			const BoundingBox local(XMFLOAT3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f),
+				XMFLOAT3(0.1f + unit(random), 0.1f + unit(random), 0.1f + unit(random)));
+			const XMMATRIX world = XMMatrixScaling(0.2f + unit(random) * 3.0f, 0.2f + unit(random) * 3.0f, 0.2f + unit(random) * 3.0f) *
+				XMMatrixRotationRollPitchYaw(unit(random) * XM_2PI, unit(random) * XM_2PI, unit(random) * XM_2PI) *
+				XMMatrixTranslation(unit(random) * 50.0f - 25.0f, unit(random) * 10.0f, unit(random) * 50.0f - 25.0f);
+			const HeightRange heights = { unit(random) * 0.4f - 0.2f, 0.3f + unit(random) * 0.7f };
+			const float scale = (unit(random) - 0.3f) * 2.0f;
+
+			BoundingBox bounds;
+			local.Transform(bounds, world);
+			const float reach = DisplacementReach(heights, scale);
+			BoundingBox grown = InflateBounds(bounds, reach);
+			grown.Extents = XMFLOAT3(grown.Extents.x + 1e-4f, grown.Extents.y + 1e-4f, grown.Extents.z + 1e-4f);
+
+			for (int i = 0; i < 200; i++)
+			{
+				const XMVECTOR point = XMVectorSet(
+					local.Center.x + (unit(random) * 2.0f - 1.0f) * local.Extents.x,
+					local.Center.y + (unit(random) * 2.0f - 1.0f) * local.Extents.y,
+					local.Center.z + (unit(random) * 2.0f - 1.0f) * local.Extents.z, 1.0f);
+				const XMVECTOR normal = XMVector3Normalize(XMVectorSet(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f, 0.0f));
+				const float height = heights.Min + (heights.Max - heights.Min) * unit(random);
+				const XMVECTOR displaced = XMVector3TransformCoord(point, world) + normal * (height * scale);
+				inside = inside && grown.Contains(displaced) != DISJOINT;
+			}
+
+			//no bigger than it has to be, a face pushed straight out by the reach lands on the grown face
+			const XMVECTOR face = XMVectorSet(bounds.Center.x + bounds.Extents.x + reach, bounds.Center.y, bounds.Center.z, 1.0f);
+			tight = tight && grown.Contains(face) != DISJOINT && grown.Contains(face + XMVectorSet(1e-2f, 0.0f, 0.0f, 0.0f)) == DISJOINT;
+		}
+		CHECK(inside);
+		CHECK(tight);
+	}
+}
+
+int main()
+{
+	TestReach();
+	TestInflate();
+	TestDisplacedPointsStayInside();
+	return CheckResult();
+}
@@ -0,0 +1,259 @@
+#include "Check.h"
+#include "IblBaker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//the baker against environments with closed form irradiance and prefiltered values
+namespace
+{
+	constexpr float gPi = 3.14159265358979f;
+
+	template<typename Radiance>
+	IblCube CubeFrom(const int size, const Radiance& radiance)
+	{
+		IblCube cube(size);
+		for (int face = 0; face < 6; face++)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					float dx, dy, dz;
+					IblBaker::FaceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, dx, dy, dz);
+					const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+					cube.At(face, x, y) = radiance(dx / length, dy / length, dz / length);
+				}
+			}
+		}
+		return cube;
+	}
+
+	//texel centres of every face, so checks cover all six orientations
+	template<typename Body>
+	void ForEachDirection(const int size, const Body& body)
+	{
+		for (int face = 0; face < 6; face++)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					float dx, dy, dz;
+					IblBaker::FaceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, dx, dy, dz);
+					const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+					body(face, x, y, dx / length, dy / length, dz / length);
+				}
+			}
+		}
+	}
+
+	void TestSampleHitsTexelCentres()
+	{
+		IblCube cube(4);
+		for (size_t i = 0; i < cube.Texels.size(); i++)
+		{
+			cube.Texels[i] = { static_cast<float>(i), 0.0f, 0.0f };
+		}
+		ForEachDirection(4, [&](const int face, const int x, const int y, const float dx, const float dy, const float dz)
+			{
+				CHECK_NEAR(IblBaker::Sample(cube, dx, dy, dz).R, cube.At(face, x, y).R, 1e-3);
+			});
+	}
+
+	void TestSampleLodBlendsMips()
+	{
+		std::vector<IblCube> chain = { IblCube(4), IblCube(2) };
+		for (IblColor& texel : chain[1].Texels)
+		{
+			texel = { 1.0f, 2.0f, 4.0f };
+		}
+		const IblColor blended = IblBaker::SampleLod(chain, 0.3f, -0.5f, 0.8f, 0.25f);
+		CHECK_NEAR(blended.R, 0.25, 1e-5);
+		CHECK_NEAR(blended.G, 0.5, 1e-5);
+		CHECK_NEAR(blended.B, 1.0, 1e-5);
+		//lods outside the chain clamp
+		CHECK_NEAR(IblBaker::SampleLod(chain, 0.0f, 1.0f, 0.0f, 9.0f).R, 1.0, 1e-5);
+		CHECK_NEAR(IblBaker::SampleLod(chain, 0.0f, 1.0f, 0.0f, -1.0f).R, 0.0, 1e-5);
+	}
+
+	void TestDownsampleAverages()
+	{
+		const IblCube cube = CubeFrom(8, [](float x, float, float) { return IblColor{ x, 1.0f, 0.0f }; });
+		const IblCube half = IblBaker::Downsample(cube);
+		CHECK(half.Size == 4);
+		CHECK_NEAR(half.At(2, 1, 3).R, 0.25f * (cube.At(2, 2, 6).R + cube.At(2, 3, 6).R + cube.At(2, 2, 7).R + cube.At(2, 3, 7).R), 1e-6);
+		CHECK_NEAR(half.At(5, 0, 0).G, 1.0, 1e-6);
+		CHECK(IblBaker::Downsample(IblBaker::Downsample(IblBaker::Downsample(half))).Size == 1);
+	}
+
+	//r, g and b hold the direction, so a wrong longitude origin or a flipped axis shows up
+	void TestEquirectOrientation()
+	{
+		const int width = 256;
+		const int height = 128;
+		std::vector<float> rgba(static_cast<size_t>(width) * height * 4);
+		for (int v = 0; v < height; v++)
+		{
+			const float theta = (v + 0.5f) / height * gPi;
+			for (int u = 0; u < width; u++)
+			{
+				const float phi = ((u + 0.5f) / width - 0.5f) * 2.0f * gPi;
+				float* texel = &rgba[(static_cast<size_t>(v) * width + u) * 4];
+				texel[0] = std::sin(theta) * std::cos(phi);
+				texel[1] = std::cos(theta);
+				texel[2] = std::sin(theta) * std::sin(phi);
+				texel[3] = 1.0f;
+			}
+		}
+
+		WorkerPool pool(4);
+		const IblCube cube = IblBaker::CubeFromEquirect(rgba.data(), width, height, 16, pool);
+		double worst = 0.0;
+		ForEachDirection(16, [&](const int face, const int x, const int y, const float dx, const float dy, const float dz)
+			{
+				const IblColor& texel = cube.At(face, x, y);
+				worst = (std::max)(worst, static_cast<double>(std::fabs(texel.R - dx)));
+				worst = (std::max)(worst, static_cast<double>(std::fabs(texel.G - dy)));
+				worst = (std::max)(worst, static_cast<double>(std::fabs(texel.B - dz)));
+			});
+		CHECK(worst < 0.02);
+	}
+
+	void TestConstantIrradiance()
+	{
+		const IblCube cube = CubeFrom(16, [](float, float, float) { return IblColor{ 0.5f, 1.0f, 2.0f }; });
+		const IblSh sh = IblBaker::ProjectIrradiance(cube);
+		//only the dc term survives
+		for (int i = 1; i < 9; i++)
+		{
+			CHECK_NEAR(sh.Coefficients[i].G, 0.0, 1e-4);
+		}
+		ForEachDirection(2, [&](int, int, int, const float dx, const float dy, const float dz)
+			{
+				const IblColor irradiance = IblBaker::EvaluateSh(sh, dx, dy, dz);
+				CHECK_NEAR(irradiance.R, 0.5, 1e-3);
+				CHECK_NEAR(irradiance.G, 1.0, 1e-3);
+				CHECK_NEAR(irradiance.B, 2.0, 1e-3);
+			});
+	}
+
+	//radiance a + b * d.z is all in bands 0 and 1, so e / pi = a + 2/3 * b * n.z holds exactly
+	void TestLinearIrradiance()
+	{
+		const IblCube cube = CubeFrom(32, [](float, float, const float z) { return IblColor{ 1.0f + 0.5f * z, 1.0f, 1.0f }; });
+		const IblCube irradiance = IblBaker::IrradianceCube(IblBaker::ProjectIrradiance(cube), 4);
+		ForEachDirection(4, [&](const int face, const int x, const int y, float, float, const float dz)
+			{
+				CHECK_NEAR(irradiance.At(face, x, y).R, 1.0f + 2.0f / 3.0f * 0.5f * dz, 2e-3);
+				CHECK_NEAR(irradiance.At(face, x, y).G, 1.0, 2e-3);
+			});
+	}
+
+	//a clamped cosine sky: the exact e / pi is 2/3 straight up and 0 straight down,
+	//order 2 sh is within a couple of percent of both
+	void TestHemisphereIrradiance()
+	{
+		const IblCube cube = CubeFrom(32, [](float, float, const float z) { return IblColor{ (std::max)(z, 0.0f), 0.0f, 0.0f }; });
+		const IblSh sh = IblBaker::ProjectIrradiance(cube);
+		CHECK_NEAR(IblBaker::EvaluateSh(sh, 0.0f, 0.0f, 1.0f).R, 2.0 / 3.0, 0.02);
+		CHECK_NEAR(IblBaker::EvaluateSh(sh, 0.0f, 0.0f, -1.0f).R, 0.0, 0.02);
+		//on the horizon the two lobes overlap in a quarter sphere, 2 / (3 pi)
+		CHECK_NEAR(IblBaker::EvaluateSh(sh, 1.0f, 0.0f, 0.0f).R, 2.0 / (3.0 * gPi), 0.02);
+	}
+
+	void TestPrefilterConstant()
+	{
+		const IblCube cube = CubeFrom(32, [](float, float, float) { return IblColor{ 3.0f, 3.0f, 3.0f }; });
+		WorkerPool pool(4);
+		const std::vector<IblCube> mips = IblBaker::PrefilterGgx(cube, 16, 5, 64, pool);
+		CHECK(mips.size() == 5);
+		for (size_t mip = 0; mip < mips.size(); mip++)
+		{
+			CHECK(mips[mip].Size == (std::max)(16 >> mip, 1));
+			for (const IblColor& texel : mips[mip].Texels)
+			{
+				CHECK_NEAR(texel.R, 3.0, 1e-3);
+			}
+		}
+	}
+
+	//share of a linear sky a ggx lobe around n = v = r keeps: the nDotL weighted mean of l.n,
+	//integrated over the half vector distribution in closed form per cos^2 of the half angle
+	double LinearResponse(const float roughness)
+	{
+		const double alpha2 = std::pow(static_cast<double>(roughness), 4.0);
+		double sum = 0.0;
+		double weight = 0.0;
+		const int steps = 100000;
+		for (int i = 0; i < steps; i++)
+		{
+			const double xi = (i + 0.5) / steps;
+			const double lDotN = 2.0 * (1.0 - xi) / (1.0 + (alpha2 - 1.0) * xi) - 1.0;
+			if (lDotN > 0.0)
+			{
+				sum += lDotN * lDotN;
+				weight += lDotN;
+			}
+		}
+		return sum / weight;
+	}
+
+	//a linear sky a + b * d.z stays linear under any rotationally symmetric lobe,
+	//every mip has to be a + b * k(roughness) * n.z
+	void TestPrefilterLinear()
+	{
+		const IblCube cube = CubeFrom(64, [](float, float, const float z) { return IblColor{ 1.0f + 0.5f * z, 0.0f, 0.0f }; });
+		WorkerPool pool(4);
+		const int mipCount = 6;
+		const std::vector<IblCube> mips = IblBaker::PrefilterGgx(cube, 32, mipCount, 256, pool);
+
+		for (int mip = 0; mip < mipCount; mip++)
+		{
+			const double k = mip == 0 ? 1.0 : LinearResponse(static_cast<float>(mip) / (mipCount - 1));
+			double worst = 0.0;
+			ForEachDirection(mips[mip].Size, [&](const int face, const int x, const int y, float, float, const float dz)
+				{
+					const double expected = 1.0 + 0.5 * k * dz;
+					worst = (std::max)(worst, std::fabs(mips[mip].At(face, x, y).R - expected));
+				});
+			//the pdf based source lods blur a little more than the lobe itself on the roughest mips
+			CHECK(worst < 0.025);
+		}
+	}
+
+	//rows are independent, so the thread count must not change a single texel
+	void TestPrefilterIsDeterministic()
+	{
+		const IblCube cube = CubeFrom(16, [](const float x, const float y, float) { return IblColor{ x * x, (std::max)(y, 0.0f), 0.2f }; });
+		WorkerPool single(1);
+		WorkerPool many(4);
+		const std::vector<IblCube> a = IblBaker::PrefilterGgx(cube, 8, 4, 32, single);
+		const std::vector<IblCube> b = IblBaker::PrefilterGgx(cube, 8, 4, 32, many);
+		bool same = a.size() == b.size();
+		for (size_t mip = 0; same && mip < a.size(); mip++)
+		{
+			for (size_t i = 0; same && i < a[mip].Texels.size(); i++)
+			{
+				same = a[mip].Texels[i].R == b[mip].Texels[i].R && a[mip].Texels[i].G == b[mip].Texels[i].G;
+			}
+		}
+		CHECK(same);
+	}
+}
+
+int main()
+{
+	TestSampleHitsTexelCentres();
+	TestSampleLodBlendsMips();
+	TestDownsampleAverages();
+	TestEquirectOrientation();
+	TestConstantIrradiance();
+	TestLinearIrradiance();
+	TestHemisphereIrradiance();
+	TestPrefilterConstant();
+	TestPrefilterLinear();
+	TestPrefilterIsDeterministic();
+	return CheckResult();
+}
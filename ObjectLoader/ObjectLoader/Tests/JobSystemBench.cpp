@@ -0,0 +1,80 @@
+#include "Check.h"
+#include "JobSystem.h"
+
+#include <DirectXCollision.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+//ParallelFor over a frustum test per object, the way the shadow casters are culled,
+//with 1 to the given number of workers against a plain loop on one thread.
+//usage: JobSystemBench [objects = 200000] [frames = 50] [max workers = hardware threads - 1]
+int main(int argc, char** argv)
+{
+	const int objectCount = argc > 1 ? std::atoi(argv[1]) : 200000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 50;
+	const unsigned hardwareThreads = std::thread::hardware_concurrency();
+	const int maxWorkers = argc > 3 ? std::atoi(argv[3]) : (hardwareThreads > 1 ? static_cast<int>(hardwareThreads) - 1 : 1);
+
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::vector<BoundingBox> boxes;
+	for (int i = 0; i < objectCount; i++)
+		boxes.emplace_back(XMFLOAT3(position(random), position(random) * 0.1f, position(random)), XMFLOAT3(size(random), size(random), size(random)));
+
+	std::vector<BoundingFrustum> frustums;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const float yaw = frame * XM_2PI / frames;
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 300.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(yaw) * XMMatrixTranslation(100.0f * std::cos(yaw), 2.0f, 100.0f * std::sin(yaw)));
+		frustums.push_back(frustum);
+	}
+
+	size_t loopCount = 0;
+	const double loopMs = MeasureMs([&]()
+		{
+			for (const BoundingFrustum& frustum : frustums)
+			{
+				for (const BoundingBox& box : boxes)
+					loopCount += frustum.Contains(box) != DISJOINT;
+			}
+		});
+	std::printf("%d objects, %d frames, %zu visible per frame, %u hardware threads\n", objectCount, frames, frames > 0 ? loopCount / frames : 0, hardwareThreads);
+	std::printf("loop:       %8.3f ms/frame\n", loopMs / frames);
+
+	double oneWorkerMs = 0.0;
+	for (int workers = 1; workers <= maxWorkers; workers++)
+	{
+		JobSystem jobs(static_cast<unsigned>(workers));
+		std::atomic<size_t> count{ 0 };
+		const double ms = MeasureMs([&]()
+			{
+				for (const BoundingFrustum& frustum : frustums)
+				{
+					jobs.ParallelFor(0, boxes.size(), 0, [&](const size_t first, const size_t last)
+						{
+							size_t chunkCount = 0;
+							for (size_t i = first; i < last; i++)
+								chunkCount += frustum.Contains(boxes[i]) != DISJOINT;
+							count += chunkCount;
+						});
+				}
+			});
+
+		//every thread count has to find what the loop found
+		CHECK(count == loopCount);
+		if (workers == 1)
+			oneWorkerMs = ms;
+		std::printf("%2d workers: %8.3f ms/frame (%.2fx the loop, %.2fx one worker)\n", workers, ms / frames,
+			ms > 0.0 ? loopMs / ms : 0.0, ms > 0.0 ? oneWorkerMs / ms : 0.0);
+	}
+	return CheckResult();
+}
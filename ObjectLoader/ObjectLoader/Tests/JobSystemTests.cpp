@@ -0,0 +1,224 @@
+#include "Check.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	void TestRunsEveryJob()
+	{
+		JobSystem jobs(3);
+		CHECK(jobs.ThreadCount() == 4);
+
+		std::atomic<int> sum{ 0 };
+		JobCounter counter;
+		for (int i = 1; i <= 1000; i++)
+			jobs.Run([&sum, i]() { sum += i; }, &counter);
+		jobs.Wait(counter);
+		CHECK(counter.Done());
+		CHECK(sum == 500500);
+	}
+
+	//every index exactly once, whatever the grain and however the range splits
+	void TestParallelForCoversTheRange()
+	{
+		JobSystem jobs(3);
+		const size_t grains[] = { 0, 1, 7, 64, 1000, 5000 };
+		for (const size_t grain : grains)
+		{
+			std::vector<std::atomic<int>> hits(3000);
+			jobs.ParallelFor(100, 3000, grain, [&hits](const size_t first, const size_t last)
+				{
+					for (size_t i = first; i < last; i++)
+						hits[i]++;
+				});
+			bool once = true;
+			for (size_t i = 0; i < hits.size(); i++)
+				once = once && hits[i] == (i < 100 ? 0 : 1);
+			CHECK(once);
+		}
+
+		int calls = 0;
+		jobs.ParallelFor(5, 5, 0, [&calls](size_t, size_t) { calls++; });
+		CHECK(calls == 0);
+	}
+
+	//a job held back by a counter only starts once every job of that counter ran
+	void TestDependencies()
+	{
+		JobSystem jobs(3);
+		bool ordered = true;
+		for (int chain = 0; chain < 200; chain++)
+		{
+			std::atomic<int> firstDone{ 0 };
+			std::atomic<int> seen{ -1 };
+			JobCounter first;
+			JobCounter second;
+			for (int i = 0; i < 8; i++)
+				jobs.Run([&firstDone]() { firstDone++; }, &first);
+			jobs.Run([&firstDone, &seen]() { seen = firstDone.load(); }, &second, first);
+			jobs.Wait(second);
+			ordered = ordered && seen == 8;
+		}
+		CHECK(ordered);
+
+		//after a counter that is already done it runs right away
+		JobCounter done;
+		JobCounter counter;
+		std::atomic<bool> ran{ false };
+		jobs.Run([&ran]() { ran = true; }, &counter, done);
+		jobs.Wait(counter);
+		CHECK(ran);
+	}
+
+	//jobs spreading into more jobs, the way a cull fans out inside a frame job
+	void TestNestedParallelFor()
+	{
+		JobSystem jobs(3);
+		std::atomic<int> sum{ 0 };
+		jobs.ParallelFor(0, 16, 1, [&jobs, &sum](const size_t first, const size_t last)
+			{
+				for (size_t outer = first; outer < last; outer++)
+				{
+					jobs.ParallelFor(0, 100, 10, [&sum](const size_t innerFirst, const size_t innerLast)
+						{
+							sum += static_cast<int>(innerLast - innerFirst);
+						});
+				}
+			});
+		CHECK(sum == 1600);
+	}
+
+	//a job that throws still counts as finished, Wait hands the exception to the caller
+	void TestThrowingJobs()
+	{
+		JobSystem jobs(2);
+		std::atomic<int> ran{ 0 };
+		JobCounter counter;
+		for (int i = 0; i < 50; i++)
+		{
+			jobs.Run([&ran, i]()
+				{
+					ran++;
+					if (i % 10 == 3)
+						throw std::runtime_error("job failed");
+				}, &counter);
+		}
+		bool thrown = false;
+		try
+		{
+			jobs.Wait(counter);
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		CHECK(thrown);
+		CHECK(counter.Done());
+		CHECK(ran == 50);
+
+		//reported once, the counter can be used again
+		jobs.Run([]() {}, &counter);
+		jobs.Wait(counter);
+
+		bool parallelForThrown = false;
+		try
+		{
+			jobs.ParallelFor(0, 100, 1, [](const size_t first, size_t)
+				{
+					if (first == 42)
+						throw std::runtime_error("chunk failed");
+				});
+		}
+		catch (const std::runtime_error&)
+		{
+			parallelForThrown = true;
+		}
+		CHECK(parallelForThrown);
+
+		//nobody waits for a job without a counter, the workers carry on after it
+		jobs.Run([]() { throw std::runtime_error("lost"); });
+		JobCounter after;
+		std::atomic<int> later{ 0 };
+		for (int i = 0; i < 20; i++)
+			jobs.Run([&later]() { later++; }, &after);
+		jobs.Wait(after);
+		CHECK(later == 20);
+	}
+
+	//threads that are not workers queue onto deques of their own, so a waiting thread takes back its own newest job first
+	void TestOutsideThreadsOwnDeques()
+	{
+		JobSystem jobs(1);
+		std::promise<void> release;
+		std::shared_future<void> released = release.get_future().share();
+		std::atomic<bool> started{ false };
+		JobCounter blocker;
+		//keeps the only worker busy so nothing else gets stolen
+		jobs.Run([&started, released]() { started = true; released.wait(); }, &blocker);
+		while (!started)
+			std::this_thread::yield();
+
+		std::vector<int> order;
+		JobCounter mine;
+		for (int i = 0; i < 3; i++)
+			jobs.Run([&order, i]() { order.push_back(i); }, &mine);
+
+		JobCounter theirs;
+		std::atomic<int> theirsRan{ 0 };
+		std::thread other([&jobs, &theirs, &theirsRan]()
+			{
+				for (int i = 0; i < 3; i++)
+					jobs.Run([&theirsRan]() { theirsRan++; }, &theirs);
+			});
+		other.join();
+
+		//with one deque for both threads the newest job would be one of the other thread's
+		jobs.Wait(mine);
+		CHECK(order == std::vector<int>({ 2, 1, 0 }));
+		CHECK(theirsRan == 0);
+
+		//the other thread is gone, its jobs are still there to steal
+		release.set_value();
+		jobs.Wait(theirs);
+		jobs.Wait(blocker);
+		CHECK(theirsRan == 3);
+	}
+
+	//more outside threads than there are deques for them share the last one and still get everything done
+	void TestManyOutsideThreads()
+	{
+		JobSystem jobs(2);
+		std::atomic<int> sum{ 0 };
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < JobSystem::MaxOutsideThreads + 4; t++)
+		{
+			threads.emplace_back([&jobs, &sum]()
+				{
+					JobCounter counter;
+					for (int i = 0; i < 100; i++)
+						jobs.Run([&sum]() { sum++; }, &counter);
+					jobs.Wait(counter);
+				});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		CHECK(sum == static_cast<int>((JobSystem::MaxOutsideThreads + 4) * 100));
+	}
+}
+
+int main()
+{
+	TestRunsEveryJob();
+	TestParallelForCoversTheRange();
+	TestDependencies();
+	TestNestedParallelFor();
+	TestThrowingJobs();
+	TestOutsideThreadsOwnDeques();
+	TestManyOutsideThreads();
+	return CheckResult();
+}
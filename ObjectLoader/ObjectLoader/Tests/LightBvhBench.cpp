@@ -0,0 +1,88 @@
+#include "Check.h"
+#include "SceneBvh.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//local light culling per frame the way LightingManager does it: every sphere against the frustum,
+//or the bvh over the boxes around the spheres and the exact test on what it lets through.
+//one light moves every frame, so the tree is refit each time as well.
+//usage: LightBvhBench [lights = 4000] [frames = 200]
+int main(int argc, char** argv)
+{
+	const int lightCount = argc > 1 ? std::atoi(argv[1]) : 4000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> position(-300.0f, 300.0f);
+	std::uniform_real_distribution<float> range(2.0f, 15.0f);
+	std::vector<BoundingSphere> lights;
+	for (int i = 0; i < lightCount; i++)
+		lights.emplace_back(XMFLOAT3(position(random), position(random) * 0.05f, position(random)), range(random));
+
+	std::vector<BoundingFrustum> frustums;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const float yaw = frame * XM_2PI / frames;
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 200.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(yaw) * XMMatrixTranslation(60.0f * std::cos(yaw), 2.0f, 60.0f * std::sin(yaw)));
+		frustums.push_back(frustum);
+	}
+	//the light that moves on each frame and where it goes
+	std::vector<int> moved;
+	std::vector<XMFLOAT3> targets;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		moved.push_back(static_cast<int>(random() % lightCount));
+		targets.emplace_back(position(random), 0.0f, position(random));
+	}
+
+	std::vector<BoundingSphere> loopLights = lights;
+	size_t loopCount = 0;
+	const double loopMs = MeasureMs([&]()
+		{
+			for (int frame = 0; frame < frames; frame++)
+			{
+				loopLights[moved[frame]].Center = targets[frame];
+				for (const BoundingSphere& light : loopLights)
+					loopCount += frustums[frame].Contains(light) != DISJOINT;
+			}
+		});
+
+	std::vector<BoundingSphere> bvhLights = lights;
+	std::vector<BoundingBox> bounds(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+		BoundingBox::CreateFromSphere(bounds[i], lights[i]);
+	SceneBvh bvh;
+	bvh.Build(bounds);
+	std::vector<int> candidates;
+	size_t bvhCount = 0;
+	double refitMs = 0.0;
+	const double bvhMs = MeasureMs([&]()
+		{
+			for (int frame = 0; frame < frames; frame++)
+			{
+				const int light = moved[frame];
+				bvhLights[light].Center = targets[frame];
+				BoundingBox::CreateFromSphere(bounds[light], bvhLights[light]);
+				refitMs += MeasureMs([&]() { bvh.Update(bounds); });
+
+				candidates.clear();
+				bvh.Query(CullingPlanes::FromFrustum(frustums[frame]), candidates);
+				for (const int i : candidates)
+					bvhCount += frustums[frame].Contains(bvhLights[i]) != DISJOINT;
+			}
+		});
+
+	//both have to find the same lights, otherwise the comparison means nothing
+	CHECK(loopCount == bvhCount);
+
+	std::printf("%d lights, %d frames, %zu visible per frame, %d rebuilds\n", lightCount, frames, frames > 0 ? bvhCount / frames : 0, bvh.BuildCount());
+	std::printf("loop:   %8.4f ms/frame\n", loopMs / frames);
+	std::printf("bvh:    %8.4f ms/frame (%.1fx), refit %.4f ms/frame of it\n", bvhMs / frames, bvhMs > 0.0 ? loopMs / bvhMs : 0.0, refitMs / frames);
+	return CheckResult();
+}
@@ -0,0 +1,190 @@
+#include "Check.h"
+#include "LightClusters.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//the lists Assign builds against a brute force of every light and every cluster,
+//built for the simd path and the portable one
+namespace
+{
+	const float FovY = 0.25f * XM_PI;
+	const float Aspect = 16.0f / 9.0f;
+	const float NearZ = 0.1f;
+	const float FarZ = 200.0f;
+
+	std::vector<ClusterLight> RandomLights(const int count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> depth(-5.0f, 220.0f);
+		std::uniform_real_distribution<float> radius(0.5f, 20.0f);
+		std::uniform_real_distribution<float> angle(0.05f, 1.7f);
+		std::vector<ClusterLight> lights;
+		for (int i = 0; i < count; i++)
+		{
+			ClusterLight light;
+			const float z = depth(random);
+			light.Position = XMFLOAT3(unit(random) * (std::abs(z) + 5.0f), unit(random) * (std::abs(z) + 5.0f) * 0.6f, z);
+			light.Radius = radius(random);
+			light.Spot = i % 2 == 1;
+			XMStoreFloat3(&light.Direction, XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f)));
+			light.Angle = angle(random);
+			light.Index = static_cast<uint32_t>(i * 3 + 1);
+			lights.push_back(light);
+		}
+		return lights;
+	}
+
+	//the lights of every cluster in light order, from the lists and from testing all of them
+	bool MatchesBruteForce(const LightClusters& clusters, const std::vector<ClusterLight>& lights)
+	{
+		bool same = clusters.Ranges().size() == static_cast<size_t>(clusters.ClusterCount());
+		for (int cluster = 0; same && cluster < clusters.ClusterCount(); cluster++)
+		{
+			std::vector<uint32_t> expected;
+			const BoundingBox bounds = clusters.Bounds(cluster);
+			for (const ClusterLight& light : lights)
+			{
+				if (light.Radius > 0.0f && LightClusters::Touches(light, bounds))
+					expected.push_back(light.Index);
+			}
+			const ClusterRange range = clusters.Ranges()[cluster];
+			const std::vector<uint32_t> actual(clusters.Indices().begin() + range.Offset, clusters.Indices().begin() + range.Offset + range.Count);
+			same = actual == expected;
+		}
+		return same;
+	}
+
+	void TestAssignMatchesBruteForce()
+	{
+		std::mt19937 random(71);
+		LightClusters clusters;
+		clusters.SetLens(FovY, Aspect, NearZ, FarZ);
+		for (int round = 0; round < 5; round++)
+		{
+			const std::vector<ClusterLight> lights = RandomLights(200, random);
+			CHECK(clusters.Assign(lights, 1 << 20));
+			CHECK(MatchesBruteForce(clusters, lights));
+		}
+
+		//grids whose rows do not fill whole groups
+		ClusterGridSettings odd;
+		odd.TilesX = 7;
+		odd.TilesY = 5;
+		odd.Slices = 11;
+		clusters.SetLens(FovY, Aspect, NearZ, FarZ, odd);
+		const std::vector<ClusterLight> lights = RandomLights(200, random);
+		CHECK(clusters.Assign(lights, 1 << 20));
+		CHECK(MatchesBruteForce(clusters, lights));
+	}
+
+	//every point a light reaches finds it in the cluster the shader would pick for that point
+	void TestLitPointsFindTheirLights()
+	{
+		std::mt19937 random(72);
+		LightClusters clusters;
+		clusters.SetLens(FovY, Aspect, NearZ, FarZ);
+		const std::vector<ClusterLight> lights = RandomLights(300, random);
+		CHECK(clusters.Assign(lights, 1 << 20));
+
+		const float tanHalfY = std::tan(FovY * 0.5f);
+		const float tanHalfX = tanHalfY * Aspect;
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		int lit = 0;
+		bool missing = false;
+		for (int i = 0; i < 100000; i++)
+		{
+			//uniform on screen, exponential in depth like the slices
+			const float screenX = unit(random);
+			const float screenY = unit(random);
+			const float z = NearZ * std::pow(FarZ / NearZ, unit(random));
+			const XMFLOAT3 p((screenX * 2.0f - 1.0f) * tanHalfX * z, (1.0f - screenY * 2.0f) * tanHalfY * z, z);
+			const int tileX = (std::min)(static_cast<int>(screenX * clusters.TilesX()), clusters.TilesX() - 1);
+			const int tileY = (std::min)(static_cast<int>(screenY * clusters.TilesY()), clusters.TilesY() - 1);
+			const ClusterRange range = clusters.Ranges()[clusters.ClusterIndex(tileX, tileY, clusters.SliceAt(z))];
+
+			for (const ClusterLight& light : lights)
+			{
+				const XMVECTOR toPoint = XMLoadFloat3(&p) - XMLoadFloat3(&light.Position);
+				const float distance = XMVectorGetX(XMVector3Length(toPoint));
+				if (distance > light.Radius)
+					continue;
+				if (light.Spot && light.Angle < XM_PIDIV2 && distance > 0.0f &&
+					XMVectorGetX(XMVector3Dot(toPoint, XMLoadFloat3(&light.Direction))) < distance * std::cos(light.Angle))
+					continue;
+
+				lit++;
+				bool listed = false;
+				for (uint32_t k = range.Offset; k < range.Offset + range.Count && !listed; k++)
+					listed = clusters.Indices()[k] == light.Index;
+				missing = missing || !listed;
+			}
+		}
+		CHECK(lit > 1000);
+		CHECK(!missing);
+	}
+
+	//every cluster box holds its slice's depths, and depth maps back to its slice
+	void TestSlicesMatchTheBoxes()
+	{
+		LightClusters clusters;
+		clusters.SetLens(FovY, Aspect, NearZ, FarZ);
+		bool inside = true;
+		for (int slice = 0; slice < clusters.Slices(); slice++)
+		{
+			const BoundingBox bounds = clusters.Bounds(clusters.ClusterIndex(0, 0, slice));
+			const float middle = bounds.Center.z;
+			inside = inside && clusters.SliceAt(middle) == slice;
+		}
+		CHECK(inside);
+		CHECK(clusters.SliceAt(0.0f) == 0);
+		CHECK(clusters.SliceAt(FarZ * 10.0f) == clusters.Slices() - 1);
+		CHECK_NEAR(clusters.Bounds(clusters.ClusterIndex(0, 0, 0)).Center.z - clusters.Bounds(clusters.ClusterIndex(0, 0, 0)).Extents.z, NearZ, 1e-5);
+		const BoundingBox last = clusters.Bounds(clusters.ClusterIndex(0, 0, clusters.Slices() - 1));
+		CHECK_NEAR(last.Center.z + last.Extents.z, FarZ, 1e-2);
+	}
+
+	//too many hits leave the lists empty, lights out of range or without a radius add none
+	void TestLimitsAndSkippedLights()
+	{
+		std::mt19937 random(73);
+		LightClusters clusters;
+		clusters.SetLens(FovY, Aspect, NearZ, FarZ);
+		const std::vector<ClusterLight> lights = RandomLights(100, random);
+		CHECK(clusters.Assign(lights, 1 << 20));
+		const size_t needed = clusters.Indices().size();
+		CHECK(needed > 0);
+		CHECK(clusters.Assign(lights, needed));
+		CHECK(!clusters.Assign(lights, needed - 1));
+		CHECK(clusters.Indices().empty());
+		CHECK(clusters.Ranges().size() == static_cast<size_t>(clusters.ClusterCount()));
+
+		ClusterLight behind;
+		behind.Position = XMFLOAT3(0.0f, 0.0f, -10.0f);
+		behind.Radius = 5.0f;
+		ClusterLight dark;
+		dark.Position = XMFLOAT3(0.0f, 0.0f, 10.0f);
+		ClusterLight beyond;
+		beyond.Position = XMFLOAT3(0.0f, 0.0f, FarZ + 10.0f);
+		beyond.Radius = 5.0f;
+		CHECK(clusters.Assign({ behind, dark, beyond }, 1 << 20));
+		CHECK(clusters.Indices().empty());
+	}
+}
+
+int main()
+{
+#if defined(_XM_SSE_INTRINSICS_)
+	std::printf("clusters: sse\n");
+#else
+	std::printf("clusters: scalar\n");
+#endif
+	TestAssignMatchesBruteForce();
+	TestLitPointsFindTheirLights();
+	TestSlicesMatchTheBoxes();
+	TestLimitsAndSkippedLights();
+	return CheckResult();
+}
@@ -0,0 +1,183 @@
+#include "Check.h"
+#include "LodSelector.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Lod
+	{
+		int TriangleCount = 0;
+		float Error = 0.0f;
+	};
+
+	//halving the triangles doubles the error, like a typical simplified chain
+	std::vector<Lod> Chain(const int count, const int triangles, const float error)
+	{
+		std::vector<Lod> lods;
+		for (int i = 0; i < count; i++)
+			lods.push_back({ triangles >> i, i == 0 ? 0.0f : error * static_cast<float>(1 << (i - 1)) });
+		return lods;
+	}
+
+	//the picked lod never shows more than the tolerance plus hysteresis, and no coarser lod
+	//would stay under the tolerance minus hysteresis
+	void TestSelectionStaysInTheBand()
+	{
+		const std::vector<Lod> lods = Chain(6, 10000, 0.01f);
+		const float tolerance = 1.0f;
+		const float hysteresis = 0.25f;
+		std::mt19937 random(51);
+		std::uniform_real_distribution<float> scale(1.0f, 1000.0f);
+		std::uniform_int_distribution<int> start(0, 5);
+		bool inBand = true;
+		for (int i = 0; i < 2000; i++)
+		{
+			const float pixelsPerUnit = scale(random);
+			const int lod = LodSelector::Select(lods, pixelsPerUnit, tolerance, hysteresis, start(random));
+			inBand = inBand && (lod == 0 || lods[lod].Error * pixelsPerUnit <= tolerance * (1.0f + hysteresis));
+			inBand = inBand && (lod == 5 || lods[lod + 1].Error * pixelsPerUnit > tolerance * (1.0f - hysteresis));
+		}
+		CHECK(inBand);
+
+		//out of range current lods are clamped, single lods never change
+		CHECK(LodSelector::Select(lods, 1.0f, tolerance, hysteresis, 99) == 5);
+		CHECK(LodSelector::Select(lods, 1e6f, tolerance, hysteresis, -3) == 0);
+		CHECK(LodSelector::Select(Chain(1, 100, 0.1f), 1e6f, tolerance, hysteresis, 0) == 0);
+	}
+
+	//an object jittering around a switch distance flips with no hysteresis and holds with it
+	void TestHysteresisHoldsAtTheSwitch()
+	{
+		const std::vector<Lod> lods = Chain(4, 10000, 0.01f);
+		std::mt19937 random(52);
+		std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+		int lodWithout = 0;
+		int lodWith = 0;
+		int switchesWithout = 0;
+		int switchesWith = 0;
+		for (int frame = 0; frame < 500; frame++)
+		{
+			//lod 1 shows exactly the tolerance at 100 pixels per unit
+			const float pixelsPerUnit = 100.0f * (1.0f + jitter(random));
+			const int without = LodSelector::Select(lods, pixelsPerUnit, 1.0f, 0.0f, lodWithout);
+			const int with = LodSelector::Select(lods, pixelsPerUnit, 1.0f, 0.25f, lodWith);
+			switchesWithout += without != lodWithout;
+			switchesWith += with != lodWith;
+			lodWithout = without;
+			lodWith = with;
+		}
+		CHECK(switchesWithout > 50);
+		CHECK(switchesWith <= 1);
+
+		//a slow walk away and back switches one lod at a time, each of them once per way
+		int lod = 0;
+		int farthest = 0;
+		int switches = 0;
+		for (int step = 0; step <= 400; step++)
+		{
+			const float distance = 1.0f + (step <= 200 ? step : 400 - step) * 0.1f;
+			const int next = LodSelector::Select(lods, 400.0f / distance, 1.0f, 0.25f, lod);
+			switches += std::abs(next - lod) == 1;
+			farthest = (std::max)(farthest, next);
+			lod = next;
+		}
+		CHECK(farthest >= 2);
+		CHECK(switches == farthest * 2);
+		CHECK(lod == 0);
+	}
+
+	//objects at random distances sharing one budget
+	void TestBudgetFits()
+	{
+		std::mt19937 random(53);
+		std::uniform_real_distribution<float> scale(10.0f, 2000.0f);
+		std::vector<std::vector<Lod>> objects;
+		std::vector<float> pixelsPerUnit;
+		for (int i = 0; i < 200; i++)
+		{
+			objects.push_back(Chain(5, 20000, 0.002f * (1 + i % 3)));
+			pixelsPerUnit.push_back(scale(random));
+		}
+		const auto triangles = [&](const float tolerance)
+		{
+			int count = 0;
+			for (size_t i = 0; i < objects.size(); i++)
+				count += objects[i][LodSelector::Select(objects[i], pixelsPerUnit[i], tolerance, 0.25f, 0)].TriangleCount;
+			return count;
+		};
+
+		const int unlimited = triangles(1.0f);
+		CHECK(LodSelector::FitBudget(1.0f, 0, triangles) == 1.0f);
+		CHECK(LodSelector::FitBudget(1.0f, unlimited, triangles) == 1.0f);
+
+		for (const int budget : { unlimited / 2, unlimited / 5, unlimited / 12 })
+		{
+			const float tolerance = LodSelector::FitBudget(1.0f, budget, triangles);
+			CHECK(tolerance > 1.0f);
+			CHECK(triangles(tolerance) <= budget);
+			//within the bisection steps of the smallest tolerance that fits
+			CHECK(triangles(tolerance * 0.98f) > budget);
+		}
+
+		//below the coarsest lods nothing fits, the coarsest is what it gets
+		const float coarsest = LodSelector::FitBudget(1.0f, 1, triangles);
+		CHECK(triangles(coarsest) == static_cast<int>(objects.size()) * (20000 >> 4));
+	}
+
+	//the grid search against distances to every triangle
+	void TestGeometricErrorMatchesBruteForce()
+	{
+		std::mt19937 random(54);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<XMFLOAT3> triangles;
+		for (int i = 0; i < 300; i++)
+		{
+			const XMFLOAT3 center(unit(random) * 5.0f, unit(random), unit(random) * 5.0f);
+			for (int k = 0; k < 3; k++)
+				triangles.emplace_back(center.x + unit(random) * 0.5f, center.y + unit(random) * 0.5f, center.z + unit(random) * 0.5f);
+		}
+		std::vector<XMFLOAT3> reference;
+		for (int i = 0; i < 200; i++)
+			reference.emplace_back(unit(random) * 6.0f, unit(random) * 2.0f, unit(random) * 6.0f);
+
+		//small triangles sampled on a fine grid of barycentrics, a little farther than the real distance
+		float expected = 0.0f;
+		for (const XMFLOAT3& point : reference)
+		{
+			float best = 1e30f;
+			for (size_t t = 0; t < triangles.size(); t += 3)
+			{
+				for (int k = 0; k <= 400; k++)
+				{
+					const float u = (k % 21) / 20.0f;
+					const float v = (k / 21) / 20.0f;
+					if (u + v > 1.0f)
+						continue;
+					const XMVECTOR q = XMLoadFloat3(&triangles[t]) * (1.0f - u - v) + XMLoadFloat3(&triangles[t + 1]) * u + XMLoadFloat3(&triangles[t + 2]) * v;
+					best = (std::min)(best, XMVectorGetX(XMVector3Length(q - XMLoadFloat3(&point))));
+				}
+			}
+			expected = (std::max)(expected, best);
+		}
+		const float error = LodSelector::GeometricError(reference, triangles);
+		CHECK(error <= expected + 1e-4f);
+		CHECK(error > expected - 0.1f);
+		CHECK(LodSelector::GeometricError(triangles, triangles) < 1e-5f);
+		CHECK(LodSelector::GeometricError({}, triangles) == 0.0f);
+		CHECK(LodSelector::ReferencePoints(std::vector<XMFLOAT3>(LodSelector::MaxReferencePoints * 3)).size() <= LodSelector::MaxReferencePoints);
+	}
+}
+
+int main()
+{
+	TestSelectionStaysInTheBand();
+	TestHysteresisHoldsAtTheSwitch();
+	TestBudgetFits();
+	TestGeometricErrorMatchesBruteForce();
+	return CheckResult();
+}
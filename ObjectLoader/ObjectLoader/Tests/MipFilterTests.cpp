@@ -0,0 +1,246 @@
+#include "Check.h"
+#include "MipFilter.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+	MipLevel Filled(const std::uint32_t width, const std::uint32_t height, const float r, const float g, const float b, const float a)
+	{
+		MipLevel level(width, height);
+		for (std::uint32_t y = 0; y < height; y++)
+		{
+			for (std::uint32_t x = 0; x < width; x++)
+			{
+				float* texel = level.At(x, y);
+				texel[0] = r;
+				texel[1] = g;
+				texel[2] = b;
+				texel[3] = a;
+			}
+		}
+		return level;
+	}
+
+	MipLevel Random(const std::uint32_t width, const std::uint32_t height, const unsigned seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		MipLevel level(width, height);
+		for (float& value : level.Texels)
+			value = unit(random);
+		return level;
+	}
+
+	//reference written straight from the definition: the area each destination texel covers, integrated in double
+	MipLevel ReferenceDownsample(const MipLevel& source)
+	{
+		const std::uint32_t width = source.Width / 2 > 0 ? source.Width / 2 : 1;
+		const std::uint32_t height = source.Height / 2 > 0 ? source.Height / 2 : 1;
+		const double scaleX = static_cast<double>(source.Width) / width;
+		const double scaleY = static_cast<double>(source.Height) / height;
+		MipLevel dest(width, height);
+		for (std::uint32_t y = 0; y < height; y++)
+		{
+			for (std::uint32_t x = 0; x < width; x++)
+			{
+				double sum[4] = {};
+				for (std::uint32_t sy = 0; sy < source.Height; sy++)
+				{
+					const double overlapY = std::fmin(sy + 1.0, (y + 1) * scaleY) - std::fmax(static_cast<double>(sy), y * scaleY);
+					if (overlapY <= 0.0)
+						continue;
+					for (std::uint32_t sx = 0; sx < source.Width; sx++)
+					{
+						const double overlapX = std::fmin(sx + 1.0, (x + 1) * scaleX) - std::fmax(static_cast<double>(sx), x * scaleX);
+						if (overlapX <= 0.0)
+							continue;
+						for (int c = 0; c < 4; c++)
+							sum[c] += source.At(sx, sy)[c] * overlapX * overlapY;
+					}
+				}
+				for (int c = 0; c < 4; c++)
+					dest.At(x, y)[c] = static_cast<float>(sum[c] / (scaleX * scaleY));
+			}
+		}
+		return dest;
+	}
+
+	void TestLevelCount()
+	{
+		CHECK(MipFilter::LevelCount(1, 1) == 1);
+		CHECK(MipFilter::LevelCount(256, 256) == 9);
+		CHECK(MipFilter::LevelCount(256, 16) == 9);
+		CHECK(MipFilter::LevelCount(13, 7) == 4);
+
+		const std::vector<MipLevel> chain = MipFilter::BuildChain(Filled(8, 2, 0, 0, 0, 1), MipContent::Linear);
+		CHECK(chain.size() == 4);
+		CHECK(chain[1].Width == 4 && chain[1].Height == 1);
+		CHECK(chain[3].Width == 1 && chain[3].Height == 1);
+	}
+
+	void TestSrgbCurve()
+	{
+		CHECK_NEAR(MipFilter::SrgbToLinear(0.0f), 0.0, 1e-7);
+		CHECK_NEAR(MipFilter::SrgbToLinear(1.0f), 1.0, 1e-6);
+		CHECK_NEAR(MipFilter::SrgbToLinear(0.5f), 0.214041, 1e-5);
+		for (int i = 0; i <= 255; i++)
+		{
+			const float value = i / 255.0f;
+			CHECK_NEAR(MipFilter::LinearToSrgb(MipFilter::SrgbToLinear(value)), value, 1e-5);
+		}
+	}
+
+	//black and white texels average to half the light, which is 188 in srgb and not the 128 a naive average gives
+	void TestCheckerboardAveragesInLinearSpace()
+	{
+		std::vector<std::uint8_t> pixels(8 * 8 * 4);
+		for (int y = 0; y < 8; y++)
+		{
+			for (int x = 0; x < 8; x++)
+			{
+				const std::uint8_t value = (x + y) % 2 == 0 ? 255 : 0;
+				std::uint8_t* texel = &pixels[(y * 8 + x) * 4];
+				texel[0] = texel[1] = texel[2] = value;
+				texel[3] = value;
+			}
+		}
+
+		const MipLevel top = MipFilter::FromRgba8(pixels.data(), 8, 8, 8 * 4);
+		for (const MipContent content : { MipContent::Srgb, MipContent::Linear })
+		{
+			const std::vector<MipLevel> chain = MipFilter::BuildChain(top, content);
+			const std::uint8_t expectedColor = content == MipContent::Srgb ? 188 : 128;
+			for (size_t mip = 1; mip < chain.size(); mip++)
+			{
+				std::vector<std::uint8_t> out(static_cast<size_t>(chain[mip].Width) * chain[mip].Height * 4);
+				MipFilter::ToRgba8(chain[mip], out.data(), chain[mip].Width * 4);
+				for (size_t i = 0; i < out.size(); i += 4)
+				{
+					CHECK(out[i] == expectedColor);
+					CHECK(out[i + 2] == expectedColor);
+					//alpha is coverage and always averaged linearly
+					CHECK(out[i + 3] == 128);
+				}
+			}
+		}
+	}
+
+	void TestNormalsAreRenormalized()
+	{
+		//ridges tilted 45 degrees left and right, averaged they have to point straight out again
+		const float tilt = 0.70710678f;
+		MipLevel top(4, 4);
+		for (std::uint32_t y = 0; y < 4; y++)
+		{
+			for (std::uint32_t x = 0; x < 4; x++)
+			{
+				float* texel = top.At(x, y);
+				texel[0] = (x % 2 == 0 ? tilt : -tilt) * 0.5f + 0.5f;
+				texel[1] = 0.5f;
+				texel[2] = tilt * 0.5f + 0.5f;
+				texel[3] = 1.0f;
+			}
+		}
+
+		const std::vector<MipLevel> chain = MipFilter::BuildChain(top, MipContent::Normal);
+		for (size_t mip = 1; mip < chain.size(); mip++)
+		{
+			for (std::uint32_t y = 0; y < chain[mip].Height; y++)
+			{
+				for (std::uint32_t x = 0; x < chain[mip].Width; x++)
+				{
+					const float* texel = chain[mip].At(x, y);
+					CHECK_NEAR(texel[0], 0.5, 1e-5);
+					CHECK_NEAR(texel[1], 0.5, 1e-5);
+					CHECK_NEAR(texel[2], 1.0, 1e-5);
+				}
+			}
+		}
+
+		//any blend of unit normals comes out unit length
+		const std::vector<MipLevel> random = MipFilter::BuildChain(Random(16, 16, 7), MipContent::Normal);
+		for (size_t mip = 1; mip < random.size(); mip++)
+		{
+			for (size_t i = 0; i < random[mip].Texels.size(); i += 4)
+			{
+				const float* texel = &random[mip].Texels[i];
+				const float x = texel[0] * 2.0f - 1.0f;
+				const float y = texel[1] * 2.0f - 1.0f;
+				const float z = texel[2] * 2.0f - 1.0f;
+				CHECK_NEAR(x * x + y * y + z * z, 1.0, 1e-4);
+			}
+		}
+	}
+
+	//every level against the reference filter, odd and non-square sizes included
+	void TestMatchesReference()
+	{
+		for (const auto& size : { std::pair<std::uint32_t, std::uint32_t>(16, 16), { 13, 7 }, { 5, 1 }, { 1, 9 }, { 31, 17 } })
+		{
+			const std::vector<MipLevel> chain = MipFilter::BuildChain(Random(size.first, size.second, size.first * 31 + size.second), MipContent::Linear);
+			for (size_t mip = 1; mip < chain.size(); mip++)
+			{
+				const MipLevel reference = ReferenceDownsample(chain[mip - 1]);
+				CHECK(reference.Width == chain[mip].Width && reference.Height == chain[mip].Height);
+				for (size_t i = 0; i < reference.Texels.size(); i++)
+				{
+					CHECK_NEAR(chain[mip].Texels[i], reference.Texels[i], 1e-5);
+				}
+			}
+		}
+	}
+
+	//for power of two sizes each level is the plain block average of the top
+	void TestPowerOfTwoMatchesBlockAverage()
+	{
+		const MipLevel top = Random(32, 8, 3);
+		const std::vector<MipLevel> chain = MipFilter::BuildChain(top, MipContent::Linear);
+		for (size_t mip = 1; mip < chain.size(); mip++)
+		{
+			const MipLevel& level = chain[mip];
+			const std::uint32_t blockX = top.Width / level.Width;
+			const std::uint32_t blockY = top.Height / level.Height;
+			for (std::uint32_t y = 0; y < level.Height; y++)
+			{
+				for (std::uint32_t x = 0; x < level.Width; x++)
+				{
+					double sum = 0.0;
+					for (std::uint32_t sy = 0; sy < blockY; sy++)
+						for (std::uint32_t sx = 0; sx < blockX; sx++)
+							sum += top.At(x * blockX + sx, y * blockY + sy)[1];
+					CHECK_NEAR(level.At(x, y)[1], sum / (blockX * blockY), 1e-5);
+				}
+			}
+		}
+	}
+
+	void TestRgba8RoundTrip()
+	{
+		std::vector<std::uint8_t> pixels(3 * 2 * 4 + 8);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = static_cast<std::uint8_t>(i * 37);
+		//rows are padded like d3d pitches
+		const size_t rowPitch = 3 * 4 + 4;
+		const MipLevel level = MipFilter::FromRgba8(pixels.data(), 3, 2, rowPitch);
+		std::vector<std::uint8_t> out(pixels.size(), 0);
+		MipFilter::ToRgba8(level, out.data(), rowPitch);
+		for (std::uint32_t y = 0; y < 2; y++)
+			for (size_t i = 0; i < 3 * 4; i++)
+				CHECK(out[y * rowPitch + i] == pixels[y * rowPitch + i]);
+	}
+}
+
+int main()
+{
+	TestLevelCount();
+	TestSrgbCurve();
+	TestCheckerboardAveragesInLinearSpace();
+	TestNormalsAreRenormalized();
+	TestMatchesReference();
+	TestPowerOfTwoMatchesBlockAverage();
+	TestRgba8RoundTrip();
+	return CheckResult();
+}
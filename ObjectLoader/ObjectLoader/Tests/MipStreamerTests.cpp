@@ -0,0 +1,315 @@
+#include "Check.h"
+#include "MipStreamer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	//rgba8 chain of a square texture, finest first
+	std::vector<std::uint64_t> ChainBytes(std::uint64_t size)
+	{
+		std::vector<std::uint64_t> bytes;
+		while (true)
+		{
+			bytes.push_back(size * size * 4);
+			if (size == 1)
+				break;
+			size /= 2;
+		}
+		return bytes;
+	}
+
+	const MipStreamer::Change* Find(const std::vector<MipStreamer::Change>& changes, const NameId id)
+	{
+		const auto found = std::find_if(changes.begin(), changes.end(),
+			[id](const MipStreamer::Change& change) { return change.Id == id; });
+		return found == changes.end() ? nullptr : &*found;
+	}
+
+	//applies a schedule the way TextureManager::UpdateStreaming does
+	std::vector<MipStreamer::Change> Step(MipStreamer& streamer, const int maxChanges)
+	{
+		const auto changes = streamer.Schedule(maxChanges);
+		for (const auto& change : changes)
+			streamer.SetResident(change.Id, change.TargetMip);
+		return changes;
+	}
+
+	void TestFootprint()
+	{
+		//one texel per pixel or finer keeps the top mip
+		CHECK(MipStreamer::MipForFootprint(1.0f / 1024.0f, 1024, 11) == 0);
+		CHECK(MipStreamer::MipForFootprint(0.0f, 1024, 11) == 0);
+		CHECK(MipStreamer::MipForFootprint(2.0f / 1024.0f, 1024, 11) == 1);
+		CHECK(MipStreamer::MipForFootprint(3.9f / 1024.0f, 1024, 11) == 1);
+		CHECK(MipStreamer::MipForFootprint(4.0f / 1024.0f, 1024, 11) == 2);
+		//never past the last level
+		CHECK(MipStreamer::MipForFootprint(100.0f, 1024, 11) == 10);
+
+		CHECK(MipStreamer::TailMip(1024, 1024, 11) == 3);
+		CHECK(MipStreamer::TailMip(1024, 256, 11) == 3);
+		CHECK(MipStreamer::TailMip(64, 64, 7) == 0);
+		//a short chain stops at its last level
+		CHECK(MipStreamer::TailMip(1024, 1024, 2) == 1);
+	}
+
+	void TestTrackingBytes()
+	{
+		MipStreamer streamer;
+		const auto bytes = ChainBytes(256);
+		streamer.Track(1, bytes, 1, 1);
+		CHECK(streamer.IsTracked(1));
+		CHECK(!streamer.IsTracked(2));
+
+		std::uint64_t fromOne = 0;
+		for (size_t mip = 1; mip < bytes.size(); mip++)
+			fromOne += bytes[mip];
+		CHECK(streamer.ResidentBytes() == fromOne);
+
+		streamer.SetResident(1, 0);
+		CHECK(streamer.ResidentBytes() == fromOne + bytes[0]);
+		CHECK(streamer.Resident(1) == 0);
+
+		//tracking twice replaces the old entry instead of counting it again
+		streamer.Track(1, bytes, 1, 1);
+		CHECK(streamer.ResidentBytes() == fromOne);
+
+		streamer.Untrack(1);
+		CHECK(!streamer.IsTracked(1));
+		CHECK(streamer.ResidentBytes() == 0);
+
+		//requests for unknown textures are ignored
+		streamer.Request(5, 0);
+		CHECK(streamer.Schedule(4).empty());
+	}
+
+	void TestUpgradesBiggestGapFirst()
+	{
+		MipStreamer streamer;
+		streamer.Track(1, ChainBytes(1024), 3, 3);
+		streamer.Track(2, ChainBytes(1024), 3, 3);
+		streamer.Track(3, ChainBytes(1024), 3, 3);
+		streamer.Request(1, 2);
+		streamer.Request(2, 0);
+		streamer.Request(3, 1);
+
+		//the finest request of the frame wins
+		streamer.Request(1, 2);
+		streamer.Request(3, 2);
+
+		const auto changes = Step(streamer, 2);
+		CHECK(changes.size() == 2);
+		CHECK(changes.size() == 2 && changes[0].Id == 2 && changes[0].TargetMip == 0);
+		CHECK(changes.size() == 2 && changes[1].Id == 3 && changes[1].TargetMip == 1);
+
+		//the one left over comes next frame, requests are not carried over
+		CHECK(Step(streamer, 2).empty());
+		streamer.Request(1, 2);
+		const auto next = Step(streamer, 2);
+		CHECK(next.size() == 1 && next[0].Id == 1 && next[0].TargetMip == 2);
+	}
+
+	void TestRequestsClampToTail()
+	{
+		MipStreamer streamer;
+		streamer.Track(1, ChainBytes(1024), 3, 3);
+		//a coarser request than the tail never downgrades past it
+		streamer.Request(1, 8);
+		CHECK(Step(streamer, 4).empty());
+		CHECK(streamer.Resident(1) == 3);
+
+		streamer.Request(1, -2);
+		const auto changes = Step(streamer, 4);
+		CHECK(changes.size() == 1 && changes[0].TargetMip == 0);
+	}
+
+	void TestDowngradeAfterDelay()
+	{
+		MipStreamer streamer;
+		streamer.DowngradeDelay = 3;
+		streamer.Track(1, ChainBytes(1024), 3, 3);
+		streamer.Request(1, 0);
+		Step(streamer, 4);
+		CHECK(streamer.Resident(1) == 0);
+
+		//still requesting the finest mip keeps it
+		for (int frame = 0; frame < 10; frame++)
+		{
+			streamer.Request(1, 0);
+			CHECK(Step(streamer, 4).empty());
+		}
+
+		//an object far away now: the mips stay for the delay, then go back to what is needed
+		int framesUntilDowngrade = 0;
+		std::vector<MipStreamer::Change> changes;
+		while (changes.empty() && framesUntilDowngrade < 20)
+		{
+			streamer.Request(1, 2);
+			changes = Step(streamer, 4);
+			framesUntilDowngrade++;
+		}
+		CHECK(framesUntilDowngrade == streamer.DowngradeDelay + 1);
+		CHECK(changes.size() == 1 && changes[0].TargetMip == 2);
+
+		//nothing drawn at all drops it to the tail
+		for (int frame = 0; frame < 10; frame++)
+			Step(streamer, 4);
+		CHECK(streamer.Resident(1) == 3);
+	}
+
+	void TestUpgradeBeforeDowngrade()
+	{
+		MipStreamer streamer;
+		streamer.DowngradeDelay = 0;
+		streamer.Track(1, ChainBytes(1024), 3, 0);
+		streamer.Track(2, ChainBytes(1024), 3, 3);
+		//texture 1 is only kept for the frame it was tracked in
+		CHECK(Step(streamer, 0).empty());
+
+		//with room for a single change the texture being looked at goes first
+		streamer.Request(2, 0);
+		const auto first = Step(streamer, 1);
+		CHECK(first.size() == 1 && first[0].Id == 2 && first[0].TargetMip == 0);
+		CHECK(streamer.Resident(1) == 0);
+
+		const auto second = Step(streamer, 1);
+		CHECK(Find(second, 1) != nullptr && Find(second, 1)->TargetMip == 3);
+	}
+
+	std::uint64_t BytesFrom(const std::vector<std::uint64_t>& bytes, const int mip)
+	{
+		std::uint64_t total = 0;
+		for (size_t level = static_cast<size_t>(mip); level < bytes.size(); level++)
+			total += bytes[level];
+		return total;
+	}
+
+	void TestBudgetEvictsLeastRecentlyUsed()
+	{
+		const auto bytes = ChainBytes(1024);
+		MipStreamer streamer;
+		streamer.DowngradeDelay = 1000;
+		//three textures at full resolution and the tail of a fourth fill the budget
+		for (NameId id = 1; id <= 3; id++)
+			streamer.Track(id, bytes, 3, 0);
+		streamer.BudgetBytes = 3 * BytesFrom(bytes, 0) + BytesFrom(bytes, 3);
+
+		//texture 1 was drawn longest ago, 3 most recently
+		streamer.Request(1, 0);
+		Step(streamer, 0);
+		streamer.Request(2, 0);
+		Step(streamer, 0);
+		streamer.Request(3, 0);
+		Step(streamer, 0);
+		CHECK(streamer.LastUsed(1) < streamer.LastUsed(2));
+		CHECK(streamer.LastUsed(2) < streamer.LastUsed(3));
+
+		//a fourth texture needs room: the least recently drawn one drops to its tail
+		streamer.Track(4, bytes, 3, 3);
+		streamer.Request(4, 0);
+		const auto changes = Step(streamer, 4);
+		CHECK(Find(changes, 1) != nullptr && Find(changes, 1)->TargetMip == 3);
+		CHECK(Find(changes, 2) == nullptr);
+		CHECK(Find(changes, 3) == nullptr);
+		CHECK(Find(changes, 4) != nullptr && Find(changes, 4)->TargetMip == 0);
+		CHECK(streamer.ResidentBytes() <= streamer.BudgetBytes);
+	}
+
+	void TestBudgetTieBreaksOnSavings()
+	{
+		MipStreamer streamer;
+		streamer.DowngradeDelay = 1000;
+		const auto small = ChainBytes(512);
+		const auto large = ChainBytes(2048);
+		streamer.Track(1, small, 2, 0);
+		streamer.Track(2, large, 4, 0);
+		Step(streamer, 0);
+
+		//both unused since the same frame, dropping the big one frees enough on its own
+		streamer.BudgetBytes = streamer.ResidentBytes() - 1;
+		streamer.Track(3, small, 2, 2);
+		streamer.Request(3, 0);
+		const auto changes = Step(streamer, 4);
+		CHECK(Find(changes, 2) != nullptr);
+		CHECK(Find(changes, 1) == nullptr);
+		CHECK(streamer.ResidentBytes() <= streamer.BudgetBytes);
+	}
+
+	void TestUpgradeSettlesForWhatFits()
+	{
+		const auto bytes = ChainBytes(1024);
+		MipStreamer streamer;
+		streamer.Track(1, bytes, 3, 3);
+		//room for mip 1 but not for the top level
+		streamer.BudgetBytes = BytesFrom(bytes, 1);
+		streamer.Request(1, 0);
+		const auto changes = Step(streamer, 4);
+		CHECK(changes.size() == 1 && changes[0].TargetMip == 1);
+		CHECK(streamer.ResidentBytes() == BytesFrom(bytes, 1));
+
+		//not even the next level fits: nothing changes
+		streamer.BudgetBytes = BytesFrom(bytes, 3);
+		streamer.Track(2, bytes, 3, 3);
+		streamer.SetResident(1, 3);
+		streamer.Request(2, 0);
+		CHECK(Step(streamer, 4).empty());
+	}
+
+	void TestUnlimitedBudget()
+	{
+		const auto bytes = ChainBytes(1024);
+		MipStreamer streamer;
+		for (NameId id = 1; id <= 8; id++)
+		{
+			streamer.Track(id, bytes, 3, 3);
+			streamer.Request(id, 0);
+		}
+		CHECK(Step(streamer, 8).size() == 8);
+		CHECK(streamer.ResidentBytes() == 8 * BytesFrom(bytes, 0));
+	}
+
+	void TestBudgetHoldsOverManyFrames()
+	{
+		//a camera sweeping over more textures than fit, the budget must hold every frame
+		const auto bytes = ChainBytes(512);
+		MipStreamer streamer;
+		streamer.DowngradeDelay = 30;
+		const NameId count = 40;
+		for (NameId id = 1; id <= count; id++)
+			streamer.Track(id, bytes, 2, 2);
+		streamer.BudgetBytes = 10 * BytesFrom(bytes, 0);
+
+		bool withinBudget = true;
+		int upgrades = 0;
+		for (int frame = 0; frame < 600; frame++)
+		{
+			//a window of eight visible textures moving along
+			const NameId first = 1 + static_cast<NameId>((frame / 10) % count);
+			for (NameId offset = 0; offset < 8; offset++)
+				streamer.Request(1 + (first - 1 + offset) % count, 0);
+			for (const auto& change : Step(streamer, 4))
+				upgrades += change.TargetMip == 0 ? 1 : 0;
+			withinBudget = withinBudget && streamer.ResidentBytes() <= streamer.BudgetBytes;
+		}
+		CHECK(withinBudget);
+		CHECK(upgrades > static_cast<int>(count));
+	}
+}
+
+int main()
+{
+	TestFootprint();
+	TestTrackingBytes();
+	TestUpgradesBiggestGapFirst();
+	TestRequestsClampToTail();
+	TestDowngradeAfterDelay();
+	TestUpgradeBeforeDowngrade();
+	TestBudgetEvictsLeastRecentlyUsed();
+	TestBudgetTieBreaksOnSavings();
+	TestUpgradeSettlesForWhatFits();
+	TestUnlimitedBudget();
+	TestBudgetHoldsOverManyFrames();
+	return CheckResult();
+}
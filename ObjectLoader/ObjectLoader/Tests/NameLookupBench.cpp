@@ -0,0 +1,123 @@
+#include "Check.h"
+#include "NameTable.h"
+
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//per-frame cost of what the draw and constant buffer loops look up for every object:
+//its geometry and the srv slots of its material textures, once by string and once by interned id.
+//usage: NameLookupBench [objects = 10000] [frames = 200]
+namespace
+{
+	const int gTexturesPerMaterial = 4;
+	const int gUniqueModels = 250;
+
+	struct GeometryEntry
+	{
+		unsigned IndexCount;
+	};
+
+	struct StringObject
+	{
+		std::string Geometry;
+		std::string Textures[gTexturesPerMaterial];
+	};
+
+	struct IdObject
+	{
+		NameId Geometry;
+		NameId Textures[gTexturesPerMaterial];
+	};
+
+	std::string ModelName(const int model)
+	{
+		return "Models/Props/prop_" + std::to_string(model) + ".fbx";
+	}
+
+	std::string TextureName(const int model, const int texture)
+	{
+		return "Models/Props/Textures/prop_" + std::to_string(model) + "_map" + std::to_string(texture) + ".png";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int objectCount = argc > 1 ? std::atoi(argv[1]) : 10000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	std::unordered_map<std::string, GeometryEntry> geometryByName;
+	std::unordered_map<std::string, unsigned> srvByName;
+	std::vector<GeometryEntry> geometryById;
+	std::vector<unsigned> srvById;
+	const auto store = [](auto& dense, const NameId id, const auto& value)
+	{
+		if (id >= dense.size())
+			dense.resize(static_cast<size_t>(id) + 1);
+		dense[id] = value;
+	};
+
+	for (int model = 0; model < gUniqueModels; model++)
+	{
+		const GeometryEntry geometry = { static_cast<unsigned>(model * 3 + 36) };
+		geometryByName[ModelName(model)] = geometry;
+		store(geometryById, NameTable::Intern(ModelName(model)), geometry);
+		for (int texture = 0; texture < gTexturesPerMaterial; texture++)
+		{
+			const unsigned srv = static_cast<unsigned>(model * gTexturesPerMaterial + texture);
+			srvByName[TextureName(model, texture)] = srv;
+			store(srvById, NameTable::Intern(TextureName(model, texture)), srv);
+		}
+	}
+
+	std::vector<StringObject> stringObjects(objectCount);
+	std::vector<IdObject> idObjects(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		const int model = (i * 7919) % gUniqueModels;
+		stringObjects[i].Geometry = ModelName(model);
+		idObjects[i].Geometry = NameTable::Find(ModelName(model));
+		for (int texture = 0; texture < gTexturesPerMaterial; texture++)
+		{
+			stringObjects[i].Textures[texture] = TextureName(model, texture);
+			idObjects[i].Textures[texture] = NameTable::Find(TextureName(model, texture));
+		}
+	}
+
+	unsigned long long stringSum = 0;
+	const double stringMs = MeasureMs([&]()
+		{
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (const auto& object : stringObjects)
+				{
+					stringSum += geometryByName.find(object.Geometry)->second.IndexCount;
+					for (const auto& texture : object.Textures)
+						stringSum += srvByName.find(texture)->second;
+				}
+			}
+		});
+
+	unsigned long long idSum = 0;
+	const double idMs = MeasureMs([&]()
+		{
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (const auto& object : idObjects)
+				{
+					idSum += geometryById[object.Geometry].IndexCount;
+					for (const NameId texture : object.Textures)
+						idSum += srvById[texture];
+				}
+			}
+		});
+
+	//both loops have to agree, otherwise the comparison means nothing
+	CHECK(stringSum == idSum);
+
+	std::printf("%d objects, %d lookups each, %d frames\n", objectCount, gTexturesPerMaterial + 1, frames);
+	std::printf("string keys: %8.4f ms/frame\n", stringMs / frames);
+	std::printf("interned ids: %7.4f ms/frame (%.1fx)\n", idMs / frames, idMs > 0.0 ? stringMs / idMs : 0.0);
+	return CheckResult();
+}
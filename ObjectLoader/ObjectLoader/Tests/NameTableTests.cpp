@@ -0,0 +1,95 @@
+#include "Check.h"
+#include "NameTable.h"
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	void TestInternDeduplicates()
+	{
+		const NameId box = NameTable::Intern("test/box");
+		const NameId sphere = NameTable::Intern("test/sphere");
+		CHECK(box != gInvalidNameId);
+		CHECK(box != sphere);
+		CHECK(NameTable::Intern("test/box") == box);
+		CHECK(NameTable::Find("test/sphere") == sphere);
+		CHECK(NameTable::Name(box) == "test/box");
+	}
+
+	void TestFindDoesNotAdd()
+	{
+		const size_t count = NameTable::Count();
+		CHECK(NameTable::Find("test/never interned") == gInvalidNameId);
+		CHECK(NameTable::Count() == count);
+		CHECK(NameTable::Name(gInvalidNameId).empty());
+	}
+
+	void TestIdsAreDense()
+	{
+		const NameId first = NameTable::Intern("test/dense 0");
+		for (NameId i = 1; i < 100; i++)
+		{
+			CHECK(NameTable::Intern("test/dense " + std::to_string(i)) == first + i);
+		}
+		CHECK(NameTable::Count() >= static_cast<size_t>(first) + 100);
+	}
+
+	void TestNamesStayValid()
+	{
+		//ui keeps references around while imports add more names
+		const std::string& name = NameTable::Name(NameTable::Intern("test/kept"));
+		for (int i = 0; i < 10000; i++)
+		{
+			NameTable::Intern("test/filler " + std::to_string(i));
+		}
+		CHECK(name == "test/kept");
+	}
+
+	void TestConcurrentIntern()
+	{
+		//decode workers intern texture paths while the main thread imports
+		const int threadCount = 4;
+		const int nameCount = 500;
+		std::vector<std::vector<NameId>> ids(threadCount, std::vector<NameId>(nameCount));
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([t, &ids]()
+				{
+					for (int i = 0; i < nameCount; i++)
+					{
+						ids[t][i] = NameTable::Intern("test/shared " + std::to_string(i));
+					}
+				});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		std::set<NameId> unique;
+		for (int i = 0; i < nameCount; i++)
+		{
+			for (int t = 1; t < threadCount; t++)
+			{
+				CHECK(ids[t][i] == ids[0][i]);
+			}
+			unique.insert(ids[0][i]);
+			CHECK(NameTable::Name(ids[0][i]) == "test/shared " + std::to_string(i));
+		}
+		CHECK(unique.size() == static_cast<size_t>(nameCount));
+	}
+}
+
+int main()
+{
+	TestInternDeduplicates();
+	TestFindDoesNotAdd();
+	TestIdsAreDense();
+	TestNamesStayValid();
+	TestConcurrentIntern();
+	return CheckResult();
+}
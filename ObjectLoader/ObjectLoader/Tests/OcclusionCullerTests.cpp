@@ -0,0 +1,255 @@
+#include "Check.h"
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//occluder voxelization and the depth test against analytic walls: a box may only be reported hidden
+//when every point of it is behind an occluder. built for the sse and the portable raster loop
+namespace
+{
+	const XMFLOAT3 gEye(0.0f, 1.0f, -12.0f);
+
+	XMMATRIX ViewProj()
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&gEye), XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		return view * XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 2.0f, 0.1f, 200.0f);
+	}
+
+	//closed box as a triangle soup, outward winding does not matter to the voxelizer
+	std::vector<XMFLOAT3> BoxTriangles(const BoundingBox& box, const bool open = false)
+	{
+		XMFLOAT3 c[8];
+		for (int i = 0; i < 8; i++)
+		{
+			c[i] = XMFLOAT3(box.Center.x + (i >> 2 & 1 ? box.Extents.x : -box.Extents.x),
+				box.Center.y + (i >> 1 & 1 ? box.Extents.y : -box.Extents.y),
+				box.Center.z + (i & 1 ? box.Extents.z : -box.Extents.z));
+		}
+		const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+		std::vector<XMFLOAT3> triangles;
+		for (int f = open ? 1 : 0; f < 6; f++)
+		{
+			for (const int k : { 0, 1, 2, 0, 2, 3 })
+				triangles.push_back(c[faces[f][k]]);
+		}
+		return triangles;
+	}
+
+	//the box itself as an occluder, faces as BuildOccluder lays them out
+	OccluderMesh BoxOccluder(const BoundingBox& box)
+	{
+		OccluderMesh occluder;
+		for (int i = 0; i < 8; i++)
+		{
+			occluder.Vertices.emplace_back(box.Center.x + (i >> 2 & 1 ? box.Extents.x : -box.Extents.x),
+				box.Center.y + (i >> 1 & 1 ? box.Extents.y : -box.Extents.y),
+				box.Center.z + (i & 1 ? box.Extents.z : -box.Extents.z));
+		}
+		occluder.Indices = { 0, 1, 3, 2, 4, 6, 7, 5, 0, 4, 5, 1, 2, 3, 7, 6, 0, 2, 6, 4, 1, 5, 7, 3 };
+		return occluder;
+	}
+
+	//segment from the eye to the point passes through the box
+	bool Behind(const BoundingBox& wall, const XMFLOAT3& point)
+	{
+		const float origin[3] = { gEye.x, gEye.y, gEye.z };
+		const float target[3] = { point.x, point.y, point.z };
+		const float center[3] = { wall.Center.x, wall.Center.y, wall.Center.z };
+		const float extents[3] = { wall.Extents.x, wall.Extents.y, wall.Extents.z };
+		float enter = 0.0f;
+		float exit = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float direction = target[axis] - origin[axis];
+			const float low = center[axis] - extents[axis] - origin[axis];
+			const float high = center[axis] + extents[axis] - origin[axis];
+			if (std::abs(direction) < 1e-9f)
+			{
+				if (low > 0.0f || high < 0.0f)
+					return false;
+				continue;
+			}
+			const float t0 = low / direction;
+			const float t1 = high / direction;
+			enter = (std::max)(enter, (std::min)(t0, t1));
+			exit = (std::min)(exit, (std::max)(t0, t1));
+		}
+		return enter <= exit;
+	}
+
+	//a grid of points through the box, all of them have to be hidden by one of the walls
+	bool TrulyHidden(const std::vector<BoundingBox>& walls, const BoundingBox& box)
+	{
+		const int steps = 4;
+		for (int k = 0; k <= steps; k++)
+		{
+			for (int j = 0; j <= steps; j++)
+			{
+				for (int i = 0; i <= steps; i++)
+				{
+					const XMFLOAT3 point(box.Center.x + box.Extents.x * (2.0f * i / steps - 1.0f),
+						box.Center.y + box.Extents.y * (2.0f * j / steps - 1.0f),
+						box.Center.z + box.Extents.z * (2.0f * k / steps - 1.0f));
+					bool hidden = false;
+					for (const BoundingBox& wall : walls)
+						hidden = hidden || Behind(wall, point);
+					if (!hidden)
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void TestBoxOccluderStaysInside()
+	{
+		const BoundingBox box(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(2.0f, 1.0f, 0.5f));
+		const OccluderMesh occluder = OcclusionCuller::BuildOccluder(BoxTriangles(box), 16, 16);
+		CHECK(!occluder.Empty());
+		CHECK(occluder.Indices.size() % 4 == 0);
+		//voxels the surface passes through are not enclosed, the occluder loses up to two cells a side
+		BoundingBox bounds;
+		BoundingBox::CreateFromPoints(bounds, occluder.Vertices.size(), occluder.Vertices.data(), sizeof(XMFLOAT3));
+		CHECK(box.Contains(bounds) == CONTAINS);
+		CHECK(bounds.Extents.x > box.Extents.x * 0.7f && bounds.Extents.y > box.Extents.y * 0.7f && bounds.Extents.z > box.Extents.z * 0.7f);
+	}
+
+	//a convex shape that is not a box, every occluder corner has to stay inside it
+	void TestOctahedronStaysInside()
+	{
+		const XMFLOAT3 tips[6] = { { 3, 0, 0 }, { -3, 0, 0 }, { 0, 3, 0 }, { 0, -3, 0 }, { 0, 0, 3 }, { 0, 0, -3 } };
+		std::vector<XMFLOAT3> triangles;
+		for (const int x : { 0, 1 })
+			for (const int y : { 2, 3 })
+				for (const int z : { 4, 5 })
+					triangles.insert(triangles.end(), { tips[x], tips[y], tips[z] });
+
+		const OccluderMesh occluder = OcclusionCuller::BuildOccluder(triangles, 24, 8);
+		CHECK(!occluder.Empty());
+		CHECK(occluder.Indices.size() <= 8 * 24);
+		bool inside = true;
+		for (const XMFLOAT3& v : occluder.Vertices)
+			inside = inside && std::abs(v.x) + std::abs(v.y) + std::abs(v.z) <= 3.0f + 1e-4f;
+		CHECK(inside);
+	}
+
+	void TestOpenAndFlatMeshesEncloseNothing()
+	{
+		const BoundingBox box(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		CHECK(OcclusionCuller::BuildOccluder(BoxTriangles(box, true), 16, 16).Empty());
+		const BoundingBox flat(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 1.0f));
+		CHECK(OcclusionCuller::BuildOccluder(BoxTriangles(flat), 16, 16).Empty());
+		CHECK(OcclusionCuller::BuildOccluder({}, 16, 16).Empty());
+	}
+
+	//a wall facing the camera has one depth, nothing may be written in front of it
+	void TestWallDepthIsNeverNearer()
+	{
+		const BoundingBox wall(XMFLOAT3(0.0f, 1.0f, 0.5f), XMFLOAT3(3.0f, 2.0f, 0.5f));
+		OcclusionCuller culler(256, 128);
+		culler.BeginFrame(ViewProj());
+		culler.RasterizeOccluder(BoxOccluder(wall), XMMatrixIdentity());
+		CHECK(culler.RasterizedQuads() > 0);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f), ViewProj()));
+		const float front = clip.z / clip.w;
+		int written = 0;
+		bool nearer = false;
+		for (const float depth : culler.Depth())
+		{
+			written += depth < 1.0f;
+			nearer = nearer || depth < front - 1e-6f;
+		}
+		CHECK(!nearer);
+		CHECK(written > 0);
+		CHECK_NEAR(culler.Depth()[64 * culler.Width() + 128], front, 1e-5);
+	}
+
+	void TestBoxesAroundAWall()
+	{
+		const BoundingBox wall(XMFLOAT3(0.0f, 1.0f, 0.5f), XMFLOAT3(3.0f, 2.0f, 0.5f));
+		OcclusionCuller culler(256, 128);
+		culler.BeginFrame(ViewProj());
+		culler.RasterizeOccluder(BoxOccluder(wall), XMMatrixIdentity());
+		culler.BuildHierarchy();
+
+		CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 1.0f, 6.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		//in front of the wall, beside it, sticking out above it
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 1.0f, -3.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(8.0f, 1.0f, 6.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 4.0f, 6.0f), XMFLOAT3(1.0f, 2.0f, 1.0f))));
+		//reaching the camera plane and off screen
+		CHECK(culler.IsVisible(BoundingBox(gEye, XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 1.0f, -30.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+		//nothing rasterized hides nothing
+		culler.BeginFrame(ViewProj());
+		culler.BuildHierarchy();
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 1.0f, 6.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	}
+
+	//random walls and boxes, every box reported hidden is checked point by point
+	void TestNoFalseOcclusion()
+	{
+		std::mt19937 random(21);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		int hiddenCount = 0;
+		bool falseHidden = false;
+		for (int scene = 0; scene < 20; scene++)
+		{
+			std::vector<BoundingBox> walls;
+			OcclusionCuller culler(128, 64);
+			culler.BeginFrame(ViewProj());
+			for (int w = 0; w < 3; w++)
+			{
+				walls.emplace_back(XMFLOAT3(unit(random) * 12.0f - 6.0f, unit(random) * 4.0f - 1.0f, unit(random) * 6.0f - 4.0f),
+					XMFLOAT3(1.0f + unit(random) * 3.0f, 1.0f + unit(random) * 2.0f, 0.2f + unit(random)));
+				culler.RasterizeOccluder(BoxOccluder(walls.back()), XMMatrixIdentity());
+			}
+			culler.BuildHierarchy();
+
+			for (int b = 0; b < 200; b++)
+			{
+				const BoundingBox box(XMFLOAT3(unit(random) * 30.0f - 15.0f, unit(random) * 10.0f - 4.0f, 4.0f + unit(random) * 30.0f),
+					XMFLOAT3(0.1f + unit(random), 0.1f + unit(random), 0.1f + unit(random)));
+				if (!culler.IsVisible(box))
+				{
+					hiddenCount++;
+					falseHidden = falseHidden || !TrulyHidden(walls, box);
+				}
+			}
+		}
+		CHECK(!falseHidden);
+		CHECK(hiddenCount > 100);
+	}
+
+	//the occluder moves with its world matrix
+	void TestWorldTransform()
+	{
+		const OccluderMesh unitWall = BoxOccluder(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		OcclusionCuller culler(256, 128);
+		culler.BeginFrame(ViewProj());
+		culler.RasterizeOccluder(unitWall, XMMatrixScaling(6.0f, 4.0f, 1.0f) * XMMatrixTranslation(-8.0f, 1.0f, 0.5f));
+		culler.BuildHierarchy();
+		CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(-10.0f, 1.0f, 8.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 1.0f, 8.0f), XMFLOAT3(0.5f, 0.5f, 0.5f))));
+	}
+}
+
+int main()
+{
+	TestBoxOccluderStaysInside();
+	TestOctahedronStaysInside();
+	TestOpenAndFlatMeshesEncloseNothing();
+	TestWallDepthIsNeverNearer();
+	TestBoxesAroundAWall();
+	TestNoFalseOcclusion();
+	TestWorldTransform();
+	return CheckResult();
+}
@@ -0,0 +1,248 @@
+#include "Check.h"
+#include "PvsBaker.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//a small scene of two rooms split by a wall, with and without a door in it
+namespace
+{
+	namespace fs = std::filesystem;
+
+	//eight corners of a box in the order AddBlockers expects, min first and max last
+	OccluderMesh BoxOccluder(const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		OccluderMesh mesh;
+		for (int i = 0; i < 8; i++)
+			mesh.Vertices.emplace_back(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+		mesh.Indices = { 0, 1, 3, 2 };
+		return mesh;
+	}
+
+	std::vector<BoundingBox> TwoRooms()
+	{
+		return {
+			BoundingBox(XMFLOAT3(-20.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)),
+			BoundingBox(XMFLOAT3(20.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)),
+			BoundingBox(XMFLOAT3(-12.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)) };
+	}
+
+	//a wall through the whole scene at x = 0, with a gap around z = 0 when door is set
+	std::vector<PvsBlocker> Wall(const bool door)
+	{
+		std::vector<PvsBlocker> blockers;
+		if (door)
+		{
+			PvsBaker::AddBlockers(BoxOccluder(XMFLOAT3(-0.5f, -50.0f, -50.0f), XMFLOAT3(0.5f, 50.0f, -0.3f)), XMMatrixIdentity(), -1, blockers);
+			PvsBaker::AddBlockers(BoxOccluder(XMFLOAT3(-0.5f, -50.0f, 0.3f), XMFLOAT3(0.5f, 50.0f, 50.0f)), XMMatrixIdentity(), -1, blockers);
+		}
+		else
+			PvsBaker::AddBlockers(BoxOccluder(XMFLOAT3(-0.5f, -50.0f, -50.0f), XMFLOAT3(0.5f, 50.0f, 50.0f)), XMMatrixIdentity(), -1, blockers);
+		return blockers;
+	}
+
+	std::vector<char> ReadBytes(const fs::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	VisibilityMask SetAt(const PotentiallyVisibleSet& pvs, const XMFLOAT3& point)
+	{
+		VisibilityMask mask;
+		const int cell = pvs.CellAt(point);
+		if (cell >= 0)
+			pvs.Decode(cell, mask);
+		return mask;
+	}
+
+	void TestEncodeRoundTrips()
+	{
+		std::mt19937 random(61);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		bool same = true;
+		for (const size_t size : { 0, 1, 31, 32, 33, 100, 1000, 5000 })
+		{
+			for (const float density : { 0.0f, 0.002f, 0.05f, 0.5f, 0.98f, 1.0f })
+			{
+				VisibilityMask mask;
+				mask.Reset(size);
+				for (size_t i = 0; i < size; i++)
+				{
+					if (unit(random) < density)
+						mask.Set(i);
+				}
+
+				std::vector<uint8_t> set;
+				PvsBaker::Encode(mask, set);
+				VisibilityMask decoded;
+				decoded.Reset(size);
+				PvsBaker::Decode(set.data(), set.size(), decoded);
+				same = same && decoded.Words() == mask.Words();
+				//never more than the raw bits and their mode byte
+				same = same && set.size() <= (size + 7) / 8 + 1;
+			}
+		}
+		CHECK(same);
+
+		//long runs are what the run encoding is for
+		VisibilityMask sparse;
+		sparse.Reset(10000);
+		sparse.Set(5000);
+		std::vector<uint8_t> set;
+		PvsBaker::Encode(sparse, set);
+		CHECK(set.size() <= 8);
+	}
+
+	void TestWallHidesTheOtherRoom()
+	{
+		const std::vector<BoundingBox> bounds = TwoRooms();
+		WorkerPool pool(2);
+		const PotentiallyVisibleSet open = PvsBaker::Bake(bounds, {}, PvsBakeSettings(), pool);
+		const PotentiallyVisibleSet walled = PvsBaker::Bake(bounds, Wall(false), PvsBakeSettings(), pool);
+
+		//nothing in the way, every cell sees every object
+		bool everything = true;
+		for (int cell = 0; cell < open.CellCount(); cell++)
+		{
+			VisibilityMask mask;
+			open.Decode(cell, mask);
+			everything = everything && mask.Count() == bounds.size();
+		}
+		CHECK(everything);
+
+		const VisibilityMask left = SetAt(walled, XMFLOAT3(-19.0f, 0.0f, 0.0f));
+		const VisibilityMask right = SetAt(walled, XMFLOAT3(19.0f, 0.0f, 0.0f));
+		CHECK(left.Size() == bounds.size());
+		CHECK(left.Test(0) && left.Test(2) && !left.Test(1));
+		CHECK(right.Size() == bounds.size());
+		CHECK(right.Test(1) && !right.Test(0) && !right.Test(2));
+
+		//a wall is only ever taken away from what the open scene sees
+		bool subset = true;
+		for (int cell = 0; cell < walled.CellCount(); cell++)
+		{
+			VisibilityMask withWall;
+			VisibilityMask without;
+			open.Decode(cell, without);
+			walled.Decode(cell, withWall);
+			for (size_t w = 0; w < withWall.Words().size(); w++)
+				subset = subset && (withWall.Words()[w] & ~without.Words()[w]) == 0;
+		}
+		CHECK(subset);
+	}
+
+	void TestDoorLetsTheRoomsSeeEachOther()
+	{
+		const std::vector<BoundingBox> bounds = TwoRooms();
+		WorkerPool pool(2);
+		const PotentiallyVisibleSet pvs = PvsBaker::Bake(bounds, Wall(true), PvsBakeSettings(), pool);
+		const VisibilityMask left = SetAt(pvs, XMFLOAT3(-19.0f, 0.0f, 0.0f));
+		CHECK(left.Size() == bounds.size());
+		CHECK(left.Test(1));
+	}
+
+	//cells whose every sample is inside a wall cannot be stood in
+	void TestCellsInsideWallsAreSolid()
+	{
+		const std::vector<BoundingBox> bounds = TwoRooms();
+		std::vector<PvsBlocker> blockers;
+		PvsBaker::AddBlockers(BoxOccluder(XMFLOAT3(-6.0f, -50.0f, -50.0f), XMFLOAT3(6.0f, 50.0f, 50.0f)), XMMatrixIdentity(), -1, blockers);
+		WorkerPool pool(2);
+		const PotentiallyVisibleSet pvs = PvsBaker::Bake(bounds, blockers, PvsBakeSettings(), pool);
+		CHECK(pvs.CellAt(XMFLOAT3(0.0f, 0.0f, 0.0f)) == -1);
+		CHECK(pvs.CellAt(XMFLOAT3(-19.0f, 0.0f, 0.0f)) >= 0);
+		CHECK(pvs.CellAt(XMFLOAT3(19.0f, 0.0f, 0.0f)) >= 0);
+	}
+
+	//blockers of rotated objects stay in the object's space
+	void TestBlockersFollowTheirObject()
+	{
+		std::vector<PvsBlocker> blockers;
+		const XMMATRIX world = XMMatrixRotationY(XM_PIDIV4) * XMMatrixTranslation(10.0f, 0.0f, 0.0f);
+		PvsBaker::AddBlockers(BoxOccluder(XMFLOAT3(-2.0f, -1.0f, -0.1f), XMFLOAT3(2.0f, 1.0f, 0.1f)), world, 7, blockers);
+		CHECK(blockers.size() == 1);
+		CHECK(blockers[0].Object == 7);
+		CHECK_NEAR(blockers[0].WorldBounds.Center.x, 10.0, 1e-4);
+		CHECK_NEAR(blockers[0].WorldBounds.Extents.x, (2.0 + 0.1) * 0.70710678, 1e-3);
+		CHECK_NEAR(blockers[0].LocalBox.Extents.x, 2.0, 1e-6);
+	}
+
+	//the same scene bakes to the same bytes whatever the threads do, and survives a save
+	void TestBakesAreReproducibleAndSaved()
+	{
+		std::mt19937 random(62);
+		std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+		std::vector<BoundingBox> bounds;
+		for (int i = 0; i < 40; i++)
+			bounds.emplace_back(XMFLOAT3(position(random), position(random) * 0.2f, position(random)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		std::vector<PvsBlocker> blockers;
+		for (int i = 0; i < 10; i++)
+		{
+			const XMFLOAT3 center(position(random), 0.0f, position(random));
+			const XMMATRIX world = XMMatrixRotationY(position(random)) * XMMatrixTranslation(center.x, center.y, center.z);
+			PvsBaker::AddBlockers(BoxOccluder(XMFLOAT3(-6.0f, -10.0f, -0.5f), XMFLOAT3(6.0f, 10.0f, 0.5f)), world, -1, blockers);
+		}
+
+		PvsBakeSettings settings;
+		settings.CellSamples = 8;
+		settings.TargetSamples = 8;
+		WorkerPool one(1);
+		WorkerPool four(4);
+		const PotentiallyVisibleSet a = PvsBaker::Bake(bounds, blockers, settings, one);
+		const PotentiallyVisibleSet b = PvsBaker::Bake(bounds, blockers, settings, four);
+
+		const fs::path folder = fs::temp_directory_path() / "objectloader_pvs_tests";
+		std::error_code error;
+		fs::remove_all(folder, error);
+		fs::create_directories(folder);
+		CHECK(a.Save((folder / "a.pvs").string()));
+		CHECK(b.Save((folder / "b.pvs").string()));
+		const std::vector<char> bytesA = ReadBytes(folder / "a.pvs");
+		const std::vector<char> bytesB = ReadBytes(folder / "b.pvs");
+		CHECK(!bytesA.empty());
+		CHECK(bytesA == bytesB);
+
+		PotentiallyVisibleSet loaded;
+		CHECK(loaded.Load((folder / "a.pvs").string()));
+		CHECK(loaded.CellCount() == a.CellCount());
+		CHECK(loaded.Matches(bounds));
+		bool same = true;
+		for (int cell = 0; cell < a.CellCount(); cell++)
+		{
+			VisibilityMask expected;
+			VisibilityMask actual;
+			a.Decode(cell, expected);
+			loaded.Decode(cell, actual);
+			same = same && expected.Words() == actual.Words();
+		}
+		CHECK(same);
+
+		//a moved box no longer matches, a cut file does not load and leaves the set as it was
+		std::vector<BoundingBox> moved = bounds;
+		moved[3].Center.x += 0.01f;
+		CHECK(!loaded.Matches(moved));
+		std::ofstream cut(folder / "cut.pvs", std::ios::binary);
+		cut.write(bytesA.data(), static_cast<std::streamsize>(bytesA.size() / 2));
+		cut.close();
+		CHECK(!loaded.Load((folder / "cut.pvs").string()));
+		CHECK(loaded.Matches(bounds));
+		fs::remove_all(folder, error);
+	}
+}
+
+int main()
+{
+	TestEncodeRoundTrips();
+	TestWallHidesTheOtherRoom();
+	TestDoorLetsTheRoomsSeeEachOther();
+	TestCellsInsideWallsAreSolid();
+	TestBlockersFollowTheirObject();
+	TestBakesAreReproducibleAndSaved();
+	return CheckResult();
+}
@@ -0,0 +1,85 @@
+#include "Check.h"
+#include "SceneBvh.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//frustum culling per frame of a camera turning through a scattered scene:
+//a loop over every box, the simd kernel over every box, and the bvh.
+//usage: SceneBvhBench [objects = 20000] [frames = 200]
+int main(int argc, char** argv)
+{
+	const int objectCount = argc > 1 ? std::atoi(argv[1]) : 20000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::vector<BoundingBox> boxes;
+	for (int i = 0; i < objectCount; i++)
+		boxes.emplace_back(XMFLOAT3(position(random), position(random) * 0.1f, position(random)), XMFLOAT3(size(random), size(random), size(random)));
+
+	std::vector<CullingPlanes> planes;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const float yaw = frame * XM_2PI / frames;
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 300.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(yaw) * XMMatrixTranslation(100.0f * std::cos(yaw), 2.0f, 100.0f * std::sin(yaw)));
+		planes.push_back(CullingPlanes::FromFrustum(frustum));
+	}
+
+	SceneBvh bvh;
+	const double buildMs = MeasureMs([&]() { bvh.Build(boxes); });
+
+	size_t loopCount = 0;
+	const double loopMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				for (const BoundingBox& box : boxes)
+					loopCount += frame.Contains(box) != DISJOINT;
+			}
+		});
+
+	AabbSoa soa;
+	soa.Resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+		soa.Set(i, boxes[i]);
+	VisibilityMask visible;
+	size_t kernelCount = 0;
+	const double kernelMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				CullingKernel::Cull(frame, soa, visible);
+				kernelCount += visible.Count();
+			}
+		});
+
+	size_t bvhCount = 0;
+	std::vector<int> result;
+	const double bvhMs = MeasureMs([&]()
+		{
+			for (const CullingPlanes& frame : planes)
+			{
+				result.clear();
+				bvh.Query(frame, result);
+				bvhCount += result.size();
+			}
+		});
+
+	//all three have to find the same boxes, otherwise the comparison means nothing
+	CHECK(loopCount == kernelCount);
+	CHECK(loopCount == bvhCount);
+
+	std::printf("%d objects, %d frames, %zu visible per frame, depth %d\n", objectCount, frames, frames > 0 ? bvhCount / frames : 0, bvh.Depth());
+	std::printf("build:  %8.4f ms\n", buildMs);
+	std::printf("loop:   %8.4f ms/frame\n", loopMs / frames);
+	std::printf("kernel: %8.4f ms/frame (%.1fx)\n", kernelMs / frames, kernelMs > 0.0 ? loopMs / kernelMs : 0.0);
+	std::printf("bvh:    %8.4f ms/frame (%.1fx)\n", bvhMs / frames, bvhMs > 0.0 ? loopMs / bvhMs : 0.0);
+	return CheckResult();
+}
@@ -0,0 +1,167 @@
+#include "Check.h"
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//every query against a plain loop over the boxes, on scattered, stacked and badly spread scenes
+namespace
+{
+	std::vector<BoundingBox> RandomBoxes(const int count, const unsigned seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> size(0.1f, 4.0f);
+		std::vector<BoundingBox> boxes;
+		for (int i = 0; i < count; i++)
+			boxes.emplace_back(XMFLOAT3(position(random), position(random), position(random)), XMFLOAT3(size(random), size(random), size(random)));
+		return boxes;
+	}
+
+	BoundingFrustum CameraFrustum(const XMFLOAT3& position, const float yaw)
+	{
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 150.0f));
+		frustum.Transform(frustum, XMMatrixRotationY(yaw) * XMMatrixTranslation(position.x, position.y, position.z));
+		return frustum;
+	}
+
+	template<typename Volume>
+	std::vector<int> BruteForce(const std::vector<BoundingBox>& boxes, const Volume& volume)
+	{
+		std::vector<int> result;
+		for (int i = 0; i < static_cast<int>(boxes.size()); i++)
+		{
+			if (volume.Contains(boxes[i]) != DISJOINT)
+				result.push_back(i);
+		}
+		return result;
+	}
+
+	template<typename Volume>
+	bool MatchesBruteForce(const SceneBvh& bvh, const std::vector<BoundingBox>& boxes, const Volume& volume)
+	{
+		std::vector<int> result;
+		bvh.Query(volume, result);
+		std::sort(result.begin(), result.end());
+		return result == BruteForce(boxes, volume);
+	}
+
+	//frustums, spheres, boxes and the plane sets the simd kernel tests
+	bool AllQueriesMatch(const SceneBvh& bvh, const std::vector<BoundingBox>& boxes)
+	{
+		bool same = true;
+		for (int i = 0; i < 16; i++)
+		{
+			const float angle = i * XM_2PI / 16.0f;
+			const XMFLOAT3 position(40.0f * std::cos(angle), 5.0f * (i % 3), 40.0f * std::sin(angle));
+			const BoundingFrustum frustum = CameraFrustum(position, angle * 2.0f);
+			same &= MatchesBruteForce(bvh, boxes, frustum);
+			same &= MatchesBruteForce(bvh, boxes, CullingPlanes::FromFrustum(frustum));
+			same &= MatchesBruteForce(bvh, boxes, BoundingSphere(position, 10.0f + 5.0f * i));
+			same &= MatchesBruteForce(bvh, boxes, BoundingBox(position, XMFLOAT3(20.0f, 3.0f + i, 8.0f)));
+		}
+		return same;
+	}
+
+	void TestEmpty()
+	{
+		SceneBvh bvh;
+		bvh.Build({});
+		std::vector<int> result;
+		bvh.Query(BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 1e6f), result);
+		CHECK(result.empty());
+		CHECK(bvh.Size() == 0);
+	}
+
+	void TestRandomScene()
+	{
+		const std::vector<BoundingBox> boxes = RandomBoxes(3000, 1);
+		SceneBvh bvh;
+		bvh.Build(boxes);
+		CHECK(bvh.Size() == boxes.size());
+		CHECK(AllQueriesMatch(bvh, boxes));
+		CHECK(bvh.Depth() <= SceneBvh::MaxDepth);
+	}
+
+	void TestRefitFollowsMovedBoxes()
+	{
+		std::vector<BoundingBox> boxes = RandomBoxes(1000, 2);
+		SceneBvh bvh;
+		bvh.Build(boxes);
+		for (BoundingBox& box : boxes)
+			box.Center.y += 30.0f * std::sin(box.Center.x);
+		bvh.Refit(boxes);
+		CHECK(bvh.BuildCount() == 1);
+		CHECK(AllQueriesMatch(bvh, boxes));
+
+		//a changed count always rebuilds
+		boxes.pop_back();
+		bvh.Update(boxes);
+		CHECK(bvh.BuildCount() == 2);
+		CHECK(AllQueriesMatch(bvh, boxes));
+	}
+
+	//one spot for every centroid, sah has nothing to split and the median takes over at once
+	void TestStackedBoxes()
+	{
+		const std::vector<BoundingBox> boxes(5000, BoundingBox(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		SceneBvh bvh;
+		bvh.Build(boxes);
+		CHECK(bvh.Depth() <= SceneBvh::MaxDepth);
+		std::vector<int> result;
+		bvh.Query(BoundingSphere(XMFLOAT3(1.0f, 2.0f, 3.0f), 0.1f), result);
+		CHECK(result.size() == boxes.size());
+		CHECK(AllQueriesMatch(bvh, boxes));
+	}
+
+	//points spreading out geometrically: every sah split peels a single box off the far end,
+	//the depth limit has to hand over to median splits before the stack would overflow
+	void TestGeometricSpread()
+	{
+		std::vector<BoundingBox> boxes;
+		for (int i = 0; i < 400; i++)
+			boxes.emplace_back(XMFLOAT3(std::pow(1.2f, static_cast<float>(i)) - 1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		SceneBvh bvh;
+		bvh.Build(boxes);
+		CHECK(bvh.Depth() <= SceneBvh::MaxDepth);
+		CHECK(bvh.Depth() > 20);
+		CHECK(MatchesBruteForce(bvh, boxes, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(50.0f, 1.0f, 1.0f))));
+		CHECK(MatchesBruteForce(bvh, boxes, BoundingBox(XMFLOAT3(1e20f, 0.0f, 0.0f), XMFLOAT3(1e20f, 1.0f, 1.0f))));
+		CHECK(MatchesBruteForce(bvh, boxes, BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 1e30f)));
+	}
+
+	//flat boxes on a line and a plane, extents of zero on some axes
+	void TestFlatScenes()
+	{
+		std::vector<BoundingBox> line;
+		std::vector<BoundingBox> plane;
+		for (int i = 0; i < 2000; i++)
+		{
+			line.emplace_back(XMFLOAT3(static_cast<float>(i % 37), 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+			plane.emplace_back(XMFLOAT3(static_cast<float>(i % 50) * 2.0f - 50.0f, 0.0f, static_cast<float>(i / 50) * 2.0f - 40.0f),
+				XMFLOAT3(1.0f, 0.0f, 1.0f));
+		}
+		for (const auto* boxes : { &line, &plane })
+		{
+			SceneBvh bvh;
+			bvh.Build(*boxes);
+			CHECK(bvh.Depth() <= SceneBvh::MaxDepth);
+			CHECK(AllQueriesMatch(bvh, *boxes));
+		}
+	}
+}
+
+int main()
+{
+	TestEmpty();
+	TestRandomScene();
+	TestRefitFollowsMovedBoxes();
+	TestStackedBoxes();
+	TestGeometricSpread();
+	TestFlatScenes();
+	return CheckResult();
+}
@@ -0,0 +1,161 @@
+#include "Check.h"
+#include "SubmeshBounds.h"
+#include "CullingKernel.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//a culled submesh may not have a single point inside the volume, and culling one never
+//keeps a submesh its object was culled without
+namespace
+{
+	bool PointOutside(const CullingPlanes& planes, const XMFLOAT3& p)
+	{
+		for (const XMFLOAT4& plane : planes.Planes)
+		{
+			if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w > 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	XMFLOAT3 Transformed(const XMFLOAT3& p, CXMMATRIX m)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3TransformCoord(XMLoadFloat3(&p), m));
+		return result;
+	}
+
+	XMMATRIX RandomWorld(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		return XMMatrixScaling(0.5f + unit(random) * 2.0f, 0.5f + unit(random) * 2.0f, 0.5f + unit(random) * 2.0f) *
+			XMMatrixRotationRollPitchYaw(unit(random) * XM_2PI, unit(random) * XM_2PI, unit(random) * XM_2PI) *
+			XMMatrixTranslation(unit(random) * 40.0f - 20.0f, unit(random) * 10.0f - 5.0f, unit(random) * 40.0f - 20.0f);
+	}
+
+	void TestOnlySeveralSubmeshesAreCulled()
+	{
+		CHECK(!CullsSubmeshes(0));
+		CHECK(!CullsSubmeshes(1));
+		CHECK(CullsSubmeshes(2));
+	}
+
+	//every vertex a submesh can have is inside its world box, whatever the two transforms do
+	void TestWorldBoundsHoldTheVertices()
+	{
+		std::mt19937 random(31);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		bool inside = true;
+		for (int i = 0; i < 200; i++)
+		{
+			const BoundingBox local(XMFLOAT3(unit(random) * 4.0f - 2.0f, unit(random), unit(random) - 0.5f),
+				XMFLOAT3(0.1f + unit(random), 0.1f + unit(random), 0.1f + unit(random)));
+			const XMMATRIX meshWorld = RandomWorld(random);
+			const XMMATRIX objectWorld = RandomWorld(random);
+			const BoundingBox world = SubmeshWorldBounds(local, meshWorld, objectWorld);
+
+			XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+			local.GetCorners(corners);
+			for (const XMFLOAT3& corner : corners)
+			{
+				const XMFLOAT3 p = Transformed(corner, meshWorld * objectWorld);
+				BoundingBox grown = world;
+				grown.Extents = XMFLOAT3(world.Extents.x + 1e-3f, world.Extents.y + 1e-3f, world.Extents.z + 1e-3f);
+				inside = inside && grown.Contains(XMLoadFloat3(&p)) != DISJOINT;
+			}
+		}
+		CHECK(inside);
+
+		//a pure translation keeps the box as it is
+		const BoundingBox local(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(0.5f, 1.0f, 1.5f));
+		const BoundingBox moved = SubmeshWorldBounds(local, XMMatrixTranslation(1.0f, 0.0f, 0.0f), XMMatrixTranslation(0.0f, -2.0f, 4.0f));
+		CHECK_NEAR(moved.Center.x, 2.0, 1e-6);
+		CHECK_NEAR(moved.Center.y, 0.0, 1e-6);
+		CHECK_NEAR(moved.Center.z, 7.0, 1e-6);
+		CHECK_NEAR(moved.Extents.z, 1.5, 1e-6);
+	}
+
+	//displaced along a unit normal by up to the reach, the surface still stays in the box
+	void TestReachGrowsEverySide()
+	{
+		const BoundingBox local(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		const BoundingBox world = SubmeshWorldBounds(local, XMMatrixIdentity(), XMMatrixTranslation(5.0f, 0.0f, 0.0f), 0.25f);
+		CHECK_NEAR(world.Extents.x, 1.25, 1e-6);
+		CHECK_NEAR(world.Extents.y, 1.25, 1e-6);
+		CHECK_NEAR(world.Extents.z, 1.25, 1e-6);
+		CHECK(world.Contains(XMVectorSet(6.0f + 0.25f * 0.577f, 1.0f + 0.25f * 0.577f, 1.0f + 0.25f * 0.577f, 1.0f)) != DISJOINT);
+		CHECK(SubmeshWorldBounds(local, XMMatrixIdentity(), XMMatrixIdentity(), 0.0f).Extents.x == 1.0f);
+	}
+
+	//objects made of a row of submeshes under random transforms and frustums
+	void TestCulledSubmeshesAreOutside()
+	{
+		std::mt19937 random(32);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		int culled = 0;
+		int kept = 0;
+		bool wrong = false;
+		bool outlivesObject = false;
+		for (int scene = 0; scene < 100; scene++)
+		{
+			BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 60.0f));
+			frustum.Transform(frustum, XMMatrixRotationY(unit(random) * XM_2PI) * XMMatrixTranslation(0.0f, 0.0f, -10.0f));
+			const CullingPlanes planes = CullingPlanes::FromFrustum(frustum);
+			const XMMATRIX objectWorld = RandomWorld(random);
+
+			std::vector<BoundingBox> locals;
+			std::vector<XMMATRIX> meshWorlds;
+			BoundingBox object;
+			for (int s = 0; s < 8; s++)
+			{
+				locals.emplace_back(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f + unit(random), 0.5f, 0.5f + unit(random)));
+				meshWorlds.push_back(XMMatrixRotationY(unit(random)) * XMMatrixTranslation(s * 3.0f - 12.0f, 0.0f, unit(random) * 4.0f));
+				BoundingBox placed;
+				locals.back().Transform(placed, meshWorlds.back());
+				if (s == 0)
+					object = placed;
+				else
+					BoundingBox::CreateMerged(object, object, placed);
+			}
+			BoundingBox objectWorldBox;
+			object.Transform(objectWorldBox, objectWorld);
+			const bool objectCulled = planes.Contains(objectWorldBox) == DISJOINT;
+
+			for (size_t s = 0; s < locals.size(); s++)
+			{
+				if (planes.Contains(SubmeshWorldBounds(locals[s], meshWorlds[s], objectWorld)) != DISJOINT)
+				{
+					kept++;
+					outlivesObject = outlivesObject || objectCulled;
+					continue;
+				}
+				culled++;
+
+				//points through the submesh box, all of them outside the frustum
+				const XMMATRIX toWorld = meshWorlds[s] * objectWorld;
+				for (int k = 0; k < 27; k++)
+				{
+					const XMFLOAT3 p(locals[s].Extents.x * (k % 3 - 1), locals[s].Extents.y * (k / 3 % 3 - 1), locals[s].Extents.z * (k / 9 - 1));
+					wrong = wrong || !PointOutside(planes, Transformed(p, toWorld));
+				}
+			}
+		}
+		CHECK(!wrong);
+		CHECK(!outlivesObject);
+		CHECK(culled > 50);
+		CHECK(kept > 50);
+	}
+}
+
+int main()
+{
+	TestOnlySeveralSubmeshesAreCulled();
+	TestWorldBoundsHoldTheVertices();
+	TestReachGrowsEverySide();
+	TestCulledSubmeshesAreOutside();
+	return CheckResult();
+}
@@ -0,0 +1,187 @@
+#include "Check.h"
+#include "TerrainHorizon.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+//whatever the horizon hides has to be hidden for real: every point of it that is on screen
+//sits behind one of the solid boxes that were added, seen from the camera
+namespace
+{
+	const float NearZ = 0.1f;
+
+	struct Camera
+	{
+		XMFLOAT3 Eye;
+		XMMATRIX View;
+		XMMATRIX Proj;
+	};
+
+	Camera LookingAlongZ(const float height, const float pitch = 0.0f)
+	{
+		Camera camera;
+		camera.Eye = XMFLOAT3(0.0f, height, 0.0f);
+		camera.View = XMMatrixTranslation(0.0f, -height, 0.0f) * XMMatrixRotationX(-pitch);
+		camera.Proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, NearZ, 500.0f);
+		return camera;
+	}
+
+	//the segment from a to b enters the box before it reaches b
+	bool SegmentHitsBox(const XMFLOAT3& a, const XMFLOAT3& b, const BoundingBox& box)
+	{
+		const float start[3] = { a.x, a.y, a.z };
+		const float end[3] = { b.x, b.y, b.z };
+		const float center[3] = { box.Center.x, box.Center.y, box.Center.z };
+		const float extents[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+		float enter = 0.0f;
+		float exit = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float d = end[axis] - start[axis];
+			const float min = center[axis] - extents[axis];
+			const float max = center[axis] + extents[axis];
+			if (std::abs(d) < 1e-9f)
+			{
+				if (start[axis] < min || start[axis] > max)
+					return false;
+				continue;
+			}
+			float t0 = (min - start[axis]) / d;
+			float t1 = (max - start[axis]) / d;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			enter = (std::max)(enter, t0);
+			exit = (std::min)(exit, t1);
+		}
+		return enter <= exit && enter < 1.0f;
+	}
+
+	bool OnScreen(const Camera& camera, const XMFLOAT3& point)
+	{
+		const XMVECTOR clip = XMVector4Transform(XMVectorSet(point.x, point.y, point.z, 1.0f), camera.View * camera.Proj);
+		const float w = XMVectorGetW(clip);
+		return w > NearZ && std::abs(XMVectorGetX(clip) / w) <= 1.0f && std::abs(XMVectorGetY(clip) / w) <= 1.0f;
+	}
+
+	bool HiddenForReal(const Camera& camera, const BoundingBox& box, const std::vector<BoundingBox>& occluders)
+	{
+		for (int k = 0; k < 4 * 4 * 4; k++)
+		{
+			const XMFLOAT3 point(
+				box.Center.x + box.Extents.x * (k % 4 / 1.5f - 1.0f),
+				box.Center.y + box.Extents.y * (k / 4 % 4 / 1.5f - 1.0f),
+				box.Center.z + box.Extents.z * (k / 16 / 1.5f - 1.0f));
+			if (!OnScreen(camera, point))
+				continue;
+			bool hidden = false;
+			for (size_t o = 0; o < occluders.size() && !hidden; o++)
+				hidden = SegmentHitsBox(camera.Eye, point, occluders[o]);
+			if (!hidden)
+				return false;
+		}
+		return true;
+	}
+
+	//ground tiles of random heights in front of the camera, then boxes scattered among them
+	void TestNoFalseOcclusion()
+	{
+		std::mt19937 random(101);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		int occluded = 0;
+		int tested = 0;
+		bool wrong = false;
+		for (int scene = 0; scene < 40; scene++)
+		{
+			const Camera camera = LookingAlongZ(1.0f + unit(random) * 4.0f, (unit(random) - 0.5f) * 0.4f);
+			TerrainHorizon horizon;
+			horizon.Begin(camera.View, camera.Proj, NearZ);
+
+			//front to back, the way the terrain sweeps its tiles
+			std::vector<BoundingBox> occluders;
+			for (int row = 0; row < 12; row++)
+			{
+				for (int col = -6; col < 6; col++)
+				{
+					const float height = unit(random) < 0.3f ? 2.0f + unit(random) * 12.0f : unit(random);
+					occluders.emplace_back(XMFLOAT3(col * 8.0f + 4.0f, height * 0.5f, 6.0f + row * 8.0f), XMFLOAT3(4.0f, height * 0.5f, 4.0f));
+					horizon.AddOccluder(occluders.back());
+				}
+			}
+
+			for (int i = 0; i < 400; i++)
+			{
+				const BoundingBox box(XMFLOAT3(unit(random) * 80.0f - 40.0f, unit(random) * 6.0f, 2.0f + unit(random) * 100.0f),
+					XMFLOAT3(0.2f + unit(random), 0.2f + unit(random), 0.2f + unit(random)));
+				tested++;
+				if (!horizon.IsOccluded(box))
+					continue;
+				occluded++;
+				wrong = wrong || !HiddenForReal(camera, box, occluders);
+			}
+		}
+		CHECK(!wrong);
+		//something has to be hidden, or the check above proves nothing
+		CHECK(occluded > tested / 20);
+	}
+
+	void TestWall()
+	{
+		const Camera camera = LookingAlongZ(2.0f);
+		TerrainHorizon horizon;
+		horizon.Begin(camera.View, camera.Proj, NearZ);
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 1.0f, 40.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+		const uint64_t empty = horizon.Signature();
+		//a ridge across the whole view, 6 units tall and 20 ahead
+		horizon.AddOccluder(BoundingBox(XMFLOAT3(0.0f, 3.0f, 20.0f), XMFLOAT3(200.0f, 3.0f, 2.0f)));
+		CHECK(horizon.Signature() != empty);
+
+		//behind it and below its top
+		CHECK(horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 1.0f, 40.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		//in front of it
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 1.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		//sticking out above it
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 12.0f, 40.0f), XMFLOAT3(1.0f, 6.0f, 1.0f))));
+		//crossing the near plane, or behind the camera
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 1.0f, -40.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+		//a ridge that covers less than it did adds nothing
+		const uint64_t ridge = horizon.Signature();
+		horizon.AddOccluder(BoundingBox(XMFLOAT3(0.0f, 1.0f, 30.0f), XMFLOAT3(200.0f, 1.0f, 2.0f)));
+		CHECK(horizon.Signature() == ridge);
+
+		//Begin forgets everything
+		horizon.Begin(camera.View, camera.Proj, NearZ);
+		CHECK(horizon.Signature() == empty);
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 1.0f, 40.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	}
+
+	//an occluder reaching behind the camera only uses the part in front of the near plane
+	void TestOccluderThroughTheNearPlane()
+	{
+		const Camera camera = LookingAlongZ(2.0f);
+		TerrainHorizon horizon;
+		horizon.Begin(camera.View, camera.Proj, NearZ, 64);
+		CHECK(horizon.Columns() == 64);
+		horizon.AddOccluder(BoundingBox(XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(100.0f, 0.5f, 30.0f)));
+		const std::vector<BoundingBox> occluders = { BoundingBox(XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(100.0f, 0.5f, 30.0f)) };
+
+		const BoundingBox low(XMFLOAT3(0.0f, 0.2f, 35.0f), XMFLOAT3(2.0f, 0.2f, 2.0f));
+		CHECK(horizon.IsOccluded(low));
+		CHECK(HiddenForReal(camera, low, occluders));
+		CHECK(!horizon.IsOccluded(BoundingBox(XMFLOAT3(0.0f, 3.0f, 35.0f), XMFLOAT3(2.0f, 1.0f, 2.0f))));
+	}
+}
+
+int main()
+{
+	TestNoFalseOcclusion();
+	TestWall();
+	TestOccluderThroughTheNearPlane();
+	return CheckResult();
+}
@@ -0,0 +1,124 @@
+#include "Check.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace
+{
+	//smooth gradients with a little noise, normals for the normal role, the same kind of image the cooker tests use
+	DirectX::ScratchImage SyntheticImage(const size_t size, const TextureRole role)
+	{
+		DirectX::ScratchImage image;
+		image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1);
+		std::mt19937 random(static_cast<unsigned>(size) + static_cast<unsigned>(role));
+		std::uniform_int_distribution<int> noise(-3, 3);
+		const DirectX::Image* top = image.GetImage(0, 0, 0);
+		for (size_t y = 0; y < size; y++)
+		{
+			std::uint8_t* row = top->pixels + y * top->rowPitch;
+			for (size_t x = 0; x < size; x++)
+			{
+				const float u = static_cast<float>(x) / size;
+				const float v = static_cast<float>(y) / size;
+				float channels[4] = { 0.5f + 0.4f * std::sin(u * 6.0f), 0.5f + 0.4f * std::cos(v * 5.0f), 0.3f + 0.3f * u * v, 1.0f };
+				if (role == TextureRole::Normal)
+				{
+					const float nx = 0.4f * std::sin(u * 6.0f);
+					const float ny = 0.4f * std::cos(v * 5.0f);
+					channels[0] = nx * 0.5f + 0.5f;
+					channels[1] = ny * 0.5f + 0.5f;
+					channels[2] = std::sqrt(1.0f - nx * nx - ny * ny) * 0.5f + 0.5f;
+				}
+				for (int c = 0; c < 4; c++)
+				{
+					const int value = static_cast<int>(channels[c] * 255.0f + 0.5f) + (c < 3 ? noise(random) : 0);
+					row[x * 4 + c] = static_cast<std::uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+				}
+			}
+		}
+		return image;
+	}
+
+	//over the channels the cooked format keeps, decoded as stored with no gamma conversion on the way back
+	double CookedPsnr(const DirectX::ScratchImage& source, const DirectX::ScratchImage& cooked, const int channels)
+	{
+		const DXGI_FORMAT cookedFormat = cooked.GetMetadata().format;
+		DirectX::ScratchImage decoded;
+		const DXGI_FORMAT decodedFormat = DirectX::IsSRGB(cookedFormat) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		if (FAILED(DirectX::Decompress(*cooked.GetImage(0, 0, 0), decodedFormat, decoded)))
+			return 0.0;
+
+		const DirectX::Image& original = *source.GetImage(0, 0, 0);
+		const DirectX::Image& result = *decoded.GetImage(0, 0, 0);
+		double squared = 0.0;
+		for (size_t y = 0; y < original.height; y++)
+		{
+			for (size_t x = 0; x < original.width; x++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					const double difference = static_cast<double>(original.pixels[y * original.rowPitch + x * 4 + c]) -
+						result.pixels[y * result.rowPitch + x * 4 + c];
+					squared += difference * difference;
+				}
+			}
+		}
+		const double mse = squared / (static_cast<double>(original.width) * original.height * channels);
+		return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+}
+
+//Fast and High cooks of one synthetic image per role, the import path against the background refinement,
+//as source megapixels per second and the psnr each one reaches.
+//usage: TextureCookerBench [size = 1024] [repeats = 3]
+int main(int argc, char** argv)
+{
+	//block compression needs whole 4x4 blocks
+	const size_t size = (argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 1024) & ~size_t(3);
+	const int repeats = argc > 2 ? (std::max)(1, std::atoi(argv[2])) : 3;
+
+	struct Case
+	{
+		const char* Name;
+		TextureRole Role;
+		int Channels;
+	};
+	const Case cases[] = {
+		{ "color", TextureRole::Color, 3 },
+		{ "data", TextureRole::Data, 4 },
+		{ "normal", TextureRole::Normal, 2 },
+		{ "mask", TextureRole::Mask, 1 },
+	};
+	const CookQuality qualities[] = { CookQuality::Fast, CookQuality::High };
+
+	const double megapixels = static_cast<double>(size) * size * repeats / 1.0e6;
+	std::printf("%zux%zu, %d cooks per quality\n", size, size, repeats);
+	for (const Case& test : cases)
+	{
+		const DirectX::ScratchImage source = SyntheticImage(size, test.Role);
+		double psnr[2] = {};
+		for (int q = 0; q < 2; q++)
+		{
+			DirectX::ScratchImage cooked;
+			bool cookedAll = true;
+			const double ms = MeasureMs([&]()
+				{
+					for (int i = 0; i < repeats; i++)
+						cookedAll = TextureCooker::Cook(source, test.Role, qualities[q], cooked) == S_OK && cookedAll;
+				});
+			CHECK(cookedAll);
+			psnr[q] = cookedAll ? CookedPsnr(source, cooked, test.Channels) : 0.0;
+			std::printf("%-6s %-4s: %10.3f ms/cook, %8.2f MPix/s, %6.2f dB\n", test.Name, q == 0 ? "fast" : "high",
+				ms / repeats, ms > 0.0 ? megapixels / (ms / 1000.0) : 0.0, psnr[q]);
+		}
+		//the same bounds the cooker tests hold the 64x64 image to
+		CHECK(psnr[0] >= 38.0);
+		CHECK(psnr[1] >= psnr[0] - 0.25);
+	}
+	return CheckResult();
+}
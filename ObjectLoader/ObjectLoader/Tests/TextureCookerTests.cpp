@@ -0,0 +1,256 @@
+#include "Check.h"
+#include "TextureCooker.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+//cache keys and cook quality of the texture cooker, without wic: sources are written as raw files
+//and the images are synthetic, so this runs wherever DirectXTex builds
+namespace
+{
+	namespace fs = std::filesystem;
+
+	fs::path TempFolder()
+	{
+		const fs::path folder = fs::temp_directory_path() / "objectloader_cooker_tests";
+		std::error_code error;
+		fs::remove_all(folder, error);
+		fs::create_directories(folder);
+		return folder;
+	}
+
+	void WriteFile(const fs::path& path, const std::string& content)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << content;
+	}
+
+	//smooth gradients with a little noise, roughly what photographed albedo looks like to bc7
+	DirectX::ScratchImage SyntheticImage(const size_t size, const TextureRole role)
+	{
+		DirectX::ScratchImage image;
+		image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1);
+		std::mt19937 random(static_cast<unsigned>(size) + static_cast<unsigned>(role));
+		std::uniform_int_distribution<int> noise(-3, 3);
+		const DirectX::Image* top = image.GetImage(0, 0, 0);
+		for (size_t y = 0; y < size; y++)
+		{
+			std::uint8_t* row = top->pixels + y * top->rowPitch;
+			for (size_t x = 0; x < size; x++)
+			{
+				const float u = static_cast<float>(x) / size;
+				const float v = static_cast<float>(y) / size;
+				float r = 0.5f + 0.4f * std::sin(u * 6.0f);
+				float g = 0.5f + 0.4f * std::cos(v * 5.0f);
+				float b = 0.3f + 0.3f * u * v;
+				if (role == TextureRole::Normal)
+				{
+					//unit normals leaning with the gradient
+					const float nx = 0.4f * std::sin(u * 6.0f);
+					const float ny = 0.4f * std::cos(v * 5.0f);
+					const float nz = std::sqrt(1.0f - nx * nx - ny * ny);
+					r = nx * 0.5f + 0.5f;
+					g = ny * 0.5f + 0.5f;
+					b = nz * 0.5f + 0.5f;
+				}
+				const float channels[4] = { r, g, b, 1.0f };
+				for (int c = 0; c < 4; c++)
+				{
+					const int value = static_cast<int>(channels[c] * 255.0f + 0.5f) + (c < 3 ? noise(random) : 0);
+					row[x * 4 + c] = static_cast<std::uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+				}
+			}
+		}
+		return image;
+	}
+
+	//over the channels the cooked format keeps
+	double Psnr(const DirectX::Image& original, const DirectX::Image& decoded, const int channels)
+	{
+		double squared = 0.0;
+		for (size_t y = 0; y < original.height; y++)
+		{
+			for (size_t x = 0; x < original.width; x++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					const double difference = static_cast<double>(original.pixels[y * original.rowPitch + x * 4 + c]) -
+						decoded.pixels[y * decoded.rowPitch + x * 4 + c];
+					squared += difference * difference;
+				}
+			}
+		}
+		const double mse = squared / (static_cast<double>(original.width) * original.height * channels);
+		return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	double CookedPsnr(const TextureRole role, const CookQuality quality, const int channels, DXGI_FORMAT& cookedFormat)
+	{
+		const DirectX::ScratchImage source = SyntheticImage(64, role);
+		DirectX::ScratchImage cooked;
+		if (TextureCooker::Cook(source, role, quality, cooked) != S_OK)
+		{
+			return 0.0;
+		}
+		cookedFormat = cooked.GetMetadata().format;
+
+		//decoded as stored, no gamma conversion on the way back
+		DirectX::ScratchImage decoded;
+		const DXGI_FORMAT decodedFormat = DirectX::IsSRGB(cookedFormat) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		if (FAILED(DirectX::Decompress(*cooked.GetImage(0, 0, 0), decodedFormat, decoded)))
+		{
+			return 0.0;
+		}
+		return Psnr(*source.GetImage(0, 0, 0), *decoded.GetImage(0, 0, 0), channels);
+	}
+
+	void TestCookedFormats()
+	{
+		DirectX::TexMetadata metadata = {};
+		metadata.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		CHECK(TextureCooker::CookedFormat(metadata, TextureRole::Color) == DXGI_FORMAT_BC7_UNORM_SRGB);
+		CHECK(TextureCooker::CookedFormat(metadata, TextureRole::Data) == DXGI_FORMAT_BC7_UNORM);
+		CHECK(TextureCooker::CookedFormat(metadata, TextureRole::Normal) == DXGI_FORMAT_BC5_UNORM);
+		CHECK(TextureCooker::CookedFormat(metadata, TextureRole::Mask) == DXGI_FORMAT_BC4_UNORM);
+		CHECK(TextureCooker::HasRefinement(metadata, TextureRole::Color));
+		CHECK(!TextureCooker::HasRefinement(metadata, TextureRole::Normal));
+
+		metadata.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		CHECK(TextureCooker::CookedFormat(metadata, TextureRole::Color) == DXGI_FORMAT_BC6H_UF16);
+	}
+
+	void TestCookQuality()
+	{
+		struct Case
+		{
+			TextureRole Role;
+			int Channels;
+			DXGI_FORMAT Expected;
+			double MinPsnr;
+		};
+		const Case cases[] = {
+			{ TextureRole::Color, 3, DXGI_FORMAT_BC7_UNORM_SRGB, 38.0 },
+			{ TextureRole::Data, 4, DXGI_FORMAT_BC7_UNORM, 38.0 },
+			{ TextureRole::Normal, 2, DXGI_FORMAT_BC5_UNORM, 38.0 },
+			{ TextureRole::Mask, 1, DXGI_FORMAT_BC4_UNORM, 38.0 },
+		};
+		for (const Case& test : cases)
+		{
+			DXGI_FORMAT fastFormat = DXGI_FORMAT_UNKNOWN;
+			DXGI_FORMAT highFormat = DXGI_FORMAT_UNKNOWN;
+			const double fast = CookedPsnr(test.Role, CookQuality::Fast, test.Channels, fastFormat);
+			const double high = CookedPsnr(test.Role, CookQuality::High, test.Channels, highFormat);
+			std::printf("role %d: fast %.2f dB, high %.2f dB\n", static_cast<int>(test.Role), fast, high);
+			CHECK(fastFormat == test.Expected);
+			CHECK(highFormat == test.Expected);
+			//a gamma mistake on the color path shows up as a large drop here
+			CHECK(fast >= test.MinPsnr);
+			CHECK(high >= fast - 0.25);
+		}
+	}
+
+	void TestRejectsPartialBlocks()
+	{
+		DirectX::ScratchImage image;
+		image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, 6, 6, 1, 1);
+		DirectX::ScratchImage cooked;
+		CHECK(TextureCooker::Cook(image, TextureRole::Color, CookQuality::Fast, cooked) == E_INVALIDARG);
+	}
+
+	void TestCachePathUsesStamp(const fs::path& folder)
+	{
+		const fs::path source = folder / "albedo.png";
+		WriteFile(source, "first content");
+		const std::wstring first = TextureCooker::CachePath(source.wstring(), TextureRole::Color);
+		CHECK(!first.empty());
+		CHECK(fs::path(first).parent_path() == folder / ".texcache");
+		CHECK(fs::exists(folder / ".texcache" / "albedo.png.stamp"));
+		CHECK(TextureCooker::CachePath(source.wstring(), TextureRole::Color) == first);
+		CHECK(TextureCooker::CachePath(source.wstring(), TextureRole::Normal) != first);
+
+		//same size and write time, the stamp is trusted and the file is not read again
+		const fs::file_time_type writeTime = fs::last_write_time(source);
+		WriteFile(source, "other content");
+		fs::last_write_time(source, writeTime);
+		CHECK(TextureCooker::CachePath(source.wstring(), TextureRole::Color) == first);
+
+		//a newer write time makes it hash the content again
+		fs::last_write_time(source, writeTime + std::chrono::seconds(5));
+		const std::wstring edited = TextureCooker::CachePath(source.wstring(), TextureRole::Color);
+		CHECK(!edited.empty() && edited != first);
+
+		CHECK(TextureCooker::CachePath((folder / "missing.png").wstring(), TextureRole::Color).empty());
+	}
+
+	void TestEmbeddedCachePath(const fs::path& folder)
+	{
+		const std::string a = "embedded bytes a";
+		const std::string b = "embedded bytes b";
+		const std::wstring pathA = TextureCooker::EmbeddedCachePath(folder.wstring(), L"model__embedded_0", a.data(), a.size(), TextureRole::Color);
+		CHECK(fs::path(pathA).parent_path() == folder / ".texcache");
+		CHECK(pathA == TextureCooker::EmbeddedCachePath(folder.wstring(), L"model__embedded_0", a.data(), a.size(), TextureRole::Color));
+		CHECK(pathA != TextureCooker::EmbeddedCachePath(folder.wstring(), L"model__embedded_0", b.data(), b.size(), TextureRole::Color));
+		CHECK(TextureCooker::EmbeddedCachePath(folder.wstring(), L"model__embedded_0", nullptr, 0, TextureRole::Color).empty());
+	}
+
+	void TestStoreRoundTrip(const fs::path& folder)
+	{
+		const DirectX::ScratchImage source = SyntheticImage(16, TextureRole::Color);
+		DirectX::ScratchImage cooked;
+		CHECK(TextureCooker::Cook(source, TextureRole::Color, CookQuality::Fast, cooked) == S_OK);
+
+		const std::wstring path = (folder / "nested" / ".texcache" / "albedo_cs.dds").wstring();
+		CHECK(!TextureCooker::IsCached(path));
+		CHECK(SUCCEEDED(TextureCooker::Store(cooked, path)));
+		CHECK(TextureCooker::IsCached(path));
+
+		DirectX::ScratchImage loaded;
+		CHECK(SUCCEEDED(DirectX::LoadFromDDSFile(path.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, loaded)));
+		CHECK(loaded.GetMetadata().format == DXGI_FORMAT_BC7_UNORM_SRGB);
+
+		TextureCooker::Remove(path);
+		CHECK(!TextureCooker::IsCached(path));
+	}
+
+	void TestCancel()
+	{
+		const DirectX::ScratchImage source = SyntheticImage(64, TextureRole::Color);
+		DirectX::ScratchImage plain;
+		CHECK(TextureCooker::Cook(source, TextureRole::Color, CookQuality::High, plain) == S_OK);
+
+		//an unset flag encodes per subresource but has to give the same blocks
+		std::atomic<bool> cancel{ false };
+		DirectX::ScratchImage cancellable;
+		CHECK(TextureCooker::Cook(source, TextureRole::Color, CookQuality::High, cancellable, &cancel) == S_OK);
+		CHECK(cancellable.GetMetadata().format == plain.GetMetadata().format);
+		CHECK(cancellable.GetPixelsSize() == plain.GetPixelsSize());
+		CHECK(std::memcmp(cancellable.GetPixels(), plain.GetPixels(), plain.GetPixelsSize()) == 0);
+
+		cancel = true;
+		DirectX::ScratchImage aborted;
+		CHECK(TextureCooker::Cook(source, TextureRole::Color, CookQuality::High, aborted, &cancel) == E_ABORT);
+		CHECK(aborted.GetImageCount() == 0);
+	}
+}
+
+int main()
+{
+	const fs::path folder = TempFolder();
+	TestCookedFormats();
+	TestCookQuality();
+	TestRejectsPartialBlocks();
+	TestCachePathUsesStamp(folder);
+	TestEmbeddedCachePath(folder);
+	TestStoreRoundTrip(folder);
+	TestCancel();
+
+	std::error_code error;
+	fs::remove_all(folder, error);
+	return CheckResult();
+}
@@ -0,0 +1,176 @@
+#include "Check.h"
+#include "NameTable.h"
+#include "TextureSlots.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	void TestEmptySlots()
+	{
+		TextureSlots slots;
+		CHECK(!slots.IsLoaded(7));
+		CHECK(!slots.TryAcquire(7));
+		CHECK(slots.Used(7) == 0);
+		CHECK(slots.Label(7) == gInvalidNameId);
+		//ids far past anything touched so far and past the capacity are just empty
+		CHECK(!slots.TryAcquire(500000));
+		CHECK(!slots.TryAcquire(gInvalidNameId));
+		CHECK(!slots.Release(7));
+	}
+
+	void TestRefCount()
+	{
+		TextureSlots slots;
+		slots.Publish(3, TextureState::Loaded, 2, 11, 42);
+		CHECK(slots.IsLoaded(3));
+		CHECK(slots.Used(3) == 2);
+		CHECK(slots.SrvIndex(3) == 11);
+		CHECK(slots.Label(3) == 42);
+
+		CHECK(slots.TryAcquire(3, 3));
+		CHECK(slots.Used(3) == 5);
+		//a zero count only checks that the texture is there
+		CHECK(slots.TryAcquire(3, 0));
+		CHECK(slots.Used(3) == 5);
+
+		CHECK(!slots.Release(3, 4));
+		CHECK(slots.Release(3, 1));
+		CHECK(slots.Used(3) == 0);
+
+		//on its way out: never revived, the caller takes the lock and loads it again
+		CHECK(!slots.TryAcquire(3));
+		slots.Clear(3);
+		CHECK(!slots.IsLoaded(3));
+		CHECK(slots.SrvIndex(3) == 0);
+	}
+
+	void TestPendingIsAcquirable()
+	{
+		TextureSlots slots;
+		slots.Publish(5, TextureState::Pending, 1, 2, 5);
+		CHECK(slots.IsLoaded(5));
+		CHECK(slots.TryAcquire(5));
+		CHECK(slots.Used(5) == 2);
+		slots.SetState(5, TextureState::Loaded);
+		slots.SetSrvIndex(5, 9);
+		CHECK(slots.State(5) == TextureState::Loaded);
+		CHECK(slots.SrvIndex(5) == 9);
+		CHECK(slots.Used(5) == 2);
+	}
+
+	void TestDedupByPath()
+	{
+		//the same file reached twice shares one slot, a file of the same name elsewhere gets its own
+		TextureSlots slots;
+		const NameId first = NameTable::Intern("c:\\assets\\rock\\albedo.png");
+		const NameId again = NameTable::Intern("c:\\assets\\rock\\albedo.png");
+		const NameId other = NameTable::Intern("c:\\assets\\tree\\albedo.png");
+		CHECK(first == again);
+		CHECK(first != other);
+
+		slots.Publish(first, TextureState::Loaded, 1, 4, first);
+		CHECK(slots.TryAcquire(again));
+		CHECK(!slots.TryAcquire(other));
+		CHECK(slots.Used(first) == 2);
+	}
+
+	//the pattern TextureManager follows: acquire without the lock, otherwise lock, check again and load
+	struct Registry
+	{
+		TextureSlots Slots;
+		std::mutex Lock;
+		std::atomic<int> Loads{ 0 };
+		std::atomic<int> Retires{ 0 };
+
+		void Acquire(const NameId id)
+		{
+			if (Slots.TryAcquire(id))
+				return;
+			std::lock_guard<std::mutex> lock(Lock);
+			if (Slots.TryAcquire(id))
+				return;
+			Loads++;
+			Slots.Publish(id, TextureState::Loaded, 1, id, id);
+		}
+
+		void Release(const NameId id)
+		{
+			std::lock_guard<std::mutex> lock(Lock);
+			if (Slots.Release(id))
+			{
+				Retires++;
+				Slots.Clear(id);
+			}
+		}
+	};
+
+	void TestConcurrentLoadsDedup()
+	{
+		Registry registry;
+		const int threadCount = 8;
+		const int perThread = 2000;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&registry]()
+				{
+					for (int i = 0; i < perThread; i++)
+						registry.Acquire(1000 + static_cast<NameId>(i % 16));
+				});
+		}
+		for (auto& thread : threads)
+			thread.join();
+
+		//every texture was loaded once and counted by every acquire
+		CHECK(registry.Loads == 16);
+		int total = 0;
+		for (NameId id = 1000; id < 1016; id++)
+			total += registry.Slots.Used(id);
+		CHECK(total == threadCount * perThread);
+	}
+
+	void TestConcurrentAcquireRelease()
+	{
+		//pairs of acquire and release hammering few textures: counts end at zero,
+		//and every load is matched by exactly one retire
+		Registry registry;
+		const int threadCount = 8;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&registry, t]()
+				{
+					for (int i = 0; i < 5000; i++)
+					{
+						const NameId id = 2000 + static_cast<NameId>((i + t) % 4);
+						registry.Acquire(id);
+						registry.Release(id);
+					}
+				});
+		}
+		for (auto& thread : threads)
+			thread.join();
+
+		bool empty = true;
+		for (NameId id = 2000; id < 2004; id++)
+			empty = empty && registry.Slots.Used(id) == 0 && !registry.Slots.IsLoaded(id);
+		CHECK(empty);
+		CHECK(registry.Loads == registry.Retires);
+		CHECK(registry.Loads >= 4);
+	}
+}
+
+int main()
+{
+	TestEmptySlots();
+	TestRefCount();
+	TestPendingIsAcquirable();
+	TestDedupByPath();
+	TestConcurrentLoadsDedup();
+	TestConcurrentAcquireRelease();
+	return CheckResult();
+}
@@ -0,0 +1,143 @@
+#include "Check.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	void TestRunsEveryJob()
+	{
+		WorkerPool pool(4);
+		CHECK(pool.ThreadCount() == 4);
+
+		std::atomic<int> sum{ 0 };
+		for (int i = 1; i <= 1000; i++)
+			pool.Submit([&sum, i]() { sum += i; });
+		pool.WaitIdle();
+		CHECK(sum == 500500);
+		CHECK(pool.PendingCount() == 0);
+	}
+
+	void TestDefaultThreadCount()
+	{
+		WorkerPool pool;
+		CHECK(pool.ThreadCount() >= 1);
+	}
+
+	void TestSingleThreadKeepsOrder()
+	{
+		WorkerPool pool(1);
+		std::vector<int> order;
+		for (int i = 0; i < 100; i++)
+			pool.Submit([&order, i]() { order.push_back(i); });
+		pool.WaitIdle();
+		bool ordered = order.size() == 100;
+		for (size_t i = 0; ordered && i < order.size(); i++)
+			ordered = order[i] == static_cast<int>(i);
+		CHECK(ordered);
+	}
+
+	void TestDropPending()
+	{
+		WorkerPool pool(1);
+		std::promise<void> release;
+		std::shared_future<void> released = release.get_future().share();
+		std::atomic<bool> started{ false };
+		std::atomic<int> ran{ 0 };
+
+		//keeps the only thread busy so the rest stays queued
+		pool.Submit([&started, released, &ran]() { started = true; released.wait(); ran++; });
+		for (int i = 0; i < 10; i++)
+			pool.Submit([&ran]() { ran++; });
+		while (!started)
+			std::this_thread::yield();
+
+		CHECK(pool.PendingCount() == 11);
+		CHECK(pool.DropPending() == 10);
+		CHECK(pool.PendingCount() == 1);
+
+		//the running job is not interrupted
+		release.set_value();
+		pool.WaitIdle();
+		CHECK(ran == 1);
+	}
+
+	void TestShutdownFinishesQueue()
+	{
+		std::atomic<int> ran{ 0 };
+		WorkerPool pool(2);
+		for (int i = 0; i < 50; i++)
+		{
+			pool.Submit([&ran]()
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+					ran++;
+				});
+		}
+		pool.Shutdown();
+		CHECK(ran == 50);
+
+		//nothing runs after shutdown, a second one and the destructor are harmless
+		pool.Submit([&ran]() { ran++; });
+		pool.Shutdown();
+		CHECK(ran == 50);
+		CHECK(pool.PendingCount() == 0);
+	}
+
+	void TestDropThenShutdown()
+	{
+		//what the editor does on exit: queued jobs go, the running one finishes before the join returns
+		std::atomic<bool> finished{ false };
+		std::atomic<bool> started{ false };
+		std::atomic<int> dropped{ 0 };
+		{
+			WorkerPool pool(1);
+			pool.Submit([&started, &finished]()
+				{
+					started = true;
+					std::this_thread::sleep_for(std::chrono::milliseconds(20));
+					finished = true;
+				});
+			for (int i = 0; i < 10; i++)
+				pool.Submit([&dropped]() { dropped++; });
+			while (!started)
+				std::this_thread::yield();
+
+			pool.DropPending();
+			pool.Shutdown();
+			CHECK(finished);
+		}
+		CHECK(dropped == 0);
+	}
+
+	void TestJobsSubmittingJobs()
+	{
+		//a decode queueing its refinement into a second pool, shut down in the same order as on exit
+		std::atomic<int> refined{ 0 };
+		WorkerPool refine(1);
+		{
+			WorkerPool decode(2);
+			for (int i = 0; i < 20; i++)
+				decode.Submit([&refine, &refined]() { refine.Submit([&refined]() { refined++; }); });
+			decode.Shutdown();
+		}
+		refine.Shutdown();
+		CHECK(refined == 20);
+	}
+}
+
+int main()
+{
+	TestRunsEveryJob();
+	TestDefaultThreadCount();
+	TestSingleThreadKeepsOrder();
+	TestDropPending();
+	TestShutdownFinishesQueue();
+	TestDropThenShutdown();
+	TestJobsSubmittingJobs();
+	return CheckResult();
+}